@@ -14,10 +14,23 @@
 
 #include "application.h"
 
+global_variable platform_api Platform;
+
+#include "application_entity.cpp"
+#include "application_spatial_grid.cpp"
+#include "application_tile_map.cpp"
+#include "application_audio_effects.cpp"
+#include "application_audio_stream.cpp"
+#include "application_render.cpp"
+#include "application_rasterizer.cpp"
+#include "application_layer.cpp"
+#include "application_particle.cpp"
+#include "application_serialize.cpp"
+
 // output sound from the
-internal void ApplicationOutputSound(application_sound_output_buffer *sound_buffer, int tone_hz)
+internal void ApplicationOutputSound(application_sound_output_buffer *sound_buffer, int tone_hz, real32 *tone_phase)
 {
-    local_persist real32 t_sine;
+    real32 t_sine = *tone_phase;
     int16 tone_volume = 3000;
     int wave_period = sound_buffer->SamplesPerSecond/tone_hz;
 
@@ -34,56 +47,448 @@ internal void ApplicationOutputSound(application_sound_output_buffer *sound_buff
 
         t_sine += 2.0f*Pi32*1.0f/(real32)wave_period;
     }
+    *tone_phase = t_sine;
 }
 
 // render a cool blue, green gradient
-void RenderWeirdGradient(offscreen_graphics_buffer *buffer, int x_offset, int y_offset)
+template<pixel_format Format>
+internal void RenderWeirdGradient(offscreen_graphics_buffer *buffer, int x_offset, int y_offset)
 {
-    uint8 *row = (uint8 *)buffer->Memory;
+    typedef pixel_traits<Format> traits;
     for (int y = 0; y < buffer->Height; ++y) 
     {
-        uint32 *pixel = (uint32 *)row;
+        typename traits::pixel *pixel = GetPixelRow<Format>(buffer, y);
         for (int x = 0; x < buffer->Width; ++x) 
         {
-            
-
             uint8 blue = (uint8)(x + x_offset);
             uint8 green = (uint8)(y + y_offset);
-            *pixel++ = (green << 8) | blue;
+            *pixel++ = traits::Pack((green << 8) | blue);
+        }
+    }
+}
+
+struct render_gradient_job
+{
+    offscreen_graphics_buffer Band;
+    int XOffset;
+    int YOffset;
+};
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoRenderGradientJob)
+{
+    render_gradient_job *job = (render_gradient_job *)data;
+    DISPATCH_PIXEL_FORMAT(job->Band.Format, RenderWeirdGradient, &job->Band, job->XOffset, job->YOffset);
+}
+
+// split the gradient into horizontal bands, one job each
+internal void RenderWeirdGradientInParallel(platform_work_queue *queue, uint32 worker_thread_count,
+                                            memory_arena *frame_arena, offscreen_graphics_buffer *buffer,
+                                            int x_offset, int y_offset)
+{
+    // NOTE: a few more bands than threads so a slow thread doesn't hold up the rest
+    int band_count = 4*(worker_thread_count + 1);
+    if(band_count > buffer->Height)
+    {
+        band_count = buffer->Height;
+    }
+    int band_height = (buffer->Height + band_count - 1) / band_count;
+
+    platform_job_counter counter = {};
+    render_gradient_job *jobs = PushArray(frame_arena, band_count, render_gradient_job);
+    for(int band_idx = 0; band_idx < band_count; ++band_idx)
+    {
+        int min_y = band_idx*band_height;
+        int max_y = min_y + band_height;
+        if(max_y > buffer->Height)
+        {
+            max_y = buffer->Height;
+        }
+        if(min_y >= max_y)
+        {
+            break;
+        }
+
+        render_gradient_job *job = jobs + band_idx;
+        job->Band = *buffer;
+        job->Band.Memory = (uint8 *)buffer->Memory + min_y*buffer->Pitch;
+        job->Band.Height = max_y - min_y;
+        job->XOffset = x_offset;
+        job->YOffset = y_offset + min_y;
+        Platform.AddEntry(queue, DoRenderGradientJob, job, &counter);
+    }
+    Platform.WaitForCounter(queue, &counter);
+}
+
+// xorshift, good enough for scattering things around
+inline uint32 NextRandom(application_state *app_state)
+{
+    uint32 x = app_state->RandomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    app_state->RandomState = x;
+    return x;
+}
+
+// [0, 1]
+inline real32 RandomUnilateral(application_state *app_state)
+{
+    real32 result = (real32)(NextRandom(app_state) & 0xFFFFFF) / (real32)0xFFFFFF;
+    return result;
+}
+
+// [-1, 1]
+inline real32 RandomBilateral(application_state *app_state)
+{
+    real32 result = 2.0f*RandomUnilateral(app_state) - 1.0f;
+    return result;
+}
+
+internal void SpawnTestEntities(application_state *app_state, uint32 count, real32 width, real32 height)
+{
+    for(uint32 spawn_idx = 0; spawn_idx < count; ++spawn_idx)
+    {
+        real32 speed = 200.0f;
+        entity_handle handle = AddEntity(&app_state->Entities,
+                                         width*RandomUnilateral(app_state), height*RandomUnilateral(app_state),
+                                         speed*RandomBilateral(app_state), speed*RandomBilateral(app_state),
+                                         EntityFlag_Bounces|EntityFlag_Collides);
+        if(!handle.Generation)
+        {
+            break;
         }
+    }
+}
+
+internal void RemoveTestEntities(application_state *app_state, uint32 count)
+{
+    entity_store *entities = &app_state->Entities;
+    for(uint32 remove_idx = 0; (remove_idx < count) && entities->Count; ++remove_idx)
+    {
+        RemoveEntity(entities, GetEntityHandle(entities, 0));
+    }
+}
+
+#define TEST_ENTITY_SIZE 4
+#define HIGHLIGHT_PAIR_BUDGET_PER_ENTITY 16 // NOTE: the most pairs sized for up front, a uniform spread never gets near it
+
+struct move_entities_job
+{
+    entity_store *Entities;
+    uint32 FirstIdx;
+    uint32 OnePastLastIdx;
+    real32 dt;
+    real32 MaxX;
+    real32 MaxY;
+};
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoMoveEntitiesJob)
+{
+    move_entities_job *job = (move_entities_job *)data;
+    MoveEntities(job->Entities, job->FirstIdx, job->OnePastLastIdx, job->dt, 0.0f, 0.0f, job->MaxX, job->MaxY);
+}
+
+// NOTE: a multiple of 4 so no two jobs touch the same SIMD lanes
+#define MOVE_ENTITIES_JOB_SIZE (8*1024)
+
+internal void MoveEntitiesInParallel(platform_work_queue *queue, memory_arena *frame_arena, entity_store *entities,
+                                     real32 dt, real32 max_x, real32 max_y)
+{
+    uint32 job_count = (entities->Count + MOVE_ENTITIES_JOB_SIZE - 1) / MOVE_ENTITIES_JOB_SIZE;
+    move_entities_job *jobs = PushArray(frame_arena, job_count, move_entities_job);
+
+    platform_job_counter counter = {};
+    for(uint32 job_idx = 0; job_idx < job_count; ++job_idx)
+    {
+        move_entities_job *job = jobs + job_idx;
+        job->Entities = entities;
+        job->FirstIdx = job_idx*MOVE_ENTITIES_JOB_SIZE;
+        job->OnePastLastIdx = job->FirstIdx + MOVE_ENTITIES_JOB_SIZE;
+        if(job->OnePastLastIdx > entities->Count)
+        {
+            job->OnePastLastIdx = entities->Count;
+        }
+        job->dt = dt;
+        job->MaxX = max_x;
+        job->MaxY = max_y;
+        Platform.AddEntry(queue, DoMoveEntitiesJob, job, &counter);
+    }
+    Platform.WaitForCounter(queue, &counter);
+}
+
+// run the broad phase over every entity that collides and highlight the ones that overlap something
+internal void HighlightOverlappingEntities(entity_store *entities, memory_arena *frame_arena)
+{
+    uint32 count = entities->Count;
+    real32 *min_x = PushArrayAligned(frame_arena, count, real32, 16);
+    real32 *min_y = PushArrayAligned(frame_arena, count, real32, 16);
+    real32 *max_x = PushArrayAligned(frame_arena, count, real32, 16);
+    real32 *max_y = PushArrayAligned(frame_arena, count, real32, 16);
+    for(uint32 entity_idx = 0; entity_idx < count; ++entity_idx)
+    {
+        min_x[entity_idx] = entities->PositionX[entity_idx];
+        min_y[entity_idx] = entities->PositionY[entity_idx];
+        max_x[entity_idx] = entities->PositionX[entity_idx] + TEST_ENTITY_SIZE;
+        max_y[entity_idx] = entities->PositionY[entity_idx] + TEST_ENTITY_SIZE;
+        entities->Flags[entity_idx] &= ~EntityFlag_Highlighted;
+    }
+
+    spatial_grid grid = {};
+    BuildSpatialGrid(&grid, frame_arena, 2.0f*TEST_ENTITY_SIZE, count, min_x, min_y, max_x, max_y);
+
+    // NOTE: size for every pair the grid will test, but a pile up in a few cells makes that quadratic,
+    // so past a budget per entity size for the budget and make room for the real count if it's still short
+    uint64 candidate_pair_count = CountSpatialCandidatePairs(&grid);
+    uint64 pair_budget = (uint64)HIGHLIGHT_PAIR_BUDGET_PER_ENTITY*count;
+    uint32 max_pair_count = (uint32)((candidate_pair_count < pair_budget) ? candidate_pair_count : pair_budget);
+    spatial_pair *pairs = PushArray(frame_arena, max_pair_count, spatial_pair);
+    uint32 pair_count = GenerateSpatialPairs(&grid, pairs, max_pair_count);
+    if(pair_count > max_pair_count)
+    {
+        max_pair_count = pair_count;
+        pairs = PushArray(frame_arena, max_pair_count, spatial_pair);
+        pair_count = GenerateSpatialPairs(&grid, pairs, max_pair_count);
+        Assert(pair_count == max_pair_count);
+    }
+    for(uint32 pair_idx = 0; pair_idx < pair_count; ++pair_idx)
+    {
+        spatial_pair *pair = pairs + pair_idx;
+        if((entities->Flags[pair->A] & EntityFlag_Collides) && (entities->Flags[pair->B] & EntityFlag_Collides))
+        {
+            entities->Flags[pair->A] |= EntityFlag_Highlighted;
+            entities->Flags[pair->B] |= EntityFlag_Highlighted;
+        }
+    }
+}
+
+// plot every entity as a small square
+internal void RenderEntities(render_group *group, entity_store *entities)
+{
+    real32 size = (real32)TEST_ENTITY_SIZE;
+    for(uint32 entity_idx = 0; entity_idx < entities->Count; ++entity_idx)
+    {
+        v2 min = V2((real32)(int)entities->PositionX[entity_idx], (real32)(int)entities->PositionY[entity_idx]);
+        v2 max = min + V2(size, size);
+        if(entities->Flags[entity_idx] & EntityFlag_Highlighted)
+        {
+            // NOTE: overlapping highlights pile up, so crowded spots show up redder
+            PushRectangle(group, min, max, 0xA0FF4040);
+        }
+        else
+        {
+            PushRectangle(group, min, max, 0xFFFFFFFF);
+        }
+    }
+}
+
+// a spinning Gouraud hexagon with a flat triangle cutting through it in depth
+internal void RenderRasterTest(rasterizer *raster, real32 angle, real32 center_x, real32 center_y)
+{
+    local_persist uint32 rim_colors[6] = {0xFFFF0000, 0xFFFFFF00, 0xFF00FF00, 0xFF00FFFF, 0xFF0000FF, 0xFFFF00FF};
+
+    real32 radius = 120.0f;
+    raster_vertex center = {center_x, center_y, 0.5f, 0xFFFFFFFF};
+    for(int segment_idx = 0; segment_idx < 6; ++segment_idx)
+    {
+        real32 angle0 = angle + (real32)segment_idx*(2.0f*Pi32 / 6.0f);
+        real32 angle1 = angle0 + (2.0f*Pi32 / 6.0f);
+        raster_vertex rim0 = {center_x + radius*cosf(angle0), center_y + radius*sinf(angle0), 0.5f,
+                              rim_colors[segment_idx]};
+        raster_vertex rim1 = {center_x + radius*cosf(angle1), center_y + radius*sinf(angle1), 0.5f,
+                              rim_colors[(segment_idx + 1) % 6]};
+        RasterTriangleGouraud(raster, center, rim0, rim1);
+    }
+
+    // NOTE: goes from in front of the hexagon on the left to behind it on the right
+    raster_vertex blade0 = {center_x - 1.5f*radius, center_y - 0.3f*radius, 0.0f, 0};
+    raster_vertex blade1 = {center_x + 1.5f*radius, center_y, 1.0f, 0};
+    raster_vertex blade2 = {center_x - 1.5f*radius, center_y + 0.3f*radius, 0.0f, 0};
+    RasterTriangleFlat(raster, blade0, blade1, blade2, 0xFF303030);
+}
+
+// a checkerboard inside a soft edged disc, premultiplied
+internal void MakeTestTexture(render_texture *texture, memory_arena *arena, int32 size)
+{
+    texture->Width = size;
+    texture->Height = size;
+    texture->Pitch = size;
+    texture->Texels = PushArray(arena, size*size, uint32);
+
+    real32 radius = 0.5f*(real32)size;
+    for(int32 y = 0; y < size; ++y)
+    {
+        for(int32 x = 0; x < size; ++x)
+        {
+            real32 dx = (real32)x + 0.5f - radius;
+            real32 dy = (real32)y + 0.5f - radius;
+            real32 alpha = radius - sqrtf(dx*dx + dy*dy);
+            alpha = (alpha < 0.0f) ? 0.0f : ((alpha > 4.0f) ? 1.0f : 0.25f*alpha);
+
+            uint32 color = (((x >> 4) ^ (y >> 4)) & 1) ? 0xFFE0A030 : 0xFF3060C0;
+            uint32 a = (uint32)(255.0f*alpha + 0.5f);
+            uint32 r = (uint32)(alpha*(real32)((color >> 16) & 0xFF) + 0.5f);
+            uint32 g = (uint32)(alpha*(real32)((color >> 8) & 0xFF) + 0.5f);
+            uint32 b = (uint32)(alpha*(real32)(color & 0xFF) + 0.5f);
+            texture->Texels[y*texture->Pitch + x] = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+    }
+}
 
-        row += buffer->Pitch;
+// draw the tiles in view, camera_x and camera_y are the world pixel at the top left of the buffer
+internal void RenderTileMap(offscreen_graphics_buffer *buffer, tile_map *tile_map, int camera_x, int camera_y)
+{
+    local_persist uint32 tile_colors[] = {0, 0xFF505050, 0xFF40C0E0};
+
+    int tile_size = tile_map->TileSizeInPixels;
+    int32 min_tile_x = FloorDivide(camera_x, tile_size);
+    int32 min_tile_y = FloorDivide(camera_y, tile_size);
+    int32 max_tile_x = FloorDivide(camera_x + buffer->Width - 1, tile_size);
+    int32 max_tile_y = FloorDivide(camera_y + buffer->Height - 1, tile_size);
+
+    // NOTE: walk chunk by chunk so there is one chunk lookup per chunk instead of one per tile
+    for(int32 chunk_y = min_tile_y >> TILE_CHUNK_SHIFT; chunk_y <= (max_tile_y >> TILE_CHUNK_SHIFT); ++chunk_y)
+    {
+        for(int32 chunk_x = min_tile_x >> TILE_CHUNK_SHIFT; chunk_x <= (max_tile_x >> TILE_CHUNK_SHIFT); ++chunk_x)
+        {
+            tile_chunk *chunk = GetTileChunk(tile_map, chunk_x, chunk_y);
+
+            int32 first_tile_x = chunk_x*TILE_CHUNK_DIM;
+            int32 first_tile_y = chunk_y*TILE_CHUNK_DIM;
+            int32 tile_x0 = (min_tile_x > first_tile_x) ? min_tile_x : first_tile_x;
+            int32 tile_y0 = (min_tile_y > first_tile_y) ? min_tile_y : first_tile_y;
+            int32 tile_x1 = (max_tile_x < first_tile_x + TILE_CHUNK_MASK) ? max_tile_x : first_tile_x + TILE_CHUNK_MASK;
+            int32 tile_y1 = (max_tile_y < first_tile_y + TILE_CHUNK_MASK) ? max_tile_y : first_tile_y + TILE_CHUNK_MASK;
+            for(int32 tile_y = tile_y0; tile_y <= tile_y1; ++tile_y)
+            {
+                for(int32 tile_x = tile_x0; tile_x <= tile_x1; ++tile_x)
+                {
+                    uint8 value = chunk->Tiles[(tile_y - first_tile_y)*TILE_CHUNK_DIM + (tile_x - first_tile_x)];
+                    if(value)
+                    {
+                        int min_x = tile_x*tile_size - camera_x;
+                        int min_y = tile_y*tile_size - camera_y;
+                        DrawRectangle(buffer, min_x + 1, min_y + 1, min_x + tile_size - 1, min_y + tile_size - 1,
+                                      tile_colors[value]);
+                    }
+                }
+            }
+        }
     }
 }
 
+struct background_layer_context
+{
+    platform_work_queue *Queue;
+    uint32 WorkerThreadCount;
+    memory_arena *FrameArena;
+    tile_map *TileMap;
+};
+
+// NOTE: the gradient and the tiles both cost less to draw than a layer costs to blend, so they
+// share one opaque layer instead of having one each
+internal RENDER_LAYER_DRAW(DrawBackgroundLayer)
+{
+    background_layer_context *background = (background_layer_context *)context;
+    RenderWeirdGradientInParallel(background->Queue, background->WorkerThreadCount, background->FrameArena, target,
+                                  world_x, world_y);
+    RenderTileMap(target, background->TileMap, world_x, world_y);
+}
+
 // the main application update loop
 // all platform non-specific code gets executed here
-APP_UPDATE_AND_RENDER(AppUpdateAndRender)
+APP_EXPORT APP_UPDATE_AND_RENDER(AppUpdateAndRender)
 {
     Assert(sizeof(application_state) <= memory->PermanentStorageSize);
     
     // this app_state is how you access the application state from permanent storage
     // so you can call this in many other functions and it will retreive the game state
     application_state *app_state = (application_state *)memory->PermanentStorage;
+    Platform = memory->PlatformAPI;
     if(!memory->IsInitialized)
     {
+#if APPLICATION_INTERNAL
         char *filename = __FILE__;
         
-        debug_read_file_result file = DEBUGPlatformReadEntireFile(filename);
+        debug_read_file_result file = Platform.DEBUGReadEntireFile(filename);
         if(file.Contents)
         {
-            DEBUGPlatformWriteEntireFile("test.out", file.ContentsSize, file.Contents);
-            DEBUGPlatformFreeFileMemory(file.Contents);
+            Platform.DEBUGWriteEntireFile("test.out", file.ContentsSize, file.Contents);
+            Platform.DEBUGFreeFileMemory(file.Contents);
         }
+#endif
         
         app_state->ToneHz = 256;
         app_state->BlueOffset = 0;
         app_state->GreenOffset = 0;
+        app_state->RandomState = 0x2F6E2B1;
+
+        InitializeArena(&app_state->WorldArena, "world", memory->PermanentStorageSize - sizeof(application_state),
+                        (uint8 *)memory->PermanentStorage + sizeof(application_state));
+        SetArenaTag(&app_state->WorldArena, MemoryTag_Entity);
+        InitializeEntityStore(&app_state->Entities, &app_state->WorldArena, 128*1024);
+
+        InitializeArena(&app_state->TransientArena, "transient", memory->TransientStorageSize, memory->TransientStorage);
+        SubArena(&app_state->FrameArena, "frame", &app_state->TransientArena, Megabytes(256));
+        SubArena(&app_state->SaveArena, "save", &app_state->TransientArena, Megabytes(128));
+        app_state->SecondsUntilAutosave = AUTOSAVE_INTERVAL_SECONDS;
+        SetArenaTag(&app_state->WorldArena, MemoryTag_TileMap);
+        SetArenaTag(&app_state->TransientArena, MemoryTag_TileMap);
+        InitializeTileMap(&app_state->TileMap, &app_state->WorldArena, &app_state->TransientArena, 256, 16*1024, 0x5EED1234);
+        SpawnTestEntities(app_state, 4096, (real32)buffer->Width, (real32)buffer->Height);
+
+        SetArenaTag(&app_state->WorldArena, MemoryTag_Audio);
+        InitializeAudioMixer(&app_state->Mixer, &app_state->WorldArena);
+        SetArenaTag(&app_state->WorldArena, MemoryTag_Render);
+        MakeTestTexture(&app_state->TestTexture, &app_state->WorldArena, 128);
+        // NOTE: the cache is the size of the buffer, a bigger buffer later gets drawn directly
+        InitializeRenderLayer(&app_state->BackgroundLayer, &app_state->WorldArena, buffer->Width, buffer->Height,
+                              true, true);
+        SetArenaTag(&app_state->WorldArena, MemoryTag_Particle);
+        InitializeParticleSystem(&app_state->Particles, &app_state->WorldArena, 1024*1024, 0x9A271C1E);
+        for(uint32 fountain_idx = 0; fountain_idx < ArrayCount(app_state->Fountains); ++fountain_idx)
+        {
+            // NOTE: most of a particle's life is spent below the screen after it falls back down,
+            // so only about a tenth of them are drawn
+            particle_emitter *fountain = app_state->Fountains + fountain_idx;
+            fountain->X = (real32)buffer->Width*(fountain_idx ? 0.75f : 0.25f);
+            fountain->Y = (real32)buffer->Height - 16.0f;
+            fountain->VelocityX = 0.0f;
+            fountain->VelocityY = -900.0f;
+            fountain->Spread = 160.0f;
+            fountain->Lifetime = 10.0f;
+            fountain->LifetimeSpread = 2.0f;
+            fountain->Color = fountain_idx ? 0x80FFA040 : 0x8040A0FF;
+            fountain->Rate = 50000.0f;
+            fountain->SpawnRemainder = 0.0f;
+        }
+        SetArenaTag(&app_state->WorldArena, MemoryTag_Untagged);
+        SetArenaTag(&app_state->TransientArena, MemoryTag_Untagged);
+        // NOTE: the rumble and the harshness off the mix bus, the music a little way into the room
+        audio_effects *effects = &app_state->Mixer.Effects;
+        AddAudioFilter(effects, AudioFilter_HighPass, 30.0f, 0.707f, 0.0f);
+        AddAudioFilter(effects, AudioFilter_Peak, 3000.0f, 1.0f, -2.0f);
+        AddAudioFilter(effects, AudioFilter_LowPass, 16000.0f, 0.707f, 0.0f);
+        audio_stream *music = PlayAudioStream(&app_state->Mixer, "music.wav", 0.5f, true);
+        if(music)
+        {
+            music->Sends[AudioSend_Delay] = 0.15f;
+            music->Sends[AudioSend_Reverb] = 0.3f;
+        }
 
         // TODO: This may be more appropriate to do in the platform layer
         memory->IsInitialized = true;
     }
 
+    BeginArenaFrame(&app_state->WorldArena);
+    BeginArenaFrame(&app_state->TransientArena);
+    BeginArenaFrame(&app_state->FrameArena);
+    BeginArenaFrame(&app_state->SaveArena);
+
+    UpdateAutosave(memory, app_state, input->SecondsToAdvanceOverUpdate);
+
+    tile_map *tile_map = &app_state->TileMap;
+    BeginTileMapFrame(tile_map);
+
     for (int controller_idx = 0; controller_idx < ArrayCount(input->Controllers); ++controller_idx)
     {
         application_controller_input *controller = GetController(input, controller_idx);
@@ -115,13 +520,217 @@ APP_UPDATE_AND_RENDER(AppUpdateAndRender)
         {
             app_state->GreenOffset += 1;
         }
+
+        if(controller->RightShoulder.EndedDown)
+        {
+            SpawnTestEntities(app_state, 1024, (real32)buffer->Width, (real32)buffer->Height);
+        }
+        if(controller->LeftShoulder.EndedDown)
+        {
+            RemoveTestEntities(app_state, 1024);
+        }
+    }
+
+    // NOTE: dig out or fill in the tile under the middle of the screen, once per press
+    // even if it was let go again before the frame ended
+    for(uint32 event_idx = 0; event_idx < input->EventCount; ++event_idx)
+    {
+        application_input_event *event = input->Events + event_idx;
+        application_controller_input *controller = GetController(input, event->ControllerIndex);
+        if((event->ButtonIndex == ButtonIndex(controller, ActionUp)) && (event->Value > 0.0f))
+        {
+            int32 tile_x = FloorDivide(app_state->BlueOffset + buffer->Width/2, tile_map->TileSizeInPixels);
+            int32 tile_y = FloorDivide(app_state->GreenOffset + buffer->Height/2, tile_map->TileSizeInPixels);
+            SetTileValue(tile_map, tile_x, tile_y, GetTileValue(tile_map, tile_x, tile_y) ? 0 : 1);
+        }
+        if((event->ButtonIndex == ButtonIndex(controller, Back)) && (event->Value > 0.0f))
+        {
+            app_state->IsGammaCorrect = !app_state->IsGammaCorrect;
+        }
+    }
+
+    ClearArena(&app_state->FrameArena);
+
+    entity_store *entities = &app_state->Entities;
+    SetArenaTag(&app_state->FrameArena, MemoryTag_Entity);
+    MoveEntitiesInParallel(memory->WorkQueue, &app_state->FrameArena, entities, input->SecondsToAdvanceOverUpdate,
+                           (real32)(buffer->Width - 1), (real32)(buffer->Height - 1));
+    SetArenaTag(&app_state->FrameArena, MemoryTag_Spatial);
+    HighlightOverlappingEntities(entities, &app_state->FrameArena);
+
+    // NOTE: a batch run without a picture only pays for the simulation, everything below that
+    // draws is skipped and everything that moves still moves
+    bool32 is_drawing = (buffer->Memory != 0);
+
+    SetArenaTag(&app_state->FrameArena, MemoryTag_Render);
+    if(is_drawing)
+    {
+        // NOTE: the gradient never changes and the tiles only when one is dug out or filled in, so most
+        // frames the background is copied out of its cache with a strip drawn along whatever edge scrolled in
+        background_layer_context background = {memory->WorkQueue, memory->WorkerThreadCount, &app_state->FrameArena,
+                                               tile_map};
+        DrawRenderLayer(&app_state->BackgroundLayer, buffer, app_state->BlueOffset, app_state->GreenOffset,
+                        tile_map->Version, DrawBackgroundLayer, &background);
+        render_group entity_group;
+        BeginRenderGroup(&entity_group, &app_state->FrameArena, entities->Count, app_state->IsGammaCorrect);
+        RenderEntities(&entity_group, entities);
+        EndRenderGroup(&entity_group, buffer);
+    }
+
+    particle_system *particles = &app_state->Particles;
+    particle_draw_list particle_draw_list;
+    SetArenaTag(&app_state->FrameArena, MemoryTag_Particle);
+    for(uint32 fountain_idx = 0; fountain_idx < ArrayCount(app_state->Fountains); ++fountain_idx)
+    {
+        SpawnParticles(particles, app_state->Fountains + fountain_idx, input->SecondsToAdvanceOverUpdate);
+    }
+    UpdateParticlesInParallel(memory->WorkQueue, &app_state->FrameArena, particles, input->SecondsToAdvanceOverUpdate,
+                              0.0f, 1500.0f, buffer->Width, buffer->Height, &particle_draw_list);
+    if(is_drawing)
+    {
+        DrawParticlesInParallel(memory->WorkQueue, &app_state->FrameArena, buffer, &particle_draw_list);
+    }
+    SetArenaTag(&app_state->FrameArena, MemoryTag_Render);
+
+    app_state->RasterAngle += 0.5f*input->SecondsToAdvanceOverUpdate;
+    if(app_state->RasterAngle > 2.0f*Pi32)
+    {
+        app_state->RasterAngle -= 2.0f*Pi32;
     }
 
-    RenderWeirdGradient(buffer, app_state->BlueOffset, app_state->GreenOffset);
+    if(is_drawing)
+    {
+        rasterizer raster;
+        BeginRaster(&raster, &app_state->FrameArena, buffer, 64, true);
+        RenderRasterTest(&raster, app_state->RasterAngle, 0.5f*(real32)buffer->Width, 0.5f*(real32)buffer->Height);
+        EndRaster(&raster, memory->WorkQueue);
+
+        // NOTE: orbits the hexagon, turning the other way and breathing in and out
+        real32 texture_scale = 160.0f + 40.0f*sinf(2.0f*app_state->RasterAngle);
+        v2 x_axis = texture_scale*V2(cosf(-app_state->RasterAngle), sinf(-app_state->RasterAngle));
+        v2 y_axis = Perp(x_axis);
+        v2 center = V2(0.5f*(real32)buffer->Width + 260.0f*cosf(app_state->RasterAngle),
+                       0.5f*(real32)buffer->Height + 260.0f*sinf(app_state->RasterAngle));
+        render_group overlay_group;
+        BeginRenderGroup(&overlay_group, &app_state->FrameArena, 16, app_state->IsGammaCorrect);
+        PushTexturedRectangle(&overlay_group, center - 0.5f*x_axis - 0.5f*y_axis, x_axis, y_axis, &app_state->TestTexture);
+        EndRenderGroup(&overlay_group, buffer);
+    }
 }
 
-APP_GET_SOUND_SAMPLES(AppGetSoundSamples)
+APP_EXPORT APP_GET_SOUND_SAMPLES(AppGetSoundSamples)
 {
     application_state *app_state = (application_state *)memory->PermanentStorage;
-    ApplicationOutputSound(sound_buffer, app_state->ToneHz);
+    ApplicationOutputSound(sound_buffer, app_state->ToneHz, &app_state->TonePhase);
+    MixAudioStreams(&app_state->Mixer, sound_buffer);
+}
+
+APP_EXPORT APP_SAVE_STATE(AppSaveState)
+{
+    Platform = memory->PlatformAPI;
+    uint64 result = 0;
+    if(memory->IsInitialized)
+    {
+        result = SaveApplicationStateImage(memory, dest, dest_size);
+    }
+    return result;
+}
+
+// NOTE: before the state is overwritten by a load or a rewind, nothing the platform is still doing
+// for the app may land in it afterwards
+internal void StopFileRequestsForLoad(application_state *app_state)
+{
+    CloseAudioStreamsForLoad(&app_state->Mixer);
+    WaitForAutosave(app_state);
+}
+
+// NOTE: the loaded streams' files and reads belonged to whoever saved them, and so did a save
+// that was still being written when the state was saved
+internal void RestartFileRequestsAfterLoad(application_state *app_state)
+{
+    RestartAudioStreamsAfterLoad(&app_state->Mixer);
+    app_state->SaveRequest.State = PlatformFileRequest_Idle;
+
+    // NOTE: and so were SaveArena's pages, which may not be in this process yet
+    app_state->SaveArenaTouchedSize = 0;
+}
+
+APP_EXPORT APP_LOAD_STATE(AppLoadState)
+{
+    Platform = memory->PlatformAPI;
+    bool32 result = IsStateImageLoadable(memory, image, image_size);
+    if(result)
+    {
+        application_state *app_state = (application_state *)memory->PermanentStorage;
+        if(memory->IsInitialized)
+        {
+            StopFileRequestsForLoad(app_state);
+        }
+        LoadApplicationStateImage(memory, image);
+        RestartFileRequestsAfterLoad(app_state);
+        memory->IsInitialized = true;
+    }
+    return result;
+}
+
+APP_EXPORT APP_BEGIN_RESTORE_STATE(AppBeginRestoreState)
+{
+    Platform = memory->PlatformAPI;
+    if(memory->IsInitialized)
+    {
+        StopFileRequestsForLoad((application_state *)memory->PermanentStorage);
+    }
+}
+
+APP_EXPORT APP_END_RESTORE_STATE(AppEndRestoreState)
+{
+    Platform = memory->PlatformAPI;
+    if(memory->IsInitialized)
+    {
+        RestartFileRequestsAfterLoad((application_state *)memory->PermanentStorage);
+    }
+}
+
+// NOTE: application_state itself sits in front of the world arena, it's reported as an arena
+// of its own so the entries add up to PermanentStorageSize and TransientStorageSize
+APP_EXPORT APP_DEBUG_GET_ARENA_INFO(AppDebugGetArenaInfo)
+{
+    uint32 result = 0;
+    if(memory->IsInitialized)
+    {
+        application_state *app_state = (application_state *)memory->PermanentStorage;
+
+        debug_arena_info state_info = {"state"};
+        state_info.Size = sizeof(application_state);
+        state_info.Used = sizeof(application_state);
+        state_info.PeakUsed = sizeof(application_state);
+        state_info.AllocationCount = 1;
+        state_info.Tags[MemoryTag_Untagged].Used = sizeof(application_state);
+        state_info.Tags[MemoryTag_Untagged].PeakUsed = sizeof(application_state);
+        state_info.Tags[MemoryTag_Untagged].AllocationCount = 1;
+
+        memory_arena *arenas[] =
+        {
+            &app_state->WorldArena,
+            &app_state->TransientArena,
+            &app_state->FrameArena,
+            &app_state->SaveArena,
+        };
+
+        if(result < max_count)
+        {
+            dest[result] = state_info;
+        }
+        ++result;
+
+        for(uint32 arena_idx = 0; arena_idx < ArrayCount(arenas); ++arena_idx)
+        {
+            if(result < max_count)
+            {
+                GetArenaInfo(arenas[arena_idx], dest + result);
+            }
+            ++result;
+        }
+    }
+    return result;
 }
@@ -75,38 +75,167 @@ struct debug_read_file_result
 /* IMPORTANT:
 
    These are NOT for doing anything in the shipping application - they are
-   blocking and the write doesn't protect against lost data!
+   blocking and the write doesn't protect against lost data! Anything that
+   has to survive goes through Platform.SaveFile.
 */
 
-#define DEBUG_PLATFORM_READ_ENTIRE_FILE(name) void name(char *filename)
+#define DEBUG_PLATFORM_READ_ENTIRE_FILE(name) debug_read_file_result name(char *filename)
 typedef DEBUG_PLATFORM_READ_ENTIRE_FILE(debug_platform_read_entire_file);
 
 #define DEBUG_PLATFORM_FREE_FILE_MEMORY(name) void name(void *memory)
-typedef DEBUG_PLATFORM_FREE_FILE_MEMORY(app_update_and_render);
+typedef DEBUG_PLATFORM_FREE_FILE_MEMORY(debug_platform_free_file_memory);
 
-#define DEBUG_PLATFORM_WRITE_ENTIRE_FILE(name) void name(char *filename, uint32 memory_size, void *memory)
+#define DEBUG_PLATFORM_WRITE_ENTIRE_FILE(name) bool32 name(char *filename, uint32 memory_size, void *memory)
 typedef DEBUG_PLATFORM_WRITE_ENTIRE_FILE(debug_platform_write_entire_file);
 #endif
 
+/* NOTE: Work queue
+
+   Jobs are pushed onto the calling thread's own deque and idle threads
+   steal from the other end, so pushing and popping your own work never
+   contends with anyone. Only the main thread and the platform's worker
+   threads may add or wait on jobs.
+
+   Every job can bump a counter when it is added and the counter drops
+   back when it finishes, so waiting on a counter is how you wait on a
+   group of jobs. Jobs run on fibers, a job that needs other jobs done
+   first adds them and waits on their counter, which parks the fiber and
+   frees up the thread until the counter hits zero. Waiting outside of a
+   job runs other jobs on the calling thread in the meantime.
+*/
+
+struct platform_work_queue;
+
+// NOTE: start counters zeroed, the platform owns everything in here
+struct platform_job_counter
+{
+    int32 volatile Value;
+    void *Waiters;
+};
+
+#define PLATFORM_WORK_QUEUE_CALLBACK(name) void name(platform_work_queue *queue, void *data)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(platform_work_queue_callback);
+
+// counter may be 0 when nothing waits on this job in particular
+#define PLATFORM_ADD_ENTRY(name) void name(platform_work_queue *queue, platform_work_queue_callback *callback, void *data, platform_job_counter *counter)
+typedef PLATFORM_ADD_ENTRY(platform_add_entry);
+
+// run jobs on the calling thread until the counter reaches zero
+#define PLATFORM_WAIT_FOR_COUNTER(name) void name(platform_work_queue *queue, platform_job_counter *counter)
+typedef PLATFORM_WAIT_FOR_COUNTER(platform_wait_for_counter);
+
+// run jobs on the calling thread until every job in the queue is done
+#define PLATFORM_COMPLETE_ALL_WORK(name) void name(platform_work_queue *queue)
+typedef PLATFORM_COMPLETE_ALL_WORK(platform_complete_all_work);
+
+/* NOTE: File streaming
+
+   One platform thread does all the file IO, the app hands it requests and
+   checks back on them later so neither the main thread nor the audio path
+   ever waits on the disk. Any thread may make requests, worker jobs
+   included: adding one takes a short spin lock on the platform's request
+   ring. Requests are carried out in the order they got into the ring, so
+   the ones a single thread makes stay in its order, but requests made on
+   different threads at the same time have no order between them.
+
+   The calls return false when the platform's request ring is full, the
+   request was not made and can be tried again later.
+*/
+
+enum platform_file_request_state
+{
+    PlatformFileRequest_Idle,
+    PlatformFileRequest_Pending,
+    PlatformFileRequest_Done,
+    PlatformFileRequest_Failed,
+};
+
+// NOTE: the app owns these and the platform writes the outcome back, State goes last,
+// leave the request and whatever it points at alone while it is Pending
+struct platform_file_request
+{
+    uint32 volatile State;
+    uint32 BytesRead;
+};
+
+struct platform_file_handle
+{
+    void *Platform; // NOTE: 0 until the open request is Done
+    uint64 Size;
+};
+
+// filename has to stay around until the request is done
+#define PLATFORM_OPEN_FILE(name) bool32 name(char *filename, platform_file_handle *file, platform_file_request *request)
+typedef PLATFORM_OPEN_FILE(platform_open_file);
+
+#define PLATFORM_READ_DATA_FROM_FILE(name) bool32 name(platform_file_handle *file, uint64 offset, uint32 size, void *dest, platform_file_request *request)
+typedef PLATFORM_READ_DATA_FROM_FILE(platform_read_data_from_file);
+
+// reads made before the close still finish, file is zeroed right away
+#define PLATFORM_CLOSE_FILE(name) bool32 name(platform_file_handle *file)
+typedef PLATFORM_CLOSE_FILE(platform_close_file);
+
+// NOTE: the write goes to filename.tmp with a checksummed footer, is flushed to the disk and
+// then renamed over filename, the file it replaces is kept as filename.prev, see
+// application_saved_file.h. filename and data have to stay around until the request is done.
+#define PLATFORM_SAVE_FILE(name) bool32 name(char *filename, void *data, uint64 size, platform_file_request *request)
+typedef PLATFORM_SAVE_FILE(platform_save_file);
+
+struct platform_api
+{
+    platform_add_entry *AddEntry;
+    platform_wait_for_counter *WaitForCounter;
+    platform_complete_all_work *CompleteAllWork;
+
+    platform_open_file *OpenFile;
+    platform_read_data_from_file *ReadDataFromFile;
+    platform_close_file *CloseFile;
+    platform_save_file *SaveFile;
+
+#if APPLICATION_INTERNAL
+    debug_platform_read_entire_file *DEBUGReadEntireFile;
+    debug_platform_free_file_memory *DEBUGFreeFileMemory;
+    debug_platform_write_entire_file *DEBUGWriteEntireFile;
+#endif
+};
+
 /*
   NOTE: Services that the application provides to the platform layer.
 */
 
+// how the pixels of an offscreen_graphics_buffer are laid out, see application_pixel_format.h
+enum pixel_format
+{
+    PixelFormat_BGRX8, // NOTE: 0 so a zeroed buffer is what the platforms have always handed over
+    PixelFormat_RGBA8,
+    PixelFormat_RGB565,
+    PixelFormat_Float32Linear,
+
+    PixelFormat_Count,
+};
+
+global_variable char *PixelFormatNames[PixelFormat_Count] = {"bgrx8", "rgba8", "rgb565", "float32"};
+global_variable int PixelFormatBytesPerPixel[PixelFormat_Count] = {4, 4, 2, 16};
+
 // FOUR THINGS - timing, controller/keyboard input, bitmap buffer to use, sound buffer to use
 // TODO: In the future, rendering _specifically_ will become a three-tiered abstraction!!!
 struct offscreen_graphics_buffer 
 { 
     /*
-        4 bytes ... pixel, pixel+1 etc 
+        BGRX8, 4 bytes ... pixel, pixel+1 etc 
         pixel in register: 0x xxRRGGBB
         pixel in memory: BB GG RR xx -> REVERSED! little endian arch.
         xx is padding
+
+        the other formats are described in application_pixel_format.h, colors
+        are always handed around as 0xAARRGGBB and converted once per draw
     */
 
-    void *Memory;
+    void *Memory; // NOTE: 0 when nobody looks at the picture, the app still runs at Width by Height but draws nothing
     int Width;
     int Height;
     int Pitch;
+    pixel_format Format;
 };
 
 struct application_sound_output_buffer 
@@ -114,6 +243,11 @@ struct application_sound_output_buffer
   int SamplesPerSecond;
   int SampleCount;
   int16 *Samples;
+  real32 LatencySeconds; // NOTE: how far ahead of the play cursor the samples get written
+
+  // NOTE: filled in by the app, what its audio effects took to run over these samples
+  uint64 EffectsCycleCount;
+  uint32 EffectsBlockCount;
 };
 
 struct application_button_state
@@ -153,9 +287,35 @@ struct application_controller_input
     };
 };
 
+#define INPUT_EVENT_STICK_X 0xFE
+#define INPUT_EVENT_STICK_Y 0xFF
+#define MAX_INPUT_EVENT_COUNT 256
+
+// one change of a button or stick, in the order they happened
+struct application_input_event
+{
+    uint64 Timestamp; // NOTE: platform high resolution clock, ticks at application_input::TimestampFrequency
+    real32 Time; // NOTE: seconds after application_input::StartTimestamp
+
+    uint8 ControllerIndex;
+    uint8 ButtonIndex; // NOTE: index into application_controller_input::Buttons, or INPUT_EVENT_STICK_X/Y
+    real32 Value; // NOTE: 1 pressed, 0 released, -1 to 1 for sticks
+};
+
 struct application_input
 {
+    real32 SecondsToAdvanceOverUpdate;
+
     application_controller_input Controllers[5];
+
+    // NOTE: everything that happened between the last input sample and this one,
+    // the controllers above are where it all ended up
+    uint64 StartTimestamp;
+    uint64 EndTimestamp;
+    uint64 TimestampFrequency;
+    uint32 EventCount;
+    uint32 DroppedEventCount;
+    application_input_event Events[MAX_INPUT_EVENT_COUNT];
 };
 
 // get a controller / keyboard and check to see if it is avalailable
@@ -166,6 +326,9 @@ inline application_controller_input *GetController(application_input *input, int
     return result;
 }
 
+// index of a button in application_controller_input::Buttons, for matching input events
+#define ButtonIndex(controller, button) ((uint8)(&(controller)->button - (controller)->Buttons))
+
 // persistent memory so that we never have to allocate memory during runtime 
 struct application_memory
 {
@@ -176,15 +339,259 @@ struct application_memory
 
     uint64 TransientStorageSize; // storage for carrying over information from a previous frame
     void *TransientStorage; // NOTE: REQUIRED to be cleared to zero at startup
+
+    platform_work_queue *WorkQueue;
+    uint32 WorkerThreadCount; // NOTE: not counting the main thread, which runs jobs too while it waits
+
+    char *AutosaveFilename; // NOTE: 0 turns autosaving off
+
+    platform_api PlatformAPI;
+};
+
+// which subsystem an arena's pushes get counted against
+enum memory_tag
+{
+    MemoryTag_Untagged,
+    MemoryTag_Entity,
+    MemoryTag_TileMap,
+    MemoryTag_Audio,
+    MemoryTag_Spatial,
+    MemoryTag_Render,
+    MemoryTag_Particle,
+    MemoryTag_Save,
+
+    MemoryTag_Count,
 };
 
+global_variable char *MemoryTagNames[MemoryTag_Count] =
+{
+    "untagged",
+    "entity",
+    "tile_map",
+    "audio",
+    "spatial",
+    "render",
+    "particle",
+    "save",
+};
+
+struct memory_tag_stats
+{
+    uint64 Used; // NOTE: alignment padding included
+    uint64 PeakUsed;
+    uint64 AllocationCount;
+    uint64 WastedBytes; // NOTE: alignment padding
+};
+
+#define MEMORY_ARENA_NAME_LENGTH 16
+
+// linear allocator that hands out pieces of application_memory, nothing is ever freed individually
+struct memory_arena
+{
+    uint64 Size;
+    uint8 *Base;
+    uint64 Used;
+
+    // NOTE: bookkeeping for sizing application_memory, none of it changes what gets handed out.
+    // The name is copied in so it survives the app code being reloaded
+    char Name[MEMORY_ARENA_NAME_LENGTH];
+    memory_tag Tag;
+    uint64 PeakUsed;
+    uint64 AllocationCount;
+    uint64 WastedBytes;
+    memory_tag_stats Tags[MemoryTag_Count];
+
+    // NOTE: pushes since BeginArenaFrame, and the frame before that
+    uint64 FrameBytes;
+    uint64 FrameAllocationCount;
+    uint64 LastFrameBytes;
+    uint64 LastFrameAllocationCount;
+    uint64 PeakFrameBytes;
+};
+
+inline void InitializeArena(memory_arena *arena, char *name, uint64 size, void *base)
+{
+    *arena = {};
+    arena->Size = size;
+    arena->Base = (uint8 *)base;
+
+    for(int char_idx = 0; name[char_idx] && (char_idx < MEMORY_ARENA_NAME_LENGTH - 1); ++char_idx)
+    {
+        arena->Name[char_idx] = name[char_idx];
+    }
+}
+
+// count everything pushed from here on against tag, returns the tag it was counting against
+inline memory_tag SetArenaTag(memory_arena *arena, memory_tag tag)
+{
+    memory_tag result = arena->Tag;
+    arena->Tag = tag;
+    return result;
+}
+
+inline void *PushSize_(memory_arena *arena, uint64 size, uint64 alignment);
+
+// carve a child arena out of the remaining space of a parent arena
+inline void SubArena(memory_arena *result, char *name, memory_arena *arena, uint64 size)
+{
+    InitializeArena(result, name, size, PushSize_(arena, size, 1));
+}
+
+// throw away everything that was pushed, the peaks and counts are kept
+inline void ClearArena(memory_arena *arena)
+{
+    arena->Used = 0;
+    for(int tag_idx = 0; tag_idx < MemoryTag_Count; ++tag_idx)
+    {
+        arena->Tags[tag_idx].Used = 0;
+    }
+}
+
+// once a frame, before anything gets pushed
+inline void BeginArenaFrame(memory_arena *arena)
+{
+    arena->LastFrameBytes = arena->FrameBytes;
+    arena->LastFrameAllocationCount = arena->FrameAllocationCount;
+    if(arena->FrameBytes > arena->PeakFrameBytes)
+    {
+        arena->PeakFrameBytes = arena->FrameBytes;
+    }
+    arena->FrameBytes = 0;
+    arena->FrameAllocationCount = 0;
+}
+
+#define PushStruct(arena, type) (type *)PushSize_(arena, sizeof(type), 4)
+#define PushArray(arena, count, type) (type *)PushSize_(arena, (count)*sizeof(type), 4)
+#define PushArrayAligned(arena, count, type, alignment) (type *)PushSize_(arena, (count)*sizeof(type), alignment)
+inline void *PushSize_(memory_arena *arena, uint64 size, uint64 alignment)
+{
+    // NOTE: alignment has to be a power of two
+    Assert((alignment & (alignment - 1)) == 0);
+
+    uint64 alignment_offset = 0;
+    uint64 next_address = (uint64)(uintptr_t)(arena->Base + arena->Used);
+    uint64 alignment_mask = alignment - 1;
+    if(next_address & alignment_mask)
+    {
+        alignment_offset = alignment - (next_address & alignment_mask);
+    }
+
+    Assert((arena->Used + alignment_offset + size) <= arena->Size);
+    void *result = arena->Base + arena->Used + alignment_offset;
+    uint64 pushed = alignment_offset + size;
+    arena->Used += pushed;
+
+    if(arena->Used > arena->PeakUsed)
+    {
+        arena->PeakUsed = arena->Used;
+    }
+    ++arena->AllocationCount;
+    arena->WastedBytes += alignment_offset;
+    arena->FrameBytes += pushed;
+    ++arena->FrameAllocationCount;
+
+    memory_tag_stats *tag = arena->Tags + arena->Tag;
+    tag->Used += pushed;
+    if(tag->Used > tag->PeakUsed)
+    {
+        tag->PeakUsed = tag->Used;
+    }
+    ++tag->AllocationCount;
+    tag->WastedBytes += alignment_offset;
+
+    return result;
+}
+
+// what the debug query hands the platform about one arena
+struct debug_arena_info
+{
+    char Name[MEMORY_ARENA_NAME_LENGTH];
+    uint64 Size;
+    uint64 Used;
+    uint64 PeakUsed;
+    uint64 AllocationCount;
+    uint64 WastedBytes;
+    uint64 LastFrameBytes;
+    uint64 LastFrameAllocationCount;
+    uint64 PeakFrameBytes;
+    memory_tag_stats Tags[MemoryTag_Count];
+};
+
+inline void GetArenaInfo(memory_arena *arena, debug_arena_info *info)
+{
+    for(int char_idx = 0; char_idx < MEMORY_ARENA_NAME_LENGTH; ++char_idx)
+    {
+        info->Name[char_idx] = arena->Name[char_idx];
+    }
+    info->Size = arena->Size;
+    info->Used = arena->Used;
+    info->PeakUsed = arena->PeakUsed;
+    info->AllocationCount = arena->AllocationCount;
+    info->WastedBytes = arena->WastedBytes;
+    info->LastFrameBytes = arena->LastFrameBytes;
+    info->LastFrameAllocationCount = arena->LastFrameAllocationCount;
+    info->PeakFrameBytes = (arena->FrameBytes > arena->PeakFrameBytes) ? arena->FrameBytes : arena->PeakFrameBytes;
+    for(int tag_idx = 0; tag_idx < MemoryTag_Count; ++tag_idx)
+    {
+        info->Tags[tag_idx] = arena->Tags[tag_idx];
+    }
+}
+
+// application side systems that are stored in application_state
+#include "application_math.h"
+#include "application_entity.h"
+#include "application_spatial_grid.h"
+#include "application_tile_map.h"
+#include "application_resampler.h"
+#include "application_pixel_format.h"
+#include "application_audio_effects.h"
+#include "application_audio_stream.h"
+#include "application_rasterizer.h"
+#include "application_render.h"
+#include "application_layer.h"
+#include "application_particle.h"
+#include "application_serialize.h"
+
 struct application_state
 {
     int ToneHz;
+    real32 TonePhase;
     int GreenOffset;
     int BlueOffset;
+
+    uint32 RandomState;
+
+    memory_arena WorldArena;
+    entity_store Entities;
+    tile_map TileMap;
+    audio_mixer Mixer;
+    real32 RasterAngle;
+    render_texture TestTexture;
+    bool32 IsGammaCorrect; // NOTE: Back toggles it, for comparing against blending the bytes as they are
+    render_layer BackgroundLayer;
+    particle_system Particles;
+    particle_emitter Fountains[2];
+
+    // NOTE: the autosave image is made into SaveArena and handed to the platform, which owns it
+    // until SaveRequest isn't Pending anymore
+    platform_file_request SaveRequest;
+    real32 SecondsUntilAutosave;
+    uint64 SaveArenaTouchedSize; // NOTE: how much of SaveArena has had its pages faulted in
+
+    // NOTE: TransientArena spans all of TransientStorage, FrameArena is cleared at the start of every frame,
+    // SaveArena comes right after it and neither of them is part of a saved state
+    memory_arena TransientArena;
+    memory_arena FrameArena;
+    memory_arena SaveArena;
 };
 
+// NOTE: the entry points the platform looks up by name in the app's shared library
+#if APPLICATION_WIN32
+#define APP_EXPORT extern "C" __declspec(dllexport)
+#else
+#define APP_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
 // these functions are dynamically loaded app code for runtime changing
 #define APP_UPDATE_AND_RENDER(name) void name(application_memory *memory, application_input *input, offscreen_graphics_buffer *buffer)
 typedef APP_UPDATE_AND_RENDER(app_update_and_render);
@@ -194,5 +601,34 @@ APP_UPDATE_AND_RENDER(AppUpdateAndRenderStub) {}
 typedef APP_GET_SOUND_SAMPLES(app_get_sound_samples);
 APP_GET_SOUND_SAMPLES(AppGetSoundSamplesStub) {} 
 
+// NOTE: fills in up to max_count arenas and returns how many there are, 0 before the app is initialized
+#define APP_DEBUG_GET_ARENA_INFO(name) uint32 name(application_memory *memory, debug_arena_info *dest, uint32 max_count)
+typedef APP_DEBUG_GET_ARENA_INFO(app_debug_get_arena_info);
+APP_DEBUG_GET_ARENA_INFO(AppDebugGetArenaInfoStub) { return 0; }
+
+// NOTE: between frames with no jobs running. Returns the size of the saved state, which is only
+// written into dest when it fits, 0 when there's nothing to save. See application_serialize.h
+#define APP_SAVE_STATE(name) uint64 name(application_memory *memory, void *dest, uint64 dest_size)
+typedef APP_SAVE_STATE(app_save_state);
+APP_SAVE_STATE(AppSaveStateStub) { return 0; }
+
+// NOTE: between frames with no jobs running, or before the first one. False when the image is from
+// a different build or doesn't fit in memory, the state is left alone then
+#define APP_LOAD_STATE(name) bool32 name(application_memory *memory, void *image, uint64 image_size)
+typedef APP_LOAD_STATE(app_load_state);
+APP_LOAD_STATE(AppLoadStateStub) { return false; }
+
+// NOTE: around a rewind, where the platform puts all of application_memory back from a snapshot it
+// took itself. Begin stops the file requests the app has going, the platform then finishes its own
+// file work before it touches the memory, and End drops the requests the snapshot was taken in the
+// middle of. Between frames with no jobs running
+#define APP_BEGIN_RESTORE_STATE(name) void name(application_memory *memory)
+typedef APP_BEGIN_RESTORE_STATE(app_begin_restore_state);
+APP_BEGIN_RESTORE_STATE(AppBeginRestoreStateStub) {}
+
+#define APP_END_RESTORE_STATE(name) void name(application_memory *memory)
+typedef APP_END_RESTORE_STATE(app_end_restore_state);
+APP_END_RESTORE_STATE(AppEndRestoreStateStub) {}
+
 #define APPLICATION_H
 #endif
\ No newline at end of file
@@ -0,0 +1,212 @@
+/*
+
+  Audio clock. Works out how far ahead of a looping sound device's play
+  cursor the next frame's samples have to be written. Every time the
+  platform is about to write it hands over the device's play and write
+  cursors and the wall clock time, and the clock learns from them:
+
+  - Granularity, how coarsely the device reports its play cursor. Some
+    cursors move sample by sample, some only every 10ms or so. A smooth
+    model of where the cursor ought to be runs alongside the reported one,
+    the spread of the difference is the granularity.
+  - Jitter, how much the time between two writes varies from the video
+    frame time the platform is aiming for.
+  - Write lead, how far the device's write cursor runs ahead of its play
+    cursor. Nothing can be written closer than that.
+
+  The safety margin is granularity plus jitter, with some headroom
+  because both are only ever seen as peaks of what happened so far, plus
+  whatever the last underruns added on top, which drains away again
+  while the device keeps up. Everything is peak held and decays, so a
+  device that settles down gets its latency back. The decay is slow on
+  purpose, a rare late wakeup has to be remembered until the next one.
+
+  Cursors are in sample frames, not bytes. Header only so any platform
+  layer can use it.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_AUDIO_CLOCK_H)
+
+// NOTE: per write, at 30 writes a second these forget a peak in roughly a minute
+#define AUDIO_CLOCK_PEAK_DECAY 0.9995f
+#define AUDIO_CLOCK_SAFETY_HEADROOM 1.2f
+#define AUDIO_CLOCK_MODEL_GAIN 0.05f
+#define AUDIO_CLOCK_MIN_SAFETY_SECONDS 0.001f
+
+struct audio_clock
+{
+    uint32 SamplesPerSecond;
+    uint32 BufferFrameCount; // NOTE: cursors wrap at this
+    real32 SecondsPerVideoFrame;
+
+    bool32 IsSynced;
+    real64 LastTime;
+    uint32 LastPlayCursor;
+    real64 PlayPosition; // NOTE: unwrapped, from the reported cursor
+    real64 ModelPosition; // NOTE: unwrapped, where a perfectly smooth cursor would be
+
+    // NOTE: reported minus model, peak held
+    real32 ResidualHigh;
+    real32 ResidualLow;
+
+    real32 GranularityFrames;
+    real32 JitterSeconds;
+    real32 WriteLeadFrames;
+    real32 UnderrunMarginFrames;
+
+    uint32 SampleCount;
+    uint32 UnderrunCount;
+};
+
+// where the next write should end, and how that was decided
+struct audio_clock_target
+{
+    uint32 TargetCursor; // NOTE: wrapped
+    uint32 ExpectedFlipPlayCursor; // NOTE: wrapped, where the play cursor should be at the next flip
+    uint32 SafetyFrameCount;
+    bool32 IsLowLatency; // NOTE: the device can keep up with writing exactly one video frame ahead of the flip
+};
+
+inline void InitializeAudioClock(audio_clock *clock, uint32 samples_per_second, uint32 buffer_frame_count,
+                                 real32 seconds_per_video_frame)
+{
+    *clock = {};
+    clock->SamplesPerSecond = samples_per_second;
+    clock->BufferFrameCount = buffer_frame_count;
+    clock->SecondsPerVideoFrame = seconds_per_video_frame;
+}
+
+// the cursors jumped, start learning the model over but keep what was learned about the device
+inline void ResyncAudioClock(audio_clock *clock)
+{
+    clock->IsSynced = false;
+}
+
+inline uint32 AudioClockWrappedDistance(audio_clock *clock, uint32 from, uint32 to)
+{
+    uint32 result = (to + clock->BufferFrameCount - from) % clock->BufferFrameCount;
+    return result;
+}
+
+inline real32 AudioClockDecayPeak(real32 peak, real32 value)
+{
+    real32 result = peak*AUDIO_CLOCK_PEAK_DECAY;
+    if(value > result)
+    {
+        result = value;
+    }
+    return result;
+}
+
+// feed in the device's cursors, time is the platform's wall clock in seconds
+internal void AudioClockAddSample(audio_clock *clock, real64 time, uint32 play_cursor, uint32 write_cursor)
+{
+    real32 write_lead = (real32)AudioClockWrappedDistance(clock, play_cursor, write_cursor);
+    clock->WriteLeadFrames = AudioClockDecayPeak(clock->WriteLeadFrames, write_lead);
+
+    real64 seconds_elapsed = time - clock->LastTime;
+    if(!clock->IsSynced || (seconds_elapsed <= 0.0) ||
+       (seconds_elapsed*clock->SamplesPerSecond >= 0.5*clock->BufferFrameCount))
+    {
+        // NOTE: too long since the last sample to tell how many times the cursor went round
+        clock->PlayPosition = play_cursor;
+        clock->ModelPosition = play_cursor;
+        clock->IsSynced = true;
+    }
+    else
+    {
+        clock->PlayPosition += AudioClockWrappedDistance(clock, clock->LastPlayCursor, play_cursor);
+        clock->ModelPosition += seconds_elapsed*clock->SamplesPerSecond;
+
+        real32 residual = (real32)(clock->PlayPosition - clock->ModelPosition);
+        clock->ResidualLow = (residual < clock->ResidualLow) ? residual : clock->ResidualLow*AUDIO_CLOCK_PEAK_DECAY;
+        clock->ResidualHigh = (residual > clock->ResidualHigh) ? residual : clock->ResidualHigh*AUDIO_CLOCK_PEAK_DECAY;
+        clock->GranularityFrames = clock->ResidualHigh - clock->ResidualLow;
+
+        // NOTE: pull the model towards the reports slowly, so it follows drift between the
+        // device's clock and ours but not the steps of a coarse cursor
+        clock->ModelPosition += AUDIO_CLOCK_MODEL_GAIN*residual;
+
+        real32 jitter = (real32)(seconds_elapsed - clock->SecondsPerVideoFrame);
+        jitter = (jitter < 0.0f) ? -jitter : jitter;
+        clock->JitterSeconds = AudioClockDecayPeak(clock->JitterSeconds, jitter);
+        ++clock->SampleCount;
+    }
+
+    clock->LastTime = time;
+    clock->LastPlayCursor = play_cursor;
+    clock->UnderrunMarginFrames *= AUDIO_CLOCK_PEAK_DECAY;
+}
+
+// the play cursor overtook what was written, back off by half a video frame
+inline void AudioClockNoteUnderrun(audio_clock *clock)
+{
+    real32 frames_per_video_frame = clock->SecondsPerVideoFrame*clock->SamplesPerSecond;
+    clock->UnderrunMarginFrames += 0.5f*frames_per_video_frame;
+    if(clock->UnderrunMarginFrames > 2.0f*frames_per_video_frame)
+    {
+        clock->UnderrunMarginFrames = 2.0f*frames_per_video_frame;
+    }
+    ++clock->UnderrunCount;
+    ResyncAudioClock(clock);
+}
+
+inline uint32 AudioClockSafetyFrames(audio_clock *clock)
+{
+    real32 safety = (AUDIO_CLOCK_SAFETY_HEADROOM*(clock->GranularityFrames + clock->JitterSeconds*clock->SamplesPerSecond) +
+                     clock->UnderrunMarginFrames);
+    real32 min_safety = AUDIO_CLOCK_MIN_SAFETY_SECONDS*clock->SamplesPerSecond;
+    if(safety < min_safety)
+    {
+        safety = min_safety;
+    }
+    uint32 result = (uint32)(safety + 0.5f);
+    return result;
+}
+
+// how far to write, given the cursors just read and how long it is until the frame
+// being made now shows up on screen
+internal audio_clock_target AudioClockComputeTarget(audio_clock *clock, uint32 play_cursor, uint32 write_cursor,
+                                                    real32 seconds_until_flip)
+{
+    audio_clock_target result = {};
+
+    if(seconds_until_flip < 0.0f)
+    {
+        seconds_until_flip = 0.0f;
+    }
+    uint32 frames_per_video_frame = (uint32)(clock->SecondsPerVideoFrame*clock->SamplesPerSecond);
+    uint32 frames_until_flip = (uint32)(seconds_until_flip*clock->SamplesPerSecond);
+    uint32 safety = AudioClockSafetyFrames(clock);
+
+    // NOTE: all measured from the play cursor so nothing wraps
+    uint32 write_lead = AudioClockWrappedDistance(clock, play_cursor, write_cursor);
+    uint32 safe_write = write_lead + safety;
+    result.IsLowLatency = (safe_write < frames_until_flip);
+
+    uint32 target = 0;
+    if(result.IsLowLatency)
+    {
+        // NOTE: sound for the next frame starts exactly when its picture does
+        target = frames_until_flip + frames_per_video_frame;
+    }
+    else
+    {
+        target = safe_write + frames_per_video_frame;
+    }
+    if(target >= clock->BufferFrameCount)
+    {
+        target = clock->BufferFrameCount - 1;
+    }
+
+    result.TargetCursor = (play_cursor + target) % clock->BufferFrameCount;
+    result.ExpectedFlipPlayCursor = (play_cursor + frames_until_flip) % clock->BufferFrameCount;
+    result.SafetyFrameCount = safety;
+    return result;
+}
+
+#define APPLICATION_AUDIO_CLOCK_H
+#endif
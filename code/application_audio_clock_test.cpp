@@ -0,0 +1,188 @@
+/*
+
+  Audio clock test. Drives application_audio_clock.h with a simulated
+  looping sound device the way a platform layer would, once per video
+  frame, and checks that the safety margin settles and that the device
+  never runs out of samples once it has.
+
+  The device plays at its own rate, a little off from the wall clock,
+  and only reports its play cursor in steps of CursorGranularity frames.
+  Its write cursor is WriteLead frames past the reported play cursor and
+  everything before the true write cursor is already committed, so the
+  test counts an underrun whenever that passes the end of what was
+  written. The platform wakes up to write some time after every flip,
+  later by a random amount up to WakeJitterSeconds.
+
+  Built and run by linux_build.sh, exits with 1 when a device fails.
+
+  Author: Justin Morrow
+
+*/
+
+#include "application.h"
+#include "application_audio_clock.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#define TEST_SAMPLES_PER_SECOND 48000
+#define TEST_VIDEO_HZ 30
+#define TEST_SECONDS 120
+#define TEST_WARMUP_SECONDS 10 // NOTE: underruns are how the clock learns, only after this they count
+#define TEST_SETTLED_SECONDS 30 // NOTE: the last this many seconds are checked for a steady margin
+
+struct simulated_audio_device
+{
+    char *Name;
+    uint32 CursorGranularity;
+    uint32 WriteLead;
+    real64 DriftRatio; // NOTE: device samples per wall clock sample
+    real64 WakeJitterSeconds;
+};
+
+struct audio_clock_test_result
+{
+    uint32 WarmupUnderrunCount;
+    uint32 UnderrunCount;
+    uint32 MinSafetyFrames;
+    uint32 MaxSafetyFrames;
+    real64 MaxLatencySeconds; // NOTE: from the true play cursor to the end of what was written
+};
+
+inline real64 NextTestRandom(uint32 *state)
+{
+    uint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    real64 result = (real64)x / 4294967296.0;
+    return result;
+}
+
+internal audio_clock_test_result SimulateAudioDevice(simulated_audio_device *device)
+{
+    audio_clock_test_result result = {};
+    result.MinSafetyFrames = 0xFFFFFFFF;
+
+    uint32 buffer_frame_count = TEST_SAMPLES_PER_SECOND;
+    real64 seconds_per_video_frame = 1.0 / (real64)TEST_VIDEO_HZ;
+    audio_clock clock;
+    InitializeAudioClock(&clock, TEST_SAMPLES_PER_SECOND, buffer_frame_count, (real32)seconds_per_video_frame);
+
+    uint32 random_state = 0x1234567;
+    bool32 is_sound_valid = false;
+    real64 written_end = 0.0; // NOTE: unwrapped, in device frames
+
+    uint32 frame_count = TEST_SECONDS*TEST_VIDEO_HZ;
+    uint32 warmup_frame_count = TEST_WARMUP_SECONDS*TEST_VIDEO_HZ;
+    uint32 settled_frame_index = (TEST_SECONDS - TEST_SETTLED_SECONDS)*TEST_VIDEO_HZ;
+    for(uint32 frame_index = 0; frame_index < frame_count; ++frame_index)
+    {
+        // NOTE: the platform wakes up to write after the frame's work, which takes a bit more or less each time
+        real64 flip_time = frame_index*seconds_per_video_frame;
+        real64 work_seconds = 0.002 + device->WakeJitterSeconds*NextTestRandom(&random_state);
+        real64 wake_time = flip_time + work_seconds;
+
+        real64 true_play = wake_time*TEST_SAMPLES_PER_SECOND*device->DriftRatio;
+        real64 reported_play = floor(true_play / device->CursorGranularity)*device->CursorGranularity;
+        uint32 play_cursor = (uint32)fmod(reported_play, (real64)buffer_frame_count);
+        uint32 write_cursor = (play_cursor + device->WriteLead) % buffer_frame_count;
+
+        if(is_sound_valid)
+        {
+            if((true_play + device->WriteLead) > written_end)
+            {
+                if(frame_index < warmup_frame_count)
+                {
+                    ++result.WarmupUnderrunCount;
+                }
+                else
+                {
+                    ++result.UnderrunCount;
+                }
+            }
+
+            // NOTE: what the platform can see, the same test win32_platform_layer.cpp makes
+            if((reported_play + device->WriteLead) > written_end)
+            {
+                AudioClockNoteUnderrun(&clock);
+                is_sound_valid = false;
+            }
+        }
+        if(!is_sound_valid)
+        {
+            written_end = reported_play + device->WriteLead;
+            is_sound_valid = true;
+        }
+
+        AudioClockAddSample(&clock, wake_time, play_cursor, write_cursor);
+        real32 seconds_until_flip = (real32)(seconds_per_video_frame - work_seconds);
+        audio_clock_target target = AudioClockComputeTarget(&clock, play_cursor, write_cursor, seconds_until_flip);
+
+        // NOTE: a target behind what's already written waits for the play cursor to catch up
+        real64 target_end = reported_play + AudioClockWrappedDistance(&clock, play_cursor, target.TargetCursor);
+        if(target_end > written_end)
+        {
+            written_end = target_end;
+        }
+
+        if(frame_index >= settled_frame_index)
+        {
+            if(target.SafetyFrameCount < result.MinSafetyFrames)
+            {
+                result.MinSafetyFrames = target.SafetyFrameCount;
+            }
+            if(target.SafetyFrameCount > result.MaxSafetyFrames)
+            {
+                result.MaxSafetyFrames = target.SafetyFrameCount;
+            }
+
+            real64 latency = (written_end - true_play) / TEST_SAMPLES_PER_SECOND;
+            if(latency > result.MaxLatencySeconds)
+            {
+                result.MaxLatencySeconds = latency;
+            }
+        }
+    }
+
+    return result;
+}
+
+int main(int argument_count, char **arguments)
+{
+    simulated_audio_device devices[] =
+    {
+        {"smooth cursor", 1, 480, 1.0, 0.001},
+        {"10ms cursor", 480, 480, 1.0002, 0.002},
+        {"40ms cursor, slow clock", 1920, 960, 0.9998, 0.004},
+        {"smooth cursor, jittery wakes", 1, 1440, 1.0, 0.008},
+        {"20ms cursor, jittery wakes", 960, 1440, 1.0005, 0.010},
+    };
+
+    int failed_count = 0;
+    for(int device_idx = 0; device_idx < (int)ArrayCount(devices); ++device_idx)
+    {
+        simulated_audio_device *device = devices + device_idx;
+        audio_clock_test_result result = SimulateAudioDevice(device);
+
+        // NOTE: the margin has to cover the cursor steps and the wake jitter and not much more,
+        // and over the settled stretch it may only wander by the slack between the two peaks decaying
+        real64 needed_frames = device->CursorGranularity + device->WakeJitterSeconds*TEST_SAMPLES_PER_SECOND;
+        real64 frames_per_video_frame = (real64)TEST_SAMPLES_PER_SECOND / TEST_VIDEO_HZ;
+        bool32 is_settled = ((result.MaxSafetyFrames - result.MinSafetyFrames) <= (0.25*needed_frames + 48.0));
+        bool32 is_bounded = (result.MaxSafetyFrames <= (1.5*needed_frames + 0.5*frames_per_video_frame));
+        bool32 passed = (!result.UnderrunCount && is_settled && is_bounded);
+        if(!passed)
+        {
+            ++failed_count;
+        }
+
+        printf("%-30s %s  underruns %u (+%u warming up)  safety %u..%u frames, %.0f needed  latency %.1fms\n",
+               device->Name, passed ? "ok    " : "FAILED", result.UnderrunCount, result.WarmupUnderrunCount,
+               result.MinSafetyFrames, result.MaxSafetyFrames, needed_frames, 1000.0*result.MaxLatencySeconds);
+    }
+
+    int result = failed_count ? 1 : 0;
+    return result;
+}
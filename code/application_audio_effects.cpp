@@ -0,0 +1,401 @@
+/*
+
+  Audio effects, see application_audio_effects.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+internal void InitializeAudioEffects(audio_effects *effects, memory_arena *arena)
+{
+    effects->SamplesPerSecond = 0;
+    for(int send_idx = 0; send_idx < AudioSend_Count; ++send_idx)
+    {
+        effects->SendLeft[send_idx] = PushArrayAligned(arena, AUDIO_MIX_BLOCK_FRAME_COUNT, real32, 16);
+        effects->SendRight[send_idx] = PushArrayAligned(arena, AUDIO_MIX_BLOCK_FRAME_COUNT, real32, 16);
+    }
+
+    effects->FilterCount = 0;
+
+    audio_delay *delay = &effects->Delay;
+    delay->Seconds = 0.3f;
+    delay->Feedback = 0.35f;
+    delay->ReturnLevel = 0.5f;
+    delay->ReverbSend = 0.25f;
+    delay->FrameCount = 0;
+    delay->WriteIndex = 0;
+    delay->Left = PushArrayAligned(arena, AUDIO_DELAY_MAX_FRAME_COUNT, real32, 16);
+    delay->Right = PushArrayAligned(arena, AUDIO_DELAY_MAX_FRAME_COUNT, real32, 16);
+
+    audio_reverb *reverb = &effects->Reverb;
+    reverb->Seconds = 2.0f;
+    reverb->Damping = 0.3f;
+    reverb->ReturnLevel = 0.3f;
+    reverb->WriteIndex = 0;
+    reverb->Lines = PushArrayAligned(arena, AUDIO_REVERB_FRAME_COUNT*AUDIO_REVERB_LINE_COUNT, real32, 16);
+
+    effects->CycleCount = 0;
+    effects->BlockCount = 0;
+}
+
+// NOTE: one sample through transposed direct form II
+inline real32 StepBiquad(audio_biquad *biquad, real32 *state, real32 x)
+{
+    real32 y = biquad->B0*x + state[0];
+    state[0] = biquad->B1*x - biquad->A1*y + state[1];
+    state[1] = biquad->B2*x - biquad->A2*y;
+    return y;
+}
+
+// the coefficients from the Audio EQ Cookbook, and what four samples in a row come to from them
+internal void SetBiquadCoefficients(audio_biquad *biquad, uint32 samples_per_second)
+{
+    real64 frequency = biquad->Frequency;
+    if(frequency > 0.49*(real64)samples_per_second)
+    {
+        frequency = 0.49*(real64)samples_per_second;
+    }
+    real64 w0 = 2.0*3.14159265358979*frequency / (real64)samples_per_second;
+    real64 cos_w0 = cos(w0);
+    real64 alpha = sin(w0) / (2.0*biquad->Q);
+
+    real64 b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+    switch(biquad->Type)
+    {
+        case AudioFilter_LowPass:
+        {
+            b0 = 0.5*(1.0 - cos_w0);
+            b1 = 1.0 - cos_w0;
+            b2 = 0.5*(1.0 - cos_w0);
+            a0 = 1.0 + alpha;
+            a1 = -2.0*cos_w0;
+            a2 = 1.0 - alpha;
+        } break;
+
+        case AudioFilter_HighPass:
+        {
+            b0 = 0.5*(1.0 + cos_w0);
+            b1 = -(1.0 + cos_w0);
+            b2 = 0.5*(1.0 + cos_w0);
+            a0 = 1.0 + alpha;
+            a1 = -2.0*cos_w0;
+            a2 = 1.0 - alpha;
+        } break;
+
+        case AudioFilter_Peak:
+        {
+            real64 a = pow(10.0, biquad->GainDB / 40.0);
+            b0 = 1.0 + alpha*a;
+            b1 = -2.0*cos_w0;
+            b2 = 1.0 - alpha*a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0*cos_w0;
+            a2 = 1.0 - alpha / a;
+        } break;
+
+        default: Assert(!"unknown filter type"); break;
+    }
+
+    biquad->B0 = (real32)(b0 / a0);
+    biquad->B1 = (real32)(b1 / a0);
+    biquad->B2 = (real32)(b2 / a0);
+    biquad->A1 = (real32)(a1 / a0);
+    biquad->A2 = (real32)(a2 / a0);
+
+    // NOTE: run the filter on its own for four samples from each state value, then from each input
+    for(int state_idx = 0; state_idx < 2; ++state_idx)
+    {
+        real32 state[2] = {(state_idx == 0) ? 1.0f : 0.0f, (state_idx == 1) ? 1.0f : 0.0f};
+        for(int sample_idx = 0; sample_idx < 4; ++sample_idx)
+        {
+            biquad->StateResponse[state_idx][sample_idx] = StepBiquad(biquad, state, 0.0f);
+        }
+    }
+    for(int input_idx = 0; input_idx < 4; ++input_idx)
+    {
+        real32 state[2] = {0.0f, 0.0f};
+        for(int sample_idx = 0; sample_idx < 4; ++sample_idx)
+        {
+            biquad->InputResponse[input_idx][sample_idx] =
+                StepBiquad(biquad, state, (sample_idx == input_idx) ? 1.0f : 0.0f);
+        }
+    }
+
+    biquad->State[0][0] = biquad->State[0][1] = 0.0f;
+    biquad->State[1][0] = biquad->State[1][1] = 0.0f;
+}
+
+// put a filter on the end of the chain on the mix bus, false when the chain is full
+internal bool32 AddAudioFilter(audio_effects *effects, audio_filter_type type, real32 frequency, real32 q,
+                               real32 gain_db)
+{
+    bool32 result = false;
+    if(effects->FilterCount < AUDIO_MAX_FILTER_COUNT)
+    {
+        audio_biquad *biquad = effects->Filters + effects->FilterCount++;
+        biquad->Type = type;
+        biquad->Frequency = frequency;
+        biquad->Q = q;
+        biquad->GainDB = gain_db;
+        if(effects->SamplesPerSecond)
+        {
+            SetBiquadCoefficients(biquad, effects->SamplesPerSecond);
+        }
+        result = true;
+    }
+    return result;
+}
+
+// work the settings out for the rate and start every effect over from silence
+internal void ConfigureAudioEffects(audio_effects *effects, uint32 samples_per_second)
+{
+    effects->SamplesPerSecond = samples_per_second;
+    real32 rate = (real32)samples_per_second;
+
+    for(uint32 filter_idx = 0; filter_idx < effects->FilterCount; ++filter_idx)
+    {
+        SetBiquadCoefficients(effects->Filters + filter_idx, samples_per_second);
+    }
+
+    // NOTE: at least 4 frames so four samples in a row are never read after they're written
+    audio_delay *delay = &effects->Delay;
+    real32 delay_seconds = (delay->Seconds < AUDIO_DELAY_MAX_SECONDS) ? delay->Seconds : AUDIO_DELAY_MAX_SECONDS;
+    delay->FrameCount = (uint32)(delay_seconds*rate);
+    delay->FrameCount = (delay->FrameCount < 4) ? 4 : delay->FrameCount;
+    delay->FrameCount = (delay->FrameCount > AUDIO_DELAY_MAX_FRAME_COUNT) ? AUDIO_DELAY_MAX_FRAME_COUNT : delay->FrameCount;
+    delay->WriteIndex = 0;
+    for(uint32 frame_idx = 0; frame_idx < delay->FrameCount; ++frame_idx)
+    {
+        delay->Left[frame_idx] = 0.0f;
+        delay->Right[frame_idx] = 0.0f;
+    }
+
+    // NOTE: lengths with nothing in common so the echoes don't line up, each line loses as much
+    // on every trip as its length is worth of the 60dB
+    local_persist real32 line_milliseconds[AUDIO_REVERB_LINE_COUNT] = {29.7f, 37.1f, 41.1f, 43.7f, 53.3f, 59.9f, 67.7f, 73.1f};
+    audio_reverb *reverb = &effects->Reverb;
+    for(int line_idx = 0; line_idx < AUDIO_REVERB_LINE_COUNT; ++line_idx)
+    {
+        uint32 length = (uint32)(0.001f*line_milliseconds[line_idx]*rate) | 1;
+        length = (length < AUDIO_REVERB_FRAME_COUNT) ? length : (AUDIO_REVERB_FRAME_COUNT - 1);
+        reverb->LineLength[line_idx] = length;
+        reverb->LineGain[line_idx] = powf(10.0f, -3.0f*(real32)length / (reverb->Seconds*rate));
+        reverb->DampState[line_idx] = 0.0f;
+    }
+    reverb->WriteIndex = 0;
+    for(uint32 sample_idx = 0; sample_idx < AUDIO_REVERB_FRAME_COUNT*AUDIO_REVERB_LINE_COUNT; ++sample_idx)
+    {
+        reverb->Lines[sample_idx] = 0.0f;
+    }
+}
+
+internal void ProcessBiquad(audio_biquad *biquad, int channel, real32 *samples, int frame_count)
+{
+    __m128 state_response0 = _mm_loadu_ps(biquad->StateResponse[0]);
+    __m128 state_response1 = _mm_loadu_ps(biquad->StateResponse[1]);
+    __m128 input_response0 = _mm_loadu_ps(biquad->InputResponse[0]);
+    __m128 input_response1 = _mm_loadu_ps(biquad->InputResponse[1]);
+    __m128 input_response2 = _mm_loadu_ps(biquad->InputResponse[2]);
+    __m128 input_response3 = _mm_loadu_ps(biquad->InputResponse[3]);
+
+    real32 *state = biquad->State[channel];
+    int frame_idx = 0;
+    for(; frame_idx + 4 <= frame_count; frame_idx += 4)
+    {
+        real32 *at = samples + frame_idx;
+        real32 x2 = at[2];
+        real32 x3 = at[3];
+
+        __m128 x = _mm_loadu_ps(at);
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(state[0]), state_response0),
+                              _mm_mul_ps(_mm_set1_ps(state[1]), state_response1));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0x00), input_response0));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0x55), input_response1));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xAA), input_response2));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xFF), input_response3));
+        _mm_storeu_ps(at, y);
+
+        // NOTE: the state after the last sample only depends on the last two samples in and out
+        real32 y2 = at[2];
+        real32 y3 = at[3];
+        state[0] = biquad->B1*x3 - biquad->A1*y3 + biquad->B2*x2 - biquad->A2*y2;
+        state[1] = biquad->B2*x3 - biquad->A2*y3;
+    }
+    for(; frame_idx < frame_count; ++frame_idx)
+    {
+        samples[frame_idx] = StepBiquad(biquad, state, samples[frame_idx]);
+    }
+}
+
+// the delay send through the delay, out into the mix bus and on to the reverb send
+internal void ProcessDelay(audio_effects *effects, int first_frame, int frame_count, real32 *mix_left, real32 *mix_right)
+{
+    audio_delay *delay = &effects->Delay;
+    real32 *send[2] = {effects->SendLeft[AudioSend_Delay] + first_frame, effects->SendRight[AudioSend_Delay] + first_frame};
+    real32 *reverb_send[2] = {effects->SendLeft[AudioSend_Reverb] + first_frame,
+                              effects->SendRight[AudioSend_Reverb] + first_frame};
+    real32 *mix[2] = {mix_left + first_frame, mix_right + first_frame};
+    real32 *line[2] = {delay->Left, delay->Right};
+
+    __m128 feedback = _mm_set1_ps(delay->Feedback);
+    __m128 return_level = _mm_set1_ps(delay->ReturnLevel);
+    __m128 reverb_level = _mm_set1_ps(delay->ReverbSend);
+
+    // NOTE: the line is exactly as long as the delay, so the sample read is the one about to be overwritten.
+    // Runs go up to where the line wraps
+    int frame_idx = 0;
+    while(frame_idx < frame_count)
+    {
+        int run = frame_count - frame_idx;
+        if(run > (int)(delay->FrameCount - delay->WriteIndex))
+        {
+            run = (int)(delay->FrameCount - delay->WriteIndex);
+        }
+
+        for(int channel = 0; channel < 2; ++channel)
+        {
+            real32 *in = send[channel] + frame_idx;
+            real32 *out = mix[channel] + frame_idx;
+            real32 *on_to_reverb = reverb_send[channel] + frame_idx;
+            real32 *at = line[channel] + delay->WriteIndex;
+
+            int run_idx = 0;
+            for(; run_idx + 4 <= run; run_idx += 4)
+            {
+                __m128 delayed = _mm_loadu_ps(at + run_idx);
+                _mm_storeu_ps(at + run_idx, _mm_add_ps(_mm_loadu_ps(in + run_idx), _mm_mul_ps(delayed, feedback)));
+                _mm_storeu_ps(out + run_idx, _mm_add_ps(_mm_loadu_ps(out + run_idx), _mm_mul_ps(delayed, return_level)));
+                _mm_storeu_ps(on_to_reverb + run_idx,
+                              _mm_add_ps(_mm_loadu_ps(on_to_reverb + run_idx), _mm_mul_ps(delayed, reverb_level)));
+            }
+            for(; run_idx < run; ++run_idx)
+            {
+                real32 delayed = at[run_idx];
+                at[run_idx] = in[run_idx] + delay->Feedback*delayed;
+                out[run_idx] += delay->ReturnLevel*delayed;
+                on_to_reverb[run_idx] += delay->ReverbSend*delayed;
+            }
+        }
+
+        frame_idx += run;
+        delay->WriteIndex += run;
+        if(delay->WriteIndex == delay->FrameCount)
+        {
+            delay->WriteIndex = 0;
+        }
+    }
+}
+
+// NOTE: the 4 point Hadamard transform of the lanes, unscaled
+inline __m128 Hadamard4(__m128 x)
+{
+    __m128 flip_odd = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    __m128 flip_high = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+    x = _mm_add_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)), _mm_mul_ps(x, flip_odd));
+    x = _mm_add_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 0, 3, 2)), _mm_mul_ps(x, flip_high));
+    return x;
+}
+
+// the reverb send through the delay network and out into the mix bus, lines 0 to 3 in one
+// register and 4 to 7 in another, left takes the even lines and right the odd ones
+internal void ProcessReverb(audio_effects *effects, int first_frame, int frame_count, real32 *mix_left, real32 *mix_right)
+{
+    audio_reverb *reverb = &effects->Reverb;
+    real32 *send_left = effects->SendLeft[AudioSend_Reverb] + first_frame;
+    real32 *send_right = effects->SendRight[AudioSend_Reverb] + first_frame;
+    mix_left += first_frame;
+    mix_right += first_frame;
+
+    __m128 gain_low = _mm_loadu_ps(reverb->LineGain);
+    __m128 gain_high = _mm_loadu_ps(reverb->LineGain + 4);
+    __m128 damp_low = _mm_loadu_ps(reverb->DampState);
+    __m128 damp_high = _mm_loadu_ps(reverb->DampState + 4);
+    __m128 damping = _mm_set1_ps(reverb->Damping);
+    __m128 hadamard_scale = _mm_set1_ps(0.35355339f); // NOTE: 1 / sqrt(8), so a trip around loses nothing by itself
+    real32 return_level = reverb->ReturnLevel;
+
+    uint32 *length = reverb->LineLength;
+    uint32 mask = AUDIO_REVERB_FRAME_COUNT - 1;
+    uint32 write_idx = reverb->WriteIndex;
+    real32 *lines = reverb->Lines;
+    for(int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+    {
+        __m128 low = _mm_setr_ps(lines[((write_idx - length[0]) & mask)*AUDIO_REVERB_LINE_COUNT + 0],
+                                 lines[((write_idx - length[1]) & mask)*AUDIO_REVERB_LINE_COUNT + 1],
+                                 lines[((write_idx - length[2]) & mask)*AUDIO_REVERB_LINE_COUNT + 2],
+                                 lines[((write_idx - length[3]) & mask)*AUDIO_REVERB_LINE_COUNT + 3]);
+        __m128 high = _mm_setr_ps(lines[((write_idx - length[4]) & mask)*AUDIO_REVERB_LINE_COUNT + 4],
+                                  lines[((write_idx - length[5]) & mask)*AUDIO_REVERB_LINE_COUNT + 5],
+                                  lines[((write_idx - length[6]) & mask)*AUDIO_REVERB_LINE_COUNT + 6],
+                                  lines[((write_idx - length[7]) & mask)*AUDIO_REVERB_LINE_COUNT + 7]);
+
+        // NOTE: one pole low pass, damp = line + damping*(damp - line)
+        low = _mm_mul_ps(low, gain_low);
+        high = _mm_mul_ps(high, gain_high);
+        damp_low = _mm_add_ps(low, _mm_mul_ps(damping, _mm_sub_ps(damp_low, low)));
+        damp_high = _mm_add_ps(high, _mm_mul_ps(damping, _mm_sub_ps(damp_high, high)));
+
+        __m128 sum = _mm_add_ps(damp_low, damp_high);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        mix_left[frame_idx] += return_level*_mm_cvtss_f32(sum);
+        mix_right[frame_idx] += return_level*_mm_cvtss_f32(_mm_shuffle_ps(sum, sum, 0x55));
+
+        // NOTE: the 8 point Hadamard is the 4 point one on the sum and the difference of the halves
+        __m128 mixed_low = Hadamard4(_mm_add_ps(damp_low, damp_high));
+        __m128 mixed_high = Hadamard4(_mm_sub_ps(damp_low, damp_high));
+        __m128 in = _mm_setr_ps(send_left[frame_idx], send_right[frame_idx], send_left[frame_idx], send_right[frame_idx]);
+        real32 *at = lines + write_idx*AUDIO_REVERB_LINE_COUNT;
+        _mm_storeu_ps(at, _mm_add_ps(_mm_mul_ps(mixed_low, hadamard_scale), in));
+        _mm_storeu_ps(at + 4, _mm_add_ps(_mm_mul_ps(mixed_high, hadamard_scale), in));
+
+        write_idx = (write_idx + 1) & mask;
+    }
+
+    _mm_storeu_ps(reverb->DampState, damp_low);
+    _mm_storeu_ps(reverb->DampState + 4, damp_high);
+    reverb->WriteIndex = write_idx;
+}
+
+// run the sends through their effects into the mix bus and the mix bus through the filters,
+// AUDIO_EFFECTS_BLOCK_FRAME_COUNT frames at a time. The sends are left holding whatever went into them
+internal void ProcessAudioEffects(audio_effects *effects, uint32 samples_per_second, real32 *mix_left, real32 *mix_right,
+                                  int frame_count)
+{
+    Assert(frame_count <= AUDIO_MIX_BLOCK_FRAME_COUNT);
+    uint64 start_cycle_count = __rdtsc();
+
+    if(effects->SamplesPerSecond != samples_per_second)
+    {
+        ConfigureAudioEffects(effects, samples_per_second);
+    }
+
+    // NOTE: the reverb's tail dies away through denormals, which are very slow on some processors
+    uint32 old_csr = _mm_getcsr();
+    _mm_setcsr(old_csr | 0x8040);
+
+    for(int first_frame = 0; first_frame < frame_count; first_frame += AUDIO_EFFECTS_BLOCK_FRAME_COUNT)
+    {
+        int block_frame_count = frame_count - first_frame;
+        if(block_frame_count > AUDIO_EFFECTS_BLOCK_FRAME_COUNT)
+        {
+            block_frame_count = AUDIO_EFFECTS_BLOCK_FRAME_COUNT;
+        }
+
+        ProcessDelay(effects, first_frame, block_frame_count, mix_left, mix_right);
+        ProcessReverb(effects, first_frame, block_frame_count, mix_left, mix_right);
+        for(uint32 filter_idx = 0; filter_idx < effects->FilterCount; ++filter_idx)
+        {
+            ProcessBiquad(effects->Filters + filter_idx, 0, mix_left + first_frame, block_frame_count);
+            ProcessBiquad(effects->Filters + filter_idx, 1, mix_right + first_frame, block_frame_count);
+        }
+        ++effects->BlockCount;
+    }
+
+    _mm_setcsr(old_csr);
+    effects->CycleCount += __rdtsc() - start_cycle_count;
+}
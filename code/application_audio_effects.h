@@ -0,0 +1,131 @@
+/*
+
+  Audio effects. Everything the mixer mixes goes into the mix bus, and
+  every stream can also send some of itself to the delay and to the
+  reverb. The delay's output goes back into the mix bus and can be sent
+  on to the reverb as well, the reverb's output goes back into the mix
+  bus, and the mix bus runs through a chain of biquad filters on its way
+  out:
+
+      streams --+---------------------------> mix bus -> filters -> out
+                +--> delay send -> delay --------^   |
+                +--> reverb send <---------------+   |
+                     reverb send -> reverb ----------+
+
+  The effects work on blocks of AUDIO_EFFECTS_BLOCK_FRAME_COUNT frames in
+  SSE:
+
+  - a biquad works out four samples in a row at once. What a biquad does
+    with four inputs from a given state is linear in the inputs and the
+    state, so the four outputs are a couple of vectors times the state
+    plus four vectors times the inputs, worked out once from the
+    coefficients
+  - the delay reads four samples it wrote at least four samples ago, so
+    there's nothing between the lanes
+  - the reverb is a feedback delay network of 8 delay lines, one per
+    lane, mixed back into each other through a Hadamard matrix, with a
+    one pole low pass on every line for the highs to die out first
+
+  Settings are in seconds and hertz, they get worked out into samples and
+  coefficients again whenever the output rate changes. All of the state is
+  allocated once with the mixer.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_AUDIO_EFFECTS_H)
+
+#define AUDIO_EFFECTS_BLOCK_FRAME_COUNT 128
+#define AUDIO_MAX_FILTER_COUNT 4
+
+#define AUDIO_DELAY_MAX_SECONDS 1.0f
+#define AUDIO_DELAY_MAX_FRAME_COUNT 96000 // NOTE: a second at the highest rate the effects are sized for
+#define AUDIO_REVERB_LINE_COUNT 8
+#define AUDIO_REVERB_FRAME_COUNT 8192 // NOTE: must be a power of 2, longer than the longest line
+
+enum audio_send
+{
+    AudioSend_Delay,
+    AudioSend_Reverb,
+
+    AudioSend_Count,
+};
+
+enum audio_filter_type
+{
+    AudioFilter_LowPass,
+    AudioFilter_HighPass,
+    AudioFilter_Peak,
+};
+
+struct audio_biquad
+{
+    audio_filter_type Type;
+    real32 Frequency;
+    real32 Q;
+    real32 GainDB; // NOTE: peak filters only
+
+    // NOTE: normalized so a0 is 1, transposed direct form II
+    real32 B0;
+    real32 B1;
+    real32 B2;
+    real32 A1;
+    real32 A2;
+
+    // NOTE: what each of the two state values and each of four inputs in a row adds to the four outputs
+    real32 StateResponse[2][4];
+    real32 InputResponse[4][4];
+
+    real32 State[2][2]; // NOTE: per channel
+};
+
+struct audio_delay
+{
+    real32 Seconds;
+    real32 Feedback;
+    real32 ReturnLevel;
+    real32 ReverbSend; // NOTE: how much of what comes out goes on to the reverb
+
+    uint32 FrameCount;
+    uint32 WriteIndex;
+    real32 *Left; // NOTE: AUDIO_DELAY_MAX_FRAME_COUNT each
+    real32 *Right;
+};
+
+struct audio_reverb
+{
+    real32 Seconds; // NOTE: how long it takes to die down by 60dB
+    real32 Damping; // NOTE: 0 to 1, how much faster the highs die down
+    real32 ReturnLevel;
+
+    uint32 LineLength[AUDIO_REVERB_LINE_COUNT];
+    real32 LineGain[AUDIO_REVERB_LINE_COUNT];
+    real32 DampState[AUDIO_REVERB_LINE_COUNT];
+
+    // NOTE: the lines are interleaved, a line's sample i is Lines[i*AUDIO_REVERB_LINE_COUNT + line]
+    // so every line writes at the same place and one sample of all of them is two stores
+    uint32 WriteIndex;
+    real32 *Lines;
+};
+
+struct audio_effects
+{
+    uint32 SamplesPerSecond; // NOTE: what the settings were last worked out for, 0 before the first block
+
+    // NOTE: AUDIO_MIX_BLOCK_FRAME_COUNT frames, the streams add into these along with the mix bus
+    real32 *SendLeft[AudioSend_Count];
+    real32 *SendRight[AudioSend_Count];
+
+    uint32 FilterCount;
+    audio_biquad Filters[AUDIO_MAX_FILTER_COUNT];
+    audio_delay Delay;
+    audio_reverb Reverb;
+
+    // NOTE: since the start
+    uint64 CycleCount;
+    uint64 BlockCount;
+};
+
+#define APPLICATION_AUDIO_EFFECTS_H
+#endif
@@ -0,0 +1,575 @@
+/*
+
+  Audio streams, see application_audio_stream.h
+
+  Author: Justin Morrow
+
+*/
+
+internal void InitializeAudioMixer(audio_mixer *mixer, memory_arena *arena)
+{
+    mixer->OutputRate = 0;
+    mixer->MixLeft = PushArrayAligned(arena, AUDIO_MIX_BLOCK_FRAME_COUNT, real32, 16);
+    mixer->MixRight = PushArrayAligned(arena, AUDIO_MIX_BLOCK_FRAME_COUNT, real32, 16);
+    mixer->Resampled = PushArrayAligned(arena, 2*AUDIO_MIX_BLOCK_FRAME_COUNT, int16, 16);
+
+    // NOTE: a file may run at up to twice the mixer's rate, one block never needs more input than this
+    int max_input_frame_count = 2*AUDIO_MIX_BLOCK_FRAME_COUNT + RESAMPLER_MAX_TAP_COUNT;
+    for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+    {
+        audio_stream *stream = mixer->Streams + stream_idx;
+        stream->State = AudioStream_Free;
+        for(int chunk_idx = 0; chunk_idx < AUDIO_STREAM_CHUNK_COUNT; ++chunk_idx)
+        {
+            stream->Chunks[chunk_idx].Data = PushArrayAligned(arena, AUDIO_STREAM_CHUNK_SIZE, uint8, 16);
+        }
+        stream->ResamplerMemory = PushSize_(arena, ResamplerMemorySize(ResamplerQuality_Medium, max_input_frame_count), 16);
+        stream->Decoded = PushArrayAligned(arena, 2*max_input_frame_count, int16, 16);
+    }
+
+    InitializeAudioEffects(&mixer->Effects, arena);
+
+    mixer->ChunksRequested = 0;
+    mixer->StarvedFrameCount = 0;
+}
+
+// open the stream's file again and play it from the start
+inline void RestartAudioStream(audio_stream *stream)
+{
+    stream->State = AudioStream_Opening;
+    stream->File.Platform = 0;
+    stream->OpenRequest.State = PlatformFileRequest_Idle;
+    for(int chunk_idx = 0; chunk_idx < AUDIO_STREAM_CHUNK_COUNT; ++chunk_idx)
+    {
+        stream->Chunks[chunk_idx].Request.State = PlatformFileRequest_Idle;
+    }
+    stream->FirstChunk = 0;
+    stream->QueuedChunkCount = 0;
+    stream->PlayOffsetInChunk = 0;
+    stream->NextReadOffset = 0;
+    stream->IsAtEnd = false;
+    stream->StarvedFrameCount = 0;
+}
+
+// start playing a wav file, 0 when every stream is busy. The file is opened on the
+// platform's file thread, a file that can't be played just frees the stream again
+internal audio_stream *PlayAudioStream(audio_mixer *mixer, char *filename, real32 volume, bool32 is_looping)
+{
+    audio_stream *result = 0;
+    for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+    {
+        audio_stream *stream = mixer->Streams + stream_idx;
+        if(stream->State == AudioStream_Free)
+        {
+            result = stream;
+            break;
+        }
+    }
+
+    if(result)
+    {
+        int char_idx = 0;
+        for(; filename[char_idx] && (char_idx < ArrayCount(result->Filename) - 1); ++char_idx)
+        {
+            result->Filename[char_idx] = filename[char_idx];
+        }
+        result->Filename[char_idx] = 0;
+
+        result->IsLooping = is_looping;
+        result->Volume = volume;
+        for(int send_idx = 0; send_idx < AudioSend_Count; ++send_idx)
+        {
+            result->Sends[send_idx] = 0.0f;
+        }
+        RestartAudioStream(result);
+    }
+
+    return result;
+}
+
+// NOTE: before the mixer is overwritten by a load, nothing the platform is still doing may land in it afterwards
+internal void CloseAudioStreamsForLoad(audio_mixer *mixer)
+{
+    for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+    {
+        audio_stream *stream = mixer->Streams + stream_idx;
+        if(stream->File.Platform)
+        {
+            Platform.CloseFile(&stream->File);
+        }
+
+        while(stream->OpenRequest.State == PlatformFileRequest_Pending)
+        {
+            _mm_pause();
+        }
+        for(int chunk_idx = 0; chunk_idx < AUDIO_STREAM_CHUNK_COUNT; ++chunk_idx)
+        {
+            while(stream->Chunks[chunk_idx].Request.State == PlatformFileRequest_Pending)
+            {
+                _mm_pause();
+            }
+        }
+    }
+}
+
+// NOTE: after a load, the file handles and reads in the loaded streams belonged to whoever saved them
+internal void RestartAudioStreamsAfterLoad(audio_mixer *mixer)
+{
+    for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+    {
+        audio_stream *stream = mixer->Streams + stream_idx;
+        if(stream->State == AudioStream_Stopping)
+        {
+            stream->State = AudioStream_Free;
+        }
+        else if(stream->State != AudioStream_Free)
+        {
+            RestartAudioStream(stream);
+        }
+    }
+}
+
+// the stream frees itself once the platform is done with its memory
+inline void StopAudioStream(audio_stream *stream)
+{
+    if(stream->State != AudioStream_Free)
+    {
+        stream->State = AudioStream_Stopping;
+    }
+}
+
+inline uint16 ReadWavUInt16(uint8 *at)
+{
+    uint16 result = (uint16)(at[0] | (at[1] << 8));
+    return result;
+}
+
+inline uint32 ReadWavUInt32(uint8 *at)
+{
+    uint32 result = (uint32)at[0] | ((uint32)at[1] << 8) | ((uint32)at[2] << 16) | ((uint32)at[3] << 24);
+    return result;
+}
+
+inline bool32 WavChunkIdIs(uint8 *at, char *id)
+{
+    bool32 result = ((at[0] == id[0]) && (at[1] == id[1]) && (at[2] == id[2]) && (at[3] == id[3]));
+    return result;
+}
+
+// the start of the file, the data chunk has to begin somewhere inside it
+internal bool32 ParseWavHeader(audio_stream *stream, uint8 *header, uint32 header_size, uint32 output_rate)
+{
+    if((header_size < 12) || !WavChunkIdIs(header, "RIFF") || !WavChunkIdIs(header + 8, "WAVE"))
+    {
+        return false;
+    }
+
+    // NOTE: offsets are 64 bit so a hostile chunk size can't wrap them back onto a chunk that was
+    // already parsed, and every chunk has to fit in the file, or in the header unless it's the data
+    bool32 found_format = false;
+    uint64 at_offset = 12;
+    while((at_offset + 8) <= header_size)
+    {
+        uint8 *chunk = header + at_offset;
+        uint64 chunk_size = ReadWavUInt32(chunk + 4);
+        uint8 *payload = chunk + 8;
+
+        uint64 chunk_end = at_offset + 8 + chunk_size;
+        if((chunk_end > stream->File.Size) ||
+           (!WavChunkIdIs(chunk, "data") && (chunk_end > header_size)))
+        {
+            return false;
+        }
+
+        if(WavChunkIdIs(chunk, "fmt "))
+        {
+            if(chunk_size < 16)
+            {
+                return false;
+            }
+
+            uint16 format_tag = ReadWavUInt16(payload + 0);
+            uint16 channel_count = ReadWavUInt16(payload + 2);
+            uint32 samples_per_second = ReadWavUInt32(payload + 4);
+            uint16 block_align = ReadWavUInt16(payload + 12);
+            uint16 bits_per_sample = ReadWavUInt16(payload + 14);
+
+            // NOTE: WAVE_FORMAT_EXTENSIBLE, the real tag is the start of the sub format guid
+            if((format_tag == 0xFFFE) && (chunk_size >= 40))
+            {
+                format_tag = ReadWavUInt16(payload + 24);
+            }
+
+            if((format_tag == 1) && (bits_per_sample == 16))
+            {
+                stream->Format = AudioSampleFormat_PCM16;
+            }
+            else if((format_tag == 3) && (bits_per_sample == 32))
+            {
+                stream->Format = AudioSampleFormat_Float32;
+            }
+            else
+            {
+                return false;
+            }
+
+            if((channel_count == 0) || (block_align != channel_count*(bits_per_sample/8)) ||
+               (samples_per_second == 0) || (samples_per_second > 2*output_rate))
+            {
+                return false;
+            }
+
+            stream->ChannelCount = channel_count;
+            stream->SamplesPerSecond = samples_per_second;
+            stream->BytesPerFrame = block_align;
+            found_format = true;
+        }
+        else if(WavChunkIdIs(chunk, "data"))
+        {
+            if(!found_format)
+            {
+                return false;
+            }
+
+            stream->DataOffset = at_offset + 8;
+            stream->DataSize = chunk_size;
+            stream->DataSize -= stream->DataSize % stream->BytesPerFrame;
+
+            return (stream->DataSize > 0);
+        }
+
+        // NOTE: chunks are padded to an even size
+        at_offset = chunk_end + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+// keep enough chunks in flight to cover prefetch_seconds of playback
+internal void QueueAudioStreamChunks(audio_mixer *mixer, audio_stream *stream, real32 prefetch_seconds)
+{
+    uint64 prefetch_bytes = (uint64)(prefetch_seconds*(real32)(stream->SamplesPerSecond*stream->BytesPerFrame));
+
+    uint64 queued_bytes = 0;
+    for(uint32 queued_idx = 0; queued_idx < stream->QueuedChunkCount; ++queued_idx)
+    {
+        queued_bytes += stream->Chunks[(stream->FirstChunk + queued_idx) % AUDIO_STREAM_CHUNK_COUNT].Size;
+    }
+    queued_bytes -= stream->PlayOffsetInChunk;
+
+    // NOTE: when the ring can't hold prefetch_bytes the stream just reads as far ahead as it can
+    while(!stream->IsAtEnd && (stream->QueuedChunkCount < AUDIO_STREAM_CHUNK_COUNT) && (queued_bytes < prefetch_bytes))
+    {
+        uint32 chunk_idx = (stream->FirstChunk + stream->QueuedChunkCount) % AUDIO_STREAM_CHUNK_COUNT;
+        audio_stream_chunk *chunk = stream->Chunks + chunk_idx;
+        Assert(chunk->Request.State != PlatformFileRequest_Pending);
+
+        uint64 bytes_left = stream->DataSize - stream->NextReadOffset;
+        uint32 size = (bytes_left < stream->ChunkSize) ? (uint32)bytes_left : stream->ChunkSize;
+        if(!Platform.ReadDataFromFile(&stream->File, stream->DataOffset + stream->NextReadOffset, size,
+                                      chunk->Data, &chunk->Request))
+        {
+            break;
+        }
+
+        chunk->Size = size;
+        queued_bytes += size;
+        ++stream->QueuedChunkCount;
+        ++mixer->ChunksRequested;
+
+        stream->NextReadOffset += size;
+        if(stream->NextReadOffset == stream->DataSize)
+        {
+            if(stream->IsLooping)
+            {
+                stream->NextReadOffset = 0;
+            }
+            else
+            {
+                stream->IsAtEnd = true;
+            }
+        }
+    }
+}
+
+inline bool32 AudioStreamHasPendingRequests(audio_stream *stream)
+{
+    bool32 result = (stream->OpenRequest.State == PlatformFileRequest_Pending);
+    for(int chunk_idx = 0; chunk_idx < AUDIO_STREAM_CHUNK_COUNT; ++chunk_idx)
+    {
+        result |= (stream->Chunks[chunk_idx].Request.State == PlatformFileRequest_Pending);
+    }
+    return result;
+}
+
+// move a stream along through opening, reading its header and reading ahead
+internal void UpdateAudioStream(audio_mixer *mixer, audio_stream *stream, real32 prefetch_seconds)
+{
+    switch(stream->State)
+    {
+        case AudioStream_Opening:
+        {
+            platform_file_request *request = &stream->OpenRequest;
+            if(request->State == PlatformFileRequest_Idle)
+            {
+                Platform.OpenFile(stream->Filename, &stream->File, request);
+            }
+            else if(request->State == PlatformFileRequest_Done)
+            {
+                stream->State = AudioStream_ReadingHeader;
+            }
+            else if(request->State == PlatformFileRequest_Failed)
+            {
+                stream->State = AudioStream_Stopping;
+            }
+        } break;
+
+        case AudioStream_ReadingHeader:
+        {
+            // NOTE: the header goes into the first chunk, it gets read again as data later
+            audio_stream_chunk *chunk = stream->Chunks;
+            if(chunk->Request.State == PlatformFileRequest_Idle)
+            {
+                uint32 size = (stream->File.Size < AUDIO_STREAM_CHUNK_SIZE) ? (uint32)stream->File.Size : AUDIO_STREAM_CHUNK_SIZE;
+                Platform.ReadDataFromFile(&stream->File, 0, size, chunk->Data, &chunk->Request);
+            }
+            else if(chunk->Request.State == PlatformFileRequest_Done)
+            {
+                chunk->Request.State = PlatformFileRequest_Idle;
+                if(ParseWavHeader(stream, chunk->Data, chunk->Request.BytesRead, mixer->OutputRate))
+                {
+                    stream->ChunkSize = AUDIO_STREAM_CHUNK_SIZE - (AUDIO_STREAM_CHUNK_SIZE % stream->BytesPerFrame);
+                    InitializeResampler(&stream->Resampler, stream->ResamplerMemory, stream->SamplesPerSecond,
+                                        mixer->OutputRate, ResamplerQuality_Medium,
+                                        2*AUDIO_MIX_BLOCK_FRAME_COUNT + RESAMPLER_MAX_TAP_COUNT);
+                    stream->State = AudioStream_Prefetching;
+                }
+                else
+                {
+                    stream->State = AudioStream_Stopping;
+                }
+            }
+            else if(chunk->Request.State == PlatformFileRequest_Failed)
+            {
+                stream->State = AudioStream_Stopping;
+            }
+        } break;
+
+        case AudioStream_Prefetching:
+        {
+            // NOTE: hold off until there's something to play, so the start isn't eaten as starvation
+            QueueAudioStreamChunks(mixer, stream, prefetch_seconds);
+            uint32 first_state = stream->Chunks[stream->FirstChunk].Request.State;
+            if(first_state == PlatformFileRequest_Done)
+            {
+                stream->State = AudioStream_Playing;
+            }
+            else if(first_state == PlatformFileRequest_Failed)
+            {
+                stream->State = AudioStream_Stopping;
+            }
+        } break;
+
+        case AudioStream_Playing:
+        {
+            QueueAudioStreamChunks(mixer, stream, prefetch_seconds);
+        } break;
+
+        case AudioStream_Stopping:
+        {
+            // NOTE: the file thread may still be writing into the chunks
+            if(!AudioStreamHasPendingRequests(stream))
+            {
+                if(!stream->File.Platform || Platform.CloseFile(&stream->File))
+                {
+                    stream->State = AudioStream_Free;
+                }
+            }
+        } break;
+
+        default: {} break;
+    }
+}
+
+// convert frame_count frames out of the chunk ring to 16 bit stereo, returns how many were there
+internal int DecodeAudioStreamFrames(audio_stream *stream, int16 *dest, int frame_count)
+{
+    int frames_decoded = 0;
+    while((frames_decoded < frame_count) && stream->QueuedChunkCount)
+    {
+        audio_stream_chunk *chunk = stream->Chunks + stream->FirstChunk;
+        if(chunk->Request.State != PlatformFileRequest_Done)
+        {
+            if(chunk->Request.State == PlatformFileRequest_Failed)
+            {
+                StopAudioStream(stream);
+            }
+            break;
+        }
+
+        uint32 frames_in_chunk = (chunk->Size - stream->PlayOffsetInChunk) / stream->BytesPerFrame;
+        uint32 frames_to_decode = (uint32)(frame_count - frames_decoded);
+        if(frames_to_decode > frames_in_chunk)
+        {
+            frames_to_decode = frames_in_chunk;
+        }
+
+        uint8 *source = chunk->Data + stream->PlayOffsetInChunk;
+        int16 *out = dest + 2*frames_decoded;
+        uint32 right_channel = (stream->ChannelCount > 1) ? 1 : 0;
+        if(stream->Format == AudioSampleFormat_PCM16)
+        {
+            for(uint32 frame_idx = 0; frame_idx < frames_to_decode; ++frame_idx)
+            {
+                int16 *frame = (int16 *)source + frame_idx*stream->ChannelCount;
+                *out++ = frame[0];
+                *out++ = frame[right_channel];
+            }
+        }
+        else
+        {
+            for(uint32 frame_idx = 0; frame_idx < frames_to_decode; ++frame_idx)
+            {
+                real32 *frame = (real32 *)source + frame_idx*stream->ChannelCount;
+                for(uint32 channel_idx = 0; channel_idx < 2; ++channel_idx)
+                {
+                    real32 value = frame[channel_idx ? right_channel : 0];
+                    value = (value < -1.0f) ? -1.0f : ((value > 1.0f) ? 1.0f : value);
+                    *out++ = (int16)(value*32767.0f);
+                }
+            }
+        }
+
+        frames_decoded += frames_to_decode;
+        stream->PlayOffsetInChunk += frames_to_decode*stream->BytesPerFrame;
+        if((stream->PlayOffsetInChunk + stream->BytesPerFrame) > chunk->Size)
+        {
+            // NOTE: played through, the chunk can be read into again
+            chunk->Request.State = PlatformFileRequest_Idle;
+            stream->FirstChunk = (stream->FirstChunk + 1) % AUDIO_STREAM_CHUNK_COUNT;
+            --stream->QueuedChunkCount;
+            stream->PlayOffsetInChunk = 0;
+        }
+    }
+
+    return frames_decoded;
+}
+
+// add frame_count frames of the stream on top of the mix block
+internal void MixAudioStream(audio_mixer *mixer, audio_stream *stream, int frame_count)
+{
+    int input_frame_count = ResamplerInputFramesNeeded(&stream->Resampler, frame_count);
+    int frames_decoded = DecodeAudioStreamFrames(stream, stream->Decoded, input_frame_count);
+    if(frames_decoded < input_frame_count)
+    {
+        // NOTE: whatever didn't make it off the disk in time plays as silence, so the stream keeps its place
+        for(int sample_idx = 2*frames_decoded; sample_idx < 2*input_frame_count; ++sample_idx)
+        {
+            stream->Decoded[sample_idx] = 0;
+        }
+
+        if(stream->IsAtEnd && !stream->QueuedChunkCount)
+        {
+            StopAudioStream(stream);
+        }
+        else if(stream->State == AudioStream_Playing)
+        {
+            stream->StarvedFrameCount += input_frame_count - frames_decoded;
+            mixer->StarvedFrameCount += input_frame_count - frames_decoded;
+        }
+    }
+
+    ResampleStereo(&stream->Resampler, stream->Decoded, input_frame_count, mixer->Resampled, frame_count);
+
+    real32 volume = stream->Volume;
+    int16 *sample = mixer->Resampled;
+    for(int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+    {
+        mixer->MixLeft[frame_idx] += volume*(real32)*sample++;
+        mixer->MixRight[frame_idx] += volume*(real32)*sample++;
+    }
+
+    audio_effects *effects = &mixer->Effects;
+    for(int send_idx = 0; send_idx < AudioSend_Count; ++send_idx)
+    {
+        real32 send_volume = volume*stream->Sends[send_idx];
+        if(send_volume != 0.0f)
+        {
+            real32 *send_left = effects->SendLeft[send_idx];
+            real32 *send_right = effects->SendRight[send_idx];
+            sample = mixer->Resampled;
+            for(int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+            {
+                send_left[frame_idx] += send_volume*(real32)*sample++;
+                send_right[frame_idx] += send_volume*(real32)*sample++;
+            }
+        }
+    }
+}
+
+// mix every playing stream and the effects on top of what is already in the sound buffer
+internal void MixAudioStreams(audio_mixer *mixer, application_sound_output_buffer *sound_buffer)
+{
+    mixer->OutputRate = sound_buffer->SamplesPerSecond;
+    audio_effects *effects = &mixer->Effects;
+    uint64 effects_cycle_count = effects->CycleCount;
+    uint64 effects_block_count = effects->BlockCount;
+
+    // NOTE: the reads asked for now have to be back before the mixer gets to them, which is
+    // this call's worth of samples plus however far ahead of the play cursor they are written
+    real32 prefetch_seconds = ((real32)sound_buffer->SampleCount / (real32)sound_buffer->SamplesPerSecond +
+                               sound_buffer->LatencySeconds + AUDIO_STREAM_IO_ALLOWANCE_SECONDS);
+    for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+    {
+        UpdateAudioStream(mixer, mixer->Streams + stream_idx, prefetch_seconds);
+    }
+
+    int16 *samples = sound_buffer->Samples;
+    for(int block_start = 0; block_start < sound_buffer->SampleCount; block_start += AUDIO_MIX_BLOCK_FRAME_COUNT)
+    {
+        int frame_count = sound_buffer->SampleCount - block_start;
+        if(frame_count > AUDIO_MIX_BLOCK_FRAME_COUNT)
+        {
+            frame_count = AUDIO_MIX_BLOCK_FRAME_COUNT;
+        }
+
+        int16 *block = samples + 2*block_start;
+        for(int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+        {
+            mixer->MixLeft[frame_idx] = (real32)block[2*frame_idx + 0];
+            mixer->MixRight[frame_idx] = (real32)block[2*frame_idx + 1];
+        }
+        for(int send_idx = 0; send_idx < AudioSend_Count; ++send_idx)
+        {
+            for(int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+            {
+                effects->SendLeft[send_idx][frame_idx] = 0.0f;
+                effects->SendRight[send_idx][frame_idx] = 0.0f;
+            }
+        }
+
+        for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+        {
+            audio_stream *stream = mixer->Streams + stream_idx;
+            if(stream->State == AudioStream_Playing)
+            {
+                MixAudioStream(mixer, stream, frame_count);
+            }
+        }
+
+        ProcessAudioEffects(effects, mixer->OutputRate, mixer->MixLeft, mixer->MixRight, frame_count);
+
+        for(int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+        {
+            real32 left = mixer->MixLeft[frame_idx];
+            real32 right = mixer->MixRight[frame_idx];
+            left = (left < -32768.0f) ? -32768.0f : ((left > 32767.0f) ? 32767.0f : left);
+            right = (right < -32768.0f) ? -32768.0f : ((right > 32767.0f) ? 32767.0f : right);
+            block[2*frame_idx + 0] = (int16)left;
+            block[2*frame_idx + 1] = (int16)right;
+        }
+    }
+
+    sound_buffer->EffectsCycleCount = effects->CycleCount - effects_cycle_count;
+    sound_buffer->EffectsBlockCount = (uint32)(effects->BlockCount - effects_block_count);
+}
@@ -0,0 +1,103 @@
+/*
+
+  Audio streams. Long sounds play straight off the disk instead of being
+  loaded whole. Every stream owns a small ring of fixed size chunks, the
+  mixer keeps enough of them read ahead of the play position to cover the
+  audio latency plus however long the disk takes, and hands the rest back
+  to the platform's file thread as they are played through. A stream costs
+  the same amount of memory no matter how long its file is.
+
+  Chunks hold the file's bytes as they are, they are converted to 16 bit
+  stereo as they get mixed and resampled when the file's rate isn't the
+  mixer's.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_AUDIO_STREAM_H)
+
+#define MAX_AUDIO_STREAM_COUNT 16
+#define AUDIO_STREAM_CHUNK_COUNT 8
+#define AUDIO_STREAM_CHUNK_SIZE Kilobytes(32)
+
+// NOTE: the mixer works through a sound buffer this many frames at a time
+#define AUDIO_MIX_BLOCK_FRAME_COUNT 1024
+
+// NOTE: extra read ahead on top of the audio latency for the disk to come back in
+#define AUDIO_STREAM_IO_ALLOWANCE_SECONDS 0.1f
+
+enum audio_stream_state
+{
+    AudioStream_Free,
+    AudioStream_Opening,
+    AudioStream_ReadingHeader,
+    AudioStream_Prefetching,
+    AudioStream_Playing,
+    AudioStream_Stopping, // NOTE: waiting for its outstanding reads before the slot can be reused
+};
+
+enum audio_sample_format
+{
+    AudioSampleFormat_PCM16,
+    AudioSampleFormat_Float32,
+};
+
+struct audio_stream_chunk
+{
+    platform_file_request Request;
+    uint32 Size;
+    uint8 *Data;
+};
+
+struct audio_stream
+{
+    audio_stream_state State;
+    bool32 IsLooping;
+    real32 Volume;
+    real32 Sends[AudioSend_Count]; // NOTE: how much of the stream goes to each effect, on top of the mix bus
+    char Filename[256];
+
+    platform_file_handle File;
+    platform_file_request OpenRequest;
+
+    // NOTE: from the file's header
+    audio_sample_format Format;
+    uint32 ChannelCount;
+    uint32 SamplesPerSecond;
+    uint32 BytesPerFrame;
+    uint64 DataOffset;
+    uint64 DataSize;
+
+    // NOTE: chunks [FirstChunk, FirstChunk + QueuedChunkCount) are read or being read, in play order
+    audio_stream_chunk Chunks[AUDIO_STREAM_CHUNK_COUNT];
+    uint32 ChunkSize; // NOTE: AUDIO_STREAM_CHUNK_SIZE rounded down to whole frames
+    uint32 FirstChunk;
+    uint32 QueuedChunkCount;
+    uint32 PlayOffsetInChunk;
+    uint64 NextReadOffset; // NOTE: into the data, where the next chunk gets read from
+    bool32 IsAtEnd; // NOTE: every chunk has been asked for and the stream doesn't loop
+
+    resampler Resampler;
+    void *ResamplerMemory;
+    int16 *Decoded; // NOTE: one block's worth of frames at the file's rate
+
+    uint32 StarvedFrameCount;
+};
+
+struct audio_mixer
+{
+    uint32 OutputRate;
+    real32 *MixLeft;
+    real32 *MixRight;
+    int16 *Resampled;
+
+    audio_effects Effects;
+    audio_stream Streams[MAX_AUDIO_STREAM_COUNT];
+
+    uint32 ChunksRequested;
+    uint32 StarvedFrameCount;
+};
+
+#define APPLICATION_AUDIO_STREAM_H
+#endif
@@ -0,0 +1,282 @@
+/*
+
+  Debug text. A tiny embedded 5x8 bitmap font gets baked once into a glyph
+  atlas of 32-bit pixel masks, after that drawing a glyph is nothing but SSE2
+  masked copies of its rows into an offscreen_graphics_buffer. This is for
+  on-screen diagnostics only, there is no kerning, unicode or anti-aliasing.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_DEBUG_TEXT_H)
+
+#include <emmintrin.h>
+
+#define DEBUG_FONT_FIRST_CHAR 32
+#define DEBUG_FONT_GLYPH_COUNT 95
+#define DEBUG_FONT_CELL_WIDTH 8 // glyphs are 5 wide, the rest is padding so rows are 4 pixel aligned
+#define DEBUG_FONT_CELL_HEIGHT 8
+#define DEBUG_FONT_ADVANCE 6
+#define DEBUG_FONT_LINE_HEIGHT 10
+
+// one byte per row, bit 4 is the leftmost pixel, starting at ' '
+global_variable uint8 DebugFontRows[DEBUG_FONT_GLYPH_COUNT*DEBUG_FONT_CELL_HEIGHT] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // ' '
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04, 0x00, // '!'
+    0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, // '"'
+    0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A, 0x00, // '#'
+    0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04, 0x00, // '$'
+    0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03, 0x00, // '%'
+    0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D, 0x00, // '&'
+    0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, // '\''
+    0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02, 0x00, // '('
+    0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08, 0x00, // ')'
+    0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00, 0x00, // '*'
+    0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00, 0x00, // '+'
+    0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08, 0x00, // ','
+    0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00, // '-'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00, // '.'
+    0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00, 0x00, // '/'
+    0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E, 0x00, // '0'
+    0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E, 0x00, // '1'
+    0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F, 0x00, // '2'
+    0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E, 0x00, // '3'
+    0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02, 0x00, // '4'
+    0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E, 0x00, // '5'
+    0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E, 0x00, // '6'
+    0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08, 0x00, // '7'
+    0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E, 0x00, // '8'
+    0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C, 0x00, // '9'
+    0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00, 0x00, // ':'
+    0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08, 0x00, // ';'
+    0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02, 0x00, // '<'
+    0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00, 0x00, // '='
+    0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08, 0x00, // '>'
+    0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04, 0x00, // '?'
+    0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E, 0x00, // '@'
+    0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11, 0x00, // 'A'
+    0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E, 0x00, // 'B'
+    0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E, 0x00, // 'C'
+    0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C, 0x00, // 'D'
+    0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F, 0x00, // 'E'
+    0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10, 0x00, // 'F'
+    0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F, 0x00, // 'G'
+    0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11, 0x00, // 'H'
+    0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E, 0x00, // 'I'
+    0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C, 0x00, // 'J'
+    0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11, 0x00, // 'K'
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F, 0x00, // 'L'
+    0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11, 0x00, // 'M'
+    0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11, 0x00, // 'N'
+    0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E, 0x00, // 'O'
+    0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10, 0x00, // 'P'
+    0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D, 0x00, // 'Q'
+    0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11, 0x00, // 'R'
+    0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E, 0x00, // 'S'
+    0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, // 'T'
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E, 0x00, // 'U'
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04, 0x00, // 'V'
+    0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A, 0x00, // 'W'
+    0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11, 0x00, // 'X'
+    0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x00, // 'Y'
+    0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F, 0x00, // 'Z'
+    0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E, 0x00, // '['
+    0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00, 0x00, // '\\'
+    0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E, 0x00, // ']'
+    0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, // '^'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x00, // '_'
+    0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, // '`'
+    0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00, // 'a'
+    0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E, 0x00, // 'b'
+    0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E, 0x00, // 'c'
+    0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F, 0x00, // 'd'
+    0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00, // 'e'
+    0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08, 0x00, // 'f'
+    0x00, 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E, // 'g'
+    0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11, 0x00, // 'h'
+    0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E, 0x00, // 'i'
+    0x02, 0x00, 0x06, 0x02, 0x02, 0x02, 0x12, 0x0C, // 'j'
+    0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12, 0x00, // 'k'
+    0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E, 0x00, // 'l'
+    0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11, 0x00, // 'm'
+    0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11, 0x00, // 'n'
+    0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E, 0x00, // 'o'
+    0x00, 0x00, 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, // 'p'
+    0x00, 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x01, // 'q'
+    0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10, 0x00, // 'r'
+    0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E, 0x00, // 's'
+    0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06, 0x00, // 't'
+    0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D, 0x00, // 'u'
+    0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04, 0x00, // 'v'
+    0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A, 0x00, // 'w'
+    0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x00, // 'x'
+    0x00, 0x00, 0x11, 0x11, 0x11, 0x0F, 0x01, 0x0E, // 'y'
+    0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F, 0x00, // 'z'
+    0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02, 0x00, // '{'
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, // '|'
+    0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08, 0x00, // '}'
+    0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00, 0x00, // '~'
+};
+
+struct debug_glyph_atlas
+{
+    int Scale;
+    int GlyphWidth; // always a multiple of 4
+    int GlyphHeight;
+    int AdvanceX;
+    int LineHeight;
+
+    // GlyphWidth*GlyphHeight masks per glyph, each 0 or 0xFFFFFFFF
+    uint32 *Masks;
+};
+
+inline uint64 DebugGlyphAtlasSize(int scale)
+{
+    uint64 result = (uint64)DEBUG_FONT_GLYPH_COUNT *
+        (DEBUG_FONT_CELL_WIDTH*scale) * (DEBUG_FONT_CELL_HEIGHT*scale) * sizeof(uint32);
+    return result;
+}
+
+// expand the font into pixel masks, memory must be 16 byte aligned and DebugGlyphAtlasSize(scale) big
+internal void BakeDebugGlyphAtlas(debug_glyph_atlas *atlas, void *memory, int scale)
+{
+    Assert(((uintptr_t)memory & 15) == 0);
+
+    atlas->Scale = scale;
+    atlas->GlyphWidth = DEBUG_FONT_CELL_WIDTH*scale;
+    atlas->GlyphHeight = DEBUG_FONT_CELL_HEIGHT*scale;
+    atlas->AdvanceX = DEBUG_FONT_ADVANCE*scale;
+    atlas->LineHeight = DEBUG_FONT_LINE_HEIGHT*scale;
+    atlas->Masks = (uint32 *)memory;
+
+    uint32 *mask = atlas->Masks;
+    for(int glyph_idx = 0; glyph_idx < DEBUG_FONT_GLYPH_COUNT; ++glyph_idx)
+    {
+        for(int y = 0; y < atlas->GlyphHeight; ++y)
+        {
+            uint8 row_bits = DebugFontRows[glyph_idx*DEBUG_FONT_CELL_HEIGHT + (y / scale)];
+            for(int x = 0; x < atlas->GlyphWidth; ++x)
+            {
+                int font_x = x / scale;
+                bool32 is_set = (font_x < 5) && (row_bits & (0x10 >> font_x));
+                *mask++ = is_set ? 0xFFFFFFFF : 0;
+            }
+        }
+    }
+}
+
+inline uint32 *GetDebugGlyphMasks(debug_glyph_atlas *atlas, char c)
+{
+    uint32 *result = 0;
+    int glyph_idx = (int)c - DEBUG_FONT_FIRST_CHAR;
+    if((glyph_idx > 0) && (glyph_idx < DEBUG_FONT_GLYPH_COUNT)) // NOTE: 0 is ' ', nothing to draw
+    {
+        result = atlas->Masks + glyph_idx*atlas->GlyphWidth*atlas->GlyphHeight;
+    }
+    return result;
+}
+
+internal void DrawDebugGlyph(offscreen_graphics_buffer *buffer, debug_glyph_atlas *atlas,
+                             int min_x, int min_y, uint32 *glyph_masks, uint32 color)
+{
+    int max_x = min_x + atlas->GlyphWidth;
+    int max_y = min_y + atlas->GlyphHeight;
+
+    if((min_x >= 0) && (min_y >= 0) && (max_x <= buffer->Width) && (max_y <= buffer->Height))
+    {
+        // NOTE: the whole glyph is on screen, blend 4 pixels at a time
+        __m128i color_4x = _mm_set1_epi32((int)color);
+        uint8 *row = (uint8 *)buffer->Memory + min_y*buffer->Pitch + min_x*sizeof(uint32);
+        uint32 *mask_row = glyph_masks;
+        for(int y = 0; y < atlas->GlyphHeight; ++y)
+        {
+            uint32 *pixel = (uint32 *)row;
+            for(int x = 0; x < atlas->GlyphWidth; x += 4)
+            {
+                __m128i mask = _mm_load_si128((__m128i *)(mask_row + x));
+                __m128i dest = _mm_loadu_si128((__m128i *)(pixel + x));
+                dest = _mm_or_si128(_mm_and_si128(mask, color_4x), _mm_andnot_si128(mask, dest));
+                _mm_storeu_si128((__m128i *)(pixel + x), dest);
+            }
+
+            row += buffer->Pitch;
+            mask_row += atlas->GlyphWidth;
+        }
+    }
+    else
+    {
+        // NOTE: clipped glyph, go pixel by pixel
+        int clip_min_x = (min_x < 0) ? 0 : min_x;
+        int clip_min_y = (min_y < 0) ? 0 : min_y;
+        int clip_max_x = (max_x > buffer->Width) ? buffer->Width : max_x;
+        int clip_max_y = (max_y > buffer->Height) ? buffer->Height : max_y;
+
+        for(int y = clip_min_y; y < clip_max_y; ++y)
+        {
+            uint32 *pixel = (uint32 *)((uint8 *)buffer->Memory + y*buffer->Pitch);
+            uint32 *mask_row = glyph_masks + (y - min_y)*atlas->GlyphWidth;
+            for(int x = clip_min_x; x < clip_max_x; ++x)
+            {
+                uint32 mask = mask_row[x - min_x];
+                pixel[x] = (mask & color) | (~mask & pixel[x]);
+            }
+        }
+    }
+}
+
+// draw text with its top left at x, y. returns how far down the text went
+internal int DrawDebugText(offscreen_graphics_buffer *buffer, debug_glyph_atlas *atlas,
+                           int x, int y, char *text, uint32 color)
+{
+    int at_x = x;
+    for(char *c = text; *c; ++c)
+    {
+        if(*c == '\n')
+        {
+            at_x = x;
+            y += atlas->LineHeight;
+        }
+        else
+        {
+            uint32 *glyph_masks = GetDebugGlyphMasks(atlas, *c);
+            if(glyph_masks)
+            {
+                DrawDebugGlyph(buffer, atlas, at_x, y, glyph_masks, color);
+            }
+            at_x += atlas->AdvanceX;
+        }
+    }
+
+    return y + atlas->LineHeight;
+}
+
+// halve the brightness of a rectangle so text over it stays readable
+internal void DarkenDebugRectangle(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y)
+{
+    if(min_x < 0) min_x = 0;
+    if(min_y < 0) min_y = 0;
+    if(max_x > buffer->Width) max_x = buffer->Width;
+    if(max_y > buffer->Height) max_y = buffer->Height;
+
+    __m128i half_mask = _mm_set1_epi32(0x007F7F7F);
+    for(int y = min_y; y < max_y; ++y)
+    {
+        uint32 *pixel = (uint32 *)((uint8 *)buffer->Memory + y*buffer->Pitch);
+        int x = min_x;
+        for(; x + 4 <= max_x; x += 4)
+        {
+            __m128i dest = _mm_loadu_si128((__m128i *)(pixel + x));
+            dest = _mm_and_si128(_mm_srli_epi32(dest, 1), half_mask);
+            _mm_storeu_si128((__m128i *)(pixel + x), dest);
+        }
+        for(; x < max_x; ++x)
+        {
+            pixel[x] = (pixel[x] >> 1) & 0x007F7F7F;
+        }
+    }
+}
+
+#define APPLICATION_DEBUG_TEXT_H
+#endif
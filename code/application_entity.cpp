@@ -0,0 +1,239 @@
+/*
+
+  Entity storage, see application_entity.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <emmintrin.h>
+
+internal void InitializeEntityStore(entity_store *store, memory_arena *arena, uint32 capacity)
+{
+    capacity = (capacity + 3) & ~3;
+
+    store->Capacity = capacity;
+    store->Count = 0;
+
+    store->PositionX = PushArrayAligned(arena, capacity, real32, 16);
+    store->PositionY = PushArrayAligned(arena, capacity, real32, 16);
+    store->VelocityX = PushArrayAligned(arena, capacity, real32, 16);
+    store->VelocityY = PushArrayAligned(arena, capacity, real32, 16);
+    store->Flags = PushArrayAligned(arena, capacity, uint32, 16);
+    store->DenseToSlot = PushArrayAligned(arena, capacity, uint32, 16);
+
+    store->SlotToDense = PushArray(arena, capacity, uint32);
+    store->SlotGeneration = PushArray(arena, capacity, uint32);
+
+    for(uint32 slot_idx = 0; slot_idx < capacity; ++slot_idx)
+    {
+        store->SlotToDense[slot_idx] = slot_idx + 1;
+        store->SlotGeneration[slot_idx] = 1;
+    }
+    store->SlotToDense[capacity - 1] = ENTITY_INVALID_INDEX;
+    store->FreeSlotHead = 0;
+}
+
+// the dense index of a live entity, or ENTITY_INVALID_INDEX if the handle is stale
+inline uint32 GetEntityDenseIndex(entity_store *store, entity_handle handle)
+{
+    uint32 result = ENTITY_INVALID_INDEX;
+    if((handle.Slot < store->Capacity) &&
+       (handle.Generation != 0) &&
+       (store->SlotGeneration[handle.Slot] == handle.Generation))
+    {
+        // NOTE: a free slot has a generation too, the one its next entity will get, and its SlotToDense
+        // is the free list link. Only a live slot is pointed back at by the dense entity it points to
+        uint32 dense_idx = store->SlotToDense[handle.Slot];
+        if((dense_idx < store->Count) && (store->DenseToSlot[dense_idx] == handle.Slot))
+        {
+            result = dense_idx;
+        }
+    }
+    return result;
+}
+
+inline bool32 IsEntityValid(entity_store *store, entity_handle handle)
+{
+    bool32 result = (GetEntityDenseIndex(store, handle) != ENTITY_INVALID_INDEX);
+    return result;
+}
+
+inline entity_handle GetEntityHandle(entity_store *store, uint32 dense_idx)
+{
+    Assert(dense_idx < store->Count);
+    entity_handle result = {};
+    result.Slot = store->DenseToSlot[dense_idx];
+    result.Generation = store->SlotGeneration[result.Slot];
+    return result;
+}
+
+// returns the null handle when the store is full
+internal entity_handle AddEntity(entity_store *store, real32 x, real32 y, real32 dx, real32 dy, uint32 flags)
+{
+    entity_handle result = {};
+    if(store->FreeSlotHead != ENTITY_INVALID_INDEX)
+    {
+        uint32 slot_idx = store->FreeSlotHead;
+        store->FreeSlotHead = store->SlotToDense[slot_idx];
+
+        uint32 dense_idx = store->Count++;
+        store->PositionX[dense_idx] = x;
+        store->PositionY[dense_idx] = y;
+        store->VelocityX[dense_idx] = dx;
+        store->VelocityY[dense_idx] = dy;
+        store->Flags[dense_idx] = flags;
+        store->DenseToSlot[dense_idx] = slot_idx;
+        store->SlotToDense[slot_idx] = dense_idx;
+
+        result.Slot = slot_idx;
+        result.Generation = store->SlotGeneration[slot_idx];
+    }
+
+    return result;
+}
+
+// swap-remove so the lanes stay dense, every other handle stays valid
+internal bool32 RemoveEntity(entity_store *store, entity_handle handle)
+{
+    bool32 result = false;
+
+    uint32 dense_idx = GetEntityDenseIndex(store, handle);
+    if(dense_idx != ENTITY_INVALID_INDEX)
+    {
+        uint32 last_idx = --store->Count;
+        if(dense_idx != last_idx)
+        {
+            store->PositionX[dense_idx] = store->PositionX[last_idx];
+            store->PositionY[dense_idx] = store->PositionY[last_idx];
+            store->VelocityX[dense_idx] = store->VelocityX[last_idx];
+            store->VelocityY[dense_idx] = store->VelocityY[last_idx];
+            store->Flags[dense_idx] = store->Flags[last_idx];
+
+            uint32 moved_slot_idx = store->DenseToSlot[last_idx];
+            store->DenseToSlot[dense_idx] = moved_slot_idx;
+            store->SlotToDense[moved_slot_idx] = dense_idx;
+        }
+
+        // NOTE: bumping the generation invalidates every outstanding handle to this slot
+        if(++store->SlotGeneration[handle.Slot] == 0)
+        {
+            store->SlotGeneration[handle.Slot] = 1;
+        }
+        store->SlotToDense[handle.Slot] = store->FreeSlotHead;
+        store->FreeSlotHead = handle.Slot;
+
+        result = true;
+    }
+
+    return result;
+}
+
+// move the dense entities [first_idx, one_past_last_idx), the ones with EntityFlag_Bounces bounce off
+// the bounds and the rest wrap around to the other side, first_idx has to be a multiple of 4
+internal void MoveEntities(entity_store *store, uint32 first_idx, uint32 one_past_last_idx, real32 dt,
+                           real32 min_x, real32 min_y, real32 max_x, real32 max_y)
+{
+    Assert((first_idx & 3) == 0);
+    Assert(one_past_last_idx <= store->Count);
+
+    __m128 dt_4x = _mm_set1_ps(dt);
+    __m128 min_x_4x = _mm_set1_ps(min_x);
+    __m128 min_y_4x = _mm_set1_ps(min_y);
+    __m128 max_x_4x = _mm_set1_ps(max_x);
+    __m128 max_y_4x = _mm_set1_ps(max_y);
+    __m128 width_4x = _mm_set1_ps(max_x - min_x);
+    __m128 height_4x = _mm_set1_ps(max_y - min_y);
+    __m128 sign_bit_4x = _mm_set1_ps(-0.0f);
+    __m128i bounces_4x = _mm_set1_epi32(EntityFlag_Bounces);
+
+    // NOTE: runs up to 3 lanes past the last entity, those lanes are dead storage
+    for(uint32 idx = first_idx; idx < one_past_last_idx; idx += 4)
+    {
+        __m128 x = _mm_load_ps(store->PositionX + idx);
+        __m128 y = _mm_load_ps(store->PositionY + idx);
+        __m128 dx = _mm_load_ps(store->VelocityX + idx);
+        __m128 dy = _mm_load_ps(store->VelocityY + idx);
+        __m128i flags = _mm_load_si128((__m128i *)(store->Flags + idx));
+        __m128 bounces = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, bounces_4x), bounces_4x));
+
+        x = _mm_add_ps(x, _mm_mul_ps(dx, dt_4x));
+        y = _mm_add_ps(y, _mm_mul_ps(dy, dt_4x));
+
+        __m128 below_x = _mm_cmplt_ps(x, min_x_4x);
+        __m128 above_x = _mm_cmpgt_ps(x, max_x_4x);
+        __m128 below_y = _mm_cmplt_ps(y, min_y_4x);
+        __m128 above_y = _mm_cmpgt_ps(y, max_y_4x);
+
+        // NOTE: bouncing flips the velocity and stops at the edge
+        __m128 out_x = _mm_or_ps(below_x, above_x);
+        __m128 out_y = _mm_or_ps(below_y, above_y);
+        dx = _mm_xor_ps(dx, _mm_and_ps(_mm_and_ps(out_x, bounces), sign_bit_4x));
+        dy = _mm_xor_ps(dy, _mm_and_ps(_mm_and_ps(out_y, bounces), sign_bit_4x));
+        __m128 bounced_x = _mm_min_ps(_mm_max_ps(x, min_x_4x), max_x_4x);
+        __m128 bounced_y = _mm_min_ps(_mm_max_ps(y, min_y_4x), max_y_4x);
+
+        // NOTE: wrapping keeps the velocity and moves over by the size of the bounds
+        __m128 wrapped_x = _mm_sub_ps(_mm_add_ps(x, _mm_and_ps(below_x, width_4x)), _mm_and_ps(above_x, width_4x));
+        __m128 wrapped_y = _mm_sub_ps(_mm_add_ps(y, _mm_and_ps(below_y, height_4x)), _mm_and_ps(above_y, height_4x));
+
+        x = _mm_or_ps(_mm_and_ps(bounces, bounced_x), _mm_andnot_ps(bounces, wrapped_x));
+        y = _mm_or_ps(_mm_and_ps(bounces, bounced_y), _mm_andnot_ps(bounces, wrapped_y));
+
+        _mm_store_ps(store->PositionX + idx, x);
+        _mm_store_ps(store->PositionY + idx, y);
+        _mm_store_ps(store->VelocityX + idx, dx);
+        _mm_store_ps(store->VelocityY + idx, dy);
+    }
+}
+
+// gather the dense indices of every entity inside the rectangle that has all of required_flags,
+// returns how many were written to results
+internal uint32 QueryEntitiesInRectangle(entity_store *store, real32 min_x, real32 min_y,
+                                         real32 max_x, real32 max_y, uint32 required_flags,
+                                         uint32 *results, uint32 max_result_count)
+{
+    uint32 result_count = 0;
+
+    __m128 min_x_4x = _mm_set1_ps(min_x);
+    __m128 min_y_4x = _mm_set1_ps(min_y);
+    __m128 max_x_4x = _mm_set1_ps(max_x);
+    __m128 max_y_4x = _mm_set1_ps(max_y);
+    __m128i required_4x = _mm_set1_epi32((int)required_flags);
+
+    for(uint32 idx = 0; idx < store->Count; idx += 4)
+    {
+        __m128 x = _mm_load_ps(store->PositionX + idx);
+        __m128 y = _mm_load_ps(store->PositionY + idx);
+        __m128i flags = _mm_load_si128((__m128i *)(store->Flags + idx));
+
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, min_x_4x), _mm_cmple_ps(x, max_x_4x)),
+                                   _mm_and_ps(_mm_cmpge_ps(y, min_y_4x), _mm_cmple_ps(y, max_y_4x)));
+        __m128i has_flags = _mm_cmpeq_epi32(_mm_and_si128(flags, required_4x), required_4x);
+        int lane_mask = _mm_movemask_ps(_mm_and_ps(inside, _mm_castsi128_ps(has_flags)));
+
+        // NOTE: drop the dead lanes past the last entity
+        uint32 live_lane_count = store->Count - idx;
+        if(live_lane_count < 4)
+        {
+            lane_mask &= (1 << live_lane_count) - 1;
+        }
+
+        while(lane_mask)
+        {
+            uint32 lane = 0;
+            while(!(lane_mask & (1 << lane)))
+            {
+                ++lane;
+            }
+            lane_mask &= ~(1 << lane);
+
+            if(result_count < max_result_count)
+            {
+                results[result_count++] = idx + lane;
+            }
+        }
+    }
+
+    return result_count;
+}
@@ -0,0 +1,54 @@
+/*
+
+  Entity storage. Entities are referenced through handles (a slot index plus
+  a generation) that stay valid no matter how the entity data moves around,
+  while the data itself is kept as dense structure-of-arrays lanes so update
+  and query loops can run over contiguous floats 4 at a time.
+
+  Removing an entity swaps the last live entity into its place, so the live
+  entities are always [0, Count) with no holes.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_ENTITY_H)
+
+#define ENTITY_INVALID_INDEX 0xFFFFFFFF
+
+// NOTE: a zero generation is never handed out, so a zeroed handle is the null handle
+struct entity_handle
+{
+    uint32 Slot;
+    uint32 Generation;
+};
+
+enum entity_flag
+{
+    EntityFlag_Bounces = (1 << 0), // NOTE: off the edges of the move bounds, without it the entity wraps around
+    EntityFlag_Collides = (1 << 1),
+    EntityFlag_Highlighted = (1 << 2),
+};
+
+struct entity_store
+{
+    uint32 Capacity; // always a multiple of 4
+    uint32 Count;
+
+    // NOTE: dense lanes, 16 byte aligned and Capacity long so SIMD loops can run off the end of Count
+    real32 *PositionX;
+    real32 *PositionY;
+    real32 *VelocityX;
+    real32 *VelocityY;
+    uint32 *Flags;
+    uint32 *DenseToSlot;
+
+    // NOTE: sparse slots that handles point at, free slots are chained through SlotToDense,
+    // so a slot is only live when DenseToSlot[SlotToDense[slot]] leads back to it
+    uint32 *SlotToDense;
+    uint32 *SlotGeneration;
+    uint32 FreeSlotHead;
+};
+
+#define APPLICATION_ENTITY_H
+#endif
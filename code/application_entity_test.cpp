@@ -0,0 +1,126 @@
+/*
+
+  Entity test. Checks that a handle only validates while it points at
+  a live entity: never issued handles to free slots, handles carrying the
+  generation a free slot will hand out next, and handles to removed entities
+  all have to come back invalid, while handles to entities that were moved
+  around by a swap-remove stay valid. Also checks that only entities with
+  EntityFlag_Bounces bounce off the move bounds.
+
+  Built and run by linux_build.sh, exits with 1 when a check fails.
+
+  Author: Justin Morrow
+
+*/
+
+#include "application.h"
+#include "application_entity.h"
+#include "application_entity.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_ENTITY_CAPACITY 16
+
+global_variable int FailedCheckCount;
+
+internal void CheckEntity(bool32 passed, char *description)
+{
+    if(!passed)
+    {
+        ++FailedCheckCount;
+    }
+    printf("%-60s %s\n", description, passed ? "ok" : "FAILED");
+}
+
+// a handle to slot with whatever generation the slot has right now
+inline entity_handle CurrentSlotHandle(entity_store *store, uint32 slot)
+{
+    entity_handle result = {};
+    result.Slot = slot;
+    result.Generation = store->SlotGeneration[slot];
+    return result;
+}
+
+int main(int argument_count, char **arguments)
+{
+    uint64 arena_size = Kilobytes(64);
+    memory_arena arena;
+    InitializeArena(&arena, "entity test", arena_size, calloc(1, arena_size));
+
+    entity_store store;
+    InitializeEntityStore(&store, &arena, TEST_ENTITY_CAPACITY);
+
+    // NOTE: nothing handed out yet, every slot is free with the generation its first entity will get
+    bool32 fresh_slots_invalid = true;
+    for(uint32 slot = 0; slot < store.Capacity; ++slot)
+    {
+        if(IsEntityValid(&store, CurrentSlotHandle(&store, slot)))
+        {
+            fresh_slots_invalid = false;
+        }
+    }
+    CheckEntity(fresh_slots_invalid, "never issued handles to an empty store");
+
+    entity_handle handles[4];
+    for(uint32 handle_idx = 0; handle_idx < ArrayCount(handles); ++handle_idx)
+    {
+        handles[handle_idx] = AddEntity(&store, (real32)handle_idx, 0.0f, 0.0f, 0.0f, 0);
+    }
+
+    bool32 added_valid = true;
+    for(uint32 handle_idx = 0; handle_idx < ArrayCount(handles); ++handle_idx)
+    {
+        if(!IsEntityValid(&store, handles[handle_idx]))
+        {
+            added_valid = false;
+        }
+    }
+    CheckEntity(added_valid, "added entities");
+
+    // NOTE: the slot right after the live ones is the free list head, its link is a small index
+    // that used to pass for a dense index
+    bool32 free_slots_invalid = true;
+    for(uint32 slot = ArrayCount(handles); slot < store.Capacity; ++slot)
+    {
+        if(IsEntityValid(&store, CurrentSlotHandle(&store, slot)))
+        {
+            free_slots_invalid = false;
+        }
+    }
+    CheckEntity(free_slots_invalid, "never issued handles to free slots");
+
+    // NOTE: removing the first one swaps the last one into its dense index
+    entity_handle removed = handles[0];
+    CheckEntity(RemoveEntity(&store, removed), "remove");
+    CheckEntity(!IsEntityValid(&store, removed), "removed handle");
+    CheckEntity(!IsEntityValid(&store, CurrentSlotHandle(&store, removed.Slot)),
+                "handle with the removed slot's next generation");
+    CheckEntity(!RemoveEntity(&store, CurrentSlotHandle(&store, removed.Slot)),
+                "remove through the removed slot's next generation");
+    CheckEntity(store.Count == 3, "count after the refused remove");
+
+    entity_handle moved = handles[ArrayCount(handles) - 1];
+    uint32 moved_dense_idx = GetEntityDenseIndex(&store, moved);
+    CheckEntity((moved_dense_idx == 0) && (store.PositionX[moved_dense_idx] == 3.0f), "handle to the swapped in entity");
+
+    // NOTE: the freed slot is reused with its bumped generation, the old handle stays dead
+    entity_handle reused = AddEntity(&store, 10.0f, 0.0f, 0.0f, 0.0f, 0);
+    CheckEntity((reused.Slot == removed.Slot) && IsEntityValid(&store, reused), "reused slot");
+    CheckEntity(!IsEntityValid(&store, removed), "old handle to the reused slot");
+
+    entity_handle null_handle = {};
+    CheckEntity(!IsEntityValid(&store, null_handle), "null handle");
+
+    // NOTE: one of each heading off the right edge of [0, 100), only the bouncing one turns around
+    entity_store move_store;
+    InitializeEntityStore(&move_store, &arena, 4);
+    AddEntity(&move_store, 95.0f, 50.0f, 10.0f, 0.0f, EntityFlag_Bounces);
+    AddEntity(&move_store, 95.0f, 50.0f, 10.0f, 0.0f, 0);
+    MoveEntities(&move_store, 0, move_store.Count, 1.0f, 0.0f, 0.0f, 100.0f, 100.0f);
+    CheckEntity((move_store.PositionX[0] == 100.0f) && (move_store.VelocityX[0] == -10.0f), "bouncing entity");
+    CheckEntity((move_store.PositionX[1] == 5.0f) && (move_store.VelocityX[1] == 10.0f), "wrapping entity");
+
+    int result = FailedCheckCount ? 1 : 0;
+    return result;
+}
@@ -0,0 +1,358 @@
+/*
+
+  Layers, see application_layer.h.
+
+  Author: Justin Morrow
+
+*/
+
+// NOTE: value modulo size, always in [0, size)
+inline int32 WrapToSize(int32 value, int32 size)
+{
+    int32 result = value % size;
+    if(result < 0)
+    {
+        result += size;
+    }
+    return result;
+}
+
+internal void InitializeRenderLayer(render_layer *layer, memory_arena *arena, int32 width, int32 height,
+                                    bool32 is_static, bool32 is_opaque)
+{
+    layer->IsStatic = is_static;
+    layer->IsOpaque = is_opaque;
+
+    layer->Cache.Width = width;
+    layer->Cache.Height = height;
+    layer->Cache.Pitch = width*sizeof(uint32);
+    layer->Cache.Format = PixelFormat_BGRX8;
+    layer->Cache.Memory = PushArrayAligned(arena, width*height, uint32, 16);
+
+    layer->IsCacheValid = false;
+    layer->CachedVersion = 0;
+    layer->CachedX = 0;
+    layer->CachedY = 0;
+    layer->DrawnPixelCount = 0;
+    layer->FullRedrawCount = 0;
+}
+
+// NOTE: the part of the cache that world pixel (world_x, world_y) wraps to, width and height pixels
+// from there without crossing the cache's edge
+inline offscreen_graphics_buffer GetLayerCacheView(render_layer *layer, int32 world_x, int32 world_y,
+                                                   int32 width, int32 height)
+{
+    int32 cache_x = WrapToSize(world_x, layer->Cache.Width);
+    int32 cache_y = WrapToSize(world_y, layer->Cache.Height);
+    Assert((cache_x + width <= layer->Cache.Width) && (cache_y + height <= layer->Cache.Height));
+
+    offscreen_graphics_buffer result = layer->Cache;
+    result.Memory = (uint8 *)layer->Cache.Memory + cache_y*layer->Cache.Pitch + cache_x*sizeof(uint32);
+    result.Width = width;
+    result.Height = height;
+    return result;
+}
+
+// NOTE: hands func at most four views into the cache that between them cover the world
+// rectangle, split where it wraps around the cache's edges
+#define LAYER_PIECE_FUNCTION(name) void name(render_layer *layer, offscreen_graphics_buffer *piece, \
+                                             int32 world_x, int32 world_y, void *data)
+typedef LAYER_PIECE_FUNCTION(layer_piece_function);
+
+internal void ForEachLayerPiece(render_layer *layer, int32 world_x, int32 world_y, int32 width, int32 height,
+                                layer_piece_function *func, void *data)
+{
+    Assert((width <= layer->Cache.Width) && (height <= layer->Cache.Height));
+
+    int32 first_width = layer->Cache.Width - WrapToSize(world_x, layer->Cache.Width);
+    int32 first_height = layer->Cache.Height - WrapToSize(world_y, layer->Cache.Height);
+    int32 piece_widths[2] = {(width < first_width) ? width : first_width, 0};
+    int32 piece_heights[2] = {(height < first_height) ? height : first_height, 0};
+    piece_widths[1] = width - piece_widths[0];
+    piece_heights[1] = height - piece_heights[0];
+
+    int32 piece_y = world_y;
+    for(int32 row_idx = 0; row_idx < 2; ++row_idx)
+    {
+        int32 piece_x = world_x;
+        for(int32 column_idx = 0; column_idx < 2; ++column_idx)
+        {
+            if(piece_widths[column_idx] && piece_heights[row_idx])
+            {
+                offscreen_graphics_buffer piece = GetLayerCacheView(layer, piece_x, piece_y,
+                                                                    piece_widths[column_idx], piece_heights[row_idx]);
+                func(layer, &piece, piece_x, piece_y, data);
+            }
+            piece_x += piece_widths[column_idx];
+        }
+        piece_y += piece_heights[row_idx];
+    }
+}
+
+struct layer_redraw
+{
+    render_layer_draw *Draw;
+    void *Context;
+};
+
+internal LAYER_PIECE_FUNCTION(RedrawLayerPiece)
+{
+    layer_redraw *redraw = (layer_redraw *)data;
+    if(!layer->IsOpaque)
+    {
+        // NOTE: whatever the draw doesn't cover has to come out see through
+        FillRectangle<PixelFormat_BGRX8>(piece, 0, 0, piece->Width, piece->Height, 0);
+    }
+    redraw->Draw(piece, world_x, world_y, redraw->Context);
+    layer->DrawnPixelCount += (uint32)(piece->Width*piece->Height);
+}
+
+internal void RedrawLayerRegion(render_layer *layer, int32 world_x, int32 world_y, int32 width, int32 height,
+                                render_layer_draw *draw, void *context)
+{
+    if((width > 0) && (height > 0))
+    {
+        layer_redraw redraw = {draw, context};
+        ForEachLayerPiece(layer, world_x, world_y, width, height, RedrawLayerPiece, &redraw);
+    }
+}
+
+// NOTE: slides the cached rectangle just far enough to take in the view and draws the strips that
+// came into it, everything that stayed in it is still in the same place in the cache
+internal void UpdateLayerCache(render_layer *layer, int32 view_x, int32 view_y, int32 view_width, int32 view_height,
+                               uint32 version, render_layer_draw *draw, void *context)
+{
+    int32 cache_width = layer->Cache.Width;
+    int32 cache_height = layer->Cache.Height;
+    int32 old_x = layer->CachedX;
+    int32 old_y = layer->CachedY;
+
+    int32 new_x = old_x;
+    if(view_x < new_x)
+    {
+        new_x = view_x;
+    }
+    else if(view_x + view_width > new_x + cache_width)
+    {
+        new_x = view_x + view_width - cache_width;
+    }
+    int32 new_y = old_y;
+    if(view_y < new_y)
+    {
+        new_y = view_y;
+    }
+    else if(view_y + view_height > new_y + cache_height)
+    {
+        new_y = view_y + view_height - cache_height;
+    }
+
+    int32 delta_x = new_x - old_x;
+    int32 delta_y = new_y - old_y;
+    bool32 jumped = ((delta_x <= -cache_width) || (delta_x >= cache_width) ||
+                     (delta_y <= -cache_height) || (delta_y >= cache_height));
+    if(!layer->IsCacheValid || (layer->CachedVersion != version) || jumped)
+    {
+        layer->CachedX = view_x;
+        layer->CachedY = view_y;
+        RedrawLayerRegion(layer, view_x, view_y, cache_width, cache_height, draw, context);
+        layer->IsCacheValid = true;
+        layer->CachedVersion = version;
+        ++layer->FullRedrawCount;
+    }
+    else
+    {
+        // NOTE: whole columns first, then the rows across only the columns that were already there
+        int32 kept_min_x = (delta_x < 0) ? old_x : new_x;
+        int32 kept_max_x = (delta_x < 0) ? new_x + cache_width : old_x + cache_width;
+        if(delta_x < 0)
+        {
+            RedrawLayerRegion(layer, new_x, new_y, -delta_x, cache_height, draw, context);
+        }
+        else if(delta_x > 0)
+        {
+            RedrawLayerRegion(layer, old_x + cache_width, new_y, delta_x, cache_height, draw, context);
+        }
+
+        if(delta_y < 0)
+        {
+            RedrawLayerRegion(layer, kept_min_x, new_y, kept_max_x - kept_min_x, -delta_y, draw, context);
+        }
+        else if(delta_y > 0)
+        {
+            RedrawLayerRegion(layer, kept_min_x, old_y + cache_height, kept_max_x - kept_min_x, delta_y, draw, context);
+        }
+
+        layer->CachedX = new_x;
+        layer->CachedY = new_y;
+    }
+}
+
+// NOTE: premultiplied over, dest + source - dest*alpha
+template<pixel_format Format>
+internal void CompositeLayerRows(offscreen_graphics_buffer *dest, int32 dest_x, int32 dest_y,
+                                 offscreen_graphics_buffer *source, bool32 is_opaque)
+{
+    typedef pixel_traits<Format> traits;
+    for(int32 y = 0; y < source->Height; ++y)
+    {
+        uint32 *source_pixel = GetPixelRow<PixelFormat_BGRX8>(source, y);
+        typename traits::pixel *dest_pixel = GetPixelRow<Format>(dest, dest_y + y) + dest_x;
+        for(int32 x = 0; x < source->Width; ++x)
+        {
+            uint32 color = *source_pixel++;
+            uint32 alpha = color >> 24;
+            if(is_opaque || (alpha == 0xFF))
+            {
+                *dest_pixel = traits::Pack(color | 0xFF000000);
+            }
+            else if(alpha)
+            {
+                uint32 inv_alpha = 256 - (alpha + (alpha >> 7));
+                uint32 below = traits::Unpack(*dest_pixel);
+                uint32 rb = (((below & 0x00FF00FF)*inv_alpha) >> 8) & 0x00FF00FF;
+                uint32 g = (((below & 0x0000FF00)*inv_alpha) >> 8) & 0x0000FF00;
+                *dest_pixel = traits::Pack(0xFF000000 | ((color & 0x00FFFFFF) + rb + g));
+            }
+            ++dest_pixel;
+        }
+    }
+}
+
+internal void CopyLayerRowsBGRX8(offscreen_graphics_buffer *dest, int32 dest_x, int32 dest_y,
+                                 offscreen_graphics_buffer *source)
+{
+    for(int32 y = 0; y < source->Height; ++y)
+    {
+        uint32 *source_pixel = GetPixelRow<PixelFormat_BGRX8>(source, y);
+        uint32 *dest_pixel = GetPixelRow<PixelFormat_BGRX8>(dest, dest_y + y) + dest_x;
+        int32 x = 0;
+        for(; x + 16 <= source->Width; x += 16)
+        {
+            __m128i a = _mm_loadu_si128((__m128i *)(source_pixel + x));
+            __m128i b = _mm_loadu_si128((__m128i *)(source_pixel + x + 4));
+            __m128i c = _mm_loadu_si128((__m128i *)(source_pixel + x + 8));
+            __m128i d = _mm_loadu_si128((__m128i *)(source_pixel + x + 12));
+            _mm_storeu_si128((__m128i *)(dest_pixel + x), a);
+            _mm_storeu_si128((__m128i *)(dest_pixel + x + 4), b);
+            _mm_storeu_si128((__m128i *)(dest_pixel + x + 8), c);
+            _mm_storeu_si128((__m128i *)(dest_pixel + x + 12), d);
+        }
+        for(; x < source->Width; ++x)
+        {
+            dest_pixel[x] = source_pixel[x];
+        }
+    }
+}
+
+// NOTE: four at a time, and the fours that are all clear or all solid don't get blended at all,
+// which is most of them for a layer that is mostly holes or mostly covered
+internal void BlendLayerRowsBGRX8(offscreen_graphics_buffer *dest, int32 dest_x, int32 dest_y,
+                                  offscreen_graphics_buffer *source)
+{
+    __m128i alpha_mask = _mm_set1_epi32((int32)0xFF000000);
+    __m128i zero = _mm_setzero_si128();
+    __m128i two_fifty_six = _mm_set1_epi16(256);
+    for(int32 y = 0; y < source->Height; ++y)
+    {
+        uint32 *source_pixel = GetPixelRow<PixelFormat_BGRX8>(source, y);
+        uint32 *dest_pixel = GetPixelRow<PixelFormat_BGRX8>(dest, dest_y + y) + dest_x;
+        int32 x = 0;
+        for(; x + 4 <= source->Width; x += 4)
+        {
+            __m128i color = _mm_loadu_si128((__m128i *)(source_pixel + x));
+            __m128i alpha = _mm_and_si128(color, alpha_mask);
+            int32 clear_mask = _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero));
+            int32 solid_mask = _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask));
+            if(clear_mask == 0xFFFF)
+            {
+                continue;
+            }
+            if(solid_mask == 0xFFFF)
+            {
+                _mm_storeu_si128((__m128i *)(dest_pixel + x), color);
+                continue;
+            }
+
+            __m128i below = _mm_loadu_si128((__m128i *)(dest_pixel + x));
+            __m128i blended[2];
+            for(int32 half_idx = 0; half_idx < 2; ++half_idx)
+            {
+                __m128i wide_color = half_idx ? _mm_unpackhi_epi8(color, zero) : _mm_unpacklo_epi8(color, zero);
+                __m128i wide_below = half_idx ? _mm_unpackhi_epi8(below, zero) : _mm_unpacklo_epi8(below, zero);
+
+                // NOTE: alpha out to all four channels and from 0-255 to 0-256 like BlendRectangle
+                __m128i wide_alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wide_color, 0xFF), 0xFF);
+                wide_alpha = _mm_add_epi16(wide_alpha, _mm_srli_epi16(wide_alpha, 7));
+                __m128i kept = _mm_srli_epi16(_mm_mullo_epi16(wide_below, _mm_sub_epi16(two_fifty_six, wide_alpha)), 8);
+                blended[half_idx] = _mm_add_epi16(wide_color, kept);
+            }
+            __m128i result = _mm_or_si128(_mm_packus_epi16(blended[0], blended[1]), alpha_mask);
+            _mm_storeu_si128((__m128i *)(dest_pixel + x), result);
+        }
+        for(; x < source->Width; ++x)
+        {
+            uint32 color = source_pixel[x];
+            uint32 alpha = color >> 24;
+            if(alpha)
+            {
+                uint32 inv_alpha = 256 - (alpha + (alpha >> 7));
+                uint32 below = dest_pixel[x];
+                uint32 rb = (((below & 0x00FF00FF)*inv_alpha) >> 8) & 0x00FF00FF;
+                uint32 g = (((below & 0x0000FF00)*inv_alpha) >> 8) & 0x0000FF00;
+                dest_pixel[x] = 0xFF000000 | ((color & 0x00FFFFFF) + rb + g);
+            }
+        }
+    }
+}
+
+struct layer_composite
+{
+    offscreen_graphics_buffer *Dest;
+    int32 ViewX;
+    int32 ViewY;
+};
+
+internal LAYER_PIECE_FUNCTION(CompositeLayerPiece)
+{
+    layer_composite *composite = (layer_composite *)data;
+    offscreen_graphics_buffer *dest = composite->Dest;
+    int32 dest_x = world_x - composite->ViewX;
+    int32 dest_y = world_y - composite->ViewY;
+    if(dest->Format == PixelFormat_BGRX8)
+    {
+        if(layer->IsOpaque)
+        {
+            CopyLayerRowsBGRX8(dest, dest_x, dest_y, piece);
+        }
+        else
+        {
+            BlendLayerRowsBGRX8(dest, dest_x, dest_y, piece);
+        }
+    }
+    else
+    {
+        DISPATCH_PIXEL_FORMAT(dest->Format, CompositeLayerRows, dest, dest_x, dest_y, piece, layer->IsOpaque);
+    }
+}
+
+// draw the layer into buffer with world pixel (view_x, view_y) at its top left. A static layer only
+// draws what its cache doesn't have yet and copies the rest, version is what its contents were drawn
+// from and anything else makes it start over. draw isn't kept past the call
+internal void DrawRenderLayer(render_layer *layer, offscreen_graphics_buffer *buffer, int32 view_x, int32 view_y,
+                              uint32 version, render_layer_draw *draw, void *context)
+{
+    layer->DrawnPixelCount = 0;
+    if(layer->IsStatic && (buffer->Width <= layer->Cache.Width) && (buffer->Height <= layer->Cache.Height))
+    {
+        UpdateLayerCache(layer, view_x, view_y, buffer->Width, buffer->Height, version, draw, context);
+
+        layer_composite composite = {buffer, view_x, view_y};
+        ForEachLayerPiece(layer, view_x, view_y, buffer->Width, buffer->Height, CompositeLayerPiece, &composite);
+    }
+    else
+    {
+        // NOTE: straight into the buffer, a layer that isn't opaque only touches what it covers
+        draw(buffer, view_x, view_y, context);
+        layer->DrawnPixelCount = (uint32)(buffer->Width*buffer->Height);
+    }
+}
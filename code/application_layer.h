@@ -0,0 +1,43 @@
+/*
+
+  Layers. A static layer is drawn into a cache once and copied or blended
+  into the frame from there, a dynamic one is drawn straight into the frame
+  every time.
+
+  Caches are in world pixels and wrap around at their size, so when the
+  view scrolls only the strips that scrolled into view get drawn; the rest
+  of the cache is still right where it was. A layer's contents are only
+  drawn again as a whole when the version number of what it's drawn from
+  changes, or the view jumps further than the cache is big.
+
+  Caches are BGRX8. Opaque layers are copied, the others keep coverage in
+  the alpha byte, premultiplied, and are blended over what's below.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_LAYER_H)
+
+// NOTE: draw the world pixels from (world_x, world_y) on into all of target
+#define RENDER_LAYER_DRAW(name) void name(offscreen_graphics_buffer *target, int32 world_x, int32 world_y, void *context)
+typedef RENDER_LAYER_DRAW(render_layer_draw);
+
+struct render_layer
+{
+    bool32 IsStatic;
+    bool32 IsOpaque;
+
+    // NOTE: cache pixel (x, y) holds every world pixel that's (x, y) modulo the cache size
+    offscreen_graphics_buffer Cache;
+    bool32 IsCacheValid;
+    uint32 CachedVersion;
+    int32 CachedX; // NOTE: the world pixels the cache holds start here
+    int32 CachedY;
+
+    uint32 DrawnPixelCount; // NOTE: this frame, whole frames for a dynamic layer
+    uint32 FullRedrawCount;
+};
+
+#define APPLICATION_LAYER_H
+#endif
@@ -0,0 +1,79 @@
+/*
+
+  Math types that more than one system shares.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_MATH_H)
+
+union v2
+{
+    struct
+    {
+        real32 x;
+        real32 y;
+    };
+    real32 E[2];
+};
+
+inline v2 V2(real32 x, real32 y)
+{
+    v2 result;
+    result.x = x;
+    result.y = y;
+    return result;
+}
+
+inline v2 operator+(v2 a, v2 b)
+{
+    return V2(a.x + b.x, a.y + b.y);
+}
+
+inline v2 operator-(v2 a, v2 b)
+{
+    return V2(a.x - b.x, a.y - b.y);
+}
+
+inline v2 operator-(v2 a)
+{
+    return V2(-a.x, -a.y);
+}
+
+inline v2 operator*(real32 a, v2 b)
+{
+    return V2(a*b.x, a*b.y);
+}
+
+inline v2 operator*(v2 a, real32 b)
+{
+    return V2(a.x*b, a.y*b);
+}
+
+inline v2 &operator+=(v2 &a, v2 b)
+{
+    a = a + b;
+    return a;
+}
+
+inline real32 Inner(v2 a, v2 b)
+{
+    real32 result = a.x*b.x + a.y*b.y;
+    return result;
+}
+
+inline real32 LengthSq(v2 a)
+{
+    real32 result = Inner(a, a);
+    return result;
+}
+
+// a turned a quarter counter clockwise
+inline v2 Perp(v2 a)
+{
+    return V2(-a.y, a.x);
+}
+
+#define APPLICATION_MATH_H
+#endif
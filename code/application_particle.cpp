@@ -0,0 +1,435 @@
+/*
+
+  Particles, see application_particle.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <emmintrin.h>
+
+internal void InitializeParticleSystem(particle_system *system, memory_arena *arena, uint32 capacity, uint32 seed)
+{
+    capacity = (capacity + 3) & ~3;
+
+    system->Capacity = capacity;
+    system->Count = 0;
+
+    system->PositionX = PushArrayAligned(arena, capacity + 4, real32, 16);
+    system->PositionY = PushArrayAligned(arena, capacity + 4, real32, 16);
+    system->VelocityX = PushArrayAligned(arena, capacity + 4, real32, 16);
+    system->VelocityY = PushArrayAligned(arena, capacity + 4, real32, 16);
+    system->Age = PushArrayAligned(arena, capacity + 4, real32, 16);
+    system->AgeRate = PushArrayAligned(arena, capacity + 4, real32, 16);
+    system->Color = PushArrayAligned(arena, capacity + 4, uint32, 16);
+
+    // NOTE: xorshift never leaves 0, so every lane gets a different odd seed
+    for(uint32 lane_idx = 0; lane_idx < 4; ++lane_idx)
+    {
+        seed = seed*1664525 + 1013904223;
+        system->RandomState[lane_idx] = seed | 1;
+    }
+
+    system->DiedCount = 0;
+    system->DroppedSpawnCount = 0;
+}
+
+// NOTE: a uniform random in [0, 1) in each lane
+inline __m128 NextParticleRandom4(__m128i *state)
+{
+    __m128i x = *state;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    *state = x;
+
+    // NOTE: the top 23 bits as the mantissa of a float in [1, 2)
+    __m128 one_to_two = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3F800000)));
+    __m128 result = _mm_sub_ps(one_to_two, _mm_set1_ps(1.0f));
+    return result;
+}
+
+// spawn however many particles the emitter's rate comes to over dt, the ones that don't fit are dropped
+internal void SpawnParticles(particle_system *system, particle_emitter *emitter, real32 dt)
+{
+    real32 wanted = emitter->Rate*dt + emitter->SpawnRemainder;
+    uint32 spawn_count = (uint32)wanted;
+    emitter->SpawnRemainder = wanted - (real32)spawn_count;
+
+    uint32 room = system->Capacity - system->Count;
+    if(spawn_count > room)
+    {
+        system->DroppedSpawnCount += spawn_count - room;
+        spawn_count = room;
+    }
+
+    __m128i random_state = _mm_loadu_si128((__m128i *)system->RandomState);
+    __m128 x = _mm_set1_ps(emitter->X);
+    __m128 y = _mm_set1_ps(emitter->Y);
+    __m128 velocity_x = _mm_set1_ps(emitter->VelocityX - emitter->Spread);
+    __m128 velocity_y = _mm_set1_ps(emitter->VelocityY - emitter->Spread);
+    __m128 spread = _mm_set1_ps(2.0f*emitter->Spread);
+    __m128 lifetime = _mm_set1_ps(emitter->Lifetime - emitter->LifetimeSpread);
+    __m128 lifetime_spread = _mm_set1_ps(2.0f*emitter->LifetimeSpread);
+    __m128 min_lifetime = _mm_set1_ps(0.001f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128i color = _mm_set1_epi32((int32)emitter->Color);
+
+    // NOTE: whole groups of 4 from Count on, up to 3 lanes past the last new particle are dead storage
+    for(uint32 spawned_idx = 0; spawned_idx < spawn_count; spawned_idx += 4)
+    {
+        uint32 idx = system->Count + spawned_idx;
+        __m128 dx = _mm_add_ps(velocity_x, _mm_mul_ps(spread, NextParticleRandom4(&random_state)));
+        __m128 dy = _mm_add_ps(velocity_y, _mm_mul_ps(spread, NextParticleRandom4(&random_state)));
+        __m128 life = _mm_add_ps(lifetime, _mm_mul_ps(lifetime_spread, NextParticleRandom4(&random_state)));
+        __m128 age_rate = _mm_div_ps(one, _mm_max_ps(life, min_lifetime));
+
+        _mm_storeu_ps(system->PositionX + idx, x);
+        _mm_storeu_ps(system->PositionY + idx, y);
+        _mm_storeu_ps(system->VelocityX + idx, dx);
+        _mm_storeu_ps(system->VelocityY + idx, dy);
+        _mm_storeu_ps(system->Age + idx, _mm_setzero_ps());
+        _mm_storeu_ps(system->AgeRate + idx, age_rate);
+        _mm_storeu_si128((__m128i *)(system->Color + idx), color);
+    }
+    _mm_storeu_si128((__m128i *)system->RandomState, random_state);
+
+    system->Count += spawn_count;
+}
+
+struct particle_staged_entry
+{
+    particle_draw_entry Entry;
+    uint32 Bin;
+};
+
+struct particle_update_job
+{
+    particle_system *System;
+    uint32 FirstIdx;
+    uint32 OnePastLastIdx;
+    real32 dt;
+    real32 GravityX;
+    real32 GravityY;
+    particle_draw_list *DrawList;
+
+    // NOTE: each job writes these from FirstIdx on in arrays shared by every job
+    uint32 *DeadIndices;
+    uint32 DeadCount;
+    particle_staged_entry *Staged; // NOTE: twice as many as the job has particles, for the ones in two bands
+    uint32 StagedCount;
+
+    uint32 *BinCursor; // NOTE: how many of this job's entries are in each bin, then where the next one goes
+};
+
+// NOTE: moves and ages [FirstIdx, OnePastLastIdx) 4 at a time, then lists the dead ones and stages
+// the ones on screen with their bins
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoUpdateParticlesJob)
+{
+    particle_update_job *job = (particle_update_job *)data;
+    particle_system *system = job->System;
+    particle_draw_list *draw_list = job->DrawList;
+    Assert((job->FirstIdx & 3) == 0);
+
+    __m128 dt_4x = _mm_set1_ps(job->dt);
+    __m128 gravity_x_4x = _mm_set1_ps(job->GravityX*job->dt);
+    __m128 gravity_y_4x = _mm_set1_ps(job->GravityY*job->dt);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 min_visible = _mm_set1_ps(-(real32)PARTICLE_SIZE);
+    __m128 max_visible_x = _mm_set1_ps((real32)draw_list->Width);
+    __m128 max_visible_y = _mm_set1_ps((real32)draw_list->Height);
+    __m128 bin_count_4x = _mm_set1_ps((real32)PARTICLE_AGE_BIN_COUNT);
+    __m128i last_bin_4x = _mm_set1_epi32(PARTICLE_AGE_BIN_COUNT - 1);
+    __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+
+    job->DeadCount = 0;
+    job->StagedCount = 0;
+    for(uint32 idx = job->FirstIdx; idx < job->OnePastLastIdx; idx += 4)
+    {
+        __m128 x = _mm_load_ps(system->PositionX + idx);
+        __m128 y = _mm_load_ps(system->PositionY + idx);
+        __m128 dx = _mm_load_ps(system->VelocityX + idx);
+        __m128 dy = _mm_load_ps(system->VelocityY + idx);
+        __m128 age = _mm_load_ps(system->Age + idx);
+        __m128 age_rate = _mm_load_ps(system->AgeRate + idx);
+
+        dx = _mm_add_ps(dx, gravity_x_4x);
+        dy = _mm_add_ps(dy, gravity_y_4x);
+        x = _mm_add_ps(x, _mm_mul_ps(dx, dt_4x));
+        y = _mm_add_ps(y, _mm_mul_ps(dy, dt_4x));
+        age = _mm_add_ps(age, _mm_mul_ps(age_rate, dt_4x));
+
+        _mm_store_ps(system->PositionX + idx, x);
+        _mm_store_ps(system->PositionY + idx, y);
+        _mm_store_ps(system->VelocityX + idx, dx);
+        _mm_store_ps(system->VelocityY + idx, dy);
+        _mm_store_ps(system->Age + idx, age);
+
+        __m128 alive = _mm_cmplt_ps(age, one);
+        __m128 visible = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(x, min_visible), _mm_cmplt_ps(x, max_visible_x)),
+                                    _mm_and_ps(_mm_cmpgt_ps(y, min_visible), _mm_cmplt_ps(y, max_visible_y)));
+        int32 dead_mask = ~_mm_movemask_ps(alive) & 0xF;
+        int32 visible_mask = _mm_movemask_ps(_mm_and_ps(alive, visible));
+
+        // NOTE: drop the dead lanes past the last particle
+        uint32 live_lane_count = job->OnePastLastIdx - idx;
+        if(live_lane_count < 4)
+        {
+            dead_mask &= (1 << live_lane_count) - 1;
+            visible_mask &= (1 << live_lane_count) - 1;
+        }
+
+        while(dead_mask)
+        {
+            uint32 lane = 0;
+            while(!(dead_mask & (1 << lane)))
+            {
+                ++lane;
+            }
+            dead_mask &= ~(1 << lane);
+            job->DeadIndices[job->DeadCount++] = idx + lane;
+        }
+
+        if(visible_mask)
+        {
+            // NOTE: floor, truncating rounds the negative ones up so those take one off
+            __m128i pixel_x = _mm_cvttps_epi32(x);
+            __m128i pixel_y = _mm_cvttps_epi32(y);
+            pixel_x = _mm_add_epi32(pixel_x, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(pixel_x), x)));
+            pixel_y = _mm_add_epi32(pixel_y, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(pixel_y), y)));
+
+            // NOTE: oldest in the first bin so it's drawn first
+            __m128i age_bin = _mm_sub_epi32(last_bin_4x, _mm_cvttps_epi32(_mm_mul_ps(age, bin_count_4x)));
+
+            __m128i color = _mm_load_si128((__m128i *)(system->Color + idx));
+            __m128 alpha = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(color, 24)), _mm_sub_ps(one, age));
+            color = _mm_or_si128(_mm_and_si128(color, rgb_mask), _mm_slli_epi32(_mm_cvttps_epi32(alpha), 24));
+
+            int32 lane_x[4];
+            int32 lane_y[4];
+            int32 lane_age_bin[4];
+            uint32 lane_color[4];
+            _mm_storeu_si128((__m128i *)lane_x, pixel_x);
+            _mm_storeu_si128((__m128i *)lane_y, pixel_y);
+            _mm_storeu_si128((__m128i *)lane_age_bin, age_bin);
+            _mm_storeu_si128((__m128i *)lane_color, color);
+
+            while(visible_mask)
+            {
+                uint32 lane = 0;
+                while(!(visible_mask & (1 << lane)))
+                {
+                    ++lane;
+                }
+                visible_mask &= ~(1 << lane);
+
+                int32 min_y = (lane_y[lane] > 0) ? lane_y[lane] : 0;
+                int32 max_y = lane_y[lane] + PARTICLE_SIZE - 1;
+                if(max_y >= draw_list->Height)
+                {
+                    max_y = draw_list->Height - 1;
+                }
+                for(int32 band = (min_y >> PARTICLE_BAND_SHIFT); band <= (max_y >> PARTICLE_BAND_SHIFT); ++band)
+                {
+                    particle_staged_entry *staged = job->Staged + job->StagedCount++;
+                    staged->Entry.X = (int16)lane_x[lane];
+                    staged->Entry.Y = (int16)lane_y[lane];
+                    staged->Entry.Color = lane_color[lane];
+                    staged->Bin = band*PARTICLE_AGE_BIN_COUNT + lane_age_bin[lane];
+                    ++job->BinCursor[staged->Bin];
+                }
+            }
+        }
+    }
+}
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoScatterParticlesJob)
+{
+    particle_update_job *job = (particle_update_job *)data;
+    particle_draw_entry *entries = job->DrawList->Entries;
+    for(uint32 staged_idx = 0; staged_idx < job->StagedCount; ++staged_idx)
+    {
+        particle_staged_entry *staged = job->Staged + staged_idx;
+        entries[job->BinCursor[staged->Bin]++] = staged->Entry;
+    }
+}
+
+inline void MoveParticle(particle_system *system, uint32 dest_idx, uint32 source_idx)
+{
+    system->PositionX[dest_idx] = system->PositionX[source_idx];
+    system->PositionY[dest_idx] = system->PositionY[source_idx];
+    system->VelocityX[dest_idx] = system->VelocityX[source_idx];
+    system->VelocityY[dest_idx] = system->VelocityY[source_idx];
+    system->Age[dest_idx] = system->Age[source_idx];
+    system->AgeRate[dest_idx] = system->AgeRate[source_idx];
+    system->Color[dest_idx] = system->Color[source_idx];
+}
+
+// NOTE: dead_indices has to be ascending. The dead at the end are just dropped and every other hole
+// gets the last live particle, so the cost goes with how many died and not how many there are
+internal void RemoveDeadParticles(particle_system *system, uint32 *dead_indices, uint32 dead_count)
+{
+    uint32 count = system->Count;
+    uint32 first_dead = 0;
+    uint32 one_past_last_dead = dead_count;
+    while(first_dead < one_past_last_dead)
+    {
+        uint32 last_idx = --count;
+        if(dead_indices[one_past_last_dead - 1] == last_idx)
+        {
+            --one_past_last_dead;
+        }
+        else
+        {
+            MoveParticle(system, dead_indices[first_dead++], last_idx);
+        }
+    }
+    system->Count = count;
+}
+
+// NOTE: a multiple of 4 so no two jobs touch the same SIMD lanes
+#define UPDATE_PARTICLES_JOB_SIZE (16*1024)
+
+// move and age every particle by dt, remove the ones that died and sort the ones on a width by
+// height screen into draw_list, which lives in the frame arena
+internal void UpdateParticlesInParallel(platform_work_queue *queue, memory_arena *frame_arena, particle_system *system,
+                                        real32 dt, real32 gravity_x, real32 gravity_y, int32 width, int32 height,
+                                        particle_draw_list *draw_list)
+{
+    draw_list->Width = width;
+    draw_list->Height = height;
+    draw_list->BandCount = (height + PARTICLE_BAND_HEIGHT - 1) >> PARTICLE_BAND_SHIFT;
+    draw_list->BandStart = PushArray(frame_arena, draw_list->BandCount + 1, uint32);
+
+    uint32 bin_count = (uint32)draw_list->BandCount*PARTICLE_AGE_BIN_COUNT;
+    uint32 job_count = (system->Count + UPDATE_PARTICLES_JOB_SIZE - 1) / UPDATE_PARTICLES_JOB_SIZE;
+    particle_update_job *jobs = PushArrayAligned(frame_arena, job_count, particle_update_job, 8);
+    uint32 *dead_indices = PushArray(frame_arena, system->Count, uint32);
+    particle_staged_entry *staged = PushArray(frame_arena, 2*system->Count, particle_staged_entry);
+    uint32 *bin_cursors = PushArray(frame_arena, job_count*bin_count, uint32);
+    for(uint32 cursor_idx = 0; cursor_idx < job_count*bin_count; ++cursor_idx)
+    {
+        bin_cursors[cursor_idx] = 0;
+    }
+
+    platform_job_counter counter = {};
+    for(uint32 job_idx = 0; job_idx < job_count; ++job_idx)
+    {
+        particle_update_job *job = jobs + job_idx;
+        job->System = system;
+        job->FirstIdx = job_idx*UPDATE_PARTICLES_JOB_SIZE;
+        job->OnePastLastIdx = job->FirstIdx + UPDATE_PARTICLES_JOB_SIZE;
+        if(job->OnePastLastIdx > system->Count)
+        {
+            job->OnePastLastIdx = system->Count;
+        }
+        job->dt = dt;
+        job->GravityX = gravity_x;
+        job->GravityY = gravity_y;
+        job->DrawList = draw_list;
+        job->DeadIndices = dead_indices + job->FirstIdx;
+        job->Staged = staged + 2*job->FirstIdx;
+        job->BinCursor = bin_cursors + job_idx*bin_count;
+        Platform.AddEntry(queue, DoUpdateParticlesJob, job, &counter);
+    }
+    Platform.WaitForCounter(queue, &counter);
+
+    // NOTE: counting sort, bin by bin and inside a bin job by job so the order inside a bin doesn't
+    // depend on which job finished first
+    uint32 total = 0;
+    for(uint32 bin = 0; bin < bin_count; ++bin)
+    {
+        if((bin % PARTICLE_AGE_BIN_COUNT) == 0)
+        {
+            draw_list->BandStart[bin / PARTICLE_AGE_BIN_COUNT] = total;
+        }
+        for(uint32 job_idx = 0; job_idx < job_count; ++job_idx)
+        {
+            uint32 count = jobs[job_idx].BinCursor[bin];
+            jobs[job_idx].BinCursor[bin] = total;
+            total += count;
+        }
+    }
+    draw_list->BandStart[draw_list->BandCount] = total;
+    draw_list->Count = total;
+    draw_list->Entries = PushArray(frame_arena, total, particle_draw_entry);
+
+    platform_job_counter scatter_counter = {};
+    for(uint32 job_idx = 0; job_idx < job_count; ++job_idx)
+    {
+        Platform.AddEntry(queue, DoScatterParticlesJob, jobs + job_idx, &scatter_counter);
+    }
+
+    // NOTE: the scatter only reads what was staged, so the lanes can be compacted while it runs.
+    // Every job's dead list is ascending and starts at its FirstIdx, so sliding them down
+    // end to end leaves one ascending list
+    uint32 dead_count = 0;
+    for(uint32 job_idx = 0; job_idx < job_count; ++job_idx)
+    {
+        particle_update_job *job = jobs + job_idx;
+        for(uint32 dead_idx = 0; dead_idx < job->DeadCount; ++dead_idx)
+        {
+            dead_indices[dead_count++] = job->DeadIndices[dead_idx];
+        }
+    }
+    RemoveDeadParticles(system, dead_indices, dead_count);
+    system->DiedCount = dead_count;
+
+    Platform.WaitForCounter(queue, &scatter_counter);
+}
+
+template<pixel_format Format>
+internal void DrawParticleBand(offscreen_graphics_buffer *buffer, particle_draw_list *draw_list, int32 band)
+{
+    int32 band_min_y = band << PARTICLE_BAND_SHIFT;
+    int32 band_max_y = band_min_y + PARTICLE_BAND_HEIGHT;
+    if(band_max_y > buffer->Height)
+    {
+        band_max_y = buffer->Height;
+    }
+
+    for(uint32 entry_idx = draw_list->BandStart[band]; entry_idx < draw_list->BandStart[band + 1]; ++entry_idx)
+    {
+        particle_draw_entry *entry = draw_list->Entries + entry_idx;
+        int32 min_x = entry->X;
+        int32 min_y = (entry->Y > band_min_y) ? entry->Y : band_min_y;
+        int32 max_x = entry->X + PARTICLE_SIZE;
+        int32 max_y = (entry->Y + PARTICLE_SIZE < band_max_y) ? entry->Y + PARTICLE_SIZE : band_max_y;
+        if(ClipRectangleToBuffer(buffer, &min_x, &min_y, &max_x, &max_y))
+        {
+            BlendRectangle<Format>(buffer, min_x, min_y, max_x, max_y, entry->Color);
+        }
+    }
+}
+
+struct particle_band_job
+{
+    offscreen_graphics_buffer *Buffer;
+    particle_draw_list *DrawList;
+    int32 Band;
+};
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoDrawParticleBandJob)
+{
+    particle_band_job *job = (particle_band_job *)data;
+    DISPATCH_PIXEL_FORMAT(job->Buffer->Format, DrawParticleBand, job->Buffer, job->DrawList, job->Band);
+}
+
+// blend the draw list over buffer, one job per band
+internal void DrawParticlesInParallel(platform_work_queue *queue, memory_arena *frame_arena,
+                                      offscreen_graphics_buffer *buffer, particle_draw_list *draw_list)
+{
+    Assert((buffer->Width == draw_list->Width) && (buffer->Height == draw_list->Height));
+
+    platform_job_counter counter = {};
+    particle_band_job *jobs = PushArrayAligned(frame_arena, draw_list->BandCount, particle_band_job, 8);
+    for(int32 band = 0; band < draw_list->BandCount; ++band)
+    {
+        particle_band_job *job = jobs + band;
+        job->Buffer = buffer;
+        job->DrawList = draw_list;
+        job->Band = band;
+        Platform.AddEntry(queue, DoDrawParticleBandJob, job, &counter);
+    }
+    Platform.WaitForCounter(queue, &counter);
+}
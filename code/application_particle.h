@@ -0,0 +1,85 @@
+/*
+
+  Particles. Every particle lives in fixed structure-of-arrays lanes that
+  are allocated once, spawning, moving and aging run 4 lanes at a time,
+  and a particle that dies has the last live one moved into its place so
+  the live particles are always [0, Count) with no holes. Nothing is
+  allocated per particle.
+
+  Updating is split into jobs over the lanes. Each job also picks out the
+  particles that are on screen and counts them into bins, a bin being a
+  band of rows and how old the particle is. The counts from every job
+  become one counting sort, so each frame ends up with a draw list in the
+  frame arena sorted by band and, inside a band, oldest first so the
+  fresh bright ones land on top. A band is then drawn by one job without
+  touching anything another job draws.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_PARTICLE_H)
+
+#define PARTICLE_SIZE 3 // NOTE: drawn as a square this many pixels wide
+
+#define PARTICLE_BAND_SHIFT 5
+#define PARTICLE_BAND_HEIGHT (1 << PARTICLE_BAND_SHIFT)
+#define PARTICLE_AGE_BIN_COUNT 16
+
+struct particle_system
+{
+    uint32 Capacity; // always a multiple of 4
+    uint32 Count;
+
+    // NOTE: dense lanes, 16 byte aligned and padded by 4 so SIMD loops can run off the end of Count
+    real32 *PositionX;
+    real32 *PositionY;
+    real32 *VelocityX;
+    real32 *VelocityY;
+    real32 *Age; // NOTE: 0 when spawned, dead at 1
+    real32 *AgeRate; // NOTE: 1 / lifetime
+    uint32 *Color; // NOTE: 0xAARRGGBB when spawned, the alpha fades out with age
+
+    uint32 RandomState[4]; // NOTE: one xorshift per lane
+
+    uint32 DiedCount; // NOTE: in the last update
+    uint32 DroppedSpawnCount; // NOTE: every spawn that didn't fit, since the start
+};
+
+struct particle_emitter
+{
+    real32 X;
+    real32 Y;
+    real32 VelocityX;
+    real32 VelocityY;
+    real32 Spread; // NOTE: up to this much is added to or taken off either velocity
+    real32 Lifetime;
+    real32 LifetimeSpread;
+    uint32 Color;
+
+    real32 Rate; // NOTE: per second
+    real32 SpawnRemainder; // NOTE: the part of a particle left over from the last spawn
+};
+
+// NOTE: Color is straight alpha, already faded
+struct particle_draw_entry
+{
+    int16 X;
+    int16 Y;
+    uint32 Color;
+};
+
+struct particle_draw_list
+{
+    int32 Width;
+    int32 Height;
+    int32 BandCount;
+    uint32 *BandStart; // NOTE: BandCount + 1 entries, band b draws [BandStart[b], BandStart[b + 1])
+
+    // NOTE: a particle that straddles two bands is in both
+    uint32 Count;
+    particle_draw_entry *Entries;
+};
+
+#define APPLICATION_PARTICLE_H
+#endif
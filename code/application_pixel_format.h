@@ -0,0 +1,305 @@
+/*
+
+  Pixel formats. Every routine that touches pixels is a template on the
+  buffer's format, and each format is a specialization of pixel_traits that
+  knows how to pack a color, get one back out and blend two together. The
+  compiler turns every instantiation into a straight loop over that
+  format's pixel type, the format is looked at once per draw call and never
+  per pixel.
+
+  - BGRX8, 0xXXRRGGBB in a register, what the platforms display
+  - RGBA8, R G B A in memory, 0xAABBGGRR in a register
+  - RGB565, 16 bits, half the memory traffic of the 8 bit formats for
+    targets that are short on it
+  - Float32Linear, four floats in linear light for offline rendering.
+    Colors come in gamma encoded, the gamma is taken as 2 so decoding is a
+    square and encoding a square root
+
+  Colors are always 0xAARRGGBB everywhere else. Header only so the
+  platforms can convert whatever the app rendered into.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_PIXEL_FORMAT_H)
+
+struct pixel_float32
+{
+    real32 R;
+    real32 G;
+    real32 B;
+    real32 A;
+};
+
+template<pixel_format Format> struct pixel_traits;
+
+// NOTE: blends two 8 bit channels at once, alpha is 0 to 256
+inline uint32 LerpPackedChannels8(uint32 dest, uint32 source, uint32 alpha)
+{
+    uint32 dest_rb = dest & 0x00FF00FF;
+    uint32 dest_ga = (dest >> 8) & 0x00FF00FF;
+    uint32 source_rb = source & 0x00FF00FF;
+    uint32 source_ga = (source >> 8) & 0x00FF00FF;
+
+    uint32 rb = ((dest_rb*(256 - alpha) + source_rb*alpha) >> 8) & 0x00FF00FF;
+    uint32 ga = ((dest_ga*(256 - alpha) + source_ga*alpha) >> 8) & 0x00FF00FF;
+    uint32 result = rb | (ga << 8);
+    return result;
+}
+
+template<> struct pixel_traits<PixelFormat_BGRX8>
+{
+    typedef uint32 pixel;
+
+    static inline pixel Pack(uint32 color)
+    {
+        return color;
+    }
+
+    static inline uint32 Unpack(pixel value)
+    {
+        return value | 0xFF000000;
+    }
+
+    static inline pixel Lerp(pixel dest, pixel source, uint32 alpha)
+    {
+        return LerpPackedChannels8(dest, source, alpha);
+    }
+};
+
+template<> struct pixel_traits<PixelFormat_RGBA8>
+{
+    typedef uint32 pixel;
+
+    static inline pixel Pack(uint32 color)
+    {
+        // NOTE: swap red and blue, alpha and green stay put
+        return (color & 0xFF00FF00) | ((color >> 16) & 0xFF) | ((color & 0xFF) << 16);
+    }
+
+    static inline uint32 Unpack(pixel value)
+    {
+        return (value & 0xFF00FF00) | ((value >> 16) & 0xFF) | ((value & 0xFF) << 16);
+    }
+
+    static inline pixel Lerp(pixel dest, pixel source, uint32 alpha)
+    {
+        return LerpPackedChannels8(dest, source, alpha);
+    }
+};
+
+template<> struct pixel_traits<PixelFormat_RGB565>
+{
+    typedef uint16 pixel;
+
+    static inline pixel Pack(uint32 color)
+    {
+        uint32 result = (((color >> 19) & 0x1F) << 11) | (((color >> 10) & 0x3F) << 5) | ((color >> 3) & 0x1F);
+        return (pixel)result;
+    }
+
+    static inline uint32 Unpack(pixel value)
+    {
+        // NOTE: repeat the top bits into the bottom so white stays white
+        uint32 r = (value >> 11) & 0x1F;
+        uint32 g = (value >> 5) & 0x3F;
+        uint32 b = value & 0x1F;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        return 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+
+    static inline pixel Lerp(pixel dest, pixel source, uint32 alpha)
+    {
+        // NOTE: spread green into the top half so all three channels get
+        // multiplied at once with room to spare, alpha drops to 5 bits
+        uint32 alpha5 = alpha >> 3;
+        uint32 dest_wide = (dest | ((uint32)dest << 16)) & 0x07E0F81F;
+        uint32 source_wide = (source | ((uint32)source << 16)) & 0x07E0F81F;
+        uint32 wide = ((dest_wide*(32 - alpha5) + source_wide*alpha5) >> 5) & 0x07E0F81F;
+        return (pixel)(wide | (wide >> 16));
+    }
+};
+
+template<> struct pixel_traits<PixelFormat_Float32Linear>
+{
+    typedef pixel_float32 pixel;
+
+    static inline pixel Pack(uint32 color)
+    {
+        real32 inv_255 = 1.0f / 255.0f;
+        real32 r = (real32)((color >> 16) & 0xFF)*inv_255;
+        real32 g = (real32)((color >> 8) & 0xFF)*inv_255;
+        real32 b = (real32)(color & 0xFF)*inv_255;
+        pixel result = {r*r, g*g, b*b, (real32)(color >> 24)*inv_255};
+        return result;
+    }
+
+    static inline uint32 Unpack(pixel value)
+    {
+        uint32 r = (uint32)(255.0f*sqrtf(value.R < 1.0f ? value.R : 1.0f) + 0.5f);
+        uint32 g = (uint32)(255.0f*sqrtf(value.G < 1.0f ? value.G : 1.0f) + 0.5f);
+        uint32 b = (uint32)(255.0f*sqrtf(value.B < 1.0f ? value.B : 1.0f) + 0.5f);
+        uint32 a = (uint32)(255.0f*(value.A < 1.0f ? value.A : 1.0f) + 0.5f);
+        return (a << 24) | (r << 16) | (g << 8) | b;
+    }
+
+    static inline pixel Lerp(pixel dest, pixel source, uint32 alpha)
+    {
+        real32 t = (real32)alpha*(1.0f / 256.0f);
+        pixel result =
+        {
+            dest.R + t*(source.R - dest.R),
+            dest.G + t*(source.G - dest.G),
+            dest.B + t*(source.B - dest.B),
+            dest.A + t*(source.A - dest.A),
+        };
+        return result;
+    }
+};
+
+template<pixel_format Format>
+inline typename pixel_traits<Format>::pixel *GetPixelRow(offscreen_graphics_buffer *buffer, int y)
+{
+    typedef typename pixel_traits<Format>::pixel pixel;
+    pixel *result = (pixel *)((uint8 *)buffer->Memory + y*buffer->Pitch);
+    return result;
+}
+
+// NOTE: calls function<buffer's format>(args) once, everything below it is the specialized loop
+#define DISPATCH_PIXEL_FORMAT(format, function, ...)                                     \
+    switch(format)                                                                      \
+    {                                                                                   \
+        case PixelFormat_BGRX8: function<PixelFormat_BGRX8>(__VA_ARGS__); break;        \
+        case PixelFormat_RGBA8: function<PixelFormat_RGBA8>(__VA_ARGS__); break;        \
+        case PixelFormat_RGB565: function<PixelFormat_RGB565>(__VA_ARGS__); break;      \
+        case PixelFormat_Float32Linear: function<PixelFormat_Float32Linear>(__VA_ARGS__); break; \
+        default: Assert(!"unknown pixel format"); break;                                \
+    }
+
+// clip [min, max) to the buffer, false when nothing is left
+inline bool32 ClipRectangleToBuffer(offscreen_graphics_buffer *buffer, int *min_x, int *min_y, int *max_x, int *max_y)
+{
+    if(*min_x < 0) *min_x = 0;
+    if(*min_y < 0) *min_y = 0;
+    if(*max_x > buffer->Width) *max_x = buffer->Width;
+    if(*max_y > buffer->Height) *max_y = buffer->Height;
+
+    bool32 result = ((*min_x < *max_x) && (*min_y < *max_y));
+    return result;
+}
+
+template<pixel_format Format>
+internal void FillRectangle(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y, uint32 color)
+{
+    typedef pixel_traits<Format> traits;
+    typename traits::pixel value = traits::Pack(color);
+    for(int y = min_y; y < max_y; ++y)
+    {
+        typename traits::pixel *pixel = GetPixelRow<Format>(buffer, y) + min_x;
+        for(int x = min_x; x < max_x; ++x)
+        {
+            *pixel++ = value;
+        }
+    }
+}
+
+// NOTE: the color's alpha blends it over what is there, the buffer's own alpha is blended like any other channel
+template<pixel_format Format>
+internal void BlendRectangle(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y, uint32 color)
+{
+    typedef pixel_traits<Format> traits;
+    typename traits::pixel value = traits::Pack(color | 0xFF000000);
+    uint32 alpha = (color >> 24);
+    alpha += (alpha >> 7); // NOTE: 0-255 to 0-256 so 0xFF is fully opaque
+    for(int y = min_y; y < max_y; ++y)
+    {
+        typename traits::pixel *pixel = GetPixelRow<Format>(buffer, y) + min_x;
+        for(int x = min_x; x < max_x; ++x)
+        {
+            *pixel = traits::Lerp(*pixel, value, alpha);
+            ++pixel;
+        }
+    }
+}
+
+// NOTE: between formats through 0xAARRGGBB, a format into itself as it is
+template<pixel_format DestFormat, pixel_format SourceFormat>
+struct pixel_convert
+{
+    static inline typename pixel_traits<DestFormat>::pixel Convert(typename pixel_traits<SourceFormat>::pixel value)
+    {
+        return pixel_traits<DestFormat>::Pack(pixel_traits<SourceFormat>::Unpack(value));
+    }
+};
+
+template<pixel_format Format>
+struct pixel_convert<Format, Format>
+{
+    static inline typename pixel_traits<Format>::pixel Convert(typename pixel_traits<Format>::pixel value)
+    {
+        return value;
+    }
+};
+
+template<pixel_format DestFormat, pixel_format SourceFormat>
+internal void BlitRows(offscreen_graphics_buffer *dest, offscreen_graphics_buffer *source, int width, int height)
+{
+    typedef pixel_traits<DestFormat> dest_traits;
+    typedef pixel_traits<SourceFormat> source_traits;
+    for(int y = 0; y < height; ++y)
+    {
+        typename dest_traits::pixel *dest_pixel = GetPixelRow<DestFormat>(dest, y);
+        typename source_traits::pixel *source_pixel = GetPixelRow<SourceFormat>(source, y);
+        for(int x = 0; x < width; ++x)
+        {
+            *dest_pixel++ = pixel_convert<DestFormat, SourceFormat>::Convert(*source_pixel++);
+        }
+    }
+}
+
+// NOTE: the source format is picked here so the outer dispatch only has to pick the destination
+template<pixel_format DestFormat>
+internal void BlitFromAnyFormat(offscreen_graphics_buffer *dest, offscreen_graphics_buffer *source, int width, int height)
+{
+    switch(source->Format)
+    {
+        case PixelFormat_BGRX8: BlitRows<DestFormat, PixelFormat_BGRX8>(dest, source, width, height); break;
+        case PixelFormat_RGBA8: BlitRows<DestFormat, PixelFormat_RGBA8>(dest, source, width, height); break;
+        case PixelFormat_RGB565: BlitRows<DestFormat, PixelFormat_RGB565>(dest, source, width, height); break;
+        case PixelFormat_Float32Linear: BlitRows<DestFormat, PixelFormat_Float32Linear>(dest, source, width, height); break;
+        default: Assert(!"unknown pixel format"); break;
+    }
+}
+
+// fill the pixels in [min, max), clipped to the buffer
+inline void DrawRectangle(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y, uint32 color)
+{
+    if(ClipRectangleToBuffer(buffer, &min_x, &min_y, &max_x, &max_y))
+    {
+        DISPATCH_PIXEL_FORMAT(buffer->Format, FillRectangle, buffer, min_x, min_y, max_x, max_y, color);
+    }
+}
+
+// blend color over the pixels in [min, max) by its alpha, clipped to the buffer
+inline void DrawRectangleBlended(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y,
+                                 uint32 color)
+{
+    if(ClipRectangleToBuffer(buffer, &min_x, &min_y, &max_x, &max_y))
+    {
+        DISPATCH_PIXEL_FORMAT(buffer->Format, BlendRectangle, buffer, min_x, min_y, max_x, max_y, color);
+    }
+}
+
+// copy source into the top left of dest, converting between their formats
+inline void BlitBuffer(offscreen_graphics_buffer *dest, offscreen_graphics_buffer *source)
+{
+    int width = (dest->Width < source->Width) ? dest->Width : source->Width;
+    int height = (dest->Height < source->Height) ? dest->Height : source->Height;
+    DISPATCH_PIXEL_FORMAT(dest->Format, BlitFromAnyFormat, dest, source, width, height);
+}
+
+#define APPLICATION_PIXEL_FORMAT_H
+#endif
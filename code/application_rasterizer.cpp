@@ -0,0 +1,678 @@
+/*
+
+  Triangle rasterizer, see application_rasterizer.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <immintrin.h>
+
+#define RASTER_FAR_DEPTH 3.0e38f
+
+// everything the rasterizer allocates comes out of arena and is good until the arena is cleared
+internal void BeginRaster(rasterizer *raster, memory_arena *arena, offscreen_graphics_buffer *target,
+                          uint32 max_triangle_count, bool32 use_depth)
+{
+    *raster = {};
+    raster->Target = *target;
+    raster->Arena = arena;
+    raster->TileCountX = (target->Width + RASTER_TILE_SIZE - 1) >> RASTER_TILE_SHIFT;
+    raster->TileCountY = (target->Height + RASTER_TILE_SIZE - 1) >> RASTER_TILE_SHIFT;
+    raster->UseAVX2 = RenderHasAVX2();
+    raster->MaxTriangleCount = max_triangle_count;
+    raster->Triangles = PushArrayAligned(arena, max_triangle_count, raster_triangle, 16);
+
+    if(use_depth)
+    {
+        // NOTE: cleared a tile at a time by the tiles that have something in them
+        raster->DepthPitch = (target->Width + 3 + 3) & ~3;
+        raster->Depth = PushArrayAligned(arena, raster->DepthPitch*target->Height, real32, 16);
+    }
+}
+
+inline int32 RasterSnap(real32 value)
+{
+    int32 result = (int32)floorf(value*RASTER_SUBPIXEL_ONE + 0.5f);
+    return result;
+}
+
+internal void RasterSetupTriangle(rasterizer *raster, raster_vertex *v0, raster_vertex *v1, raster_vertex *v2,
+                                  uint32 flags, uint32 flat_color)
+{
+    ++raster->SubmittedCount;
+    if(raster->TriangleCount >= raster->MaxTriangleCount)
+    {
+        ++raster->DroppedCount;
+        return;
+    }
+
+    raster_vertex *vertices[3] = {v0, v1, v2};
+    for(int vertex_idx = 0; vertex_idx < 3; ++vertex_idx)
+    {
+        raster_vertex *vertex = vertices[vertex_idx];
+        if(!(fabsf(vertex->X) <= RASTER_GUARD_BAND) || !(fabsf(vertex->Y) <= RASTER_GUARD_BAND))
+        {
+            ++raster->CulledCount;
+            return;
+        }
+    }
+
+    int32 x[3];
+    int32 y[3];
+    for(int vertex_idx = 0; vertex_idx < 3; ++vertex_idx)
+    {
+        x[vertex_idx] = RasterSnap(vertices[vertex_idx]->X);
+        y[vertex_idx] = RasterSnap(vertices[vertex_idx]->Y);
+    }
+
+    int64 area = (int64)(x[1] - x[0])*(y[2] - y[0]) - (int64)(x[2] - x[0])*(y[1] - y[0]);
+    if(area == 0)
+    {
+        ++raster->CulledCount;
+        return;
+    }
+    if(area < 0)
+    {
+        // NOTE: nothing is back face culled, wind everything the same way
+        raster_vertex *temp_vertex = vertices[1]; vertices[1] = vertices[2]; vertices[2] = temp_vertex;
+        int32 temp = x[1]; x[1] = x[2]; x[2] = temp;
+        temp = y[1]; y[1] = y[2]; y[2] = temp;
+        area = -area;
+    }
+
+    // NOTE: pixel x is covered when its center, x*16 + 8 in subpixels, is inside
+    int32 half = RASTER_SUBPIXEL_ONE / 2;
+    int32 min_sub_x = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+    int32 min_sub_y = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+    int32 max_sub_x = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+    int32 max_sub_y = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+
+    int32 min_x = (min_sub_x - half + RASTER_SUBPIXEL_ONE - 1) >> RASTER_SUBPIXEL_BITS;
+    int32 min_y = (min_sub_y - half + RASTER_SUBPIXEL_ONE - 1) >> RASTER_SUBPIXEL_BITS;
+    int32 max_x = ((max_sub_x - half) >> RASTER_SUBPIXEL_BITS) + 1;
+    int32 max_y = ((max_sub_y - half) >> RASTER_SUBPIXEL_BITS) + 1;
+    if(min_x < 0) min_x = 0;
+    if(min_y < 0) min_y = 0;
+    if(max_x > raster->Target.Width) max_x = raster->Target.Width;
+    if(max_y > raster->Target.Height) max_y = raster->Target.Height;
+    if((min_x >= max_x) || (min_y >= max_y))
+    {
+        ++raster->CulledCount;
+        return;
+    }
+
+    raster_triangle *triangle = raster->Triangles + raster->TriangleCount++;
+    triangle->Flags = flags;
+    triangle->FlatColor = flat_color;
+    triangle->MinX = min_x;
+    triangle->MinY = min_y;
+    triangle->MaxX = max_x;
+    triangle->MaxY = max_y;
+
+    // NOTE: edge i is the one across from vertex i, so E_i/area is vertex i's barycentric weight
+    for(int edge_idx = 0; edge_idx < 3; ++edge_idx)
+    {
+        int a = (edge_idx + 1) % 3;
+        int b = (edge_idx + 2) % 3;
+        int32 edge_a = y[a] - y[b];
+        int32 edge_b = x[b] - x[a];
+        int64 edge_c = (int64)x[a]*y[b] - (int64)y[a]*x[b];
+
+        // NOTE: top left rule. Pixel centers exactly on an edge belong to the triangle on its left, or
+        // below it for a flat edge. Everything else has to be strictly inside, E > 0 is E - 1 >= 0
+        bool32 is_top_left = (edge_a > 0) || ((edge_a == 0) && (edge_b > 0));
+        if(!is_top_left)
+        {
+            edge_c -= 1;
+        }
+
+        triangle->EdgeA[edge_idx] = edge_a*RASTER_SUBPIXEL_ONE;
+        triangle->EdgeB[edge_idx] = edge_b*RASTER_SUBPIXEL_ONE;
+        triangle->EdgeC[edge_idx] = edge_c + (int64)half*(edge_a + edge_b);
+    }
+
+    // NOTE: planes through the snapped vertices, a step per pixel is the sum of the vertex values
+    // weighted by how fast each barycentric changes
+    real32 inv_area = 1.0f / (real32)area;
+    real32 origin_x = (real32)x[0]*(1.0f / RASTER_SUBPIXEL_ONE) - 0.5f;
+    real32 origin_y = (real32)y[0]*(1.0f / RASTER_SUBPIXEL_ONE) - 0.5f;
+    int attribute_count = 4;
+    for(int attribute_idx = 0; attribute_idx < attribute_count; ++attribute_idx)
+    {
+        real32 values[3];
+        for(int vertex_idx = 0; vertex_idx < 3; ++vertex_idx)
+        {
+            raster_vertex *vertex = vertices[vertex_idx];
+            switch(attribute_idx)
+            {
+                case 0: values[vertex_idx] = (real32)((vertex->Color >> 16) & 0xFF); break;
+                case 1: values[vertex_idx] = (real32)((vertex->Color >> 8) & 0xFF); break;
+                case 2: values[vertex_idx] = (real32)(vertex->Color & 0xFF); break;
+                default: values[vertex_idx] = vertex->Z; break;
+            }
+        }
+
+        real32 dx = ((real32)triangle->EdgeA[0]*values[0] + (real32)triangle->EdgeA[1]*values[1] +
+                     (real32)triangle->EdgeA[2]*values[2])*inv_area;
+        real32 dy = ((real32)triangle->EdgeB[0]*values[0] + (real32)triangle->EdgeB[1]*values[1] +
+                     (real32)triangle->EdgeB[2]*values[2])*inv_area;
+        triangle->Attribute[attribute_idx] = values[0] - dx*origin_x - dy*origin_y;
+        triangle->AttributeDX[attribute_idx] = dx;
+        triangle->AttributeDY[attribute_idx] = dy;
+    }
+}
+
+inline void RasterTriangleFlat(rasterizer *raster, raster_vertex v0, raster_vertex v1, raster_vertex v2, uint32 color)
+{
+    RasterSetupTriangle(raster, &v0, &v1, &v2, 0, color);
+}
+
+inline void RasterTriangleGouraud(rasterizer *raster, raster_vertex v0, raster_vertex v1, raster_vertex v2)
+{
+    RasterSetupTriangle(raster, &v0, &v1, &v2, RasterTriangle_Gouraud, 0);
+}
+
+// store the lanes of colors that are set in mask, colors are 0xAARRGGBB
+template<pixel_format Format>
+inline void RasterStore4(offscreen_graphics_buffer *target, int32 x, int32 y, __m128i colors, __m128i mask)
+{
+    typedef pixel_traits<Format> traits;
+    int lane_mask = _mm_movemask_ps(_mm_castsi128_ps(mask));
+    uint32 lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, colors);
+
+    typename traits::pixel *pixel = GetPixelRow<Format>(target, y) + x;
+    for(int lane_idx = 0; lane_idx < 4; ++lane_idx)
+    {
+        if(lane_mask & (1 << lane_idx))
+        {
+            pixel[lane_idx] = traits::Pack(lanes[lane_idx]);
+        }
+    }
+}
+
+// NOTE: the display format takes all four at once, unless the quad hangs off the end of the row
+template<>
+inline void RasterStore4<PixelFormat_BGRX8>(offscreen_graphics_buffer *target, int32 x, int32 y, __m128i colors,
+                                            __m128i mask)
+{
+    uint32 *pixel = GetPixelRow<PixelFormat_BGRX8>(target, y) + x;
+    if(x + 4 <= target->Width)
+    {
+        __m128i old_colors = _mm_loadu_si128((__m128i *)pixel);
+        __m128i new_colors = _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, old_colors));
+        _mm_storeu_si128((__m128i *)pixel, new_colors);
+    }
+    else
+    {
+        int lane_mask = _mm_movemask_ps(_mm_castsi128_ps(mask));
+        uint32 lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, colors);
+        for(int lane_idx = 0; (lane_idx < 4) && (x + lane_idx < target->Width); ++lane_idx)
+        {
+            if(lane_mask & (1 << lane_idx))
+            {
+                pixel[lane_idx] = lanes[lane_idx];
+            }
+        }
+    }
+}
+
+// shade and write the four pixels at (x, y) that are set in mask
+template<pixel_format Format>
+inline void RasterShade4(rasterizer *raster, raster_triangle *triangle, int32 x, int32 y, __m128i mask)
+{
+    __m128 lane_x = _mm_add_ps(_mm_set1_ps((real32)x), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+    __m128 pixel_y = _mm_set1_ps((real32)y);
+
+    if(raster->Depth)
+    {
+        __m128 z = _mm_add_ps(_mm_set1_ps(triangle->Attribute[3]),
+                              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle->AttributeDX[3]), lane_x),
+                                         _mm_mul_ps(_mm_set1_ps(triangle->AttributeDY[3]), pixel_y)));
+        real32 *depth = raster->Depth + y*raster->DepthPitch + x;
+        __m128 old_z = _mm_loadu_ps(depth);
+        mask = _mm_and_si128(mask, _mm_castps_si128(_mm_cmplt_ps(z, old_z)));
+        if(!_mm_movemask_ps(_mm_castsi128_ps(mask)))
+        {
+            return;
+        }
+
+        __m128 z_mask = _mm_castsi128_ps(mask);
+        _mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(z_mask, z), _mm_andnot_ps(z_mask, old_z)));
+    }
+
+    __m128i colors;
+    if(triangle->Flags & RasterTriangle_Gouraud)
+    {
+        __m128 zero = _mm_setzero_ps();
+        __m128 max_channel = _mm_set1_ps(255.0f);
+        __m128i channels[3];
+        for(int channel_idx = 0; channel_idx < 3; ++channel_idx)
+        {
+            __m128 value = _mm_add_ps(_mm_set1_ps(triangle->Attribute[channel_idx]),
+                                      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle->AttributeDX[channel_idx]), lane_x),
+                                                 _mm_mul_ps(_mm_set1_ps(triangle->AttributeDY[channel_idx]), pixel_y)));
+            value = _mm_min_ps(_mm_max_ps(value, zero), max_channel);
+            channels[channel_idx] = _mm_cvtps_epi32(value);
+        }
+        colors = _mm_or_si128(_mm_or_si128(_mm_set1_epi32((int32)0xFF000000), _mm_slli_epi32(channels[0], 16)),
+                              _mm_or_si128(_mm_slli_epi32(channels[1], 8), channels[2]));
+    }
+    else
+    {
+        colors = _mm_set1_epi32((int32)triangle->FlatColor);
+    }
+
+    RasterStore4<Format>(&raster->Target, x, y, colors, mask);
+}
+
+/* NOTE: walk [min, max) in 4x2 quads. crossing_mask has a bit for every edge that runs through
+   the region, the others cover all of it and are left out of the tests.
+
+   Edge values anywhere near a crossing edge stay well inside 32 bits: they are bounded by how much
+   the edge changes across the region, and the guard band keeps the steps small.
+*/
+template<pixel_format Format>
+internal void RasterRegion(rasterizer *raster, raster_triangle *triangle, int32 min_x, int32 min_y,
+                           int32 max_x, int32 max_y, uint32 crossing_mask)
+{
+    __m128i lane_offsets = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i row_edge[3];
+    __m128i edge_step_x[3];
+    __m128i edge_step_y[3];
+    for(int edge_idx = 0; edge_idx < 3; ++edge_idx)
+    {
+        if(crossing_mask & (1 << edge_idx))
+        {
+            int32 a = triangle->EdgeA[edge_idx];
+            int32 b = triangle->EdgeB[edge_idx];
+            int32 start = (int32)((int64)a*min_x + (int64)b*min_y + triangle->EdgeC[edge_idx]);
+
+            // NOTE: SSE2 has no 32 bit multiply, the lane offsets are 0 a 2a 3a
+            row_edge[edge_idx] = _mm_add_epi32(_mm_set1_epi32(start), _mm_setr_epi32(0, a, 2*a, 3*a));
+            edge_step_x[edge_idx] = _mm_set1_epi32(4*a);
+            edge_step_y[edge_idx] = _mm_set1_epi32(b);
+        }
+        else
+        {
+            row_edge[edge_idx] = _mm_setzero_si128();
+            edge_step_x[edge_idx] = _mm_setzero_si128();
+            edge_step_y[edge_idx] = _mm_setzero_si128();
+        }
+    }
+
+    __m128i all_ones = _mm_set1_epi32(-1);
+    __m128i region_max_x = _mm_set1_epi32(max_x);
+    for(int32 y = min_y; y < max_y; y += 2)
+    {
+        bool32 has_second_row = (y + 1 < max_y);
+        __m128i edge0 = row_edge[0];
+        __m128i edge1 = row_edge[1];
+        __m128i edge2 = row_edge[2];
+        __m128i lane_x = _mm_add_epi32(_mm_set1_epi32(min_x), lane_offsets);
+        for(int32 x = min_x; x < max_x; x += 4)
+        {
+            __m128i in_region = _mm_cmplt_epi32(lane_x, region_max_x);
+
+            // NOTE: inside when no edge value has its sign bit set
+            __m128i top = _mm_or_si128(_mm_or_si128(edge0, edge1), edge2);
+            __m128i top_mask = _mm_and_si128(_mm_cmpgt_epi32(top, all_ones), in_region);
+
+            __m128i bottom_mask = _mm_setzero_si128();
+            if(has_second_row)
+            {
+                __m128i bottom = _mm_or_si128(_mm_or_si128(_mm_add_epi32(edge0, edge_step_y[0]),
+                                                           _mm_add_epi32(edge1, edge_step_y[1])),
+                                              _mm_add_epi32(edge2, edge_step_y[2]));
+                bottom_mask = _mm_and_si128(_mm_cmpgt_epi32(bottom, all_ones), in_region);
+            }
+
+            if(_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(top_mask, bottom_mask))))
+            {
+                if(_mm_movemask_ps(_mm_castsi128_ps(top_mask)))
+                {
+                    RasterShade4<Format>(raster, triangle, x, y, top_mask);
+                }
+                if(_mm_movemask_ps(_mm_castsi128_ps(bottom_mask)))
+                {
+                    RasterShade4<Format>(raster, triangle, x, y + 1, bottom_mask);
+                }
+            }
+
+            edge0 = _mm_add_epi32(edge0, edge_step_x[0]);
+            edge1 = _mm_add_epi32(edge1, edge_step_x[1]);
+            edge2 = _mm_add_epi32(edge2, edge_step_x[2]);
+            lane_x = _mm_add_epi32(lane_x, _mm_set1_epi32(4));
+        }
+
+        for(int edge_idx = 0; edge_idx < 3; ++edge_idx)
+        {
+            row_edge[edge_idx] = _mm_add_epi32(row_edge[edge_idx], _mm_add_epi32(edge_step_y[edge_idx],
+                                                                                  edge_step_y[edge_idx]));
+        }
+    }
+}
+
+// NOTE: RasterStore4 eight at a time. Masked off lanes aren't touched at all, not even read
+template<pixel_format Format>
+RENDER_TARGET_AVX2
+inline void RasterStore8(offscreen_graphics_buffer *target, int32 x, int32 y, __m256i colors, __m256i mask)
+{
+    typedef pixel_traits<Format> traits;
+    int lane_mask = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+    uint32 lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, colors);
+
+    typename traits::pixel *pixel = GetPixelRow<Format>(target, y) + x;
+    for(int lane_idx = 0; lane_idx < 8; ++lane_idx)
+    {
+        if(lane_mask & (1 << lane_idx))
+        {
+            pixel[lane_idx] = traits::Pack(lanes[lane_idx]);
+        }
+    }
+}
+
+template<>
+RENDER_TARGET_AVX2
+inline void RasterStore8<PixelFormat_BGRX8>(offscreen_graphics_buffer *target, int32 x, int32 y, __m256i colors,
+                                            __m256i mask)
+{
+    uint32 *pixel = GetPixelRow<PixelFormat_BGRX8>(target, y) + x;
+    _mm256_maskstore_epi32((int *)pixel, mask, colors);
+}
+
+// NOTE: RasterShade4 eight at a time
+template<pixel_format Format>
+RENDER_TARGET_AVX2
+inline void RasterShade8(rasterizer *raster, raster_triangle *triangle, int32 x, int32 y, __m256i mask)
+{
+    __m256 lane_x = _mm256_add_ps(_mm256_set1_ps((real32)x),
+                                  _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    __m256 pixel_y = _mm256_set1_ps((real32)y);
+
+    if(raster->Depth)
+    {
+        __m256 z = _mm256_add_ps(_mm256_set1_ps(triangle->Attribute[3]),
+                                 _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle->AttributeDX[3]), lane_x),
+                                               _mm256_mul_ps(_mm256_set1_ps(triangle->AttributeDY[3]), pixel_y)));
+        real32 *depth = raster->Depth + y*raster->DepthPitch + x;
+        __m256 old_z = _mm256_maskload_ps(depth, mask);
+        mask = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(z, old_z, _CMP_LT_OQ)));
+        if(!_mm256_movemask_ps(_mm256_castsi256_ps(mask)))
+        {
+            return;
+        }
+
+        _mm256_maskstore_ps(depth, mask, z);
+    }
+
+    __m256i colors;
+    if(triangle->Flags & RasterTriangle_Gouraud)
+    {
+        __m256 zero = _mm256_setzero_ps();
+        __m256 max_channel = _mm256_set1_ps(255.0f);
+        __m256i channels[3];
+        for(int channel_idx = 0; channel_idx < 3; ++channel_idx)
+        {
+            __m256 value = _mm256_add_ps(_mm256_set1_ps(triangle->Attribute[channel_idx]),
+                                         _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle->AttributeDX[channel_idx]), lane_x),
+                                                       _mm256_mul_ps(_mm256_set1_ps(triangle->AttributeDY[channel_idx]), pixel_y)));
+            value = _mm256_min_ps(_mm256_max_ps(value, zero), max_channel);
+            channels[channel_idx] = _mm256_cvtps_epi32(value);
+        }
+        colors = _mm256_or_si256(_mm256_or_si256(_mm256_set1_epi32((int32)0xFF000000), _mm256_slli_epi32(channels[0], 16)),
+                                 _mm256_or_si256(_mm256_slli_epi32(channels[1], 8), channels[2]));
+    }
+    else
+    {
+        colors = _mm256_set1_epi32((int32)triangle->FlatColor);
+    }
+
+    RasterStore8<Format>(&raster->Target, x, y, colors, mask);
+}
+
+/* NOTE: RasterRegion in 8x2 quads. The lanes can now run up to 7 pixels past the region, the edge
+   values there still fit: a tile is 32 pixels across, so that's at most 39 steps of an edge.
+*/
+template<pixel_format Format>
+RENDER_TARGET_AVX2
+internal void RasterRegionAVX2(rasterizer *raster, raster_triangle *triangle, int32 min_x, int32 min_y,
+                               int32 max_x, int32 max_y, uint32 crossing_mask)
+{
+    __m256i lane_offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i row_edge[3];
+    __m256i edge_step_x[3];
+    __m256i edge_step_y[3];
+    for(int edge_idx = 0; edge_idx < 3; ++edge_idx)
+    {
+        if(crossing_mask & (1 << edge_idx))
+        {
+            int32 a = triangle->EdgeA[edge_idx];
+            int32 b = triangle->EdgeB[edge_idx];
+            int32 start = (int32)((int64)a*min_x + (int64)b*min_y + triangle->EdgeC[edge_idx]);
+            row_edge[edge_idx] = _mm256_add_epi32(_mm256_set1_epi32(start), _mm256_mullo_epi32(_mm256_set1_epi32(a), lane_offsets));
+            edge_step_x[edge_idx] = _mm256_set1_epi32(8*a);
+            edge_step_y[edge_idx] = _mm256_set1_epi32(b);
+        }
+        else
+        {
+            row_edge[edge_idx] = _mm256_setzero_si256();
+            edge_step_x[edge_idx] = _mm256_setzero_si256();
+            edge_step_y[edge_idx] = _mm256_setzero_si256();
+        }
+    }
+
+    __m256i all_ones = _mm256_set1_epi32(-1);
+    __m256i region_max_x = _mm256_set1_epi32(max_x);
+    for(int32 y = min_y; y < max_y; y += 2)
+    {
+        bool32 has_second_row = (y + 1 < max_y);
+        __m256i edge0 = row_edge[0];
+        __m256i edge1 = row_edge[1];
+        __m256i edge2 = row_edge[2];
+        __m256i lane_x = _mm256_add_epi32(_mm256_set1_epi32(min_x), lane_offsets);
+        for(int32 x = min_x; x < max_x; x += 8)
+        {
+            __m256i in_region = _mm256_cmpgt_epi32(region_max_x, lane_x);
+
+            __m256i top = _mm256_or_si256(_mm256_or_si256(edge0, edge1), edge2);
+            __m256i top_mask = _mm256_and_si256(_mm256_cmpgt_epi32(top, all_ones), in_region);
+
+            __m256i bottom_mask = _mm256_setzero_si256();
+            if(has_second_row)
+            {
+                __m256i bottom = _mm256_or_si256(_mm256_or_si256(_mm256_add_epi32(edge0, edge_step_y[0]),
+                                                                 _mm256_add_epi32(edge1, edge_step_y[1])),
+                                                 _mm256_add_epi32(edge2, edge_step_y[2]));
+                bottom_mask = _mm256_and_si256(_mm256_cmpgt_epi32(bottom, all_ones), in_region);
+            }
+
+            if(!_mm256_testz_si256(_mm256_or_si256(top_mask, bottom_mask), all_ones))
+            {
+                if(!_mm256_testz_si256(top_mask, all_ones))
+                {
+                    RasterShade8<Format>(raster, triangle, x, y, top_mask);
+                }
+                if(!_mm256_testz_si256(bottom_mask, all_ones))
+                {
+                    RasterShade8<Format>(raster, triangle, x, y + 1, bottom_mask);
+                }
+            }
+
+            edge0 = _mm256_add_epi32(edge0, edge_step_x[0]);
+            edge1 = _mm256_add_epi32(edge1, edge_step_x[1]);
+            edge2 = _mm256_add_epi32(edge2, edge_step_x[2]);
+            lane_x = _mm256_add_epi32(lane_x, _mm256_set1_epi32(8));
+        }
+
+        for(int edge_idx = 0; edge_idx < 3; ++edge_idx)
+        {
+            row_edge[edge_idx] = _mm256_add_epi32(row_edge[edge_idx], _mm256_add_epi32(edge_step_y[edge_idx],
+                                                                                       edge_step_y[edge_idx]));
+        }
+    }
+}
+
+// draw every triangle binned to one tile, in the order they were submitted
+template<pixel_format Format>
+internal void RasterTile(rasterizer *raster, int32 tile_x, int32 tile_y)
+{
+    int32 tile_idx = tile_y*raster->TileCountX + tile_x;
+    uint32 first = raster->TileStart[tile_idx];
+    uint32 one_past_last = raster->TileStart[tile_idx + 1];
+    if(first == one_past_last)
+    {
+        return;
+    }
+
+    int32 tile_min_x = tile_x << RASTER_TILE_SHIFT;
+    int32 tile_min_y = tile_y << RASTER_TILE_SHIFT;
+    int32 tile_max_x = tile_min_x + RASTER_TILE_SIZE;
+    int32 tile_max_y = tile_min_y + RASTER_TILE_SIZE;
+    if(tile_max_x > raster->Target.Width) tile_max_x = raster->Target.Width;
+    if(tile_max_y > raster->Target.Height) tile_max_y = raster->Target.Height;
+
+    if(raster->Depth)
+    {
+        for(int32 y = tile_min_y; y < tile_max_y; ++y)
+        {
+            real32 *depth = raster->Depth + y*raster->DepthPitch;
+            for(int32 x = tile_min_x; x < tile_max_x; ++x)
+            {
+                depth[x] = RASTER_FAR_DEPTH;
+            }
+        }
+    }
+
+    for(uint32 bin_idx = first; bin_idx < one_past_last; ++bin_idx)
+    {
+        raster_triangle *triangle = raster->Triangles + raster->TileTriangles[bin_idx];
+        int32 min_x = (triangle->MinX > tile_min_x) ? triangle->MinX : tile_min_x;
+        int32 min_y = (triangle->MinY > tile_min_y) ? triangle->MinY : tile_min_y;
+        int32 max_x = (triangle->MaxX < tile_max_x) ? triangle->MaxX : tile_max_x;
+        int32 max_y = (triangle->MaxY < tile_max_y) ? triangle->MaxY : tile_max_y;
+
+        // NOTE: test every edge against the corners of the region, the one furthest inside and the
+        // one furthest outside. All outside rejects the triangle, all inside drops the edge
+        bool32 is_rejected = false;
+        uint32 crossing_mask = 0;
+        for(int edge_idx = 0; edge_idx < 3; ++edge_idx)
+        {
+            int64 a = triangle->EdgeA[edge_idx];
+            int64 b = triangle->EdgeB[edge_idx];
+            int64 inside_x = (a > 0) ? (max_x - 1) : min_x;
+            int64 inside_y = (b > 0) ? (max_y - 1) : min_y;
+            int64 outside_x = (a > 0) ? min_x : (max_x - 1);
+            int64 outside_y = (b > 0) ? min_y : (max_y - 1);
+            int64 most_inside = a*inside_x + b*inside_y + triangle->EdgeC[edge_idx];
+            int64 most_outside = a*outside_x + b*outside_y + triangle->EdgeC[edge_idx];
+            if(most_inside < 0)
+            {
+                is_rejected = true;
+                break;
+            }
+            if(most_outside < 0)
+            {
+                crossing_mask |= (1 << edge_idx);
+            }
+        }
+
+        if(is_rejected)
+        {
+            continue;
+        }
+
+        if(!crossing_mask && !raster->Depth && !(triangle->Flags & RasterTriangle_Gouraud))
+        {
+            FillRectangle<Format>(&raster->Target, min_x, min_y, max_x, max_y, triangle->FlatColor);
+        }
+        else if(raster->UseAVX2)
+        {
+            RasterRegionAVX2<Format>(raster, triangle, min_x, min_y, max_x, max_y, crossing_mask);
+        }
+        else
+        {
+            RasterRegion<Format>(raster, triangle, min_x, min_y, max_x, max_y, crossing_mask);
+        }
+    }
+}
+
+struct raster_tile_row_job
+{
+    rasterizer *Raster;
+    int32 TileY;
+};
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoRasterTileRowJob)
+{
+    raster_tile_row_job *job = (raster_tile_row_job *)data;
+    rasterizer *raster = job->Raster;
+    for(int32 tile_x = 0; tile_x < raster->TileCountX; ++tile_x)
+    {
+        DISPATCH_PIXEL_FORMAT(raster->Target.Format, RasterTile, raster, tile_x, job->TileY);
+    }
+}
+
+// bin everything that was submitted and draw it, one job per row of tiles
+internal void EndRaster(rasterizer *raster, platform_work_queue *queue)
+{
+    int32 tile_count = raster->TileCountX*raster->TileCountY;
+    raster->TileStart = PushArray(raster->Arena, tile_count + 1, uint32);
+    uint32 *tile_cursor = PushArray(raster->Arena, tile_count, uint32);
+    for(int32 tile_idx = 0; tile_idx <= tile_count; ++tile_idx)
+    {
+        raster->TileStart[tile_idx] = 0;
+    }
+
+    // NOTE: counting sort, count every tile a triangle's bounds touch then scatter
+    for(uint32 triangle_idx = 0; triangle_idx < raster->TriangleCount; ++triangle_idx)
+    {
+        raster_triangle *triangle = raster->Triangles + triangle_idx;
+        for(int32 tile_y = triangle->MinY >> RASTER_TILE_SHIFT; tile_y <= ((triangle->MaxY - 1) >> RASTER_TILE_SHIFT); ++tile_y)
+        {
+            for(int32 tile_x = triangle->MinX >> RASTER_TILE_SHIFT; tile_x <= ((triangle->MaxX - 1) >> RASTER_TILE_SHIFT); ++tile_x)
+            {
+                ++raster->TileStart[tile_y*raster->TileCountX + tile_x];
+            }
+        }
+    }
+
+    uint32 total = 0;
+    for(int32 tile_idx = 0; tile_idx < tile_count; ++tile_idx)
+    {
+        uint32 count = raster->TileStart[tile_idx];
+        raster->TileStart[tile_idx] = total;
+        tile_cursor[tile_idx] = total;
+        total += count;
+    }
+    raster->TileStart[tile_count] = total;
+
+    raster->TileTriangles = PushArray(raster->Arena, total, uint32);
+    for(uint32 triangle_idx = 0; triangle_idx < raster->TriangleCount; ++triangle_idx)
+    {
+        raster_triangle *triangle = raster->Triangles + triangle_idx;
+        for(int32 tile_y = triangle->MinY >> RASTER_TILE_SHIFT; tile_y <= ((triangle->MaxY - 1) >> RASTER_TILE_SHIFT); ++tile_y)
+        {
+            for(int32 tile_x = triangle->MinX >> RASTER_TILE_SHIFT; tile_x <= ((triangle->MaxX - 1) >> RASTER_TILE_SHIFT); ++tile_x)
+            {
+                raster->TileTriangles[tile_cursor[tile_y*raster->TileCountX + tile_x]++] = triangle_idx;
+            }
+        }
+    }
+
+    // NOTE: an SSE2 quad can read and write back up to 3 pixels past a tile's right edge, which is fine
+    // because the whole row of tiles belongs to one job
+    platform_job_counter counter = {};
+    raster_tile_row_job *jobs = PushArrayAligned(raster->Arena, raster->TileCountY, raster_tile_row_job, 8);
+    for(int32 tile_y = 0; tile_y < raster->TileCountY; ++tile_y)
+    {
+        raster_tile_row_job *job = jobs + tile_y;
+        job->Raster = raster;
+        job->TileY = tile_y;
+        Platform.AddEntry(queue, DoRasterTileRowJob, job, &counter);
+    }
+    Platform.WaitForCounter(queue, &counter);
+}
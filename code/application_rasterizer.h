@@ -0,0 +1,103 @@
+/*
+
+  Triangle rasterizer. Triangles are set up as they are submitted, then
+  counting sorted into the screen tiles their bounds touch, so every tile
+  is a contiguous run of triangle indices in submission order. Each row of
+  tiles is one job.
+
+  Within a tile a triangle is first tested against the tile as a whole:
+  an edge that misses the tile throws the triangle out, an edge that
+  covers all of it doesn't have to be looked at again. Whatever is left
+  is walked in 4x2 pixel quads, with the remaining edge functions stepped
+  four lanes at a time, or in 8x2 quads eight lanes at a time when the
+  processor has AVX2.
+
+  Positions are snapped to 1/16 of a pixel and the edge functions are
+  exact integers, so the top left fill rule holds: triangles sharing an
+  edge never draw a pixel twice or leave a crack between them.
+
+  Colors are flat or Gouraud, depth is optional and lives in the arena
+  the frame was begun with. Pixels are written in the target buffer's own
+  format.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_RASTERIZER_H)
+
+#define RASTER_TILE_SHIFT 5
+#define RASTER_TILE_SIZE (1 << RASTER_TILE_SHIFT)
+#define RASTER_SUBPIXEL_BITS 4
+#define RASTER_SUBPIXEL_ONE (1 << RASTER_SUBPIXEL_BITS)
+
+// NOTE: triangles with a vertex further off screen than this are dropped instead of clipped,
+// it keeps the edge functions of a tile's crossing edges inside 32 bits
+#define RASTER_GUARD_BAND 8192.0f
+
+// screen space, pixels. Z is only looked at with a depth buffer, smaller is closer
+struct raster_vertex
+{
+    real32 X;
+    real32 Y;
+    real32 Z;
+    uint32 Color; // NOTE: 0xAARRGGBB
+};
+
+enum raster_triangle_flags
+{
+    RasterTriangle_Gouraud = (1 << 0),
+};
+
+// NOTE: everything the tiles need, worked out once at submission
+struct raster_triangle
+{
+    uint32 Flags;
+    uint32 FlatColor;
+
+    // NOTE: pixel bounds, inclusive min exclusive max, already clipped to the target
+    int32 MinX;
+    int32 MinY;
+    int32 MaxX;
+    int32 MaxY;
+
+    // NOTE: E(x, y) = A*x + B*y + C at the center of pixel (x, y), in subpixels squared.
+    // Inside is E >= 0, the top left bias is folded into C
+    int32 EdgeA[3];
+    int32 EdgeB[3];
+    int64 EdgeC[3];
+
+    // NOTE: planes, value at the center of pixel (0, 0) plus a step per pixel in x and y.
+    // Red, green, blue, depth
+    real32 Attribute[4];
+    real32 AttributeDX[4];
+    real32 AttributeDY[4];
+};
+
+struct rasterizer
+{
+    offscreen_graphics_buffer Target;
+    memory_arena *Arena;
+
+    bool32 UseAVX2; // NOTE: looked up once in BeginRaster, the tile jobs only read it
+    real32 *Depth; // NOTE: 0 without a depth buffer
+    int32 DepthPitch; // NOTE: in floats, a multiple of 4 so quads never run off a row
+
+    int32 TileCountX;
+    int32 TileCountY;
+
+    uint32 MaxTriangleCount;
+    uint32 TriangleCount;
+    raster_triangle *Triangles;
+
+    // NOTE: built by EndRaster, tile t holds TileTriangles[TileStart[t], TileStart[t + 1])
+    uint32 *TileStart;
+    uint32 *TileTriangles;
+
+    uint32 SubmittedCount;
+    uint32 CulledCount; // NOTE: no area, off screen or outside the guard band
+    uint32 DroppedCount; // NOTE: past MaxTriangleCount
+};
+
+#define APPLICATION_RASTERIZER_H
+#endif
@@ -0,0 +1,890 @@
+/*
+
+  Software renderer, see application_render.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// NOTE: MSVC takes AVX2 intrinsics anywhere, gcc and clang want the function marked
+#if defined(_MSC_VER)
+#define RENDER_TARGET_AVX2
+#else
+#define RENDER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// does the processor and the OS both do AVX2
+internal bool32 RenderDetectAVX2()
+{
+    bool32 result = false;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    if(max_leaf >= 7)
+    {
+        __cpuid(info, 1);
+        bool32 os_saves_ymm = false;
+        if(info[2] & (1 << 27))
+        {
+            os_saves_ymm = ((_xgetbv(0) & 6) == 6);
+        }
+        // NOTE: leaf 7 is only there when leaf 0 says so, past the max leaf cpuid hands back whatever the top leaf has
+        __cpuidex(info, 7, 0);
+        result = (os_saves_ymm && (info[1] & (1 << 5))) ? true : false;
+    }
+#else
+    // NOTE: this can run before libgcc's own constructor has filled in what the processor has
+    __builtin_cpu_init();
+    result = __builtin_cpu_supports("avx2") ? true : false;
+#endif
+    return result;
+}
+
+// NOTE: set while the app code is being loaded, before anything can start a job, and only read after.
+// Every reload of the app code sets it again
+global_variable bool32 RenderCPUHasAVX2 = RenderDetectAVX2();
+
+inline bool32 RenderHasAVX2()
+{
+    return RenderCPUHasAVX2;
+}
+
+/* NOTE: gamma correct blending takes the gamma as 2, like Float32Linear: decoding an 8 bit channel is
+   a square and encoding is a square root. The straight C paths look the decode up, the SIMD ones
+   just square.
+
+   Textures are premultiplied in their stored, gamma encoded form, p = c*a. The linear premultiplied
+   color that's wanted is c^2*a, which is p^2 / a, so the same decode and one divide gets there.
+
+   The table is (value / 255)^2 worked out in floats, spelled out so the render jobs never have to
+   build it and race each other doing it.
+*/
+global_variable const real32 SRGB8ToLinearTable[256] =
+{
+    0.0f, 1.53787023e-05f, 6.15148092e-05f, 0.00013840833f, 0.000246059237f, 0.000384467538f, 0.000553633319f, 0.000753556436f,
+    0.000984236947f, 0.00124567491f, 0.00153787015f, 0.0018608229f, 0.00221453328f, 0.00259900093f, 0.00301422575f, 0.00346020819f,
+    0.00393694779f, 0.00444444502f, 0.00498269964f, 0.00555171119f, 0.0061514806f, 0.0067820074f, 0.0074432916f, 0.00813533273f,
+    0.00885813311f, 0.00961168949f, 0.0103960037f, 0.0112110749f, 0.012056903f, 0.0129334889f, 0.0138408327f, 0.0147789335f,
+    0.0157477912f, 0.0167474076f, 0.0177777801f, 0.0188389104f, 0.0199307986f, 0.0210534427f, 0.0222068448f, 0.0233910047f,
+    0.0246059224f, 0.025851598f, 0.0271280296f, 0.0284352191f, 0.0297731664f, 0.0311418697f, 0.0325413309f, 0.0339715518f,
+    0.0354325324f, 0.0369242653f, 0.0384467579f, 0.0400000066f, 0.0415840149f, 0.0431987755f, 0.0448442996f, 0.0465205759f,
+    0.0482276119f, 0.049965404f, 0.0517339557f, 0.0535332635f, 0.055363331f, 0.0572241507f, 0.059115734f, 0.0610380694f,
+    0.0629911646f, 0.0649750158f, 0.0669896305f, 0.0690349936f, 0.0711111203f, 0.0732180029f, 0.0753556415f, 0.0775240362f,
+    0.0797231942f, 0.0819531009f, 0.0842137709f, 0.086505197f, 0.088827379f, 0.0911803246f, 0.0935640186f, 0.0959784761f,
+    0.0984236896f, 0.100899659f, 0.103406392f, 0.105943874f, 0.108512118f, 0.111111119f, 0.113740876f, 0.116401389f,
+    0.119092666f, 0.121814691f, 0.124567479f, 0.127351031f, 0.130165324f, 0.133010387f, 0.135886207f, 0.138792783f,
+    0.14173013f, 0.144698218f, 0.147697061f, 0.150726676f, 0.153787032f, 0.156878158f, 0.160000026f, 0.163152665f,
+    0.16633606f, 0.169550195f, 0.172795102f, 0.176070765f, 0.179377198f, 0.182714373f, 0.186082304f, 0.189481005f,
+    0.192910448f, 0.196370661f, 0.199861616f, 0.203383341f, 0.206935823f, 0.21051906f, 0.214133054f, 0.217777804f,
+    0.221453324f, 0.225159585f, 0.228896603f, 0.232664391f, 0.236462936f, 0.240292221f, 0.244152278f, 0.24804309f,
+    0.251964658f, 0.255916983f, 0.259900063f, 0.2639139f, 0.267958522f, 0.27203387f, 0.276139975f, 0.280276835f,
+    0.284444481f, 0.288642853f, 0.292872012f, 0.297131896f, 0.301422566f, 0.305743963f, 0.310096145f, 0.314479083f,
+    0.318892777f, 0.323337197f, 0.327812403f, 0.332318366f, 0.336855084f, 0.341422558f, 0.346020788f, 0.350649774f,
+    0.355309516f, 0.360000014f, 0.364721298f, 0.369473308f, 0.374256074f, 0.379069626f, 0.383913904f, 0.388788968f,
+    0.393694758f, 0.398631334f, 0.403598636f, 0.408596724f, 0.413625568f, 0.418685138f, 0.423775494f, 0.428896606f,
+    0.434048474f, 0.439231098f, 0.444444478f, 0.449688613f, 0.454963505f, 0.460269153f, 0.465605557f, 0.470972717f,
+    0.476370662f, 0.481799334f, 0.487258762f, 0.492748976f, 0.498269916f, 0.503821611f, 0.509404123f, 0.515017331f,
+    0.520661294f, 0.526336074f, 0.53204155f, 0.537777781f, 0.543544829f, 0.549342573f, 0.555171132f, 0.561030388f,
+    0.566920519f, 0.572841346f, 0.57879287f, 0.584775209f, 0.590788245f, 0.596832097f, 0.602906704f, 0.609012008f,
+    0.615148127f, 0.621315002f, 0.627512634f, 0.633740962f, 0.640000105f, 0.646290004f, 0.65261066f, 0.658962071f,
+    0.665344238f, 0.671757162f, 0.678200781f, 0.684675217f, 0.691180408f, 0.697716355f, 0.704283059f, 0.710880518f,
+    0.717508793f, 0.724167764f, 0.730857491f, 0.737577975f, 0.744329214f, 0.751111209f, 0.75792402f, 0.764767528f,
+    0.771641791f, 0.77854681f, 0.785482645f, 0.792449176f, 0.799446464f, 0.806474566f, 0.813533366f, 0.820622981f,
+    0.827743292f, 0.834894419f, 0.842076242f, 0.849288881f, 0.856532216f, 0.863806367f, 0.871111214f, 0.878446877f,
+    0.885813296f, 0.893210411f, 0.900638342f, 0.908097029f, 0.915586412f, 0.923106611f, 0.930657566f, 0.938239276f,
+    0.945851743f, 0.953494906f, 0.961168885f, 0.96887362f, 0.976609111f, 0.984375358f, 0.99217236f, 1.0f
+};
+
+inline uint32 EncodeLinearChannel8(real32 linear)
+{
+    uint32 result = (uint32)(255.0f*sqrtf(linear < 1.0f ? linear : 1.0f) + 0.5f);
+    return result;
+}
+
+// premultiplied linear red, green, blue plus alpha over dest 0xAARRGGBB, in linear light
+inline uint32 BlendLinear(uint32 dest, real32 *source_linear, real32 source_alpha)
+{
+    const real32 *to_linear = SRGB8ToLinearTable;
+    real32 inv_alpha = 1.0f - source_alpha;
+
+    real32 dest_alpha = (real32)(dest >> 24)*(1.0f / 255.0f);
+    uint32 result = (uint32)(255.0f*(source_alpha + dest_alpha*inv_alpha) + 0.5f) << 24;
+    for(int32 channel_idx = 0; channel_idx < 3; ++channel_idx)
+    {
+        int32 shift = 16 - 8*channel_idx;
+        real32 linear = source_linear[channel_idx] + to_linear[(dest >> shift) & 0xFF]*inv_alpha;
+        result |= EncodeLinearChannel8(linear) << shift;
+    }
+    return result;
+}
+
+// NOTE: the part of a textured rectangle that's the same whichever path draws it
+struct textured_rectangle_setup
+{
+    int32 MinX;
+    int32 MinY;
+    int32 MaxX;
+    int32 MaxY;
+
+    v2 Origin;
+    v2 NX; // NOTE: x axis over its length squared, u is (p - origin) . NX
+    v2 NY;
+    real32 TexelScaleX; // NOTE: Width - 2 and Height - 2, the bilinear footprint never leaves the texture
+    real32 TexelScaleY;
+
+    bool32 IsGammaCorrect;
+};
+
+/* NOTE: filtering and blending are fixed point on 16 bit lanes. Texel coordinates are converted once
+   with the fraction in the low 7 bits, so the weights are in 1/128ths of a texel:
+
+     top = a + (((b - a)*wx) >> 7)              bottom the same from c and d
+     texel = top + (((bottom - top)*wy) >> 7)
+     result = texel + ((dest*(256 - alpha)) >> 8)
+
+   The AVX2 path's weights are in 1/64ths instead, see TexturedFilterPairs8.
+*/
+#define TEXTURED_FRACTION_BITS 7
+
+// narrow [*min_x, *max_x] to the x where k + x*step is in [0, 1]
+inline void ClipTexturedSpan(real32 k, real32 step, real32 *min_x, real32 *max_x)
+{
+    if(step > 0.0f)
+    {
+        real32 low = -k / step;
+        real32 high = (1.0f - k) / step;
+        *min_x = (low > *min_x) ? low : *min_x;
+        *max_x = (high < *max_x) ? high : *max_x;
+    }
+    else if(step < 0.0f)
+    {
+        real32 low = (1.0f - k) / step;
+        real32 high = -k / step;
+        *min_x = (low > *min_x) ? low : *min_x;
+        *max_x = (high < *max_x) ? high : *max_x;
+    }
+    else if((k < 0.0f) || (k > 1.0f))
+    {
+        *max_x = *min_x - 1.0f;
+    }
+}
+
+/* NOTE: the pixels of row y whose centers are inside the rectangle, first_x up to but not including
+   end_x. Only these get visited, so nothing inside has to check u and v: a pixel the rounding puts
+   right on the wrong side of an edge is at most a hair outside [0, 1], which still fetches in bounds.
+*/
+inline void GetTexturedRowSpan(textured_rectangle_setup *setup, int32 y, int32 *first_x, int32 *end_x)
+{
+    real32 d_y = (real32)y + 0.5f - setup->Origin.y;
+    real32 d_x = 0.5f - setup->Origin.x;
+    real32 min_x = (real32)setup->MinX;
+    real32 max_x = (real32)(setup->MaxX - 1);
+    ClipTexturedSpan(d_x*setup->NX.x + d_y*setup->NX.y, setup->NX.x, &min_x, &max_x);
+    ClipTexturedSpan(d_x*setup->NY.x + d_y*setup->NY.y, setup->NY.x, &min_x, &max_x);
+
+    *first_x = (int32)ceilf(min_x);
+    *end_x = (int32)floorf(max_x) + 1;
+}
+
+// straight C, for the buffer formats the SIMD paths don't write
+template<pixel_format Format>
+internal void DrawRectangleTexturedScalar(offscreen_graphics_buffer *buffer, render_texture *texture,
+                                          textured_rectangle_setup *setup)
+{
+    typedef pixel_traits<Format> traits;
+    for(int32 y = setup->MinY; y < setup->MaxY; ++y)
+    {
+        int32 first_x;
+        int32 end_x;
+        GetTexturedRowSpan(setup, y, &first_x, &end_x);
+
+        typename traits::pixel *pixel = GetPixelRow<Format>(buffer, y) + first_x;
+        for(int32 x = first_x; x < end_x; ++x, ++pixel)
+        {
+            v2 d = V2((real32)x + 0.5f, (real32)y + 0.5f) - setup->Origin;
+            real32 u = Inner(d, setup->NX);
+            real32 v = Inner(d, setup->NY);
+
+            int32 tx = (int32)(u*setup->TexelScaleX*(1 << TEXTURED_FRACTION_BITS));
+            int32 ty = (int32)(v*setup->TexelScaleY*(1 << TEXTURED_FRACTION_BITS));
+            int32 wx = tx & ((1 << TEXTURED_FRACTION_BITS) - 1);
+            int32 wy = ty & ((1 << TEXTURED_FRACTION_BITS) - 1);
+
+            uint32 *texel = texture->Texels + (ty >> TEXTURED_FRACTION_BITS)*texture->Pitch + (tx >> TEXTURED_FRACTION_BITS);
+            uint32 filtered = 0;
+            for(int32 shift = 0; shift < 32; shift += 8)
+            {
+                int32 a = (texel[0] >> shift) & 0xFF;
+                int32 b = (texel[1] >> shift) & 0xFF;
+                int32 c = (texel[texture->Pitch] >> shift) & 0xFF;
+                int32 e = (texel[texture->Pitch + 1] >> shift) & 0xFF;
+                int32 top = a + (((b - a)*wx) >> 7);
+                int32 bottom = c + (((e - c)*wx) >> 7);
+                filtered |= (uint32)(top + (((bottom - top)*wy) >> 7)) << shift;
+            }
+
+            uint32 dest = traits::Unpack(*pixel);
+            uint32 result = 0;
+            if(setup->IsGammaCorrect)
+            {
+                const real32 *to_linear = SRGB8ToLinearTable;
+                real32 alpha = (real32)(filtered >> 24)*(1.0f / 255.0f);
+                real32 inv_alpha = (alpha > 0.0f) ? (1.0f / alpha) : 0.0f;
+                real32 source_linear[3] =
+                {
+                    to_linear[(filtered >> 16) & 0xFF]*inv_alpha,
+                    to_linear[(filtered >> 8) & 0xFF]*inv_alpha,
+                    to_linear[filtered & 0xFF]*inv_alpha,
+                };
+                result = BlendLinear(dest, source_linear, alpha);
+            }
+            else
+            {
+                uint32 inv_alpha = 256 - (filtered >> 24);
+                for(int32 shift = 0; shift < 32; shift += 8)
+                {
+                    uint32 blended = ((filtered >> shift) & 0xFF) + ((((dest >> shift) & 0xFF)*inv_alpha) >> 8);
+                    result |= ((blended > 255) ? 255 : blended) << shift;
+                }
+            }
+            *pixel = traits::Pack(result);
+        }
+    }
+}
+
+// NOTE: lanes past the end of a row's span are masked off
+global_variable uint32 TexturedColumnMasks[9][8] =
+{
+    {0, 0, 0, 0, 0, 0, 0, 0},
+    {~0u, 0, 0, 0, 0, 0, 0, 0},
+    {~0u, ~0u, 0, 0, 0, 0, 0, 0},
+    {~0u, ~0u, ~0u, 0, 0, 0, 0, 0},
+    {~0u, ~0u, ~0u, ~0u, 0, 0, 0, 0},
+    {~0u, ~0u, ~0u, ~0u, ~0u, 0, 0, 0},
+    {~0u, ~0u, ~0u, ~0u, ~0u, ~0u, 0, 0},
+    {~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, 0},
+    {~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u},
+};
+
+// NOTE: two pixels of 16 bit channels, weights already spread across each pixel's four channels
+inline __m128i TexturedFilterHalf(__m128i a, __m128i b, __m128i c, __m128i d, __m128i wx, __m128i wy)
+{
+    __m128i top = _mm_add_epi16(a, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(b, a), wx), 7));
+    __m128i bottom = _mm_add_epi16(c, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(d, c), wx), 7));
+    __m128i result = _mm_add_epi16(top, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bottom, top), wy), 7));
+    return result;
+}
+
+// NOTE: the same from two pixels' a b and c d pairs, as they come out of memory
+inline __m128i TexturedFilterPairs(__m128i ab, __m128i cd, __m128i wx, __m128i wy)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i ab0 = _mm_unpacklo_epi8(ab, zero);
+    __m128i ab1 = _mm_unpackhi_epi8(ab, zero);
+    __m128i cd0 = _mm_unpacklo_epi8(cd, zero);
+    __m128i cd1 = _mm_unpackhi_epi8(cd, zero);
+    return TexturedFilterHalf(_mm_unpacklo_epi64(ab0, ab1), _mm_unpackhi_epi64(ab0, ab1),
+                              _mm_unpacklo_epi64(cd0, cd1), _mm_unpackhi_epi64(cd0, cd1), wx, wy);
+}
+
+inline __m128i TexturedBlendHalf(__m128i texel, __m128i dest)
+{
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(texel, 0xFF), 0xFF);
+    __m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(256), alpha);
+    __m128i scaled = _mm_srli_epi16(_mm_mullo_epi16(dest, inv_alpha), 8);
+    return _mm_add_epi16(texel, scaled);
+}
+
+/* NOTE: the gamma correct blend, on one pixel's B G R A as floats from 0 to 255. The alpha lane works
+   out to the texel's alpha over the X byte squared, which is never looked at. sqrt is x*rsqrt(x),
+   the approximation is good to 12 bits.
+*/
+inline __m128 BlendLinearPixel(__m128 texel, __m128 dest)
+{
+    __m128 inv_255 = _mm_set1_ps(1.0f / 255.0f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 t = _mm_mul_ps(texel, inv_255);
+    __m128 d = _mm_mul_ps(dest, inv_255);
+    __m128 alpha = _mm_shuffle_ps(t, t, 0xFF);
+    __m128 linear_texel = _mm_mul_ps(_mm_mul_ps(t, t), _mm_rcp_ps(_mm_max_ps(alpha, _mm_set1_ps(1.0f / 512.0f))));
+    __m128 linear = _mm_min_ps(_mm_add_ps(linear_texel, _mm_mul_ps(_mm_mul_ps(d, d), _mm_sub_ps(one, alpha))), one);
+    __m128 encoded = _mm_mul_ps(linear, _mm_rsqrt_ps(_mm_max_ps(linear, _mm_set1_ps(1.0e-8f))));
+    return _mm_mul_ps(encoded, _mm_set1_ps(255.0f));
+}
+
+inline __m128i TexturedBlendLinearHalf(__m128i texel, __m128i dest)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128 pixel0 = BlendLinearPixel(_mm_cvtepi32_ps(_mm_unpacklo_epi16(texel, zero)),
+                                     _mm_cvtepi32_ps(_mm_unpacklo_epi16(dest, zero)));
+    __m128 pixel1 = BlendLinearPixel(_mm_cvtepi32_ps(_mm_unpackhi_epi16(texel, zero)),
+                                     _mm_cvtepi32_ps(_mm_unpackhi_epi16(dest, zero)));
+    return _mm_packs_epi32(_mm_cvtps_epi32(pixel0), _mm_cvtps_epi32(pixel1));
+}
+
+/* NOTE: four pixels at a time. SSE2 can't gather, the texels a group needs are eight 64 bit loads,
+   everything else is lanes. Pixels past the right edge of the buffer never get read or written:
+   a group that hangs off it goes through a copy on the stack.
+*/
+template<bool32 IsGammaCorrect>
+internal void DrawRectangleTexturedSSE2(offscreen_graphics_buffer *buffer, render_texture *texture,
+                                        textured_rectangle_setup *setup)
+{
+    __m128i zero_i = _mm_setzero_si128();
+    __m128i fraction_mask = _mm_set1_epi32((1 << TEXTURED_FRACTION_BITS) - 1);
+    __m128 texel_scale_x = _mm_set1_ps(setup->TexelScaleX*(1 << TEXTURED_FRACTION_BITS));
+    __m128 texel_scale_y = _mm_set1_ps(setup->TexelScaleY*(1 << TEXTURED_FRACTION_BITS));
+    __m128i texture_pitch = _mm_set1_epi32((texture->Pitch << 16) | 1);
+    __m128 nx_x = _mm_set1_ps(setup->NX.x);
+    __m128 nx_y = _mm_set1_ps(setup->NX.y);
+    __m128 ny_x = _mm_set1_ps(setup->NY.x);
+    __m128 ny_y = _mm_set1_ps(setup->NY.y);
+    __m128 u_step = _mm_set1_ps(4.0f*setup->NX.x);
+    __m128 v_step = _mm_set1_ps(4.0f*setup->NY.x);
+    uint32 *texels = texture->Texels;
+    int32 pitch = texture->Pitch;
+
+    for(int32 y = setup->MinY; y < setup->MaxY; ++y)
+    {
+        __m128 d_y = _mm_set1_ps((real32)y + 0.5f - setup->Origin.y);
+        int32 first_x;
+        int32 end_x;
+        GetTexturedRowSpan(setup, y, &first_x, &end_x);
+
+        __m128 d_x = _mm_add_ps(_mm_set1_ps((real32)first_x + 0.5f - setup->Origin.x),
+                                _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+        __m128 u = _mm_add_ps(_mm_mul_ps(d_x, nx_x), _mm_mul_ps(d_y, nx_y));
+        __m128 v = _mm_add_ps(_mm_mul_ps(d_x, ny_x), _mm_mul_ps(d_y, ny_y));
+
+        uint32 *row = GetPixelRow<PixelFormat_BGRX8>(buffer, y);
+        for(int32 x = first_x; x < end_x; x += 4)
+        {
+            int32 remaining = end_x - x;
+            __m128i write_mask = _mm_loadu_si128((__m128i *)TexturedColumnMasks[remaining < 4 ? remaining : 4]);
+            __m128i tx = _mm_cvttps_epi32(_mm_mul_ps(u, texel_scale_x));
+            __m128i ty = _mm_cvttps_epi32(_mm_mul_ps(v, texel_scale_y));
+            __m128i wx = _mm_and_si128(tx, fraction_mask);
+            __m128i wy = _mm_and_si128(ty, fraction_mask);
+
+            // NOTE: SSE2 has no 32 bit multiply, but x | y << 16 times 1 | pitch << 16 is one pmaddwd.
+            // Lanes past the end of the span could be anywhere, they fetch texel 0 instead
+            __m128i fetch = _mm_or_si128(_mm_srli_epi32(tx, TEXTURED_FRACTION_BITS),
+                                         _mm_slli_epi32(_mm_srli_epi32(ty, TEXTURED_FRACTION_BITS), 16));
+            int32 texel_index[4];
+            _mm_storeu_si128((__m128i *)texel_index, _mm_and_si128(_mm_madd_epi16(fetch, texture_pitch), write_mask));
+
+            // NOTE: a texel and its right neighbour are one 64 bit load, a0 b0 a1 b1 and a2 b2 a3 b3
+            uint32 *t0 = texels + texel_index[0];
+            uint32 *t1 = texels + texel_index[1];
+            uint32 *t2 = texels + texel_index[2];
+            uint32 *t3 = texels + texel_index[3];
+            __m128i ab01 = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i *)t0), _mm_loadl_epi64((__m128i *)t1));
+            __m128i ab23 = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i *)t2), _mm_loadl_epi64((__m128i *)t3));
+            __m128i cd01 = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i *)(t0 + pitch)),
+                                              _mm_loadl_epi64((__m128i *)(t1 + pitch)));
+            __m128i cd23 = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i *)(t2 + pitch)),
+                                              _mm_loadl_epi64((__m128i *)(t3 + pitch)));
+
+            uint32 *pixel = row + x;
+            uint32 edge_pixels[4];
+            bool32 is_past_edge = (x + 4 > buffer->Width);
+            if(is_past_edge)
+            {
+                for(int32 lane_idx = 0; lane_idx < 4; ++lane_idx)
+                {
+                    edge_pixels[lane_idx] = (x + lane_idx < buffer->Width) ? pixel[lane_idx] : 0;
+                }
+            }
+            __m128i original = _mm_loadu_si128((__m128i *)(is_past_edge ? edge_pixels : pixel));
+
+            // NOTE: w0 w1 w2 w3 -> w0 w0 w0 w0 w1 w1 w1 w1 and w2 w2 w2 w2 w3 w3 w3 w3
+            __m128i wx16 = _mm_packs_epi32(wx, wx);
+            __m128i wy16 = _mm_packs_epi32(wy, wy);
+            wx16 = _mm_unpacklo_epi16(wx16, wx16);
+            wy16 = _mm_unpacklo_epi16(wy16, wy16);
+
+            __m128i texel_lo = TexturedFilterPairs(ab01, cd01, _mm_unpacklo_epi32(wx16, wx16), _mm_unpacklo_epi32(wy16, wy16));
+            __m128i texel_hi = TexturedFilterPairs(ab23, cd23, _mm_unpackhi_epi32(wx16, wx16), _mm_unpackhi_epi32(wy16, wy16));
+            __m128i out;
+            if(IsGammaCorrect)
+            {
+                out = _mm_packus_epi16(TexturedBlendLinearHalf(texel_lo, _mm_unpacklo_epi8(original, zero_i)),
+                                       TexturedBlendLinearHalf(texel_hi, _mm_unpackhi_epi8(original, zero_i)));
+            }
+            else
+            {
+                out = _mm_packus_epi16(TexturedBlendHalf(texel_lo, _mm_unpacklo_epi8(original, zero_i)),
+                                       TexturedBlendHalf(texel_hi, _mm_unpackhi_epi8(original, zero_i)));
+            }
+
+            __m128i result = _mm_or_si128(_mm_and_si128(write_mask, out), _mm_andnot_si128(write_mask, original));
+            if(is_past_edge)
+            {
+                _mm_storeu_si128((__m128i *)edge_pixels, result);
+                for(int32 lane_idx = 0; x + lane_idx < buffer->Width; ++lane_idx)
+                {
+                    pixel[lane_idx] = edge_pixels[lane_idx];
+                }
+            }
+            else
+            {
+                _mm_storeu_si128((__m128i *)pixel, result);
+            }
+
+            u = _mm_add_ps(u, u_step);
+            v = _mm_add_ps(v, v_step);
+        }
+    }
+}
+
+/* NOTE: AVX2 has pmaddubsw, which does a whole horizontal lerp in one go once each texel's bytes are
+   interleaved with its right neighbour's. Its weights are signed bytes, so here they're out of 64:
+   ab and cd are pairs straight from memory, wx is (64 - w) | (w << 8) and wy is w*512 in each pixel's
+   four 16 bit lanes, and the result is back down to 8 bit range.
+*/
+RENDER_TARGET_AVX2
+inline __m256i TexturedFilterPairs8(__m256i ab, __m256i cd, __m256i wx, __m256i wy)
+{
+    __m256i interleave = _mm256_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15,
+                                          0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    __m256i top = _mm256_maddubs_epi16(_mm256_shuffle_epi8(ab, interleave), wx);
+    __m256i bottom = _mm256_maddubs_epi16(_mm256_shuffle_epi8(cd, interleave), wx);
+    __m256i result = _mm256_add_epi16(top, _mm256_mulhrs_epi16(_mm256_sub_epi16(bottom, top), wy));
+    return _mm256_srli_epi16(_mm256_add_epi16(result, _mm256_set1_epi16(32)), 6);
+}
+
+RENDER_TARGET_AVX2
+inline __m256i TexturedBlendHalf8(__m256i texel, __m256i dest)
+{
+    __m256i broadcast_alpha = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15,
+                                               6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+    __m256i inv_alpha = _mm256_sub_epi16(_mm256_set1_epi16(256), _mm256_shuffle_epi8(texel, broadcast_alpha));
+    __m256i scaled = _mm256_srli_epi16(_mm256_mullo_epi16(dest, inv_alpha), 8);
+    return _mm256_add_epi16(texel, scaled);
+}
+
+// NOTE: BlendLinearPixel two pixels at a time, one in each 128 bit half
+RENDER_TARGET_AVX2
+inline __m256 BlendLinearPixels8(__m256 texel, __m256 dest)
+{
+    __m256 inv_255 = _mm256_set1_ps(1.0f / 255.0f);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 t = _mm256_mul_ps(texel, inv_255);
+    __m256 d = _mm256_mul_ps(dest, inv_255);
+    __m256 alpha = _mm256_permute_ps(t, 0xFF);
+    __m256 linear_texel = _mm256_mul_ps(_mm256_mul_ps(t, t),
+                                        _mm256_rcp_ps(_mm256_max_ps(alpha, _mm256_set1_ps(1.0f / 512.0f))));
+    __m256 linear = _mm256_min_ps(_mm256_add_ps(linear_texel, _mm256_mul_ps(_mm256_mul_ps(d, d), _mm256_sub_ps(one, alpha))),
+                                  one);
+    __m256 encoded = _mm256_mul_ps(linear, _mm256_rsqrt_ps(_mm256_max_ps(linear, _mm256_set1_ps(1.0e-8f))));
+    return _mm256_mul_ps(encoded, _mm256_set1_ps(255.0f));
+}
+
+RENDER_TARGET_AVX2
+inline __m256i TexturedBlendLinearHalf8(__m256i texel, __m256i dest)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256 pixels0 = BlendLinearPixels8(_mm256_cvtepi32_ps(_mm256_unpacklo_epi16(texel, zero)),
+                                        _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(dest, zero)));
+    __m256 pixels1 = BlendLinearPixels8(_mm256_cvtepi32_ps(_mm256_unpackhi_epi16(texel, zero)),
+                                        _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(dest, zero)));
+    return _mm256_packs_epi32(_mm256_cvtps_epi32(pixels0), _mm256_cvtps_epi32(pixels1));
+}
+
+/* NOTE: the SSE2 path eight wide, with the texels gathered. The byte unpacks and the pack at the end
+   work within each 128 bit half, so the filter runs on pixels 0 1 | 4 5 and 2 3 | 6 7: that way the
+   only shuffle that crosses the halves is the one putting the gather indices in that order.
+*/
+template<bool32 IsGammaCorrect>
+RENDER_TARGET_AVX2
+internal void DrawRectangleTexturedAVX2(offscreen_graphics_buffer *buffer, render_texture *texture,
+                                        textured_rectangle_setup *setup)
+{
+    __m256i weight_sum = _mm256_set1_epi32(64);
+    __m256i fraction_mask = _mm256_set1_epi32(63);
+    __m256i zero_i = _mm256_setzero_si256();
+    __m256 texel_scale_x = _mm256_set1_ps(setup->TexelScaleX*64.0f);
+    __m256 texel_scale_y = _mm256_set1_ps(setup->TexelScaleY*64.0f);
+    __m256i texture_pitch = _mm256_set1_epi32(texture->Pitch);
+    __m256 nx_x = _mm256_set1_ps(setup->NX.x);
+    __m256 nx_y = _mm256_set1_ps(setup->NX.y);
+    __m256 ny_x = _mm256_set1_ps(setup->NY.x);
+    __m256 ny_y = _mm256_set1_ps(setup->NY.y);
+    __m256 u_step = _mm256_set1_ps(8.0f*setup->NX.x);
+    __m256 v_step = _mm256_set1_ps(8.0f*setup->NY.x);
+    long long const *texels = (long long const *)texture->Texels;
+
+    // NOTE: a 32 bit weight's low 16 bits spread over the four channels of its pixel, first or second
+    // pixel of each 64 bits
+    __m256i spread_first = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5,
+                                            0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5);
+    __m256i spread_second = _mm256_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13,
+                                             8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13);
+
+    for(int32 y = setup->MinY; y < setup->MaxY; ++y)
+    {
+        __m256 d_y = _mm256_set1_ps((real32)y + 0.5f - setup->Origin.y);
+        int32 first_x;
+        int32 end_x;
+        GetTexturedRowSpan(setup, y, &first_x, &end_x);
+
+        __m256 d_x = _mm256_add_ps(_mm256_set1_ps((real32)first_x + 0.5f - setup->Origin.x),
+                                   _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+        __m256 u = _mm256_add_ps(_mm256_mul_ps(d_x, nx_x), _mm256_mul_ps(d_y, nx_y));
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(d_x, ny_x), _mm256_mul_ps(d_y, ny_y));
+
+        uint32 *row = GetPixelRow<PixelFormat_BGRX8>(buffer, y);
+        for(int32 x = first_x; x < end_x; x += 8)
+        {
+            int32 remaining = end_x - x;
+            __m256i write_mask = _mm256_loadu_si256((__m256i *)TexturedColumnMasks[remaining < 8 ? remaining : 8]);
+            __m256i tx = _mm256_cvttps_epi32(_mm256_mul_ps(u, texel_scale_x));
+            __m256i ty = _mm256_cvttps_epi32(_mm256_mul_ps(v, texel_scale_y));
+            __m256i wx = _mm256_and_si256(tx, fraction_mask);
+            __m256i wy = _mm256_and_si256(ty, fraction_mask);
+            wx = _mm256_or_si256(_mm256_sub_epi32(weight_sum, wx), _mm256_slli_epi32(wx, 8));
+            wy = _mm256_slli_epi32(wy, 9);
+
+            // NOTE: each texel comes with its right neighbour as one 64 bit element,
+            // a0 b0 a1 b1 | a4 b4 a5 b5 from the first gather and pixels 2 3 | 6 7 from the second
+            // NOTE: lanes past the end of the span could be anywhere, they fetch texel 0 instead
+            __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(ty, 6), texture_pitch),
+                                             _mm256_srli_epi32(tx, 6));
+            index = _mm256_permute4x64_epi64(_mm256_and_si256(index, write_mask), 0xD8);
+            __m256i index_below = _mm256_add_epi32(index, texture_pitch);
+            __m256i ab0145 = _mm256_i32gather_epi64(texels, _mm256_castsi256_si128(index), 4);
+            __m256i ab2367 = _mm256_i32gather_epi64(texels, _mm256_extracti128_si256(index, 1), 4);
+            __m256i cd0145 = _mm256_i32gather_epi64(texels, _mm256_castsi256_si128(index_below), 4);
+            __m256i cd2367 = _mm256_i32gather_epi64(texels, _mm256_extracti128_si256(index_below, 1), 4);
+
+            uint32 *pixel = row + x;
+            uint32 edge_pixels[8];
+            bool32 is_past_edge = (x + 8 > buffer->Width);
+            if(is_past_edge)
+            {
+                for(int32 lane_idx = 0; lane_idx < 8; ++lane_idx)
+                {
+                    edge_pixels[lane_idx] = (x + lane_idx < buffer->Width) ? pixel[lane_idx] : 0;
+                }
+            }
+            __m256i original = _mm256_loadu_si256((__m256i *)(is_past_edge ? edge_pixels : pixel));
+
+            __m256i texel_lo = TexturedFilterPairs8(ab0145, cd0145, _mm256_shuffle_epi8(wx, spread_first),
+                                                    _mm256_shuffle_epi8(wy, spread_first));
+            __m256i texel_hi = TexturedFilterPairs8(ab2367, cd2367, _mm256_shuffle_epi8(wx, spread_second),
+                                                    _mm256_shuffle_epi8(wy, spread_second));
+            __m256i out;
+            if(IsGammaCorrect)
+            {
+                out = _mm256_packus_epi16(TexturedBlendLinearHalf8(texel_lo, _mm256_unpacklo_epi8(original, zero_i)),
+                                          TexturedBlendLinearHalf8(texel_hi, _mm256_unpackhi_epi8(original, zero_i)));
+            }
+            else
+            {
+                out = _mm256_packus_epi16(TexturedBlendHalf8(texel_lo, _mm256_unpacklo_epi8(original, zero_i)),
+                                          TexturedBlendHalf8(texel_hi, _mm256_unpackhi_epi8(original, zero_i)));
+            }
+
+            __m256i result = (remaining < 8) ? _mm256_blendv_epi8(original, out, write_mask) : out;
+            if(is_past_edge)
+            {
+                _mm256_storeu_si256((__m256i *)edge_pixels, result);
+                for(int32 lane_idx = 0; x + lane_idx < buffer->Width; ++lane_idx)
+                {
+                    pixel[lane_idx] = edge_pixels[lane_idx];
+                }
+            }
+            else
+            {
+                _mm256_storeu_si256((__m256i *)pixel, result);
+            }
+
+            u = _mm256_add_ps(u, u_step);
+            v = _mm256_add_ps(v, v_step);
+        }
+    }
+}
+
+/* NOTE: draw texture stretched over the rectangle origin + s*x_axis + t*y_axis, s and t in [0, 1].
+   The axes don't have to be square to each other or to the screen, so this rotates, scales and
+   shears. The texture is premultiplied and blended over what's there, in linear light when
+   is_gamma_correct.
+*/
+internal void DrawRectangleTextured(offscreen_graphics_buffer *buffer, v2 origin, v2 x_axis, v2 y_axis,
+                                    render_texture *texture, bool32 is_gamma_correct)
+{
+    real32 x_axis_length_sq = LengthSq(x_axis);
+    real32 y_axis_length_sq = LengthSq(y_axis);
+    if((x_axis_length_sq <= 0.0f) || (y_axis_length_sq <= 0.0f) || (texture->Width < 2) || (texture->Height < 2))
+    {
+        return;
+    }
+
+    textured_rectangle_setup setup = {};
+    v2 corners[4] = {origin, origin + x_axis, origin + y_axis, origin + x_axis + y_axis};
+    real32 min_x = corners[0].x;
+    real32 min_y = corners[0].y;
+    real32 max_x = corners[0].x;
+    real32 max_y = corners[0].y;
+    for(int corner_idx = 1; corner_idx < 4; ++corner_idx)
+    {
+        v2 corner = corners[corner_idx];
+        if(corner.x < min_x) min_x = corner.x;
+        if(corner.y < min_y) min_y = corner.y;
+        if(corner.x > max_x) max_x = corner.x;
+        if(corner.y > max_y) max_y = corner.y;
+    }
+
+    setup.MinX = (min_x > 0.0f) ? (int32)floorf(min_x) : 0;
+    setup.MinY = (min_y > 0.0f) ? (int32)floorf(min_y) : 0;
+    setup.MaxX = (max_x < (real32)buffer->Width) ? (int32)ceilf(max_x) : buffer->Width;
+    setup.MaxY = (max_y < (real32)buffer->Height) ? (int32)ceilf(max_y) : buffer->Height;
+    if((setup.MinX >= setup.MaxX) || (setup.MinY >= setup.MaxY))
+    {
+        return;
+    }
+
+    setup.Origin = origin;
+    setup.NX = (1.0f / x_axis_length_sq)*x_axis;
+    setup.NY = (1.0f / y_axis_length_sq)*y_axis;
+    setup.TexelScaleX = (real32)(texture->Width - 2);
+    setup.TexelScaleY = (real32)(texture->Height - 2);
+    setup.IsGammaCorrect = is_gamma_correct;
+    Assert(texture->Pitch < 32768);
+
+    if(buffer->Format == PixelFormat_BGRX8)
+    {
+        if(RenderHasAVX2())
+        {
+            if(is_gamma_correct)
+            {
+                DrawRectangleTexturedAVX2<true>(buffer, texture, &setup);
+            }
+            else
+            {
+                DrawRectangleTexturedAVX2<false>(buffer, texture, &setup);
+            }
+        }
+        else
+        {
+            if(is_gamma_correct)
+            {
+                DrawRectangleTexturedSSE2<true>(buffer, texture, &setup);
+            }
+            else
+            {
+                DrawRectangleTexturedSSE2<false>(buffer, texture, &setup);
+            }
+        }
+    }
+    else
+    {
+        DISPATCH_PIXEL_FORMAT(buffer->Format, DrawRectangleTexturedScalar, buffer, texture, &setup);
+    }
+}
+
+// NOTE: the straight C gamma correct rectangle, for the formats the SSE2 one doesn't write
+template<pixel_format Format>
+internal void BlendRectangleLinear(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y,
+                                   uint32 color)
+{
+    typedef pixel_traits<Format> traits;
+    const real32 *to_linear = SRGB8ToLinearTable;
+    real32 alpha = (real32)(color >> 24)*(1.0f / 255.0f);
+    real32 source_linear[3] =
+    {
+        to_linear[(color >> 16) & 0xFF]*alpha,
+        to_linear[(color >> 8) & 0xFF]*alpha,
+        to_linear[color & 0xFF]*alpha,
+    };
+    for(int y = min_y; y < max_y; ++y)
+    {
+        typename traits::pixel *pixel = GetPixelRow<Format>(buffer, y) + min_x;
+        for(int x = min_x; x < max_x; ++x)
+        {
+            *pixel = traits::Pack(BlendLinear(traits::Unpack(*pixel), source_linear, alpha));
+            ++pixel;
+        }
+    }
+}
+
+/* NOTE: four pixels at a time, each one a float B G R A. The row's last few pixels go through a copy
+   on the stack so nothing past max_x is read or written.
+*/
+internal void BlendRectangleLinearBGRX8(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y,
+                                        uint32 color)
+{
+    const real32 *to_linear = SRGB8ToLinearTable;
+    real32 alpha = (real32)(color >> 24)*(1.0f / 255.0f);
+    __m128 source_linear = _mm_setr_ps(to_linear[color & 0xFF]*alpha, to_linear[(color >> 8) & 0xFF]*alpha,
+                                       to_linear[(color >> 16) & 0xFF]*alpha, alpha);
+    __m128 inv_alpha = _mm_set1_ps(1.0f - alpha);
+    __m128 inv_255 = _mm_set1_ps(1.0f / 255.0f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 tiny = _mm_set1_ps(1.0e-8f);
+    __m128 max_color = _mm_set1_ps(255.0f);
+    __m128i zero = _mm_setzero_si128();
+
+    for(int y = min_y; y < max_y; ++y)
+    {
+        uint32 *row = GetPixelRow<PixelFormat_BGRX8>(buffer, y);
+        for(int x = min_x; x < max_x; x += 4)
+        {
+            uint32 *pixel = row + x;
+            int32 count = (max_x - x < 4) ? (max_x - x) : 4;
+            uint32 edge_pixels[4] = {};
+            for(int32 lane_idx = 0; (count < 4) && (lane_idx < count); ++lane_idx)
+            {
+                edge_pixels[lane_idx] = pixel[lane_idx];
+            }
+
+            __m128i original = _mm_loadu_si128((__m128i *)((count < 4) ? edge_pixels : pixel));
+            __m128i wide[2] = {_mm_unpacklo_epi8(original, zero), _mm_unpackhi_epi8(original, zero)};
+            __m128i blended[2];
+            for(int32 half_idx = 0; half_idx < 2; ++half_idx)
+            {
+                __m128i packed[2];
+                for(int32 pixel_idx = 0; pixel_idx < 2; ++pixel_idx)
+                {
+                    __m128i channels = pixel_idx ? _mm_unpackhi_epi16(wide[half_idx], zero) :
+                                                   _mm_unpacklo_epi16(wide[half_idx], zero);
+                    __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(channels), inv_255);
+                    __m128 linear = _mm_min_ps(_mm_add_ps(source_linear, _mm_mul_ps(_mm_mul_ps(d, d), inv_alpha)), one);
+                    __m128 encoded = _mm_mul_ps(linear, _mm_rsqrt_ps(_mm_max_ps(linear, tiny)));
+                    packed[pixel_idx] = _mm_cvtps_epi32(_mm_mul_ps(encoded, max_color));
+                }
+                blended[half_idx] = _mm_packs_epi32(packed[0], packed[1]);
+            }
+
+            __m128i result = _mm_packus_epi16(blended[0], blended[1]);
+            if(count < 4)
+            {
+                _mm_storeu_si128((__m128i *)edge_pixels, result);
+                for(int32 lane_idx = 0; lane_idx < count; ++lane_idx)
+                {
+                    pixel[lane_idx] = edge_pixels[lane_idx];
+                }
+            }
+            else
+            {
+                _mm_storeu_si128((__m128i *)pixel, result);
+            }
+        }
+    }
+}
+
+// DrawRectangleBlended in linear light
+internal void DrawRectangleBlendedLinear(offscreen_graphics_buffer *buffer, int min_x, int min_y, int max_x, int max_y,
+                                         uint32 color)
+{
+    if(ClipRectangleToBuffer(buffer, &min_x, &min_y, &max_x, &max_y))
+    {
+        if(buffer->Format == PixelFormat_BGRX8)
+        {
+            BlendRectangleLinearBGRX8(buffer, min_x, min_y, max_x, max_y, color);
+        }
+        else
+        {
+            DISPATCH_PIXEL_FORMAT(buffer->Format, BlendRectangleLinear, buffer, min_x, min_y, max_x, max_y, color);
+        }
+    }
+}
+
+internal void BeginRenderGroup(render_group *group, memory_arena *arena, uint32 max_entry_count, bool32 is_gamma_correct)
+{
+    group->IsGammaCorrect = is_gamma_correct;
+    group->MaxEntryCount = max_entry_count;
+    group->EntryCount = 0;
+    group->Entries = PushArrayAligned(arena, max_entry_count, render_entry, 8);
+    group->DroppedCount = 0;
+}
+
+internal render_entry *PushRenderEntry(render_group *group, render_entry_type type)
+{
+    render_entry *result = 0;
+    if(group->EntryCount < group->MaxEntryCount)
+    {
+        result = group->Entries + group->EntryCount++;
+        *result = {};
+        result->Type = type;
+    }
+    else
+    {
+        ++group->DroppedCount;
+    }
+    return result;
+}
+
+// [min, max) in pixels, blended by the color's alpha
+internal void PushRectangle(render_group *group, v2 min, v2 max, uint32 color)
+{
+    render_entry *entry = PushRenderEntry(group, RenderEntry_Rectangle);
+    if(entry)
+    {
+        entry->Color = color;
+        entry->Origin = min;
+        entry->XAxis = V2(max.x - min.x, 0.0f);
+        entry->YAxis = V2(0.0f, max.y - min.y);
+    }
+}
+
+internal void PushTexturedRectangle(render_group *group, v2 origin, v2 x_axis, v2 y_axis, render_texture *texture)
+{
+    render_entry *entry = PushRenderEntry(group, RenderEntry_TexturedRectangle);
+    if(entry)
+    {
+        entry->Origin = origin;
+        entry->XAxis = x_axis;
+        entry->YAxis = y_axis;
+        entry->Texture = texture;
+    }
+}
+
+// draw everything pushed since BeginRenderGroup, in the order it was pushed
+internal void EndRenderGroup(render_group *group, offscreen_graphics_buffer *buffer)
+{
+    for(uint32 entry_idx = 0; entry_idx < group->EntryCount; ++entry_idx)
+    {
+        render_entry *entry = group->Entries + entry_idx;
+        switch(entry->Type)
+        {
+            case RenderEntry_Rectangle:
+            {
+                int min_x = (int)entry->Origin.x;
+                int min_y = (int)entry->Origin.y;
+                int max_x = (int)(entry->Origin.x + entry->XAxis.x);
+                int max_y = (int)(entry->Origin.y + entry->YAxis.y);
+                if((entry->Color >> 24) == 0xFF)
+                {
+                    DrawRectangle(buffer, min_x, min_y, max_x, max_y, entry->Color);
+                }
+                else if(group->IsGammaCorrect)
+                {
+                    DrawRectangleBlendedLinear(buffer, min_x, min_y, max_x, max_y, entry->Color);
+                }
+                else
+                {
+                    DrawRectangleBlended(buffer, min_x, min_y, max_x, max_y, entry->Color);
+                }
+            } break;
+
+            case RenderEntry_TexturedRectangle:
+            {
+                DrawRectangleTextured(buffer, entry->Origin, entry->XAxis, entry->YAxis, entry->Texture,
+                                      group->IsGammaCorrect);
+            } break;
+
+            default:
+            {
+                Assert(!"unknown render entry");
+            } break;
+        }
+    }
+    group->EntryCount = 0;
+}
@@ -0,0 +1,62 @@
+/*
+
+  Software renderer. Draws textured rectangles with any rotation and
+  scale into an offscreen_graphics_buffer: the rectangle is an origin
+  plus an x and a y axis, only the pixels inside the axes' bounding box
+  are visited, and the texel coordinates are stepped along with the
+  pixels instead of being worked out from scratch.
+
+  Textures are bilinear filtered and blended four pixels at a time with
+  SSE2, or eight at a time with AVX2 gathers when the processor has them.
+
+  Drawing goes through render groups: entries are pushed during the
+  frame and drawn in order when the group ends. A group either blends on
+  the stored bytes as they are, or gamma correctly: colors are decoded to
+  linear light (gamma taken as 2, the same as Float32Linear), blended in
+  float and encoded back with a square root.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_RENDER_H)
+
+// NOTE: 0xAARRGGBB with premultiplied alpha, the same layout as a BGRX8 buffer with the padding used
+struct render_texture
+{
+    int32 Width;
+    int32 Height;
+    int32 Pitch; // NOTE: in texels
+    uint32 *Texels;
+};
+
+enum render_entry_type
+{
+    RenderEntry_Rectangle,
+    RenderEntry_TexturedRectangle,
+};
+
+// NOTE: rectangles are Origin up to Origin + XAxis + YAxis with the axes along x and y
+struct render_entry
+{
+    render_entry_type Type;
+    uint32 Color; // NOTE: 0xAARRGGBB, straight alpha, rectangles only
+    v2 Origin;
+    v2 XAxis;
+    v2 YAxis;
+    render_texture *Texture;
+};
+
+struct render_group
+{
+    bool32 IsGammaCorrect;
+
+    uint32 MaxEntryCount;
+    uint32 EntryCount;
+    render_entry *Entries;
+
+    uint32 DroppedCount; // NOTE: past MaxEntryCount
+};
+
+#define APPLICATION_RENDER_H
+#endif
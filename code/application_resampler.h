@@ -0,0 +1,259 @@
+/*
+
+  Resampler. Converts interleaved stereo 16 bit audio from one rate to any
+  other with a polyphase windowed sinc filter. The filter is tabulated at
+  RESAMPLER_PHASE_COUNT fractional offsets and every output frame lerps
+  between the two nearest, so the ratio doesn't have to be a nice fraction.
+
+  It streams: ask how many input frames the next N output frames need, hand
+  exactly that many over and get exactly N back. The last TapCount input
+  frames are kept around between calls so block edges don't click.
+
+  Header only so the platform's device path and the application's per sound
+  conversion use the same code.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_RESAMPLER_H)
+
+#include <emmintrin.h>
+
+enum resampler_quality
+{
+    ResamplerQuality_Low,
+    ResamplerQuality_Medium,
+    ResamplerQuality_High,
+
+    ResamplerQuality_Count,
+};
+
+global_variable char *ResamplerQualityNames[ResamplerQuality_Count] = {"low", "medium", "high"};
+
+// NOTE: taps per output frame, a multiple of 4 for the SIMD loop
+global_variable int ResamplerTapCounts[ResamplerQuality_Count] = {8, 16, 32};
+
+// NOTE: more taps buy a steeper transition band, so the passband can go closer to nyquist
+global_variable real32 ResamplerPassbands[ResamplerQuality_Count] = {0.80f, 0.88f, 0.92f};
+global_variable real32 ResamplerKaiserBetas[ResamplerQuality_Count] = {5.0f, 7.0f, 9.0f};
+
+#define RESAMPLER_PHASE_COUNT 256
+#define RESAMPLER_MAX_TAP_COUNT 32
+
+struct resampler
+{
+    uint32 InputRate;
+    uint32 OutputRate;
+    resampler_quality Quality;
+    int TapCount;
+
+    uint64 Step; // NOTE: 32.32 fixed point, input frames per output frame
+    uint64 Position; // NOTE: 32.32 fixed point, where the next output frame falls in Left/Right
+
+    // NOTE: RESAMPLER_PHASE_COUNT + 1 rows of TapCount, the extra row lets the last phase lerp too
+    real32 *Coefficients;
+
+    // NOTE: planar, TapCount frames of history followed by the frames handed to the current call
+    int MaxInputFrameCount;
+    real32 *Left;
+    real32 *Right;
+};
+
+inline uint64 ResamplerMemorySize(resampler_quality quality, int max_input_frame_count)
+{
+    int tap_count = ResamplerTapCounts[quality];
+    uint64 result = (RESAMPLER_PHASE_COUNT + 1)*tap_count*sizeof(real32) +
+        2*(tap_count + max_input_frame_count)*sizeof(real32) + 3*16;
+    return result;
+}
+
+// zeroth order modified bessel function of the first kind, for the kaiser window
+internal real64 ResamplerBesselI0(real64 x)
+{
+    real64 result = 1.0;
+    real64 term = 1.0;
+    real64 half_x_squared = 0.25*x*x;
+    for(int k = 1; k < 32; ++k)
+    {
+        term *= half_x_squared / (real64)(k*k);
+        result += term;
+    }
+    return result;
+}
+
+inline real32 *ResamplerAlign16(uint8 **at)
+{
+    uint8 *result = (uint8 *)(((uintptr_t)*at + 15) & ~(uintptr_t)15);
+    return (real32 *)result;
+}
+
+// memory has to be ResamplerMemorySize bytes, max_input_frame_count bounds a single call
+internal void InitializeResampler(resampler *resampler, void *memory, uint32 input_rate, uint32 output_rate,
+                                  resampler_quality quality, int max_input_frame_count)
+{
+    int tap_count = ResamplerTapCounts[quality];
+    Assert((tap_count % 4) == 0);
+    Assert(tap_count <= RESAMPLER_MAX_TAP_COUNT);
+
+    resampler->InputRate = input_rate;
+    resampler->OutputRate = output_rate;
+    resampler->Quality = quality;
+    resampler->TapCount = tap_count;
+    resampler->Step = ((uint64)input_rate << 32) / output_rate;
+    resampler->Position = (uint64)(tap_count/2 - 1) << 32;
+    resampler->MaxInputFrameCount = max_input_frame_count;
+
+    uint8 *at = (uint8 *)memory;
+    resampler->Coefficients = ResamplerAlign16(&at);
+    at = (uint8 *)(resampler->Coefficients + (RESAMPLER_PHASE_COUNT + 1)*tap_count);
+    resampler->Left = ResamplerAlign16(&at);
+    at = (uint8 *)(resampler->Left + tap_count + max_input_frame_count);
+    resampler->Right = ResamplerAlign16(&at);
+
+    for(int frame_idx = 0; frame_idx < tap_count; ++frame_idx)
+    {
+        resampler->Left[frame_idx] = 0.0f;
+        resampler->Right[frame_idx] = 0.0f;
+    }
+
+    // NOTE: when going down in rate the cutoff has to drop to the output's nyquist
+    real64 ratio = (output_rate < input_rate) ? (real64)output_rate / (real64)input_rate : 1.0;
+    real64 cutoff = 0.5*ratio*ResamplerPassbands[quality]; // NOTE: in cycles per input frame
+    real64 beta = ResamplerKaiserBetas[quality];
+    real64 inv_i0_beta = 1.0 / ResamplerBesselI0(beta);
+    real64 half_width = 0.5*tap_count;
+
+    for(int phase_idx = 0; phase_idx <= RESAMPLER_PHASE_COUNT; ++phase_idx)
+    {
+        real64 fraction = (real64)phase_idx / (real64)RESAMPLER_PHASE_COUNT;
+        real32 *row = resampler->Coefficients + phase_idx*tap_count;
+
+        real64 sum = 0.0;
+        for(int tap_idx = 0; tap_idx < tap_count; ++tap_idx)
+        {
+            // NOTE: tap 0 sits TapCount/2 - 1 frames before the output frame's whole position
+            real64 distance = (real64)(tap_idx - (tap_count/2 - 1)) - fraction;
+            real64 x = 2.0*cutoff*distance;
+            real64 sinc = (x == 0.0) ? 1.0 : sin(Pi32*x) / (Pi32*x);
+
+            real64 window = 0.0;
+            real64 normalized = distance / half_width;
+            if((normalized > -1.0) && (normalized < 1.0))
+            {
+                window = ResamplerBesselI0(beta*sqrt(1.0 - normalized*normalized))*inv_i0_beta;
+            }
+
+            real64 coefficient = 2.0*cutoff*sinc*window;
+            row[tap_idx] = (real32)coefficient;
+            sum += coefficient;
+        }
+
+        // NOTE: unity gain at DC for every phase, otherwise the phases ripple against each other
+        for(int tap_idx = 0; tap_idx < tap_count; ++tap_idx)
+        {
+            row[tap_idx] = (real32)(row[tap_idx] / sum);
+        }
+    }
+}
+
+// how many input frames the next output_frame_count output frames need
+inline int ResamplerInputFramesNeeded(resampler *resampler, int output_frame_count)
+{
+    int result = output_frame_count;
+    if(resampler->InputRate != resampler->OutputRate)
+    {
+        result = 0;
+        if(output_frame_count > 0)
+        {
+            uint64 last_position = resampler->Position + (uint64)(output_frame_count - 1)*resampler->Step;
+            int64 needed = (int64)(last_position >> 32) - (resampler->TapCount/2 - 1);
+            if(needed > 0)
+            {
+                result = (int)needed;
+            }
+        }
+    }
+    return result;
+}
+
+// input_frame_count must be what ResamplerInputFramesNeeded asked for
+internal void ResampleStereo(resampler *resampler, int16 *input, int input_frame_count,
+                             int16 *output, int output_frame_count)
+{
+    Assert(input_frame_count == ResamplerInputFramesNeeded(resampler, output_frame_count));
+    Assert(input_frame_count <= resampler->MaxInputFrameCount);
+
+    if(resampler->InputRate == resampler->OutputRate)
+    {
+        for(int sample_idx = 0; sample_idx < 2*output_frame_count; ++sample_idx)
+        {
+            output[sample_idx] = input[sample_idx];
+        }
+        return;
+    }
+
+    int tap_count = resampler->TapCount;
+    real32 *left = resampler->Left;
+    real32 *right = resampler->Right;
+
+    // NOTE: split the new frames out behind the history, still in 16 bit units
+    for(int frame_idx = 0; frame_idx < input_frame_count; ++frame_idx)
+    {
+        left[tap_count + frame_idx] = (real32)input[2*frame_idx + 0];
+        right[tap_count + frame_idx] = (real32)input[2*frame_idx + 1];
+    }
+
+    uint64 position = resampler->Position;
+    uint64 step = resampler->Step;
+    for(int frame_idx = 0; frame_idx < output_frame_count; ++frame_idx)
+    {
+        uint32 whole = (uint32)(position >> 32);
+        uint64 phase_position = (position & 0xFFFFFFFF)*RESAMPLER_PHASE_COUNT;
+        uint32 phase_idx = (uint32)(phase_position >> 32);
+        __m128 t_4x = _mm_set1_ps((real32)(uint32)phase_position * (1.0f / 4294967296.0f));
+
+        real32 *c0 = resampler->Coefficients + phase_idx*tap_count;
+        real32 *c1 = c0 + tap_count;
+        real32 *l = left + whole - (tap_count/2 - 1);
+        real32 *r = right + whole - (tap_count/2 - 1);
+
+        __m128 left_sum_4x = _mm_setzero_ps();
+        __m128 right_sum_4x = _mm_setzero_ps();
+        for(int tap_idx = 0; tap_idx < tap_count; tap_idx += 4)
+        {
+            __m128 a = _mm_load_ps(c0 + tap_idx);
+            __m128 b = _mm_load_ps(c1 + tap_idx);
+            __m128 c = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t_4x));
+            left_sum_4x = _mm_add_ps(left_sum_4x, _mm_mul_ps(c, _mm_loadu_ps(l + tap_idx)));
+            right_sum_4x = _mm_add_ps(right_sum_4x, _mm_mul_ps(c, _mm_loadu_ps(r + tap_idx)));
+        }
+
+        // NOTE: fold both sums at once, ends up as {left, right, left, right}
+        __m128 lo = _mm_unpacklo_ps(left_sum_4x, right_sum_4x);
+        __m128 hi = _mm_unpackhi_ps(left_sum_4x, right_sum_4x);
+        __m128 sum = _mm_add_ps(lo, hi);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+        // NOTE: packs saturates, so overshoot past full scale clips instead of wrapping
+        __m128i sum_16 = _mm_packs_epi32(_mm_cvtps_epi32(sum), _mm_setzero_si128());
+        *(int32 *)(output + 2*frame_idx) = _mm_cvtsi128_si32(sum_16);
+
+        position += step;
+    }
+
+    // NOTE: keep the last TapCount frames as history for the next call
+    if(input_frame_count)
+    {
+        for(int frame_idx = 0; frame_idx < tap_count; ++frame_idx)
+        {
+            left[frame_idx] = left[input_frame_count + frame_idx];
+            right[frame_idx] = right[input_frame_count + frame_idx];
+        }
+        position -= (uint64)input_frame_count << 32;
+    }
+    resampler->Position = position;
+}
+
+#define APPLICATION_RESAMPLER_H
+#endif
@@ -0,0 +1,178 @@
+/*
+
+  Saved files. Platform.SaveFile never writes over the file it is saving:
+  the data goes into filename.tmp with a footer after it, the temp file is
+  flushed all the way to the disk and only then renamed over filename, so
+  after a crash filename is either all of the old save or all of the new
+  one. The save it replaces is kept as filename.prev.
+
+  The footer holds the size of the data and a checksum of it, loading
+  checks both and treats a file that fails as torn. The footer goes after
+  the data instead of in front of it so the data starts at the start of
+  the file, wherever the data needs its pages to line up they still do.
+
+      data | saved_file_footer
+
+  Nothing in here is platform specific, both platform layers write and
+  check saved files with it.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_SAVED_FILE_H)
+
+#define SAVED_FILE_MAGIC 0x45564153 // NOTE: "SAVE"
+#define SAVED_FILE_VERSION 1
+#define SAVED_FILE_MAX_FILENAME 512
+
+struct saved_file_footer
+{
+    uint64 DataSize;
+    uint64 Checksum;
+    uint32 Magic;
+    uint32 Version;
+};
+
+#define SAVED_FILE_PRIME_1 0x9E3779B185EBCA87ULL
+#define SAVED_FILE_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define SAVED_FILE_PRIME_3 0x165667B19E3779F9ULL
+#define SAVED_FILE_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define SAVED_FILE_PRIME_5 0x27D4EB2F165667C5ULL
+
+inline uint64 SavedFileRotate(uint64 value, uint32 shift)
+{
+    uint64 result = (value << shift) | (value >> (64 - shift));
+    return result;
+}
+
+inline uint64 SavedFileRound(uint64 lane, uint64 value)
+{
+    lane += value*SAVED_FILE_PRIME_2;
+    lane = SavedFileRotate(lane, 31);
+    lane *= SAVED_FILE_PRIME_1;
+    return lane;
+}
+
+// NOTE: x86 only, unaligned loads are fine and the bytes are already little endian
+inline uint64 SavedFileRead64(uint8 *at)
+{
+    uint64 result = *(uint64 *)at;
+    return result;
+}
+
+// NOTE: xxHash64's layout, four independent lanes over 32 byte stripes so the checksum
+// runs at memory speed instead of waiting on one multiply chain
+internal uint64 SavedFileChecksum(void *data, uint64 size)
+{
+    uint8 *at = (uint8 *)data;
+    uint8 *end = at + size;
+
+    uint64 result;
+    if(size >= 32)
+    {
+        uint64 lanes[4] =
+        {
+            SAVED_FILE_PRIME_1 + SAVED_FILE_PRIME_2,
+            SAVED_FILE_PRIME_2,
+            0,
+            0 - SAVED_FILE_PRIME_1,
+        };
+        while((end - at) >= 32)
+        {
+            for(int lane_idx = 0; lane_idx < 4; ++lane_idx)
+            {
+                lanes[lane_idx] = SavedFileRound(lanes[lane_idx], SavedFileRead64(at + 8*lane_idx));
+            }
+            at += 32;
+        }
+
+        result = (SavedFileRotate(lanes[0], 1) + SavedFileRotate(lanes[1], 7) +
+                  SavedFileRotate(lanes[2], 12) + SavedFileRotate(lanes[3], 18));
+        for(int lane_idx = 0; lane_idx < 4; ++lane_idx)
+        {
+            result ^= SavedFileRound(0, lanes[lane_idx]);
+            result = result*SAVED_FILE_PRIME_1 + SAVED_FILE_PRIME_4;
+        }
+    }
+    else
+    {
+        result = SAVED_FILE_PRIME_5;
+    }
+    result += size;
+
+    while((end - at) >= 8)
+    {
+        result ^= SavedFileRound(0, SavedFileRead64(at));
+        result = SavedFileRotate(result, 27)*SAVED_FILE_PRIME_1 + SAVED_FILE_PRIME_4;
+        at += 8;
+    }
+    while(at < end)
+    {
+        result ^= (*at++)*SAVED_FILE_PRIME_5;
+        result = SavedFileRotate(result, 11)*SAVED_FILE_PRIME_1;
+    }
+
+    result ^= result >> 33;
+    result *= SAVED_FILE_PRIME_2;
+    result ^= result >> 29;
+    result *= SAVED_FILE_PRIME_3;
+    result ^= result >> 32;
+    return result;
+}
+
+inline saved_file_footer MakeSavedFileFooter(void *data, uint64 size)
+{
+    saved_file_footer result = {};
+    result.DataSize = size;
+    result.Checksum = SavedFileChecksum(data, size);
+    result.Magic = SAVED_FILE_MAGIC;
+    result.Version = SAVED_FILE_VERSION;
+    return result;
+}
+
+// the size of the data in a whole saved file, 0 when the file is torn or isn't a saved file
+internal uint64 GetSavedFileDataSize(void *file, uint64 file_size)
+{
+    uint64 result = 0;
+    if(file_size >= sizeof(saved_file_footer))
+    {
+        uint64 data_size = file_size - sizeof(saved_file_footer);
+        saved_file_footer *footer = (saved_file_footer *)((uint8 *)file + data_size);
+        if((footer->Magic == SAVED_FILE_MAGIC) &&
+           (footer->Version == SAVED_FILE_VERSION) &&
+           (footer->DataSize == data_size) &&
+           (footer->Checksum == SavedFileChecksum(file, data_size)))
+        {
+            result = data_size;
+        }
+    }
+    return result;
+}
+
+// filename with suffix on the end, false when it doesn't fit
+internal bool32 GetSavedFileName(char *dest, uint32 dest_size, char *filename, char *suffix)
+{
+    uint32 length = 0;
+    for(char *at = filename; *at; ++at)
+    {
+        if((length + 1) >= dest_size)
+        {
+            return false;
+        }
+        dest[length++] = *at;
+    }
+    for(char *at = suffix; *at; ++at)
+    {
+        if((length + 1) >= dest_size)
+        {
+            return false;
+        }
+        dest[length++] = *at;
+    }
+    dest[length] = 0;
+    return true;
+}
+
+#define APPLICATION_SAVED_FILE_H
+#endif
@@ -0,0 +1,593 @@
+/*
+
+  Saved state, see application_serialize.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <emmintrin.h>
+
+// NOTE: FNV-1a over the value's bytes
+inline void HashSchemaValue(state_serializer *serializer, uint64 value)
+{
+    for(int byte_idx = 0; byte_idx < 8; ++byte_idx)
+    {
+        serializer->SchemaHash = (serializer->SchemaHash ^ (uint8)(value >> (8*byte_idx))) * 16777619u;
+    }
+}
+
+// where an address in application_memory sits in the image, false when it's outside of it
+inline bool32 GetStateImageOffset(application_memory *memory, void *address, uint64 *offset)
+{
+    uint8 *at = (uint8 *)address;
+    uint8 *permanent = (uint8 *)memory->PermanentStorage;
+    uint8 *transient = (uint8 *)memory->TransientStorage;
+
+    bool32 result = true;
+    if((at >= permanent) && (at < permanent + memory->PermanentStorageSize))
+    {
+        *offset = (uint64)(at - permanent);
+    }
+    else if((at >= transient) && (at <= transient + memory->TransientStorageSize))
+    {
+        *offset = memory->PermanentStorageSize + (uint64)(at - transient);
+    }
+    else
+    {
+        result = false;
+    }
+    return result;
+}
+
+// NOTE: the other way, for an image saved with permanent_storage_size
+inline uint8 *GetStateImageAddress(application_memory *memory, uint64 permanent_storage_size, uint64 offset)
+{
+    uint8 *result = 0;
+    if(offset < permanent_storage_size)
+    {
+        result = (uint8 *)memory->PermanentStorage + offset;
+    }
+    else
+    {
+        result = (uint8 *)memory->TransientStorage + (offset - permanent_storage_size);
+    }
+    return result;
+}
+
+// the span holding [offset, offset + size), 0 if no span holds all of it
+inline serialized_state_span *FindStateSpan(serialized_state_span *spans, uint32 span_count, uint64 offset, uint64 size)
+{
+    serialized_state_span *result = 0;
+    for(uint32 span_idx = 0; span_idx < span_count; ++span_idx)
+    {
+        serialized_state_span *span = spans + span_idx;
+        if((offset >= span->ImageOffset) && (size <= span->Size) && (offset - span->ImageOffset <= span->Size - size))
+        {
+            result = span;
+            break;
+        }
+    }
+    return result;
+}
+
+// save [base, base + size) in whole pages, spans have to be added in order and can't cross
+// from one storage into the other
+internal void AddStateSpan(state_serializer *serializer, void *base, uint64 size)
+{
+    uint64 start = 0;
+    if(size && GetStateImageOffset(serializer->Memory, base, &start))
+    {
+        uint64 end = start + size;
+        start &= ~(uint64)(SERIALIZED_STATE_PAGE_SIZE - 1);
+        end = (end + SERIALIZED_STATE_PAGE_SIZE - 1) & ~(uint64)(SERIALIZED_STATE_PAGE_SIZE - 1);
+
+        serialized_state_span *last = serializer->SpanCount ? (serializer->Spans + serializer->SpanCount - 1) : 0;
+        if(last && (start <= last->ImageOffset + last->Size))
+        {
+            Assert(start >= last->ImageOffset);
+            if(end > last->ImageOffset + last->Size)
+            {
+                last->Size = end - last->ImageOffset;
+            }
+        }
+        else if(serializer->SpanCount < SERIALIZED_STATE_MAX_SPAN_COUNT)
+        {
+            serialized_state_span *span = serializer->Spans + serializer->SpanCount++;
+            span->ImageOffset = start;
+            span->Size = end - start;
+            span->FileOffset = 0;
+        }
+        else
+        {
+            serializer->IsValid = false;
+        }
+    }
+}
+
+#define SerializeLayout(serializer, type) HashSchemaValue(serializer, sizeof(type))
+#define SerializePointer(serializer, field) SerializePointer_(serializer, (void **)(field), false)
+// NOTE: a pointer the platform handed over, it's saved as null and the app has to get it again after a load
+#define SerializeExternal(serializer, field) SerializePointer_(serializer, (void **)(field), true)
+
+internal void SerializePointer_(state_serializer *serializer, void **field, bool32 is_external)
+{
+    // NOTE: every pointer is somewhere in application_state, where it is in there is part of the layout
+    uint64 field_offset = 0;
+    bool32 is_in_memory = GetStateImageOffset(serializer->Memory, field, &field_offset);
+    Assert(is_in_memory);
+    HashSchemaValue(serializer, field_offset | ((uint64)is_external << 63));
+
+    if(serializer->File)
+    {
+        uint64 target_offset = 0;
+        serialized_state_span *span = FindStateSpan(serializer->Spans, serializer->SpanCount, field_offset, sizeof(void *));
+        if(span && (is_external || !*field || GetStateImageOffset(serializer->Memory, *field, &target_offset)))
+        {
+            int64 distance = (is_external || !*field) ? 0 : (int64)(target_offset - field_offset);
+            *(int64 *)(serializer->File + span->FileOffset + (field_offset - span->ImageOffset)) = distance;
+            if(!is_external)
+            {
+                serializer->Fixups[serializer->FixupCount] = field_offset;
+            }
+        }
+        else
+        {
+            serializer->IsValid = false;
+        }
+    }
+
+    if(!is_external)
+    {
+        ++serializer->FixupCount;
+    }
+}
+
+//
+// Schema
+//
+
+internal void SerializeArena(state_serializer *serializer, memory_arena *arena)
+{
+    SerializeLayout(serializer, memory_arena);
+    SerializePointer(serializer, &arena->Base);
+}
+
+internal void SerializeEntityStore(state_serializer *serializer, entity_store *store)
+{
+    SerializeLayout(serializer, entity_store);
+    SerializePointer(serializer, &store->PositionX);
+    SerializePointer(serializer, &store->PositionY);
+    SerializePointer(serializer, &store->VelocityX);
+    SerializePointer(serializer, &store->VelocityY);
+    SerializePointer(serializer, &store->Flags);
+    SerializePointer(serializer, &store->DenseToSlot);
+    SerializePointer(serializer, &store->SlotToDense);
+    SerializePointer(serializer, &store->SlotGeneration);
+}
+
+internal void SerializeTileChunkTable(state_serializer *serializer, tile_chunk_table *table)
+{
+    SerializeLayout(serializer, tile_chunk_table);
+    SerializeLayout(serializer, tile_chunk);
+    SerializePointer(serializer, &table->Chunks);
+    SerializePointer(serializer, &table->NextFreeChunk);
+    SerializePointer(serializer, &table->HashSlots);
+}
+
+internal void SerializeTileMap(state_serializer *serializer, tile_map *tile_map)
+{
+    SerializeLayout(serializer, tile_map);
+    SerializeTileChunkTable(serializer, &tile_map->Resident);
+    SerializeTileChunkTable(serializer, &tile_map->Cold);
+}
+
+internal void SerializeResampler(state_serializer *serializer, resampler *resampler)
+{
+    SerializeLayout(serializer, resampler);
+    SerializePointer(serializer, &resampler->Coefficients);
+    SerializePointer(serializer, &resampler->Left);
+    SerializePointer(serializer, &resampler->Right);
+}
+
+internal void SerializeAudioEffects(state_serializer *serializer, audio_effects *effects)
+{
+    SerializeLayout(serializer, audio_effects);
+    for(int send_idx = 0; send_idx < AudioSend_Count; ++send_idx)
+    {
+        SerializePointer(serializer, &effects->SendLeft[send_idx]);
+        SerializePointer(serializer, &effects->SendRight[send_idx]);
+    }
+    SerializePointer(serializer, &effects->Delay.Left);
+    SerializePointer(serializer, &effects->Delay.Right);
+    SerializePointer(serializer, &effects->Reverb.Lines);
+}
+
+internal void SerializeAudioStream(state_serializer *serializer, audio_stream *stream)
+{
+    SerializeLayout(serializer, audio_stream);
+    SerializeExternal(serializer, &stream->File.Platform);
+    for(int chunk_idx = 0; chunk_idx < AUDIO_STREAM_CHUNK_COUNT; ++chunk_idx)
+    {
+        SerializePointer(serializer, &stream->Chunks[chunk_idx].Data);
+    }
+    SerializeResampler(serializer, &stream->Resampler);
+    SerializePointer(serializer, &stream->ResamplerMemory);
+    SerializePointer(serializer, &stream->Decoded);
+}
+
+internal void SerializeAudioMixer(state_serializer *serializer, audio_mixer *mixer)
+{
+    SerializeLayout(serializer, audio_mixer);
+    SerializePointer(serializer, &mixer->MixLeft);
+    SerializePointer(serializer, &mixer->MixRight);
+    SerializePointer(serializer, &mixer->Resampled);
+    SerializeAudioEffects(serializer, &mixer->Effects);
+    for(int stream_idx = 0; stream_idx < MAX_AUDIO_STREAM_COUNT; ++stream_idx)
+    {
+        SerializeAudioStream(serializer, mixer->Streams + stream_idx);
+    }
+}
+
+internal void SerializeRenderTexture(state_serializer *serializer, render_texture *texture)
+{
+    SerializeLayout(serializer, render_texture);
+    SerializePointer(serializer, &texture->Texels);
+}
+
+internal void SerializeRenderLayer(state_serializer *serializer, render_layer *layer)
+{
+    SerializeLayout(serializer, render_layer);
+    SerializePointer(serializer, &layer->Cache.Memory);
+}
+
+internal void SerializeParticleSystem(state_serializer *serializer, particle_system *system)
+{
+    SerializeLayout(serializer, particle_system);
+    SerializePointer(serializer, &system->PositionX);
+    SerializePointer(serializer, &system->PositionY);
+    SerializePointer(serializer, &system->VelocityX);
+    SerializePointer(serializer, &system->VelocityY);
+    SerializePointer(serializer, &system->Age);
+    SerializePointer(serializer, &system->AgeRate);
+    SerializePointer(serializer, &system->Color);
+}
+
+// NOTE: in the order the fields sit in application_state, so the fixups come out in address order
+internal void SerializeApplicationState(state_serializer *serializer, application_state *state)
+{
+    HashSchemaValue(serializer, SERIALIZED_STATE_VERSION);
+    SerializeLayout(serializer, application_state);
+    SerializeArena(serializer, &state->WorldArena);
+    SerializeEntityStore(serializer, &state->Entities);
+    SerializeTileMap(serializer, &state->TileMap);
+    SerializeAudioMixer(serializer, &state->Mixer);
+    SerializeRenderTexture(serializer, &state->TestTexture);
+    SerializeRenderLayer(serializer, &state->BackgroundLayer);
+    SerializeParticleSystem(serializer, &state->Particles);
+    SerializeArena(serializer, &state->TransientArena);
+    SerializeArena(serializer, &state->FrameArena);
+    SerializeArena(serializer, &state->SaveArena);
+}
+
+// NOTE: application_state and the world arena behind it, and whatever of the transient arena
+// isn't the frame arena, which only ever holds the current frame, or the save arena, which
+// only ever holds the last save
+internal void AddApplicationStateSpans(state_serializer *serializer, application_state *state)
+{
+    AddStateSpan(serializer, state, (uint64)(state->WorldArena.Base + state->WorldArena.Used - (uint8 *)state));
+
+    uint8 *transient_start = state->TransientArena.Base;
+    uint8 *transient_end = state->TransientArena.Base + state->TransientArena.Used;
+    uint8 *skip_start = state->FrameArena.Base;
+    uint8 *skip_end = state->SaveArena.Base + state->SaveArena.Size;
+    Assert((state->FrameArena.Base + state->FrameArena.Size) == state->SaveArena.Base);
+    Assert((skip_start >= transient_start) && (skip_end <= transient_end));
+    AddStateSpan(serializer, transient_start, (uint64)(skip_start - transient_start));
+    AddStateSpan(serializer, skip_end, (uint64)(transient_end - skip_end));
+}
+
+inline void BeginStateSerializer(state_serializer *serializer, application_memory *memory)
+{
+    *serializer = {};
+    serializer->Memory = memory;
+    serializer->SchemaHash = 2166136261u;
+    serializer->IsValid = true;
+}
+
+// NOTE: the schema hash of this build, nothing in the state is read so the state can be anything
+internal uint32 GetStateSchemaHash(application_memory *memory)
+{
+    state_serializer serializer;
+    BeginStateSerializer(&serializer, memory);
+    SerializeApplicationState(&serializer, (application_state *)memory->PermanentStorage);
+    return serializer.SchemaHash;
+}
+
+// NOTE: spans are whole pages, so 16 bytes at a time always comes out even
+internal void CopyStatePages(uint8 *dest, uint8 *source, uint64 size)
+{
+    Assert((size % SERIALIZED_STATE_PAGE_SIZE) == 0);
+    for(uint64 offset = 0; offset < size; offset += 64)
+    {
+        __m128i a = _mm_loadu_si128((__m128i *)(source + offset + 0));
+        __m128i b = _mm_loadu_si128((__m128i *)(source + offset + 16));
+        __m128i c = _mm_loadu_si128((__m128i *)(source + offset + 32));
+        __m128i d = _mm_loadu_si128((__m128i *)(source + offset + 48));
+        _mm_storeu_si128((__m128i *)(dest + offset + 0), a);
+        _mm_storeu_si128((__m128i *)(dest + offset + 16), b);
+        _mm_storeu_si128((__m128i *)(dest + offset + 32), c);
+        _mm_storeu_si128((__m128i *)(dest + offset + 48), d);
+    }
+}
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(DoStateCopyJob)
+{
+    state_copy_job *job = (state_copy_job *)data;
+    CopyStatePages(job->Dest, job->Source, job->Size);
+}
+
+// NOTE: the copy is bound by memory bandwidth, which one core doesn't use up
+internal void CopyStateSpansInParallel(platform_work_queue *queue, uint8 *file, application_memory *memory,
+                                       serialized_state_span *spans, uint32 span_count)
+{
+    uint64 total_size = 0;
+    for(uint32 span_idx = 0; span_idx < span_count; ++span_idx)
+    {
+        total_size += spans[span_idx].Size;
+    }
+    uint64 job_size = total_size / SERIALIZED_STATE_COPY_JOB_COUNT;
+    job_size = (job_size + SERIALIZED_STATE_PAGE_SIZE - 1) & ~(uint64)(SERIALIZED_STATE_PAGE_SIZE - 1);
+    if(job_size < SERIALIZED_STATE_PAGE_SIZE)
+    {
+        job_size = SERIALIZED_STATE_PAGE_SIZE;
+    }
+
+    // NOTE: a span can be split across more jobs than its share, so there's room for one extra per span
+    state_copy_job jobs[SERIALIZED_STATE_COPY_JOB_COUNT + SERIALIZED_STATE_MAX_SPAN_COUNT];
+    uint32 job_count = 0;
+    platform_job_counter counter = {};
+    for(uint32 span_idx = 0; span_idx < span_count; ++span_idx)
+    {
+        serialized_state_span *span = spans + span_idx;
+        uint8 *source = GetStateImageAddress(memory, memory->PermanentStorageSize, span->ImageOffset);
+        for(uint64 offset = 0; offset < span->Size; offset += job_size)
+        {
+            Assert(job_count < ArrayCount(jobs));
+            state_copy_job *job = jobs + job_count++;
+            job->Dest = file + span->FileOffset + offset;
+            job->Source = source + offset;
+            job->Size = ((span->Size - offset) < job_size) ? (span->Size - offset) : job_size;
+            Platform.AddEntry(queue, DoStateCopyJob, job, &counter);
+        }
+    }
+    Platform.WaitForCounter(queue, &counter);
+}
+
+// the size of the image, which is written into dest only if it fits. 0 when the state can't be saved.
+// Main thread, between frames, with no jobs running. The copy is shared out over the work queue
+internal uint64 SaveApplicationStateImage(application_memory *memory, void *dest, uint64 dest_size)
+{
+    application_state *state = (application_state *)memory->PermanentStorage;
+    Assert(sizeof(void *) == sizeof(int64));
+
+    state_serializer serializer;
+    BeginStateSerializer(&serializer, memory);
+    AddApplicationStateSpans(&serializer, state);
+    SerializeApplicationState(&serializer, state);
+
+    uint64 span_table_offset = sizeof(serialized_state_header);
+    uint64 fixup_table_offset = span_table_offset + serializer.SpanCount*sizeof(serialized_state_span);
+    uint64 file_size = fixup_table_offset + serializer.FixupCount*sizeof(uint64);
+    file_size = (file_size + SERIALIZED_STATE_PAGE_SIZE - 1) & ~(uint64)(SERIALIZED_STATE_PAGE_SIZE - 1);
+    for(uint32 span_idx = 0; span_idx < serializer.SpanCount; ++span_idx)
+    {
+        serializer.Spans[span_idx].FileOffset = file_size;
+        file_size += serializer.Spans[span_idx].Size;
+    }
+
+    if(dest && (dest_size >= file_size) && serializer.IsValid)
+    {
+        uint8 *file = (uint8 *)dest;
+        serialized_state_header *header = (serialized_state_header *)file;
+        header->Magic = SERIALIZED_STATE_MAGIC;
+        header->Version = SERIALIZED_STATE_VERSION;
+        header->SpanCount = serializer.SpanCount;
+        header->PermanentStorageSize = memory->PermanentStorageSize;
+        header->TransientStorageSize = memory->TransientStorageSize;
+        header->FixupCount = serializer.FixupCount;
+        header->SpanTableOffset = span_table_offset;
+        header->FixupTableOffset = fixup_table_offset;
+        header->FileSize = file_size;
+
+        serialized_state_span *spans = (serialized_state_span *)(file + span_table_offset);
+        for(uint32 span_idx = 0; span_idx < serializer.SpanCount; ++span_idx)
+        {
+            spans[span_idx] = serializer.Spans[span_idx];
+        }
+        CopyStateSpansInParallel(memory->WorkQueue, file, memory, spans, serializer.SpanCount);
+        for(uint8 *pad = file + fixup_table_offset + serializer.FixupCount*sizeof(uint64); pad < file + spans[0].FileOffset; ++pad)
+        {
+            *pad = 0;
+        }
+
+        // NOTE: again, this time turning the pointers in the copy into distances
+        uint64 fixup_count = serializer.FixupCount;
+        serializer.SchemaHash = 2166136261u;
+        serializer.File = file;
+        serializer.Fixups = (uint64 *)(file + fixup_table_offset);
+        serializer.FixupCount = 0;
+        SerializeApplicationState(&serializer, state);
+        Assert(serializer.FixupCount == fixup_count);
+        header->SchemaHash = serializer.SchemaHash;
+    }
+
+    uint64 result = serializer.IsValid ? file_size : 0;
+    return result;
+}
+
+// check everything before touching application_memory, an image that doesn't fit leaves the state alone
+internal bool32 IsStateImageLoadable(application_memory *memory, void *image, uint64 file_size)
+{
+    uint8 *file = (uint8 *)image;
+    serialized_state_header *header = (serialized_state_header *)file;
+    if((file_size < sizeof(serialized_state_header)) || (header->Magic != SERIALIZED_STATE_MAGIC) ||
+       (header->Version != SERIALIZED_STATE_VERSION) || (header->FileSize != file_size) ||
+       (header->SchemaHash != GetStateSchemaHash(memory)) ||
+       (header->PermanentStorageSize > memory->PermanentStorageSize) ||
+       (header->TransientStorageSize > memory->TransientStorageSize) ||
+       (header->SpanCount == 0) || (header->SpanCount > SERIALIZED_STATE_MAX_SPAN_COUNT) ||
+       (header->SpanTableOffset > file_size) ||
+       ((file_size - header->SpanTableOffset) / sizeof(serialized_state_span) < header->SpanCount) ||
+       (header->FixupTableOffset > file_size) ||
+       ((file_size - header->FixupTableOffset) / sizeof(uint64) < header->FixupCount))
+    {
+        return false;
+    }
+
+    // NOTE: the first span has to be application_state itself
+    uint64 image_size = header->PermanentStorageSize + header->TransientStorageSize;
+    serialized_state_span *spans = (serialized_state_span *)(file + header->SpanTableOffset);
+    if((spans[0].ImageOffset != 0) || (spans[0].Size < sizeof(application_state)))
+    {
+        return false;
+    }
+    for(uint32 span_idx = 0; span_idx < header->SpanCount; ++span_idx)
+    {
+        serialized_state_span *span = spans + span_idx;
+        uint64 span_end = span->ImageOffset + span->Size;
+        bool32 is_permanent = (span->ImageOffset < header->PermanentStorageSize);
+        if((span_end < span->ImageOffset) || (span_end > image_size) ||
+           (is_permanent && (span_end > header->PermanentStorageSize)) ||
+           (span->FileOffset > file_size) || (span->Size > file_size - span->FileOffset) ||
+           (span->Size % SERIALIZED_STATE_PAGE_SIZE))
+        {
+            return false;
+        }
+    }
+
+    uint64 *fixups = (uint64 *)(file + header->FixupTableOffset);
+    for(uint64 fixup_idx = 0; fixup_idx < header->FixupCount; ++fixup_idx)
+    {
+        uint64 field_offset = fixups[fixup_idx];
+        serialized_state_span *span = FindStateSpan(spans, header->SpanCount, field_offset, sizeof(int64));
+        if(!span)
+        {
+            return false;
+        }
+
+        int64 distance = *(int64 *)(file + span->FileOffset + (field_offset - span->ImageOffset));
+        uint64 target_offset = field_offset + (uint64)distance;
+        if(target_offset > image_size)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// put an image from SaveApplicationStateImage back into application_memory, once it's been
+// through IsStateImageLoadable
+internal void LoadApplicationStateImage(application_memory *memory, void *image)
+{
+    uint8 *file = (uint8 *)image;
+    serialized_state_header *header = (serialized_state_header *)file;
+    serialized_state_span *spans = (serialized_state_span *)(file + header->SpanTableOffset);
+    for(uint32 span_idx = 0; span_idx < header->SpanCount; ++span_idx)
+    {
+        serialized_state_span *span = spans + span_idx;
+        CopyStatePages(GetStateImageAddress(memory, header->PermanentStorageSize, span->ImageOffset),
+                       file + span->FileOffset, span->Size);
+    }
+
+    uint64 *fixups = (uint64 *)(file + header->FixupTableOffset);
+    for(uint64 fixup_idx = 0; fixup_idx < header->FixupCount; ++fixup_idx)
+    {
+        uint64 field_offset = fixups[fixup_idx];
+        uint8 *field = GetStateImageAddress(memory, header->PermanentStorageSize, field_offset);
+        int64 distance = *(int64 *)field;
+        *(uint8 **)field = distance ? GetStateImageAddress(memory, header->PermanentStorageSize,
+                                                            field_offset + (uint64)distance) : 0;
+    }
+}
+
+// NOTE: the platform only touches SaveArena and SaveRequest while the save is Pending,
+// loading over either of them has to wait it out
+internal void WaitForAutosave(application_state *state)
+{
+    while(state->SaveRequest.State == PlatformFileRequest_Pending)
+    {
+        _mm_pause();
+    }
+}
+
+// NOTE: the first time SaveArena is used every page of the image faults in, which cost several
+// times what the copy itself does. The pages are written a few at a time over the frames before
+// the autosave instead, SaveArena isn't part of a saved state so what goes in them doesn't matter
+internal void TouchSaveArena(application_memory *memory, application_state *state)
+{
+    if(state->SaveArenaTouchedSize >= state->SaveArena.Size)
+    {
+        return;
+    }
+
+    uint64 image_size = SaveApplicationStateImage(memory, 0, 0);
+    uint64 touch_size = (image_size < state->SaveArena.Size) ? image_size : state->SaveArena.Size;
+    if(state->SaveArenaTouchedSize < touch_size)
+    {
+        uint64 end = state->SaveArenaTouchedSize + AUTOSAVE_TOUCH_BYTES_PER_FRAME;
+        if(end > touch_size)
+        {
+            end = touch_size;
+        }
+        for(uint64 offset = state->SaveArenaTouchedSize; offset < end; offset += SERIALIZED_STATE_PAGE_SIZE)
+        {
+            state->SaveArena.Base[offset] = 0;
+        }
+        state->SaveArenaTouchedSize = end;
+    }
+}
+
+// every AUTOSAVE_INTERVAL_SECONDS the state is made into an image in SaveArena and handed to
+// the platform's file thread, the frame only pays for the copy and never for the disk.
+// Main thread, before anything in the frame has changed the state
+internal void UpdateAutosave(application_memory *memory, application_state *state, real32 dt)
+{
+    state->SecondsUntilAutosave -= dt;
+    if(memory->AutosaveFilename && (state->SaveRequest.State != PlatformFileRequest_Pending))
+    {
+        if(state->SecondsUntilAutosave <= 0.0f)
+        {
+            // NOTE: reset before the image is made, or loading it would save again straight away
+            state->SecondsUntilAutosave = AUTOSAVE_INTERVAL_SECONDS;
+
+            ClearArena(&state->SaveArena);
+            uint64 image_size = SaveApplicationStateImage(memory, 0, 0);
+            if(image_size && (image_size <= state->SaveArena.Size))
+            {
+                SetArenaTag(&state->SaveArena, MemoryTag_Save);
+                uint8 *image = PushArrayAligned(&state->SaveArena, image_size, uint8, SERIALIZED_STATE_PAGE_SIZE);
+                SaveApplicationStateImage(memory, image, image_size);
+                if(state->SaveArenaTouchedSize < image_size)
+                {
+                    state->SaveArenaTouchedSize = image_size;
+                }
+
+                // NOTE: a full request ring is tried again next frame, a failed write at the next interval
+                if(!Platform.SaveFile(memory->AutosaveFilename, image, image_size, &state->SaveRequest))
+                {
+                    state->SecondsUntilAutosave = 0.0f;
+                }
+            }
+            else
+            {
+                // TODO: Logging, the state outgrew SaveArena
+            }
+        }
+        else if(state->SecondsUntilAutosave <= AUTOSAVE_TOUCH_SECONDS)
+        {
+            TouchSaveArena(memory, state);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*
+
+  Saved state. application_state and everything its arenas hold are
+  written out as an image of application_memory that doesn't depend on
+  where the memory was: every pointer in it is stored as the distance from
+  the pointer to what it points at, and the image lists where all of those
+  pointers are. Loading copies the spans back into application_memory
+  wherever it is now and turns the distances back into pointers in one
+  pass over that list, so nothing needs a fixed base address.
+
+  Image offsets put PermanentStorage first and TransientStorage right
+  after it, at the PermanentStorageSize the image was saved with. Only the
+  parts of the memory that hold state are saved, as spans of whole pages
+  so the platform could also map them straight from the file. A pointer
+  can still point anywhere in either storage, into the frame arena for
+  one, it only has to be in the image's range of offsets.
+
+  Where the pointers are is described by the schema in
+  application_serialize.cpp, one function per struct. The schema hash
+  comes from the same walk, it covers the size of every struct that holds
+  a pointer and where in it each pointer is, so an image from a build
+  whose layout is different is refused instead of being misread.
+  SERIALIZED_STATE_VERSION is for the changes a layout doesn't show, like
+  a field that now means something else.
+
+  The file is the header, the span table and the fixup table, then the
+  span data starting on a page:
+
+      header | spans | fixups | pad | span 0 | span 1 | ...
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_SERIALIZE_H)
+
+#define SERIALIZED_STATE_MAGIC 0x54535041 // NOTE: "APST"
+#define SERIALIZED_STATE_VERSION 1
+#define SERIALIZED_STATE_PAGE_SIZE 4096
+#define SERIALIZED_STATE_MAX_SPAN_COUNT 8
+
+#define AUTOSAVE_INTERVAL_SECONDS 30.0f
+#define AUTOSAVE_TOUCH_SECONDS 5.0f // NOTE: how long before an autosave SaveArena starts being faulted in
+#define AUTOSAVE_TOUCH_BYTES_PER_FRAME Megabytes(1)
+#define SERIALIZED_STATE_COPY_JOB_COUNT 32
+
+struct serialized_state_header
+{
+    uint32 Magic;
+    uint32 Version;
+    uint32 SchemaHash;
+    uint32 SpanCount;
+
+    // NOTE: what the image was saved from, the memory it's loaded into can be bigger
+    uint64 PermanentStorageSize;
+    uint64 TransientStorageSize;
+
+    uint64 FixupCount;
+    uint64 SpanTableOffset;
+    uint64 FixupTableOffset;
+    uint64 FileSize;
+};
+
+struct serialized_state_span
+{
+    uint64 ImageOffset;
+    uint64 Size;
+    uint64 FileOffset;
+};
+
+// NOTE: a pointer at image offset Fixups[i] holds the int64 distance to what it points at, 0 for null
+struct state_serializer
+{
+    application_memory *Memory;
+    uint32 SchemaHash;
+
+    uint32 SpanCount;
+    serialized_state_span Spans[SERIALIZED_STATE_MAX_SPAN_COUNT];
+
+    // NOTE: 0 while the schema is only being walked to count the pointers and work out the hash
+    uint8 *File;
+    uint64 *Fixups;
+    uint64 FixupCount;
+    bool32 IsValid; // NOTE: cleared by a pointer that points outside of application_memory
+};
+
+struct state_copy_job
+{
+    uint8 *Dest;
+    uint8 *Source;
+    uint64 Size;
+};
+
+#define APPLICATION_SERIALIZE_H
+#endif
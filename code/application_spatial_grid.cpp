@@ -0,0 +1,349 @@
+/*
+
+  Broad phase, see application_spatial_grid.h
+
+  Author: Justin Morrow
+
+*/
+
+#include <emmintrin.h>
+
+// cell coordinate of a position, clamped to the grid
+inline int32 GetSpatialCell(real32 value, real32 origin, real32 inv_cell_size, int32 cell_count)
+{
+    real32 scaled = (value - origin)*inv_cell_size;
+    int32 result = 0;
+    if(scaled > 0.0f)
+    {
+        result = (scaled < (real32)cell_count) ? (int32)scaled : (cell_count - 1);
+    }
+    return result;
+}
+
+/* NOTE: file every object under the cell its center is in, everything is allocated out of arena.
+
+   The grid covers the bounds of the object centers. If that would take more than about one cell
+   per object the cells are grown to fit, so a sparse world never costs more than the objects in it.
+*/
+internal void BuildSpatialGrid(spatial_grid *grid, memory_arena *arena, real32 cell_size, uint32 object_count,
+                               real32 *min_x, real32 *min_y, real32 *max_x, real32 *max_y)
+{
+    real32 center_min_x = 0.0f;
+    real32 center_min_y = 0.0f;
+    real32 center_max_x = 0.0f;
+    real32 center_max_y = 0.0f;
+    for(uint32 object_idx = 0; object_idx < object_count; ++object_idx)
+    {
+        Assert((max_x[object_idx] - min_x[object_idx]) <= cell_size);
+        Assert((max_y[object_idx] - min_y[object_idx]) <= cell_size);
+
+        real32 center_x = 0.5f*(min_x[object_idx] + max_x[object_idx]);
+        real32 center_y = 0.5f*(min_y[object_idx] + max_y[object_idx]);
+        if((object_idx == 0) || (center_x < center_min_x)) center_min_x = center_x;
+        if((object_idx == 0) || (center_y < center_min_y)) center_min_y = center_y;
+        if((object_idx == 0) || (center_x > center_max_x)) center_max_x = center_x;
+        if((object_idx == 0) || (center_y > center_max_y)) center_max_y = center_y;
+    }
+
+    real64 max_cell_count = (real64)object_count + 64.0;
+    real64 width_in_cells = (center_max_x - center_min_x) / cell_size + 1.0;
+    real64 height_in_cells = (center_max_y - center_min_y) / cell_size + 1.0;
+    if(width_in_cells*height_in_cells > max_cell_count)
+    {
+        cell_size *= (real32)sqrt((width_in_cells*height_in_cells) / max_cell_count) + 0.01f;
+    }
+
+    grid->CellSize = cell_size;
+    grid->InvCellSize = 1.0f / cell_size;
+    grid->OriginX = center_min_x;
+    grid->OriginY = center_min_y;
+    grid->CellCountX = (int32)((center_max_x - center_min_x)*grid->InvCellSize) + 1;
+    grid->CellCountY = (int32)((center_max_y - center_min_y)*grid->InvCellSize) + 1;
+    grid->ObjectCount = object_count;
+
+    uint32 cell_count = (uint32)(grid->CellCountX*grid->CellCountY);
+    grid->CellStart = PushArray(arena, cell_count + 1, uint32);
+    uint32 *cell_cursor = PushArray(arena, cell_count, uint32);
+    uint32 *object_cell = PushArray(arena, object_count, uint32);
+
+    uint32 padded_count = object_count + 4;
+    grid->Boxes = PushArrayAligned(arena, 4*padded_count, real32, 16);
+    grid->ObjectId = PushArrayAligned(arena, padded_count, uint32, 16);
+
+    for(uint32 cell_idx = 0; cell_idx <= cell_count; ++cell_idx)
+    {
+        grid->CellStart[cell_idx] = 0;
+    }
+
+    // NOTE: counting sort, count -> prefix sum -> scatter
+    for(uint32 object_idx = 0; object_idx < object_count; ++object_idx)
+    {
+        int32 cell_x = GetSpatialCell(0.5f*(min_x[object_idx] + max_x[object_idx]),
+                                      grid->OriginX, grid->InvCellSize, grid->CellCountX);
+        int32 cell_y = GetSpatialCell(0.5f*(min_y[object_idx] + max_y[object_idx]),
+                                      grid->OriginY, grid->InvCellSize, grid->CellCountY);
+        uint32 cell = (uint32)(cell_y*grid->CellCountX + cell_x);
+        object_cell[object_idx] = cell;
+        ++grid->CellStart[cell];
+    }
+
+    uint32 running_start = 0;
+    for(uint32 cell_idx = 0; cell_idx < cell_count; ++cell_idx)
+    {
+        uint32 count = grid->CellStart[cell_idx];
+        grid->CellStart[cell_idx] = running_start;
+        cell_cursor[cell_idx] = running_start;
+        running_start += count;
+    }
+    grid->CellStart[cell_count] = running_start;
+
+    for(uint32 object_idx = 0; object_idx < object_count; ++object_idx)
+    {
+        uint32 sorted_idx = cell_cursor[object_cell[object_idx]]++;
+        _mm_store_ps(grid->Boxes + 4*sorted_idx,
+                     _mm_setr_ps(min_x[object_idx], min_y[object_idx], max_x[object_idx], max_y[object_idx]));
+        grid->ObjectId[sorted_idx] = object_idx;
+    }
+
+    // NOTE: keep the padding lanes out of every overlap test
+    for(uint32 pad_idx = object_count; pad_idx < padded_count; ++pad_idx)
+    {
+        _mm_store_ps(grid->Boxes + 4*pad_idx, _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f));
+        grid->ObjectId[pad_idx] = 0;
+    }
+}
+
+// load the sorted boxes [idx, idx + 4) as min x, min y, max x, max y lanes
+inline void LoadSpatialBoxes(spatial_grid *grid, uint32 idx, __m128 *min_x, __m128 *min_y, __m128 *max_x, __m128 *max_y)
+{
+    __m128 box0 = _mm_load_ps(grid->Boxes + 4*idx);
+    __m128 box1 = _mm_load_ps(grid->Boxes + 4*idx + 4);
+    __m128 box2 = _mm_load_ps(grid->Boxes + 4*idx + 8);
+    __m128 box3 = _mm_load_ps(grid->Boxes + 4*idx + 12);
+    _MM_TRANSPOSE4_PS(box0, box1, box2, box3);
+    *min_x = box0;
+    *min_y = box1;
+    *max_x = box2;
+    *max_y = box3;
+}
+
+// test sorted object a_idx against the sorted objects [first_idx, one_past_last_idx), 4 at a time
+internal uint32 CollectSpatialOverlaps(spatial_grid *grid, uint32 a_idx, uint32 first_idx, uint32 one_past_last_idx,
+                                       spatial_pair *pairs, uint32 pair_count, uint32 max_pair_count)
+{
+    real32 *a_box = grid->Boxes + 4*a_idx;
+    __m128 a_min_x_4x = _mm_set1_ps(a_box[0]);
+    __m128 a_min_y_4x = _mm_set1_ps(a_box[1]);
+    __m128 a_max_x_4x = _mm_set1_ps(a_box[2]);
+    __m128 a_max_y_4x = _mm_set1_ps(a_box[3]);
+
+    for(uint32 idx = first_idx; idx < one_past_last_idx; idx += 4)
+    {
+        __m128 b_min_x, b_min_y, b_max_x, b_max_y;
+        LoadSpatialBoxes(grid, idx, &b_min_x, &b_min_y, &b_max_x, &b_max_y);
+
+        __m128 overlaps = _mm_and_ps(
+            _mm_and_ps(_mm_cmple_ps(a_min_x_4x, b_max_x), _mm_cmple_ps(b_min_x, a_max_x_4x)),
+            _mm_and_ps(_mm_cmple_ps(a_min_y_4x, b_max_y), _mm_cmple_ps(b_min_y, a_max_y_4x)));
+        int lane_mask = _mm_movemask_ps(overlaps);
+
+        uint32 live_lane_count = one_past_last_idx - idx;
+        if(live_lane_count < 4)
+        {
+            lane_mask &= (1 << live_lane_count) - 1;
+        }
+
+        for(uint32 lane = 0; lane_mask; ++lane, lane_mask >>= 1)
+        {
+            if(lane_mask & 1)
+            {
+                // NOTE: past the end pairs are only counted, so the caller learns how many to make room for
+                if(pair_count < max_pair_count)
+                {
+                    spatial_pair *pair = pairs + pair_count;
+                    pair->A = grid->ObjectId[a_idx];
+                    pair->B = grid->ObjectId[idx + lane];
+                }
+                ++pair_count;
+            }
+        }
+    }
+
+    return pair_count;
+}
+
+// the runs of sorted objects a cell looks forward at: [first_idx, right_end_idx) is its own objects
+// followed by the cell to its right, [below_first_idx, below_end_idx) the 3 cells below it
+struct spatial_forward_runs
+{
+    uint32 FirstIdx;
+    uint32 OnePastLastIdx;
+    uint32 RightEndIdx;
+    uint32 BelowFirstIdx;
+    uint32 BelowEndIdx;
+};
+
+inline spatial_forward_runs GetSpatialForwardRuns(spatial_grid *grid, int32 cell_x, int32 cell_y)
+{
+    spatial_forward_runs result = {};
+
+    int32 cell = cell_y*grid->CellCountX + cell_x;
+    result.FirstIdx = grid->CellStart[cell];
+    result.OnePastLastIdx = grid->CellStart[cell + 1];
+
+    int32 right_end_cell = (cell_x + 1 < grid->CellCountX) ? (cell + 2) : (cell + 1);
+    result.RightEndIdx = grid->CellStart[right_end_cell];
+
+    if(cell_y + 1 < grid->CellCountY)
+    {
+        int32 below_cell = cell + grid->CellCountX;
+        int32 below_first_cell = (cell_x > 0) ? (below_cell - 1) : below_cell;
+        int32 below_end_cell = (cell_x + 1 < grid->CellCountX) ? (below_cell + 2) : (below_cell + 1);
+        result.BelowFirstIdx = grid->CellStart[below_first_cell];
+        result.BelowEndIdx = grid->CellStart[below_end_cell];
+    }
+
+    return result;
+}
+
+// how many pairs GenerateSpatialPairs tests, which is as many as it can ever report.
+// only walks the cell table, so it is cheap enough to size the pair buffer with every frame
+internal uint64 CountSpatialCandidatePairs(spatial_grid *grid)
+{
+    uint64 result = 0;
+    for(int32 cell_y = 0; cell_y < grid->CellCountY; ++cell_y)
+    {
+        for(int32 cell_x = 0; cell_x < grid->CellCountX; ++cell_x)
+        {
+            spatial_forward_runs runs = GetSpatialForwardRuns(grid, cell_x, cell_y);
+            uint64 object_count = runs.OnePastLastIdx - runs.FirstIdx;
+            if(object_count)
+            {
+                // NOTE: every object against the ones after it in its own cell, and against all of its right and below neighbors
+                uint64 own_count = object_count*(object_count - 1) / 2;
+                uint64 right_count = runs.RightEndIdx - runs.OnePastLastIdx;
+                uint64 below_count = runs.BelowEndIdx - runs.BelowFirstIdx;
+                result += own_count + object_count*(right_count + below_count);
+            }
+        }
+    }
+
+    return result;
+}
+
+/* NOTE: every pair of objects whose bounds overlap, each pair is reported once.
+
+   Each object only looks forward: at the objects after it in its own cell, the cell to its
+   right and the 3 cells below it, the other 4 neighbors find it from their side. Because cells
+   are sorted row by row, own cell + right cell is one contiguous run of objects and so are the
+   3 cells below, so it is only ever 2 SIMD loops per object.
+
+   Returns how many pairs overlap, only the first max_pair_count of them are written. When that
+   is more than max_pair_count the caller can make room for all of them and run it again.
+*/
+internal uint32 GenerateSpatialPairs(spatial_grid *grid, spatial_pair *pairs, uint32 max_pair_count)
+{
+    uint32 pair_count = 0;
+    for(int32 cell_y = 0; cell_y < grid->CellCountY; ++cell_y)
+    {
+        for(int32 cell_x = 0; cell_x < grid->CellCountX; ++cell_x)
+        {
+            spatial_forward_runs runs = GetSpatialForwardRuns(grid, cell_x, cell_y);
+            for(uint32 a_idx = runs.FirstIdx; a_idx < runs.OnePastLastIdx; ++a_idx)
+            {
+                pair_count = CollectSpatialOverlaps(grid, a_idx, a_idx + 1, runs.RightEndIdx,
+                                                    pairs, pair_count, max_pair_count);
+                pair_count = CollectSpatialOverlaps(grid, a_idx, runs.BelowFirstIdx, runs.BelowEndIdx,
+                                                    pairs, pair_count, max_pair_count);
+            }
+        }
+    }
+
+    return pair_count;
+}
+
+// shared by the rectangle and radius queries, a radius of zero means plain rectangle overlap
+internal uint32 QuerySpatialGrid_(spatial_grid *grid, real32 min_x, real32 min_y, real32 max_x, real32 max_y,
+                                  real32 center_x, real32 center_y, real32 radius,
+                                  uint32 *results, uint32 max_result_count)
+{
+    uint32 result_count = 0;
+
+    __m128 min_x_4x = _mm_set1_ps(min_x);
+    __m128 min_y_4x = _mm_set1_ps(min_y);
+    __m128 max_x_4x = _mm_set1_ps(max_x);
+    __m128 max_y_4x = _mm_set1_ps(max_y);
+    __m128 center_x_4x = _mm_set1_ps(center_x);
+    __m128 center_y_4x = _mm_set1_ps(center_y);
+    __m128 radius_sq_4x = _mm_set1_ps(radius*radius);
+    __m128 zero_4x = _mm_setzero_ps();
+
+    // NOTE: objects are filed by center, so widen by half a cell to catch everything that sticks in
+    real32 half_cell = 0.5f*grid->CellSize;
+    int32 first_cell_x = GetSpatialCell(min_x - half_cell, grid->OriginX, grid->InvCellSize, grid->CellCountX);
+    int32 first_cell_y = GetSpatialCell(min_y - half_cell, grid->OriginY, grid->InvCellSize, grid->CellCountY);
+    int32 last_cell_x = GetSpatialCell(max_x + half_cell, grid->OriginX, grid->InvCellSize, grid->CellCountX);
+    int32 last_cell_y = GetSpatialCell(max_y + half_cell, grid->OriginY, grid->InvCellSize, grid->CellCountY);
+
+    for(int32 cell_y = first_cell_y; cell_y <= last_cell_y; ++cell_y)
+    {
+        // NOTE: a row of cells is one contiguous run of sorted objects
+        uint32 first_idx = grid->CellStart[cell_y*grid->CellCountX + first_cell_x];
+        uint32 one_past_last_idx = grid->CellStart[cell_y*grid->CellCountX + last_cell_x + 1];
+
+        for(uint32 idx = first_idx; idx < one_past_last_idx; idx += 4)
+        {
+            __m128 b_min_x, b_min_y, b_max_x, b_max_y;
+            LoadSpatialBoxes(grid, idx, &b_min_x, &b_min_y, &b_max_x, &b_max_y);
+
+            __m128 hits = _mm_and_ps(
+                _mm_and_ps(_mm_cmple_ps(min_x_4x, b_max_x), _mm_cmple_ps(b_min_x, max_x_4x)),
+                _mm_and_ps(_mm_cmple_ps(min_y_4x, b_max_y), _mm_cmple_ps(b_min_y, max_y_4x)));
+            if(radius > 0.0f)
+            {
+                // NOTE: distance from the center to the closest point of each box
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(b_min_x, center_x_4x),
+                                                  _mm_sub_ps(center_x_4x, b_max_x)), zero_4x);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(b_min_y, center_y_4x),
+                                                  _mm_sub_ps(center_y_4x, b_max_y)), zero_4x);
+                __m128 distance_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+                hits = _mm_and_ps(hits, _mm_cmple_ps(distance_sq, radius_sq_4x));
+            }
+            int lane_mask = _mm_movemask_ps(hits);
+
+            uint32 live_lane_count = one_past_last_idx - idx;
+            if(live_lane_count < 4)
+            {
+                lane_mask &= (1 << live_lane_count) - 1;
+            }
+
+            for(uint32 lane = 0; lane_mask; ++lane, lane_mask >>= 1)
+            {
+                if((lane_mask & 1) && (result_count < max_result_count))
+                {
+                    results[result_count++] = grid->ObjectId[idx + lane];
+                }
+            }
+        }
+    }
+
+    return result_count;
+}
+
+// ids of every object whose bounds overlap the rectangle
+internal uint32 QuerySpatialGridRectangle(spatial_grid *grid, real32 min_x, real32 min_y, real32 max_x, real32 max_y,
+                                          uint32 *results, uint32 max_result_count)
+{
+    uint32 result = QuerySpatialGrid_(grid, min_x, min_y, max_x, max_y, 0.0f, 0.0f, 0.0f,
+                                      results, max_result_count);
+    return result;
+}
+
+// ids of every object whose bounds come within radius of x, y
+internal uint32 QuerySpatialGridRadius(spatial_grid *grid, real32 x, real32 y, real32 radius,
+                                       uint32 *results, uint32 max_result_count)
+{
+    uint32 result = QuerySpatialGrid_(grid, x - radius, y - radius, x + radius, y + radius, x, y, radius,
+                                      results, max_result_count);
+    return result;
+}
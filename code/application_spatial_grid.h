@@ -0,0 +1,47 @@
+/*
+
+  Broad phase. A uniform grid that gets rebuilt from scratch every frame in
+  the frame arena, sized to the bounds of whatever was put into it. Objects
+  are counting sorted by the cell their center falls into, so every cell is
+  a contiguous range of the sorted SoA bounds and nothing is allocated per
+  cell. Cells are stored row by row, so walking them in order walks the
+  objects in memory order as well.
+
+  Objects are only filed under one cell, so the cell size has to be at least
+  as big as the biggest object for the neighboring cells to see every overlap.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_SPATIAL_GRID_H)
+
+struct spatial_pair
+{
+    uint32 A;
+    uint32 B;
+};
+
+struct spatial_grid
+{
+    real32 CellSize;
+    real32 InvCellSize;
+    real32 OriginX;
+    real32 OriginY;
+
+    int32 CellCountX;
+    int32 CellCountY;
+    uint32 ObjectCount;
+
+    // NOTE: CellCountX*CellCountY + 1 entries, cell c holds sorted objects [CellStart[c], CellStart[c + 1])
+    uint32 *CellStart;
+
+    // NOTE: sorted by cell, padded by 4 so SIMD loops can read past the end.
+    // a box is {min x, min y, max x, max y} so sorting only scatters one 16 byte store per object,
+    // the tests transpose 4 boxes at a time back into lanes
+    real32 *Boxes;
+    uint32 *ObjectId;
+};
+
+#define APPLICATION_SPATIAL_GRID_H
+#endif
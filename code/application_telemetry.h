@@ -0,0 +1,449 @@
+/*
+
+  Frame telemetry. Every frame the platform layer records how long it spent
+  working, sleeping and presenting (plus the current audio latency) into
+  fixed-memory HDR (high dynamic range) histograms. At the end of a session
+  the histograms are summarized as percentiles so builds and machines can be
+  compared on their tail latency instead of on averages.
+
+  Nothing in here is platform specific, the platform layer owns a
+  frame_telemetry and decides when to dump it. It also keeps the latest
+  copy of the app's arena usage from the debug query so the dump shows how
+  much of application_memory was actually needed.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_TELEMETRY_H)
+
+#include <stdio.h>
+#include <stdarg.h>
+
+/* NOTE: how the histogram buckets values
+
+   Values are recorded in microseconds. The first bucket holds the values
+   [0, HDR_SUB_BUCKET_COUNT) at full precision. Every bucket after that covers
+   the next power of two range and splits it into HDR_SUB_BUCKET_HALF_COUNT
+   linear sub buckets, so the error of any recorded value is at most
+   1 / HDR_SUB_BUCKET_HALF_COUNT (~0.8%) no matter how big it gets.
+*/
+#define HDR_SUB_BUCKET_BITS 8
+#define HDR_SUB_BUCKET_COUNT (1 << HDR_SUB_BUCKET_BITS)
+#define HDR_SUB_BUCKET_HALF_COUNT (HDR_SUB_BUCKET_COUNT / 2)
+#define HDR_MAX_VALUE_BITS 32 // ~71 minutes worth of microseconds
+#define HDR_BUCKET_COUNT (HDR_MAX_VALUE_BITS - HDR_SUB_BUCKET_BITS + 1)
+#define HDR_COUNTS_COUNT ((HDR_BUCKET_COUNT + 1) * HDR_SUB_BUCKET_HALF_COUNT)
+
+struct hdr_histogram
+{
+    uint64 TotalCount;
+    uint64 Sum;
+    uint32 Min;
+    uint32 Max;
+    uint32 Counts[HDR_COUNTS_COUNT];
+};
+
+enum telemetry_timing
+{
+    TelemetryTiming_Work,
+    TelemetryTiming_Sleep,
+    TelemetryTiming_Present,
+    TelemetryTiming_Frame,
+    TelemetryTiming_AudioLatency,
+    TelemetryTiming_InputAge,
+    TelemetryTiming_Snapshot,
+
+    TelemetryTiming_Count,
+};
+
+global_variable char *TelemetryTimingNames[TelemetryTiming_Count] =
+{
+    "work",
+    "sleep",
+    "present",
+    "frame",
+    "audio_latency",
+    "input_age",
+    "snapshot",
+};
+
+#define TELEMETRY_MAX_ARENA_COUNT 16
+
+struct frame_telemetry
+{
+    uint64 FrameCount;
+    uint64 MissedFrameCount;
+    uint64 AudioUnderrunCount;
+    real32 TargetSecondsPerFrame;
+
+    // NOTE: sound resampling cost, cycles over output frames
+    uint64 ResampleCycleCount;
+    uint64 ResampledFrameCount;
+
+    // NOTE: the app's audio effects, cycles over the frames and blocks they ran on. CyclesPerSecond
+    // is measured by the platform so the cost can be put against the audio budget, 0 until it is
+    uint64 EffectsCycleCount;
+    uint64 EffectsFrameCount;
+    uint64 EffectsBlockCount;
+    uint32 EffectsSamplesPerSecond;
+    real64 CyclesPerSecond;
+
+    hdr_histogram Timings[TelemetryTiming_Count];
+
+    // NOTE: from the app's debug query, the latest copy the platform asked for
+    uint32 ArenaCount;
+    debug_arena_info Arenas[TELEMETRY_MAX_ARENA_COUNT];
+};
+
+inline uint32 HdrFindMostSignificantBit(uint32 value)
+{
+    uint32 result = 0;
+    while(value >>= 1)
+    {
+        ++result;
+    }
+    return result;
+}
+
+inline uint32 HdrGetCountsIndex(uint32 value)
+{
+    uint32 bucket_idx = 0;
+    if(value >= HDR_SUB_BUCKET_COUNT)
+    {
+        bucket_idx = HdrFindMostSignificantBit(value) - (HDR_SUB_BUCKET_BITS - 1);
+    }
+
+    uint32 sub_bucket_idx = value >> bucket_idx;
+    uint32 result = bucket_idx*HDR_SUB_BUCKET_HALF_COUNT + sub_bucket_idx;
+    Assert(result < HDR_COUNTS_COUNT);
+    return result;
+}
+
+// the largest value that lands in the same slot as counts_idx
+inline uint32 HdrGetHighestEquivalentValue(uint32 counts_idx)
+{
+    uint32 bucket_idx = 0;
+    if(counts_idx >= HDR_SUB_BUCKET_COUNT)
+    {
+        bucket_idx = (counts_idx / HDR_SUB_BUCKET_HALF_COUNT) - 1;
+    }
+
+    uint64 sub_bucket_idx = counts_idx - bucket_idx*HDR_SUB_BUCKET_HALF_COUNT;
+    uint64 lowest = sub_bucket_idx << bucket_idx;
+    uint64 result = lowest + ((uint64)1 << bucket_idx) - 1;
+    if(result > 0xFFFFFFFF)
+    {
+        result = 0xFFFFFFFF;
+    }
+    return (uint32)result;
+}
+
+inline void HdrRecordValue(hdr_histogram *histogram, uint32 value)
+{
+    ++histogram->Counts[HdrGetCountsIndex(value)];
+
+    if((histogram->TotalCount == 0) || (value < histogram->Min))
+    {
+        histogram->Min = value;
+    }
+    if(value > histogram->Max)
+    {
+        histogram->Max = value;
+    }
+
+    ++histogram->TotalCount;
+    histogram->Sum += value;
+}
+
+// percentile is [0, 100], returns microseconds
+internal uint32 HdrValueAtPercentile(hdr_histogram *histogram, real64 percentile)
+{
+    uint32 result = 0;
+    if(histogram->TotalCount)
+    {
+        uint64 rank = (uint64)ceil((percentile / 100.0) * (real64)histogram->TotalCount);
+        if(rank < 1)
+        {
+            rank = 1;
+        }
+
+        uint64 running_count = 0;
+        for(uint32 counts_idx = 0; counts_idx < HDR_COUNTS_COUNT; ++counts_idx)
+        {
+            running_count += histogram->Counts[counts_idx];
+            if(running_count >= rank)
+            {
+                result = HdrGetHighestEquivalentValue(counts_idx);
+                break;
+            }
+        }
+
+        if(result > histogram->Max)
+        {
+            result = histogram->Max;
+        }
+    }
+
+    return result;
+}
+
+inline void TelemetryRecordSeconds(frame_telemetry *telemetry, telemetry_timing timing, real32 seconds)
+{
+    if(seconds < 0.0f)
+    {
+        seconds = 0.0f;
+    }
+
+    real64 microseconds = 1000000.0 * (real64)seconds;
+    if(microseconds > 4294967295.0)
+    {
+        microseconds = 4294967295.0;
+    }
+
+    HdrRecordValue(&telemetry->Timings[timing], (uint32)microseconds);
+}
+
+// NOTE: after the app has filled the sound buffer
+inline void TelemetryRecordEffects(frame_telemetry *telemetry, application_sound_output_buffer *sound_buffer)
+{
+    telemetry->EffectsCycleCount += sound_buffer->EffectsCycleCount;
+    telemetry->EffectsFrameCount += sound_buffer->SampleCount;
+    telemetry->EffectsBlockCount += sound_buffer->EffectsBlockCount;
+    telemetry->EffectsSamplesPerSecond = sound_buffer->SamplesPerSecond;
+}
+
+struct telemetry_timing_summary
+{
+    uint64 Count;
+    real64 MinMs;
+    real64 P50Ms;
+    real64 P90Ms;
+    real64 P99Ms;
+    real64 P999Ms;
+    real64 MaxMs;
+    real64 MeanMs;
+};
+
+internal telemetry_timing_summary TelemetrySummarizeTiming(hdr_histogram *histogram)
+{
+    telemetry_timing_summary result = {};
+    result.Count = histogram->TotalCount;
+    if(histogram->TotalCount)
+    {
+        result.MinMs = histogram->Min / 1000.0;
+        result.P50Ms = HdrValueAtPercentile(histogram, 50.0) / 1000.0;
+        result.P90Ms = HdrValueAtPercentile(histogram, 90.0) / 1000.0;
+        result.P99Ms = HdrValueAtPercentile(histogram, 99.0) / 1000.0;
+        result.P999Ms = HdrValueAtPercentile(histogram, 99.9) / 1000.0;
+        result.MaxMs = histogram->Max / 1000.0;
+        result.MeanMs = ((real64)histogram->Sum / (real64)histogram->TotalCount) / 1000.0;
+    }
+    return result;
+}
+
+// appends to the text in dest, keeps it null terminated and never overruns dest_size
+inline int TelemetryAppend(char *dest, int dest_size, int at, char *format, ...)
+{
+    if(at < dest_size)
+    {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(dest + at, (size_t)(dest_size - at), format, args);
+        va_end(args);
+
+        if(written > 0)
+        {
+            at += written;
+        }
+    }
+
+    if(at >= dest_size)
+    {
+        at = dest_size - 1;
+    }
+    return at;
+}
+
+inline real64 TelemetryResampleCyclesPerFrame(frame_telemetry *telemetry)
+{
+    real64 result = 0.0;
+    if(telemetry->ResampledFrameCount)
+    {
+        result = (real64)telemetry->ResampleCycleCount / (real64)telemetry->ResampledFrameCount;
+    }
+    return result;
+}
+
+inline real64 TelemetryEffectsCyclesPerFrame(frame_telemetry *telemetry)
+{
+    real64 result = 0.0;
+    if(telemetry->EffectsFrameCount)
+    {
+        result = (real64)telemetry->EffectsCycleCount / (real64)telemetry->EffectsFrameCount;
+    }
+    return result;
+}
+
+inline real64 TelemetryEffectsCyclesPerBlock(frame_telemetry *telemetry)
+{
+    real64 result = 0.0;
+    if(telemetry->EffectsBlockCount)
+    {
+        result = (real64)telemetry->EffectsCycleCount / (real64)telemetry->EffectsBlockCount;
+    }
+    return result;
+}
+
+// NOTE: how much of the time the samples take to play the effects took to work out
+inline real64 TelemetryEffectsBudgetPercent(frame_telemetry *telemetry)
+{
+    real64 result = 0.0;
+    if(telemetry->CyclesPerSecond > 0.0)
+    {
+        result = 100.0 * TelemetryEffectsCyclesPerFrame(telemetry) * (real64)telemetry->EffectsSamplesPerSecond /
+                 telemetry->CyclesPerSecond;
+    }
+    return result;
+}
+
+// the query reports how many arenas there are even when they don't all fit
+inline uint32 TelemetryArenaCount(frame_telemetry *telemetry)
+{
+    uint32 result = telemetry->ArenaCount;
+    if(result > TELEMETRY_MAX_ARENA_COUNT)
+    {
+        result = TELEMETRY_MAX_ARENA_COUNT;
+    }
+    return result;
+}
+
+// human readable summary, returns the length of the text written into dest
+internal int TelemetryFormatText(frame_telemetry *telemetry, char *dest, int dest_size)
+{
+    real64 missed_percent = 0.0;
+    if(telemetry->FrameCount)
+    {
+        missed_percent = 100.0 * (real64)telemetry->MissedFrameCount / (real64)telemetry->FrameCount;
+    }
+
+    int at = 0;
+    at = TelemetryAppend(dest, dest_size, at, "frames: %llu  target: %.3fms\n",
+                         (unsigned long long)telemetry->FrameCount,
+                         1000.0 * telemetry->TargetSecondsPerFrame);
+    at = TelemetryAppend(dest, dest_size, at, "missed frames: %llu (%.2f%%)  audio underruns: %llu\n",
+                         (unsigned long long)telemetry->MissedFrameCount, missed_percent,
+                         (unsigned long long)telemetry->AudioUnderrunCount);
+    at = TelemetryAppend(dest, dest_size, at, "resample: %.1f cycles per output frame\n",
+                         TelemetryResampleCyclesPerFrame(telemetry));
+    at = TelemetryAppend(dest, dest_size, at, "effects: %.1f cycles per frame, %.0f per block (%.2f%% of the audio budget)\n",
+                         TelemetryEffectsCyclesPerFrame(telemetry), TelemetryEffectsCyclesPerBlock(telemetry),
+                         TelemetryEffectsBudgetPercent(telemetry));
+    at = TelemetryAppend(dest, dest_size, at, "%-14s %8s %9s %9s %9s %9s %9s %9s %9s\n",
+                         "timing (ms)", "count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+
+    for(int timing_idx = 0; timing_idx < TelemetryTiming_Count; ++timing_idx)
+    {
+        telemetry_timing_summary summary = TelemetrySummarizeTiming(&telemetry->Timings[timing_idx]);
+        at = TelemetryAppend(dest, dest_size, at, "%-14s %8llu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+                             TelemetryTimingNames[timing_idx], (unsigned long long)summary.Count,
+                             summary.MinMs, summary.P50Ms, summary.P90Ms, summary.P99Ms,
+                             summary.P999Ms, summary.MaxMs, summary.MeanMs);
+    }
+
+    at = TelemetryAppend(dest, dest_size, at, "%-14s %10s %10s %10s %9s %9s %10s %10s\n",
+                         "memory (KB)", "size", "used", "peak", "allocs", "wasted", "last frame", "peak frame");
+    uint32 arena_count = TelemetryArenaCount(telemetry);
+    for(uint32 arena_idx = 0; arena_idx < arena_count; ++arena_idx)
+    {
+        debug_arena_info *arena = telemetry->Arenas + arena_idx;
+        at = TelemetryAppend(dest, dest_size, at, "%-14s %10.1f %10.1f %10.1f %9llu %9.1f %10.1f %10.1f\n",
+                             arena->Name, arena->Size / 1024.0, arena->Used / 1024.0, arena->PeakUsed / 1024.0,
+                             (unsigned long long)arena->AllocationCount, arena->WastedBytes / 1024.0,
+                             arena->LastFrameBytes / 1024.0, arena->PeakFrameBytes / 1024.0);
+
+        for(int tag_idx = 0; tag_idx < MemoryTag_Count; ++tag_idx)
+        {
+            memory_tag_stats *tag = arena->Tags + tag_idx;
+            if(tag->AllocationCount)
+            {
+                at = TelemetryAppend(dest, dest_size, at, "  %-12s %10s %10.1f %10.1f %9llu %9.1f\n",
+                                     MemoryTagNames[tag_idx], "", tag->Used / 1024.0, tag->PeakUsed / 1024.0,
+                                     (unsigned long long)tag->AllocationCount, tag->WastedBytes / 1024.0);
+            }
+        }
+    }
+
+    return at;
+}
+
+// machine readable summary, returns the length of the text written into dest
+internal int TelemetryFormatJson(frame_telemetry *telemetry, char *dest, int dest_size)
+{
+    int at = 0;
+    at = TelemetryAppend(dest, dest_size, at,
+                         "{\n  \"frames\": %llu,\n  \"missed_frames\": %llu,\n"
+                         "  \"audio_underruns\": %llu,\n  \"target_frame_ms\": %.3f,\n"
+                         "  \"resample_cycles_per_frame\": %.1f,\n"
+                         "  \"effects_cycles_per_frame\": %.1f,\n  \"effects_cycles_per_block\": %.0f,\n"
+                         "  \"effects_budget_percent\": %.2f,\n  \"timings\": {\n",
+                         (unsigned long long)telemetry->FrameCount,
+                         (unsigned long long)telemetry->MissedFrameCount,
+                         (unsigned long long)telemetry->AudioUnderrunCount,
+                         1000.0 * telemetry->TargetSecondsPerFrame,
+                         TelemetryResampleCyclesPerFrame(telemetry),
+                         TelemetryEffectsCyclesPerFrame(telemetry), TelemetryEffectsCyclesPerBlock(telemetry),
+                         TelemetryEffectsBudgetPercent(telemetry));
+
+    for(int timing_idx = 0; timing_idx < TelemetryTiming_Count; ++timing_idx)
+    {
+        telemetry_timing_summary summary = TelemetrySummarizeTiming(&telemetry->Timings[timing_idx]);
+        at = TelemetryAppend(dest, dest_size, at,
+                             "    \"%s\": {\"count\": %llu, \"min_ms\": %.3f, \"p50_ms\": %.3f, "
+                             "\"p90_ms\": %.3f, \"p99_ms\": %.3f, \"p999_ms\": %.3f, "
+                             "\"max_ms\": %.3f, \"mean_ms\": %.3f}%s\n",
+                             TelemetryTimingNames[timing_idx], (unsigned long long)summary.Count,
+                             summary.MinMs, summary.P50Ms, summary.P90Ms, summary.P99Ms,
+                             summary.P999Ms, summary.MaxMs, summary.MeanMs,
+                             (timing_idx + 1 < TelemetryTiming_Count) ? "," : "");
+    }
+
+    at = TelemetryAppend(dest, dest_size, at, "  },\n  \"arenas\": [\n");
+    uint32 arena_count = TelemetryArenaCount(telemetry);
+    for(uint32 arena_idx = 0; arena_idx < arena_count; ++arena_idx)
+    {
+        debug_arena_info *arena = telemetry->Arenas + arena_idx;
+        at = TelemetryAppend(dest, dest_size, at,
+                             "    {\"name\": \"%s\", \"size\": %llu, \"used\": %llu, \"peak\": %llu, "
+                             "\"allocations\": %llu, \"wasted\": %llu, \"last_frame_bytes\": %llu, "
+                             "\"last_frame_allocations\": %llu, \"peak_frame_bytes\": %llu, \"tags\": {",
+                             arena->Name, (unsigned long long)arena->Size, (unsigned long long)arena->Used,
+                             (unsigned long long)arena->PeakUsed, (unsigned long long)arena->AllocationCount,
+                             (unsigned long long)arena->WastedBytes, (unsigned long long)arena->LastFrameBytes,
+                             (unsigned long long)arena->LastFrameAllocationCount,
+                             (unsigned long long)arena->PeakFrameBytes);
+
+        bool32 is_first_tag = true;
+        for(int tag_idx = 0; tag_idx < MemoryTag_Count; ++tag_idx)
+        {
+            memory_tag_stats *tag = arena->Tags + tag_idx;
+            if(tag->AllocationCount)
+            {
+                at = TelemetryAppend(dest, dest_size, at,
+                                     "%s\"%s\": {\"used\": %llu, \"peak\": %llu, \"allocations\": %llu, \"wasted\": %llu}",
+                                     is_first_tag ? "" : ", ", MemoryTagNames[tag_idx],
+                                     (unsigned long long)tag->Used, (unsigned long long)tag->PeakUsed,
+                                     (unsigned long long)tag->AllocationCount, (unsigned long long)tag->WastedBytes);
+                is_first_tag = false;
+            }
+        }
+
+        at = TelemetryAppend(dest, dest_size, at, "}}%s\n", (arena_idx + 1 < arena_count) ? "," : "");
+    }
+
+    at = TelemetryAppend(dest, dest_size, at, "  ]\n}\n");
+    return at;
+}
+
+#define APPLICATION_TELEMETRY_H
+#endif
@@ -0,0 +1,473 @@
+/*
+
+  Tile map, see application_tile_map.h
+
+  Author: Justin Morrow
+
+*/
+
+inline uint32 HashTileChunkCoordinates(int32 chunk_x, int32 chunk_y)
+{
+    // NOTE: both coordinates packed into one key, then a 64 bit finalizer mix
+    uint64 key = ((uint64)(uint32)chunk_x << 32) | (uint64)(uint32)chunk_y;
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return (uint32)key;
+}
+
+internal void InitializeTileChunkTable(tile_chunk_table *table, memory_arena *arena, uint32 chunk_capacity)
+{
+    uint32 hash_slot_count = 16;
+    while(hash_slot_count < 2*chunk_capacity)
+    {
+        hash_slot_count <<= 1;
+    }
+
+    table->ChunkCapacity = chunk_capacity;
+    table->ChunkCount = 0;
+    table->Chunks = PushArray(arena, chunk_capacity, tile_chunk);
+    table->NextFreeChunk = PushArray(arena, chunk_capacity, uint32);
+    table->HashMask = hash_slot_count - 1;
+    table->HashSlots = PushArray(arena, hash_slot_count, uint32);
+
+    for(uint32 chunk_idx = 0; chunk_idx < chunk_capacity; ++chunk_idx)
+    {
+        table->NextFreeChunk[chunk_idx] = chunk_idx + 1;
+    }
+    table->NextFreeChunk[chunk_capacity - 1] = TILE_CHUNK_INVALID_INDEX;
+    table->FirstFreeChunk = 0;
+
+    for(uint32 slot_idx = 0; slot_idx < hash_slot_count; ++slot_idx)
+    {
+        table->HashSlots[slot_idx] = 0;
+    }
+
+    table->CleanList.FirstChunk = table->CleanList.LastChunk = TILE_CHUNK_INVALID_INDEX;
+    table->DirtyList.FirstChunk = table->DirtyList.LastChunk = TILE_CHUNK_INVALID_INDEX;
+}
+
+// the hash slot that holds the chunk, or TILE_CHUNK_INVALID_INDEX
+internal uint32 FindTileChunkSlot(tile_chunk_table *table, int32 chunk_x, int32 chunk_y)
+{
+    uint32 result = TILE_CHUNK_INVALID_INDEX;
+
+    uint32 slot_idx = HashTileChunkCoordinates(chunk_x, chunk_y) & table->HashMask;
+    while(table->HashSlots[slot_idx])
+    {
+        tile_chunk *chunk = table->Chunks + (table->HashSlots[slot_idx] - 1);
+        if((chunk->ChunkX == chunk_x) && (chunk->ChunkY == chunk_y))
+        {
+            result = slot_idx;
+            break;
+        }
+        slot_idx = (slot_idx + 1) & table->HashMask;
+    }
+
+    return result;
+}
+
+inline tile_chunk *FindTileChunk(tile_chunk_table *table, int32 chunk_x, int32 chunk_y)
+{
+    tile_chunk *result = 0;
+    uint32 slot_idx = FindTileChunkSlot(table, chunk_x, chunk_y);
+    if(slot_idx != TILE_CHUNK_INVALID_INDEX)
+    {
+        result = table->Chunks + (table->HashSlots[slot_idx] - 1);
+    }
+    return result;
+}
+
+inline tile_chunk_list *GetTileChunkList(tile_chunk_table *table, tile_chunk *chunk)
+{
+    tile_chunk_list *result = (chunk->Flags & TileChunkFlag_Dirty) ? &table->DirtyList : &table->CleanList;
+    return result;
+}
+
+internal void LinkTileChunk(tile_chunk_table *table, uint32 chunk_idx)
+{
+    tile_chunk *chunk = table->Chunks + chunk_idx;
+    tile_chunk_list *list = GetTileChunkList(table, chunk);
+
+    chunk->PrevChunk = TILE_CHUNK_INVALID_INDEX;
+    chunk->NextChunk = list->FirstChunk;
+    if(list->FirstChunk != TILE_CHUNK_INVALID_INDEX)
+    {
+        table->Chunks[list->FirstChunk].PrevChunk = chunk_idx;
+    }
+    else
+    {
+        list->LastChunk = chunk_idx;
+    }
+    list->FirstChunk = chunk_idx;
+}
+
+internal void UnlinkTileChunk(tile_chunk_table *table, uint32 chunk_idx)
+{
+    tile_chunk *chunk = table->Chunks + chunk_idx;
+    tile_chunk_list *list = GetTileChunkList(table, chunk);
+
+    if(chunk->PrevChunk != TILE_CHUNK_INVALID_INDEX)
+    {
+        table->Chunks[chunk->PrevChunk].NextChunk = chunk->NextChunk;
+    }
+    else
+    {
+        list->FirstChunk = chunk->NextChunk;
+    }
+
+    if(chunk->NextChunk != TILE_CHUNK_INVALID_INDEX)
+    {
+        table->Chunks[chunk->NextChunk].PrevChunk = chunk->PrevChunk;
+    }
+    else
+    {
+        list->LastChunk = chunk->PrevChunk;
+    }
+}
+
+// the table must have room and must not already hold the chunk, the tiles are left as they were
+internal tile_chunk *InsertTileChunk(tile_chunk_table *table, int32 chunk_x, int32 chunk_y, uint32 flags)
+{
+    Assert(table->FirstFreeChunk != TILE_CHUNK_INVALID_INDEX);
+    Assert(FindTileChunkSlot(table, chunk_x, chunk_y) == TILE_CHUNK_INVALID_INDEX);
+
+    uint32 chunk_idx = table->FirstFreeChunk;
+    table->FirstFreeChunk = table->NextFreeChunk[chunk_idx];
+    ++table->ChunkCount;
+
+    uint32 slot_idx = HashTileChunkCoordinates(chunk_x, chunk_y) & table->HashMask;
+    while(table->HashSlots[slot_idx])
+    {
+        slot_idx = (slot_idx + 1) & table->HashMask;
+    }
+    table->HashSlots[slot_idx] = chunk_idx + 1;
+
+    tile_chunk *result = table->Chunks + chunk_idx;
+    result->ChunkX = chunk_x;
+    result->ChunkY = chunk_y;
+    result->Flags = flags;
+    result->LastTouchedFrame = 0;
+    LinkTileChunk(table, chunk_idx);
+    return result;
+}
+
+internal void RemoveTileChunk(tile_chunk_table *table, uint32 slot_idx)
+{
+    uint32 chunk_idx = table->HashSlots[slot_idx] - 1;
+    UnlinkTileChunk(table, chunk_idx);
+    table->NextFreeChunk[chunk_idx] = table->FirstFreeChunk;
+    table->FirstFreeChunk = chunk_idx;
+    --table->ChunkCount;
+
+    // NOTE: backward shift deletion, pull later entries of the probe run into the hole so
+    // lookups never stop early at it
+    uint32 hole_idx = slot_idx;
+    uint32 next_idx = slot_idx;
+    for(;;)
+    {
+        next_idx = (next_idx + 1) & table->HashMask;
+        if(!table->HashSlots[next_idx])
+        {
+            break;
+        }
+
+        tile_chunk *chunk = table->Chunks + (table->HashSlots[next_idx] - 1);
+        uint32 home_idx = HashTileChunkCoordinates(chunk->ChunkX, chunk->ChunkY) & table->HashMask;
+
+        // NOTE: entries whose home is cyclically in (hole, next] are still reachable, leave them
+        bool32 stays = (hole_idx <= next_idx) ?
+            ((hole_idx < home_idx) && (home_idx <= next_idx)) :
+            ((hole_idx < home_idx) || (home_idx <= next_idx));
+        if(!stays)
+        {
+            table->HashSlots[hole_idx] = table->HashSlots[next_idx];
+            hole_idx = next_idx;
+        }
+    }
+    table->HashSlots[hole_idx] = 0;
+}
+
+inline void RemoveTileChunk(tile_chunk_table *table, tile_chunk *chunk)
+{
+    uint32 slot_idx = FindTileChunkSlot(table, chunk->ChunkX, chunk->ChunkY);
+    Assert(slot_idx != TILE_CHUNK_INVALID_INDEX);
+    RemoveTileChunk(table, slot_idx);
+}
+
+// the least recently touched chunk on the list if it wasn't touched this frame, otherwise 0
+inline tile_chunk *GetTileChunkVictim(tile_chunk_table *table, tile_chunk_list *list, uint32 current_frame)
+{
+    // NOTE: lists are kept in touch order, if the last chunk was touched this frame they all were
+    tile_chunk *result = 0;
+    if(list->LastChunk != TILE_CHUNK_INVALID_INDEX)
+    {
+        tile_chunk *chunk = table->Chunks + list->LastChunk;
+        if(chunk->LastTouchedFrame != current_frame)
+        {
+            result = chunk;
+        }
+    }
+    return result;
+}
+
+// the least recently touched chunk of either list that wasn't touched this frame, or 0
+internal tile_chunk *GetTileChunkVictim(tile_chunk_table *table, uint32 current_frame)
+{
+    tile_chunk *clean = GetTileChunkVictim(table, &table->CleanList, current_frame);
+    tile_chunk *dirty = GetTileChunkVictim(table, &table->DirtyList, current_frame);
+
+    tile_chunk *result = clean;
+    if(dirty && (!clean || (dirty->LastTouchedFrame < clean->LastTouchedFrame)))
+    {
+        result = dirty;
+    }
+    return result;
+}
+
+internal void InitializeTileMap(tile_map *tile_map, memory_arena *resident_arena, memory_arena *cold_arena,
+                                uint32 resident_chunk_count, uint32 cold_chunk_count, uint32 seed)
+{
+    tile_map->TileSizeInPixels = 32;
+    tile_map->Seed = seed;
+    tile_map->CurrentFrame = 1;
+    InitializeTileChunkTable(&tile_map->Resident, resident_arena, resident_chunk_count);
+    InitializeTileChunkTable(&tile_map->Cold, cold_arena, cold_chunk_count);
+}
+
+// chunks touched this frame are never paged out, so call once per frame before touching any
+inline void BeginTileMapFrame(tile_map *tile_map)
+{
+    ++tile_map->CurrentFrame;
+}
+
+inline uint8 GenerateTileValue(tile_map *tile_map, int32 tile_x, int32 tile_y)
+{
+    uint32 hash = HashTileChunkCoordinates(tile_x, tile_y) ^ tile_map->Seed;
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6D;
+    hash ^= hash >> 12;
+
+    uint8 result = 0;
+    uint32 roll = hash & 0xFF;
+    if(roll < 3)
+    {
+        result = 2;
+    }
+    else if(roll < 24)
+    {
+        result = 1;
+    }
+    return result;
+}
+
+internal void GenerateTileChunk(tile_map *tile_map, tile_chunk *chunk)
+{
+    int32 first_tile_x = chunk->ChunkX*TILE_CHUNK_DIM;
+    int32 first_tile_y = chunk->ChunkY*TILE_CHUNK_DIM;
+    for(int32 y = 0; y < TILE_CHUNK_DIM; ++y)
+    {
+        for(int32 x = 0; x < TILE_CHUNK_DIM; ++x)
+        {
+            chunk->Tiles[y*TILE_CHUNK_DIM + x] = GenerateTileValue(tile_map, first_tile_x + x, first_tile_y + y);
+        }
+    }
+    ++tile_map->ChunksGenerated;
+}
+
+inline void CopyTileChunkTiles(tile_chunk *dest, tile_chunk *source)
+{
+    uint64 *dest_tiles = (uint64 *)dest->Tiles;
+    uint64 *source_tiles = (uint64 *)source->Tiles;
+    for(int idx = 0; idx < (int)(sizeof(dest->Tiles) / sizeof(uint64)); ++idx)
+    {
+        dest_tiles[idx] = source_tiles[idx];
+    }
+}
+
+// make room for one more resident chunk, false when every chunk that could go is edited
+internal bool32 PageOutTileChunk(tile_map *tile_map)
+{
+    tile_chunk *victim = GetTileChunkVictim(&tile_map->Resident, tile_map->CurrentFrame);
+    if(!victim)
+    {
+        // NOTE: more chunks in view than there are resident chunks
+        return false;
+    }
+
+    if(tile_map->Cold.ChunkCount == tile_map->Cold.ChunkCapacity)
+    {
+        // NOTE: clean chunks come back identical from the generator, so dropping those costs
+        // nothing. Cold chunks are never touched, so any of them will do.
+        tile_chunk *dropped = GetTileChunkVictim(&tile_map->Cold, &tile_map->Cold.CleanList, tile_map->CurrentFrame);
+        if(dropped)
+        {
+            RemoveTileChunk(&tile_map->Cold, dropped);
+            ++tile_map->ChunksDropped;
+        }
+        else
+        {
+            // NOTE: the cold table is all edits, the only thing left to give up is a clean
+            // resident chunk
+            dropped = GetTileChunkVictim(&tile_map->Resident, &tile_map->Resident.CleanList, tile_map->CurrentFrame);
+            if(dropped)
+            {
+                RemoveTileChunk(&tile_map->Resident, dropped);
+                ++tile_map->ChunksDropped;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    tile_chunk *cold_chunk = InsertTileChunk(&tile_map->Cold, victim->ChunkX, victim->ChunkY, victim->Flags);
+    cold_chunk->LastTouchedFrame = victim->LastTouchedFrame;
+    CopyTileChunkTiles(cold_chunk, victim);
+    RemoveTileChunk(&tile_map->Resident, victim);
+    ++tile_map->ChunksPagedOut;
+    return true;
+}
+
+// bring the cold chunk in by trading places with the least recently touched resident chunk, the victim
+// goes into the cold chunk the request leaves behind so neither table has to drop anything. 0 when
+// every resident chunk was touched this frame
+internal tile_chunk *SwapInTileChunk(tile_map *tile_map, uint32 cold_slot)
+{
+    tile_chunk *victim = GetTileChunkVictim(&tile_map->Resident, tile_map->CurrentFrame);
+    if(!victim)
+    {
+        return 0;
+    }
+
+    // NOTE: the cold chunk's storage is reused for the victim, so hold on to it while they trade
+    tile_chunk paged_in = tile_map->Cold.Chunks[tile_map->Cold.HashSlots[cold_slot] - 1];
+    RemoveTileChunk(&tile_map->Cold, cold_slot);
+
+    tile_chunk *cold_chunk = InsertTileChunk(&tile_map->Cold, victim->ChunkX, victim->ChunkY, victim->Flags);
+    cold_chunk->LastTouchedFrame = victim->LastTouchedFrame;
+    CopyTileChunkTiles(cold_chunk, victim);
+    RemoveTileChunk(&tile_map->Resident, victim);
+    ++tile_map->ChunksPagedOut;
+
+    tile_chunk *result = InsertTileChunk(&tile_map->Resident, paged_in.ChunkX, paged_in.ChunkY, paged_in.Flags);
+    CopyTileChunkTiles(result, &paged_in);
+    ++tile_map->ChunksPagedIn;
+    return result;
+}
+
+// the resident chunk, paged in or generated on demand. When the map has overflowed this is
+// OverflowChunk instead, which has the right tiles but can't be edited.
+internal tile_chunk *GetTileChunk(tile_map *tile_map, int32 chunk_x, int32 chunk_y)
+{
+    tile_chunk *chunk = FindTileChunk(&tile_map->Resident, chunk_x, chunk_y);
+    if(!chunk)
+    {
+        uint32 cold_slot = FindTileChunkSlot(&tile_map->Cold, chunk_x, chunk_y);
+        tile_chunk *cold_chunk = 0;
+        if(cold_slot != TILE_CHUNK_INVALID_INDEX)
+        {
+            cold_chunk = tile_map->Cold.Chunks + (tile_map->Cold.HashSlots[cold_slot] - 1);
+        }
+
+        if(tile_map->Resident.ChunkCount < tile_map->Resident.ChunkCapacity)
+        {
+            chunk = InsertTileChunk(&tile_map->Resident, chunk_x, chunk_y, cold_chunk ? cold_chunk->Flags : 0);
+            if(cold_chunk)
+            {
+                CopyTileChunkTiles(chunk, cold_chunk);
+                RemoveTileChunk(&tile_map->Cold, cold_slot);
+                ++tile_map->ChunksPagedIn;
+            }
+            else
+            {
+                GenerateTileChunk(tile_map, chunk);
+            }
+        }
+        else if(cold_chunk)
+        {
+            // NOTE: a chunk that is already cold always has somewhere for the victim to go, this is
+            // what keeps edited chunks editable when both tables are full of edits
+            chunk = SwapInTileChunk(tile_map, cold_slot);
+        }
+        else if(PageOutTileChunk(tile_map))
+        {
+            chunk = InsertTileChunk(&tile_map->Resident, chunk_x, chunk_y, 0);
+            GenerateTileChunk(tile_map, chunk);
+        }
+
+        if(!chunk)
+        {
+            chunk = &tile_map->OverflowChunk;
+            if((chunk->ChunkX != chunk_x) || (chunk->ChunkY != chunk_y) ||
+               (chunk->LastTouchedFrame != tile_map->CurrentFrame))
+            {
+                chunk->ChunkX = chunk_x;
+                chunk->ChunkY = chunk_y;
+                chunk->Flags = 0;
+                if(cold_chunk)
+                {
+                    CopyTileChunkTiles(chunk, cold_chunk);
+                }
+                else
+                {
+                    GenerateTileChunk(tile_map, chunk);
+                }
+                ++tile_map->ChunksOverflowed;
+            }
+            chunk->LastTouchedFrame = tile_map->CurrentFrame;
+            return chunk;
+        }
+    }
+
+    if(chunk->LastTouchedFrame != tile_map->CurrentFrame)
+    {
+        // NOTE: only the first touch in a frame moves the chunk, that keeps the lists in frame order
+        uint32 chunk_idx = (uint32)(chunk - tile_map->Resident.Chunks);
+        UnlinkTileChunk(&tile_map->Resident, chunk_idx);
+        LinkTileChunk(&tile_map->Resident, chunk_idx);
+        chunk->LastTouchedFrame = tile_map->CurrentFrame;
+    }
+    return chunk;
+}
+
+inline uint8 GetTileValue(tile_map *tile_map, int32 tile_x, int32 tile_y)
+{
+    tile_chunk *chunk = GetTileChunk(tile_map, tile_x >> TILE_CHUNK_SHIFT, tile_y >> TILE_CHUNK_SHIFT);
+    uint8 result = chunk->Tiles[(tile_y & TILE_CHUNK_MASK)*TILE_CHUNK_DIM + (tile_x & TILE_CHUNK_MASK)];
+    return result;
+}
+
+// false when the map has overflowed and the edit was refused
+internal bool32 SetTileValue(tile_map *tile_map, int32 tile_x, int32 tile_y, uint8 value)
+{
+    tile_chunk *chunk = GetTileChunk(tile_map, tile_x >> TILE_CHUNK_SHIFT, tile_y >> TILE_CHUNK_SHIFT);
+    if(chunk == &tile_map->OverflowChunk)
+    {
+        ++tile_map->EditsRefused;
+        return false;
+    }
+
+    chunk->Tiles[(tile_y & TILE_CHUNK_MASK)*TILE_CHUNK_DIM + (tile_x & TILE_CHUNK_MASK)] = value;
+    if(!(chunk->Flags & TileChunkFlag_Dirty))
+    {
+        uint32 chunk_idx = (uint32)(chunk - tile_map->Resident.Chunks);
+        UnlinkTileChunk(&tile_map->Resident, chunk_idx);
+        chunk->Flags |= TileChunkFlag_Dirty;
+        LinkTileChunk(&tile_map->Resident, chunk_idx);
+    }
+    ++tile_map->Version;
+    return true;
+}
+
+// floor division for world pixel -> tile coordinates that may be negative
+inline int32 FloorDivide(int32 numerator, int32 denominator)
+{
+    int32 result = numerator / denominator;
+    if((numerator % denominator) && ((numerator < 0) != (denominator < 0)))
+    {
+        --result;
+    }
+    return result;
+}
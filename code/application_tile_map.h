@@ -0,0 +1,101 @@
+/*
+
+  Tile map. The world is an unbounded grid of tiles cut up into fixed size
+  chunks. Only chunks that have been looked at exist, they are found
+  through a hash table keyed by the packed chunk coordinates.
+
+  A limited number of chunks are resident in PermanentStorage. When the
+  resident pool runs out the least recently touched chunk is paged out to a
+  bigger cold table in the transient arena, and paged back in the next time
+  it is needed. Chunks that were never edited can always be generated
+  again, so those are the first to go when the cold table fills up.
+
+  Edited chunks are never thrown away. Each table keeps its clean and its
+  edited chunks on two lists in the order they were last touched, so the
+  chunk to page out or drop is always at the end of a list. A chunk that is
+  paged back in while the resident pool is full trades places with the
+  least recently touched resident chunk, so a cold chunk can always come
+  back and be edited again. If a chunk that is in neither table is asked
+  for and every chunk that could make room is edited, the map has
+  overflowed: that chunk is generated into OverflowChunk, which can be
+  looked at but not edited, and EditsRefused counts the edits that were
+  turned down. The same goes for any chunk while every resident chunk was
+  touched this frame.
+
+  Author: Justin Morrow
+
+*/
+
+#if !defined(APPLICATION_TILE_MAP_H)
+
+#define TILE_CHUNK_SHIFT 4
+#define TILE_CHUNK_DIM (1 << TILE_CHUNK_SHIFT)
+#define TILE_CHUNK_MASK (TILE_CHUNK_DIM - 1)
+
+#define TILE_CHUNK_INVALID_INDEX 0xFFFFFFFF
+
+enum tile_chunk_flag
+{
+    TileChunkFlag_Dirty = (1 << 0), // edited since it was generated, it can't just be thrown away
+};
+
+struct tile_chunk
+{
+    int32 ChunkX;
+    int32 ChunkY;
+    uint32 Flags;
+    uint32 LastTouchedFrame;
+
+    // NOTE: chunk indices on the table's clean or dirty list, TILE_CHUNK_INVALID_INDEX at the ends
+    uint32 PrevChunk;
+    uint32 NextChunk;
+
+    uint8 Tiles[TILE_CHUNK_DIM*TILE_CHUNK_DIM];
+};
+
+// most recently touched first
+struct tile_chunk_list
+{
+    uint32 FirstChunk;
+    uint32 LastChunk;
+};
+
+// a pool of chunks plus an open addressed (linear probing) hash table of indices into it
+struct tile_chunk_table
+{
+    uint32 ChunkCapacity;
+    uint32 ChunkCount;
+    tile_chunk *Chunks;
+    uint32 *NextFreeChunk;
+    uint32 FirstFreeChunk;
+
+    uint32 HashMask;
+    uint32 *HashSlots; // chunk index + 1, 0 is an empty slot
+
+    tile_chunk_list CleanList;
+    tile_chunk_list DirtyList;
+};
+
+struct tile_map
+{
+    int32 TileSizeInPixels;
+    uint32 Seed;
+    uint32 CurrentFrame;
+
+    tile_chunk_table Resident;
+    tile_chunk_table Cold;
+
+    uint32 ChunksGenerated;
+    uint32 ChunksPagedOut;
+    uint32 ChunksPagedIn;
+    uint32 ChunksDropped;
+    uint32 ChunksOverflowed;
+    uint32 EditsRefused;
+
+    tile_chunk OverflowChunk; // NOTE: read only, holds whatever chunk the map had no room for last
+
+    uint32 Version; // NOTE: bumped by every edit, whatever was drawn from the tiles before is stale
+};
+
+#define APPLICATION_TILE_MAP_H
+#endif
@@ -0,0 +1,114 @@
+/*
+
+  Tile map test. Edits one tile in more chunks than the resident and cold
+  tables hold together, so both end up full of edited chunks, then checks
+  that chunks which were paged out can still be edited, that a chunk in
+  neither table is refused, and that no edit was lost on the way.
+
+  Built and run by linux_build.sh, exits with 1 when a check fails.
+
+  Author: Justin Morrow
+
+*/
+
+#include "application.h"
+#include "application_tile_map.h"
+#include "application_tile_map.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_RESIDENT_CHUNK_COUNT 4
+#define TEST_COLD_CHUNK_COUNT 4
+#define TEST_EDITED_CHUNK_COUNT (TEST_RESIDENT_CHUNK_COUNT + TEST_COLD_CHUNK_COUNT)
+#define TEST_TILE_VALUE 7 // NOTE: the generator never makes this one
+
+global_variable int FailedCheckCount;
+
+internal void CheckTileMap(bool32 passed, char *description)
+{
+    if(!passed)
+    {
+        ++FailedCheckCount;
+    }
+    printf("%-60s %s\n", description, passed ? "ok" : "FAILED");
+}
+
+// NOTE: every test chunk gets its edit in its first tile, chunks go along a row
+inline bool32 EditTestChunk(tile_map *tile_map, int32 chunk_x, uint8 value)
+{
+    BeginTileMapFrame(tile_map);
+    bool32 result = SetTileValue(tile_map, chunk_x*TILE_CHUNK_DIM, 0, value);
+    return result;
+}
+
+inline uint8 ReadTestChunk(tile_map *tile_map, int32 chunk_x)
+{
+    BeginTileMapFrame(tile_map);
+    uint8 result = GetTileValue(tile_map, chunk_x*TILE_CHUNK_DIM, 0);
+    return result;
+}
+
+int main(int argument_count, char **arguments)
+{
+    uint64 arena_size = Kilobytes(64);
+    memory_arena resident_arena;
+    memory_arena cold_arena;
+    InitializeArena(&resident_arena, "resident", arena_size, calloc(1, arena_size));
+    InitializeArena(&cold_arena, "cold", arena_size, calloc(1, arena_size));
+
+    tile_map tile_map = {};
+    InitializeTileMap(&tile_map, &resident_arena, &cold_arena, TEST_RESIDENT_CHUNK_COUNT, TEST_COLD_CHUNK_COUNT, 1234);
+
+    bool32 all_edited = true;
+    for(int32 chunk_x = 0; chunk_x < TEST_EDITED_CHUNK_COUNT; ++chunk_x)
+    {
+        if(!EditTestChunk(&tile_map, chunk_x, TEST_TILE_VALUE))
+        {
+            all_edited = false;
+        }
+    }
+    CheckTileMap(all_edited, "edit as many chunks as both tables hold");
+    CheckTileMap((tile_map.Resident.DirtyList.FirstChunk != TILE_CHUNK_INVALID_INDEX) &&
+                 (tile_map.Resident.CleanList.FirstChunk == TILE_CHUNK_INVALID_INDEX) &&
+                 (tile_map.Resident.ChunkCount == TEST_RESIDENT_CHUNK_COUNT) &&
+                 (tile_map.Cold.CleanList.FirstChunk == TILE_CHUNK_INVALID_INDEX) &&
+                 (tile_map.Cold.ChunkCount == TEST_COLD_CHUNK_COUNT),
+                 "both tables full of edited chunks");
+
+    CheckTileMap(!EditTestChunk(&tile_map, TEST_EDITED_CHUNK_COUNT, TEST_TILE_VALUE) && (tile_map.EditsRefused == 1),
+                 "edit a chunk in neither table is refused");
+
+    // NOTE: chunk 0 was the first one paged out
+    CheckTileMap(FindTileChunk(&tile_map.Cold, 0, 0) != 0, "first chunk is cold");
+    CheckTileMap(EditTestChunk(&tile_map, 0, TEST_TILE_VALUE + 1), "edit the cold chunk");
+    CheckTileMap((FindTileChunk(&tile_map.Resident, 0, 0) != 0) && (tile_map.Cold.ChunkCount == TEST_COLD_CHUNK_COUNT),
+                 "cold chunk swapped with a resident one");
+
+    // NOTE: reading them all back pages every one of them in and out again
+    bool32 edits_kept = (ReadTestChunk(&tile_map, 0) == TEST_TILE_VALUE + 1);
+    for(int32 chunk_x = 1; chunk_x < TEST_EDITED_CHUNK_COUNT; ++chunk_x)
+    {
+        if(ReadTestChunk(&tile_map, chunk_x) != TEST_TILE_VALUE)
+        {
+            edits_kept = false;
+        }
+    }
+    CheckTileMap(edits_kept, "every edit kept");
+
+    bool32 cold_edits_allowed = true;
+    for(int32 chunk_x = 0; chunk_x < TEST_EDITED_CHUNK_COUNT; ++chunk_x)
+    {
+        if(!EditTestChunk(&tile_map, chunk_x, TEST_TILE_VALUE))
+        {
+            cold_edits_allowed = false;
+        }
+    }
+    CheckTileMap(cold_edits_allowed && (tile_map.EditsRefused == 1), "edit every chunk again");
+    CheckTileMap((tile_map.ChunksDropped == 0) &&
+                 (tile_map.Resident.ChunkCount + tile_map.Cold.ChunkCount == TEST_EDITED_CHUNK_COUNT),
+                 "no edited chunk dropped");
+
+    int result = FailedCheckCount ? 1 : 0;
+    return result;
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Builds the headless Linux host and the application library into ./build,
+# run from the repository root like win32_build.bat
+
+mkdir -p ./build
+pushd ./build > /dev/null
+
+linux_app_name=linux_application
+linux_flags="-std=c++17 -g -O2 -fno-exceptions -fno-rtti -msse2"
+linux_warn_flags="-Werror -Wall -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable -Wno-write-strings -Wno-sign-compare -Wno-missing-braces"
+linux_defines="-DAPPLICATION_INTERNAL=1 -DAPPLICATION_SLOW=1 -DAPPLICATION_LINUX=1"
+linux_libs="-lpthread -ldl"
+
+# linux compile
+c++ $linux_flags $linux_warn_flags $linux_defines -shared -fPIC -fvisibility=hidden ../code/application.cpp -o application.so || exit 1
+c++ $linux_flags $linux_warn_flags $linux_defines ../code/linux_platform_layer.cpp -o $linux_app_name $linux_libs || exit 1
+
+# audio clock test, a simulated sound device driven through application_audio_clock.h
+c++ $linux_flags $linux_warn_flags $linux_defines ../code/application_audio_clock_test.cpp -o application_audio_clock_test || exit 1
+./application_audio_clock_test || exit 1
+
+# entity test, stale and never issued handles and bouncing against application_entity.cpp
+c++ $linux_flags $linux_warn_flags $linux_defines ../code/application_entity_test.cpp -o application_entity_test || exit 1
+./application_entity_test || exit 1
+
+# tile map test, paging edited chunks between the resident and cold tables of application_tile_map.cpp
+c++ $linux_flags $linux_warn_flags $linux_defines ../code/application_tile_map_test.cpp -o application_tile_map_test || exit 1
+./application_tile_map_test || exit 1
+
+popd > /dev/null
@@ -0,0 +1,1783 @@
+/*
+    Headless Linux platform layer. Runs the application without a window,
+    sound device or controllers at a fixed update rate, for servers, batch
+    runs and crash triage. Sound is generated and thrown away so the app
+    runs exactly the code it runs on Win32.
+
+    application_memory is checkpointed by forking: the child sees the
+    memory frozen copy on write and copies it into a memfd in the
+    background, the parent only pays for the fork. A checkpoint can be
+    mapped straight back over application_memory to rewind to it.
+
+    With --instances it runs many independent copies of the app in one
+    process instead, for load tests and bot farms. Each copy gets its own
+    application_memory and the copies' frames are spread over a pool of
+    threads, see linux_batch in linux_platform_layer.h.
+
+    Author: Justin Morrow
+*/
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "application.h"
+#include "application_telemetry.h"
+#include "application_saved_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <x86intrin.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "linux_platform_layer.h"
+
+//
+// Dynamic load game code
+//
+
+internal linux_app_code LinuxLoadGameCode(char *filename)
+{
+    linux_app_code result = {};
+    result.AppCodeLibrary = dlopen(filename, RTLD_NOW|RTLD_LOCAL);
+
+    if(result.AppCodeLibrary)
+    {
+        result.UpdateAndRender = (app_update_and_render *)dlsym(result.AppCodeLibrary, "AppUpdateAndRender");
+        result.GetSoundSamples = (app_get_sound_samples *)dlsym(result.AppCodeLibrary, "AppGetSoundSamples");
+        result.DebugGetArenaInfo = (app_debug_get_arena_info *)dlsym(result.AppCodeLibrary, "AppDebugGetArenaInfo");
+        result.SaveState = (app_save_state *)dlsym(result.AppCodeLibrary, "AppSaveState");
+        result.LoadState = (app_load_state *)dlsym(result.AppCodeLibrary, "AppLoadState");
+        result.BeginRestoreState = (app_begin_restore_state *)dlsym(result.AppCodeLibrary, "AppBeginRestoreState");
+        result.EndRestoreState = (app_end_restore_state *)dlsym(result.AppCodeLibrary, "AppEndRestoreState");
+
+        result.IsValid = (result.UpdateAndRender && result.GetSoundSamples);
+    }
+    else
+    {
+        fprintf(stderr, "could not load %s: %s\n", filename, dlerror());
+    }
+
+    if(!result.IsValid)
+    {
+        result.UpdateAndRender = AppUpdateAndRenderStub;
+        result.GetSoundSamples = AppGetSoundSamplesStub;
+    }
+
+    // NOTE: optional, the app runs fine without it
+    if(!result.DebugGetArenaInfo)
+    {
+        result.DebugGetArenaInfo = AppDebugGetArenaInfoStub;
+    }
+    if(!result.SaveState || !result.LoadState)
+    {
+        result.SaveState = AppSaveStateStub;
+        result.LoadState = AppLoadStateStub;
+    }
+    if(!result.BeginRestoreState || !result.EndRestoreState)
+    {
+        result.BeginRestoreState = AppBeginRestoreStateStub;
+        result.EndRestoreState = AppEndRestoreStateStub;
+    }
+
+    return result;
+}
+
+//
+// Timing
+//
+
+inline uint64 LinuxGetWallClock()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64 result = (uint64)now.tv_sec*1000000000ULL + (uint64)now.tv_nsec;
+    return result;
+}
+
+inline real32 LinuxGetSecondsElapsed(uint64 start, uint64 end)
+{
+    real32 result = (real32)((real64)(end - start) / 1000000000.0);
+    return result;
+}
+
+//
+// File IO
+//
+
+internal bool32 LinuxWriteAll(int file_descriptor, void *data, uint64 size, uint64 offset)
+{
+    uint8 *at = (uint8 *)data;
+    while(size)
+    {
+        ssize_t bytes_written = pwrite(file_descriptor, at, (size_t)size, (off_t)offset);
+        if(bytes_written <= 0)
+        {
+            if((bytes_written < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            return false;
+        }
+        at += bytes_written;
+        offset += (uint64)bytes_written;
+        size -= (uint64)bytes_written;
+    }
+    return true;
+}
+
+internal bool32 LinuxReadAll(int file_descriptor, void *dest, uint64 size, uint64 offset)
+{
+    uint8 *at = (uint8 *)dest;
+    while(size)
+    {
+        ssize_t bytes_read = pread(file_descriptor, at, (size_t)size, (off_t)offset);
+        if(bytes_read <= 0)
+        {
+            if((bytes_read < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            return false;
+        }
+        at += bytes_read;
+        offset += (uint64)bytes_read;
+        size -= (uint64)bytes_read;
+    }
+    return true;
+}
+
+// NOTE: a rename only survives a crash once the directory that holds the file is flushed too
+internal bool32 LinuxFlushDirectoryOf(char *filename)
+{
+    bool32 result = false;
+
+    char directory[SAVED_FILE_MAX_FILENAME] = ".";
+    char *last_slash = strrchr(filename, '/');
+    if(last_slash)
+    {
+        size_t length = (last_slash == filename) ? 1 : (size_t)(last_slash - filename);
+        if(length < sizeof(directory))
+        {
+            memcpy(directory, filename, length);
+            directory[length] = 0;
+        }
+    }
+
+    int directory_fd = open(directory, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if(directory_fd >= 0)
+    {
+        result = (fsync(directory_fd) == 0);
+        close(directory_fd);
+    }
+    return result;
+}
+
+// write filename the way application_saved_file.h describes, blocks until it's on the disk
+internal bool32 LinuxSaveFileAtomically(char *filename, void *data, uint64 size)
+{
+    bool32 result = false;
+
+    char temp_filename[SAVED_FILE_MAX_FILENAME];
+    char prev_filename[SAVED_FILE_MAX_FILENAME];
+    if(GetSavedFileName(temp_filename, sizeof(temp_filename), filename, ".tmp") &&
+       GetSavedFileName(prev_filename, sizeof(prev_filename), filename, ".prev"))
+    {
+        saved_file_footer footer = MakeSavedFileFooter(data, size);
+
+        int file_descriptor = open(temp_filename, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+        if(file_descriptor >= 0)
+        {
+            bool32 written = (LinuxWriteAll(file_descriptor, data, size, 0) &&
+                              LinuxWriteAll(file_descriptor, &footer, sizeof(footer), size) &&
+                              (fsync(file_descriptor) == 0));
+            close(file_descriptor);
+
+            if(written)
+            {
+                // NOTE: the old save becomes .prev by hard link so filename never stops existing,
+                // there just isn't a .prev yet the first time
+                unlink(prev_filename);
+                link(filename, prev_filename);
+
+                if(rename(temp_filename, filename) == 0)
+                {
+                    result = LinuxFlushDirectoryOf(filename);
+                }
+            }
+
+            if(!result)
+            {
+                unlink(temp_filename);
+            }
+        }
+    }
+
+    return result;
+}
+
+#if APPLICATION_INTERNAL
+// DEBUG: free file memory
+DEBUG_PLATFORM_FREE_FILE_MEMORY(DEBUGPlatformFreeFileMemory)
+{
+    free(memory);
+}
+
+// DEBUG: read the contents of a file
+DEBUG_PLATFORM_READ_ENTIRE_FILE(DEBUGPlatformReadEntireFile)
+{
+    debug_read_file_result result = {};
+
+    int file_descriptor = open(filename, O_RDONLY);
+    if(file_descriptor >= 0)
+    {
+        struct stat file_stat;
+        if(fstat(file_descriptor, &file_stat) == 0)
+        {
+            uint32 file_size32 = SafeTruncateUInt64((uint64)file_stat.st_size);
+            result.Contents = malloc(file_size32 ? file_size32 : 1);
+            if(result.Contents && LinuxReadAll(file_descriptor, result.Contents, file_size32, 0))
+            {
+                result.ContentsSize = file_size32;
+            }
+            else
+            {
+                // TODO: Logging
+                DEBUGPlatformFreeFileMemory(result.Contents);
+                result.Contents = 0;
+            }
+        }
+
+        close(file_descriptor);
+    }
+
+    return(result);
+}
+
+// DEBUG: write bytes into a file
+DEBUG_PLATFORM_WRITE_ENTIRE_FILE(DEBUGPlatformWriteEntireFile)
+{
+    bool32 result = false;
+
+    int file_descriptor = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(file_descriptor >= 0)
+    {
+        result = LinuxWriteAll(file_descriptor, memory, memory_size, 0);
+        close(file_descriptor);
+    }
+
+    return(result);
+}
+#endif
+
+global_variable linux_file_queue GlobalFileQueue;
+
+// false when the file thread is a whole ring behind
+internal bool32 LinuxQueueFileRequest(linux_file_queue *queue, linux_file_request *file_request)
+{
+    bool32 result = false;
+    while(__atomic_exchange_n(&queue->Lock, 1, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+
+    uint32 write_idx = queue->WriteIndex;
+    if((write_idx - __atomic_load_n(&queue->ReadIndex, __ATOMIC_ACQUIRE)) < LINUX_FILE_REQUEST_RING_SIZE)
+    {
+        if(file_request->Request)
+        {
+            file_request->Request->State = PlatformFileRequest_Pending;
+            file_request->Request->BytesRead = 0;
+        }
+        queue->Requests[write_idx & (LINUX_FILE_REQUEST_RING_SIZE - 1)] = *file_request;
+
+        // NOTE: the request has to land before the index that publishes it
+        __atomic_store_n(&queue->WriteIndex, write_idx + 1, __ATOMIC_RELEASE);
+        sem_post(&queue->WakeSemaphore);
+        result = true;
+    }
+
+    __atomic_store_n(&queue->Lock, 0, __ATOMIC_RELEASE);
+    return result;
+}
+
+internal PLATFORM_OPEN_FILE(LinuxOpenFile)
+{
+    linux_file_request file_request = {};
+    file_request.Type = LinuxFileRequest_Open;
+    file_request.Request = request;
+    file_request.Filename = filename;
+    file_request.File = file;
+    bool32 result = LinuxQueueFileRequest(&GlobalFileQueue, &file_request);
+    return result;
+}
+
+internal PLATFORM_READ_DATA_FROM_FILE(LinuxReadDataFromFile)
+{
+    Assert(file->Platform);
+
+    linux_file_request file_request = {};
+    file_request.Type = LinuxFileRequest_Read;
+    file_request.Request = request;
+    file_request.FileDescriptor = (int)((intptr_t)file->Platform - 1);
+    file_request.Offset = offset;
+    file_request.Size = size;
+    file_request.Dest = dest;
+    bool32 result = LinuxQueueFileRequest(&GlobalFileQueue, &file_request);
+    return result;
+}
+
+internal PLATFORM_CLOSE_FILE(LinuxCloseFile)
+{
+    linux_file_request file_request = {};
+    file_request.Type = LinuxFileRequest_Close;
+    file_request.FileDescriptor = (int)((intptr_t)file->Platform - 1);
+    bool32 result = LinuxQueueFileRequest(&GlobalFileQueue, &file_request);
+    if(result)
+    {
+        file->Platform = 0;
+        file->Size = 0;
+    }
+    return result;
+}
+
+internal PLATFORM_SAVE_FILE(LinuxSaveFile)
+{
+    linux_file_request file_request = {};
+    file_request.Type = LinuxFileRequest_Save;
+    file_request.Request = request;
+    file_request.Filename = filename;
+    file_request.Size = size;
+    file_request.Dest = data;
+    bool32 result = LinuxQueueFileRequest(&GlobalFileQueue, &file_request);
+    return result;
+}
+
+// wait for the file thread to finish every request made so far, saves included
+internal void LinuxFinishFileRequests(linux_file_queue *queue)
+{
+    uint32 write_idx = __atomic_load_n(&queue->WriteIndex, __ATOMIC_ACQUIRE);
+    while(__atomic_load_n(&queue->DoneIndex, __ATOMIC_ACQUIRE) != write_idx)
+    {
+        usleep(1000);
+    }
+}
+
+internal void *LinuxFileThreadProc(void *parameter)
+{
+    linux_file_queue *queue = (linux_file_queue *)parameter;
+    for(;;)
+    {
+        while(sem_wait(&queue->WakeSemaphore) != 0)
+        {
+            // NOTE: interrupted, the fork for a checkpoint can do that
+        }
+
+        uint32 read_idx = queue->ReadIndex;
+        Assert(read_idx != __atomic_load_n(&queue->WriteIndex, __ATOMIC_ACQUIRE));
+        linux_file_request file_request = queue->Requests[read_idx & (LINUX_FILE_REQUEST_RING_SIZE - 1)];
+
+        // NOTE: the copy is taken, the slot can be reused
+        __atomic_store_n(&queue->ReadIndex, read_idx + 1, __ATOMIC_RELEASE);
+
+        bool32 succeeded = false;
+        switch(file_request.Type)
+        {
+            case LinuxFileRequest_Open:
+            {
+                int file_descriptor = open(file_request.Filename, O_RDONLY|O_CLOEXEC);
+                if(file_descriptor >= 0)
+                {
+                    struct stat file_stat;
+                    if(fstat(file_descriptor, &file_stat) == 0)
+                    {
+                        // NOTE: descriptor + 1 so that 0 still means not open
+                        file_request.File->Size = (uint64)file_stat.st_size;
+                        file_request.File->Platform = (void *)(intptr_t)(file_descriptor + 1);
+                        succeeded = true;
+                    }
+                    else
+                    {
+                        close(file_descriptor);
+                    }
+                }
+            } break;
+
+            case LinuxFileRequest_Read:
+            {
+                if(LinuxReadAll(file_request.FileDescriptor, file_request.Dest, file_request.Size, file_request.Offset))
+                {
+                    file_request.Request->BytesRead = (uint32)file_request.Size;
+                    succeeded = true;
+                }
+            } break;
+
+            case LinuxFileRequest_Close:
+            {
+                close(file_request.FileDescriptor);
+            } break;
+
+            case LinuxFileRequest_Save:
+            {
+                succeeded = LinuxSaveFileAtomically(file_request.Filename, file_request.Dest, file_request.Size);
+            } break;
+        }
+
+        if(file_request.Request)
+        {
+            // NOTE: everything the request wrote has to be visible before the app sees it finished
+            __atomic_store_n(&file_request.Request->State,
+                             succeeded ? PlatformFileRequest_Done : PlatformFileRequest_Failed, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&queue->DoneIndex, read_idx + 1, __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+//
+// Threading
+//
+
+/* NOTE: fibers move between threads. A fiber reads LinuxThreadContext once, when it starts, after that it only
+   gets to the thread it's on through fiber->Thread, which the scheduler sets before every switch. The compiler
+   is free to keep the address of a thread local around across the call to swapcontext.
+*/
+global_variable __thread linux_thread_context LinuxThreadContext;
+
+inline void LinuxLockQueue(platform_work_queue *queue)
+{
+    while(__atomic_exchange_n(&queue->Lock, 1, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+}
+
+inline void LinuxUnlockQueue(platform_work_queue *queue)
+{
+    __atomic_store_n(&queue->Lock, 0, __ATOMIC_RELEASE);
+}
+
+inline void LinuxLockFibers(platform_work_queue *queue)
+{
+    while(__atomic_exchange_n(&queue->FiberLock, 1, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+}
+
+inline void LinuxUnlockFibers(platform_work_queue *queue)
+{
+    __atomic_store_n(&queue->FiberLock, 0, __ATOMIC_RELEASE);
+}
+
+// the fiber lock must be held
+inline void LinuxPushReadyFiber(platform_work_queue *queue, linux_job_fiber *fiber)
+{
+    fiber->Next = 0;
+    if(queue->LastReadyFiber)
+    {
+        queue->LastReadyFiber->Next = fiber;
+    }
+    else
+    {
+        queue->FirstReadyFiber = fiber;
+    }
+    queue->LastReadyFiber = fiber;
+    __atomic_add_fetch(&queue->ReadyFiberCount, 1, __ATOMIC_RELEASE);
+}
+
+internal linux_job_fiber *LinuxPopReadyFiber(platform_work_queue *queue)
+{
+    linux_job_fiber *result = 0;
+    if(__atomic_load_n(&queue->ReadyFiberCount, __ATOMIC_ACQUIRE) > 0)
+    {
+        LinuxLockFibers(queue);
+        result = queue->FirstReadyFiber;
+        if(result)
+        {
+            queue->FirstReadyFiber = result->Next;
+            if(!queue->FirstReadyFiber)
+            {
+                queue->LastReadyFiber = 0;
+            }
+            __atomic_sub_fetch(&queue->ReadyFiberCount, 1, __ATOMIC_RELEASE);
+        }
+        LinuxUnlockFibers(queue);
+    }
+    return result;
+}
+
+inline void LinuxFreeJobFiber(platform_work_queue *queue, linux_job_fiber *fiber)
+{
+    LinuxLockFibers(queue);
+    fiber->Next = queue->FirstFreeFiber;
+    queue->FirstFreeFiber = fiber;
+    LinuxUnlockFibers(queue);
+}
+
+// called from the scheduler once the fiber is off its stack, so nobody can resume it too early
+internal void LinuxParkJobFiber(platform_work_queue *queue, linux_job_fiber *fiber, platform_job_counter *counter)
+{
+    LinuxLockFibers(queue);
+
+    bool32 parked = false;
+    for(;;)
+    {
+        int32 value = __atomic_load_n(&counter->Value, __ATOMIC_ACQUIRE);
+        if(!(value & LINUX_COUNTER_COUNT_MASK))
+        {
+            break;
+        }
+        if(__atomic_compare_exchange_n(&counter->Value, &value, (int32)(value | LINUX_COUNTER_HAS_WAITERS), false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            // NOTE: the job that takes the count to zero needs the lock to read the wait list, so it waits for us
+            fiber->Next = (linux_job_fiber *)counter->Waiters;
+            counter->Waiters = fiber;
+            parked = true;
+            break;
+        }
+    }
+
+    if(!parked)
+    {
+        // NOTE: the counter hit zero while the fiber was switching out
+        LinuxPushReadyFiber(queue, fiber);
+    }
+
+    LinuxUnlockFibers(queue);
+
+    if(!parked)
+    {
+        sem_post(&queue->WakeSemaphore);
+    }
+}
+
+internal void LinuxRunJob(platform_work_queue *queue, linux_job *job)
+{
+    job->Callback(queue, job->Data);
+
+    platform_job_counter *counter = job->Counter;
+    if(counter)
+    {
+        // NOTE: unless fibers are parked on it this is the last time the counter is touched, a waiter
+        // outside of a job may return and take the counter's memory with it as soon as it reads zero
+        int32 value = __atomic_sub_fetch(&counter->Value, 1, __ATOMIC_ACQ_REL);
+        if(value == (int32)LINUX_COUNTER_HAS_WAITERS)
+        {
+            LinuxLockFibers(queue);
+            linux_job_fiber *waiter = (linux_job_fiber *)counter->Waiters;
+            counter->Waiters = 0;
+            __atomic_and_fetch(&counter->Value, LINUX_COUNTER_COUNT_MASK, __ATOMIC_RELEASE);
+            uint32 woken_count = 0;
+            while(waiter)
+            {
+                linux_job_fiber *next = waiter->Next;
+                LinuxPushReadyFiber(queue, waiter);
+                ++woken_count;
+                waiter = next;
+            }
+            LinuxUnlockFibers(queue);
+
+            for(uint32 woken_idx = 0; woken_idx < woken_count; ++woken_idx)
+            {
+                sem_post(&queue->WakeSemaphore);
+            }
+        }
+    }
+
+    __atomic_sub_fetch(&queue->OutstandingJobCount, 1, __ATOMIC_RELEASE);
+}
+
+internal void LinuxJobFiberProc()
+{
+    linux_job_fiber *fiber = LinuxThreadContext.CurrentFiber;
+    for(;;)
+    {
+        LinuxRunJob(fiber->Queue, &fiber->Job);
+
+        // NOTE: the job may have been resumed on another thread, so this is whichever thread we're on now
+        linux_thread_context *thread = fiber->Thread;
+        thread->SwitchReason = LinuxFiberSwitch_Finished;
+        swapcontext(&fiber->Context, &thread->SchedulerContext);
+    }
+}
+
+// the fiber lock must be held, makes another LINUX_JOB_FIBER_BLOCK_COUNT fibers and puts them on the
+// free list. False when the queue has all the fibers it may have or the stacks couldn't be mapped
+internal bool32 LinuxGrowJobFibers(platform_work_queue *queue)
+{
+    uint32 block_count = queue->MaxFiberCount - queue->FiberCount;
+    if(block_count > LINUX_JOB_FIBER_BLOCK_COUNT)
+    {
+        block_count = LINUX_JOB_FIBER_BLOCK_COUNT;
+    }
+    if(!block_count)
+    {
+        return false;
+    }
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t slot_size = page_size + LINUX_JOB_FIBER_STACK_SIZE;
+    uint8 *stacks = (uint8 *)mmap(0, block_count*slot_size, PROT_READ|PROT_WRITE,
+                                  MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_STACK, -1, 0);
+    if(stacks == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // NOTE: a checkpoint's child never runs a job, so it doesn't get copies of the stacks
+    madvise(stacks, block_count*slot_size, MADV_DONTFORK);
+    for(uint32 block_idx = 0; block_idx < block_count; ++block_idx)
+    {
+        uint8 *slot = stacks + block_idx*slot_size;
+        mprotect(slot, page_size, PROT_NONE);
+
+        linux_job_fiber *fiber = queue->Fibers + queue->FiberCount + block_idx;
+        fiber->Queue = queue;
+        getcontext(&fiber->Context);
+        fiber->Context.uc_stack.ss_sp = slot + page_size;
+        fiber->Context.uc_stack.ss_size = LINUX_JOB_FIBER_STACK_SIZE;
+        fiber->Context.uc_link = 0;
+        makecontext(&fiber->Context, LinuxJobFiberProc, 0);
+
+        fiber->Next = queue->FirstFreeFiber;
+        queue->FirstFreeFiber = fiber;
+    }
+    queue->FiberCount += block_count;
+
+    return true;
+}
+
+// 0 when every fiber the queue may have is busy or parked
+inline linux_job_fiber *LinuxAllocateJobFiber(platform_work_queue *queue)
+{
+    LinuxLockFibers(queue);
+    if(!queue->FirstFreeFiber)
+    {
+        LinuxGrowJobFibers(queue);
+    }
+    linux_job_fiber *result = queue->FirstFreeFiber;
+    if(result)
+    {
+        queue->FirstFreeFiber = result->Next;
+    }
+    LinuxUnlockFibers(queue);
+    return result;
+}
+
+// run the fiber until it finishes or waits, then deal with it from the scheduler's side
+internal void LinuxSwitchToJobFiber(platform_work_queue *queue, linux_job_fiber *fiber)
+{
+    linux_thread_context *thread = &LinuxThreadContext;
+    thread->CurrentFiber = fiber;
+    fiber->Thread = thread;
+    swapcontext(&thread->SchedulerContext, &fiber->Context);
+    thread->CurrentFiber = 0;
+
+    if(thread->SwitchReason == LinuxFiberSwitch_Finished)
+    {
+        LinuxFreeJobFiber(queue, fiber);
+    }
+    else
+    {
+        LinuxParkJobFiber(queue, fiber, thread->WaitCounter);
+    }
+}
+
+inline bool32 LinuxTakeJob(platform_work_queue *queue, linux_job *job)
+{
+    bool32 result = false;
+
+    LinuxLockQueue(queue);
+    if(queue->ReadIndex != queue->WriteIndex)
+    {
+        *job = queue->Jobs[queue->ReadIndex++ & (LINUX_JOB_QUEUE_SIZE - 1)];
+        result = true;
+    }
+    LinuxUnlockQueue(queue);
+
+    return result;
+}
+
+// resume a fiber whose wait is over, otherwise start a new job, returns false if there was nothing to do
+internal bool32 LinuxDoNextWork(platform_work_queue *queue)
+{
+    bool32 result = true;
+
+    // NOTE: only a thread's own stack switches fibers. Inside a job this is a wait on some other queue,
+    // whose jobs then run on top of the waiter
+    bool32 use_fibers = (queue->MaxFiberCount && !LinuxThreadContext.CurrentFiber);
+
+    linux_job_fiber *fiber = use_fibers ? LinuxPopReadyFiber(queue) : 0;
+    if(fiber)
+    {
+        LinuxSwitchToJobFiber(queue, fiber);
+    }
+    else
+    {
+        linux_job job;
+        if(LinuxTakeJob(queue, &job))
+        {
+            fiber = use_fibers ? LinuxAllocateJobFiber(queue) : 0;
+            if(fiber)
+            {
+                fiber->Job = job;
+                LinuxSwitchToJobFiber(queue, fiber);
+            }
+            else
+            {
+                // NOTE: every fiber is busy or parked, run it on this stack, its waits will block this thread
+                LinuxRunJob(queue, &job);
+            }
+        }
+        else
+        {
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+internal PLATFORM_ADD_ENTRY(LinuxAddEntry)
+{
+    if(counter)
+    {
+        __atomic_add_fetch(&counter->Value, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&queue->OutstandingJobCount, 1, __ATOMIC_RELAXED);
+
+    LinuxLockQueue(queue);
+    Assert((queue->WriteIndex - queue->ReadIndex) < LINUX_JOB_QUEUE_SIZE);
+    linux_job *job = queue->Jobs + (queue->WriteIndex++ & (LINUX_JOB_QUEUE_SIZE - 1));
+    job->Callback = callback;
+    job->Data = data;
+    job->Counter = counter;
+    LinuxUnlockQueue(queue);
+
+    sem_post(&queue->WakeSemaphore);
+}
+
+internal PLATFORM_WAIT_FOR_COUNTER(LinuxWaitForCounter)
+{
+    linux_job_fiber *fiber = LinuxThreadContext.CurrentFiber;
+    if(fiber && (fiber->Queue == queue))
+    {
+        // NOTE: inside a job, park the fiber and let the scheduler get on with something else
+        if(__atomic_load_n(&counter->Value, __ATOMIC_ACQUIRE) & LINUX_COUNTER_COUNT_MASK)
+        {
+            linux_thread_context *thread = fiber->Thread;
+            thread->SwitchReason = LinuxFiberSwitch_Wait;
+            thread->WaitCounter = counter;
+            swapcontext(&fiber->Context, &thread->SchedulerContext);
+        }
+    }
+    else
+    {
+        // NOTE: the whole value, not just the count, so we don't return while a job is still waking fibers
+        while(__atomic_load_n(&counter->Value, __ATOMIC_ACQUIRE))
+        {
+            if(!LinuxDoNextWork(queue))
+            {
+                sched_yield();
+            }
+        }
+    }
+}
+
+internal PLATFORM_COMPLETE_ALL_WORK(LinuxCompleteAllWork)
+{
+    Assert(!LinuxThreadContext.CurrentFiber);
+    while(__atomic_load_n(&queue->OutstandingJobCount, __ATOMIC_ACQUIRE))
+    {
+        if(!LinuxDoNextWork(queue))
+        {
+            sched_yield();
+        }
+    }
+}
+
+internal void *LinuxWorkerThreadProc(void *parameter)
+{
+    platform_work_queue *queue = (platform_work_queue *)parameter;
+    for(;;)
+    {
+        if(!LinuxDoNextWork(queue))
+        {
+            sem_wait(&queue->WakeSemaphore);
+        }
+    }
+    return 0;
+}
+
+// NOTE: a queue whose jobs never wait on it, like the batch queue running whole frames, can do without fibers
+internal bool32 LinuxMakeWorkQueue(platform_work_queue *queue, uint32 worker_count, uint32 fiber_count)
+{
+    queue->Lock = 0;
+    queue->ReadIndex = 0;
+    queue->WriteIndex = 0;
+    queue->OutstandingJobCount = 0;
+    sem_init(&queue->WakeSemaphore, 0, 0);
+
+    queue->FiberLock = 0;
+    queue->MaxFiberCount = 0;
+    queue->FiberCount = 0;
+    queue->FirstFreeFiber = 0;
+    queue->FirstReadyFiber = 0;
+    queue->LastReadyFiber = 0;
+    queue->ReadyFiberCount = 0;
+    if(fiber_count)
+    {
+        // NOTE: the fibers themselves are only touched as the pool grows, the first block is made right away
+        queue->Fibers = (linux_job_fiber *)calloc(fiber_count, sizeof(linux_job_fiber));
+        if(!queue->Fibers)
+        {
+            return false;
+        }
+        queue->MaxFiberCount = fiber_count;
+        if(!LinuxGrowJobFibers(queue))
+        {
+            return false;
+        }
+    }
+
+    for(uint32 worker_idx = 0; worker_idx < worker_count; ++worker_idx)
+    {
+        pthread_t thread;
+        pthread_create(&thread, 0, LinuxWorkerThreadProc, queue);
+        pthread_detach(thread);
+    }
+
+    return true;
+}
+
+// NOTE: every file request goes through here so the main thread never waits on the disk
+internal void LinuxStartFileThread(linux_file_queue *queue)
+{
+    sem_init(&queue->WakeSemaphore, 0, 0);
+    pthread_t file_thread;
+    pthread_create(&file_thread, 0, LinuxFileThreadProc, queue);
+    pthread_detach(file_thread);
+}
+
+internal void LinuxFillPlatformAPI(platform_api *api)
+{
+    api->AddEntry = LinuxAddEntry;
+    api->WaitForCounter = LinuxWaitForCounter;
+    api->CompleteAllWork = LinuxCompleteAllWork;
+    api->OpenFile = LinuxOpenFile;
+    api->ReadDataFromFile = LinuxReadDataFromFile;
+    api->CloseFile = LinuxCloseFile;
+    api->SaveFile = LinuxSaveFile;
+#if APPLICATION_INTERNAL
+    api->DEBUGReadEntireFile = DEBUGPlatformReadEntireFile;
+    api->DEBUGFreeFileMemory = DEBUGPlatformFreeFileMemory;
+    api->DEBUGWriteEntireFile = DEBUGPlatformWriteEntireFile;
+#endif
+}
+
+//
+// Checkpoints
+//
+
+// child process only, nothing in here may allocate or take a lock some other thread of the parent held
+internal bool32 LinuxWriteCheckpointImage(uint8 *memory, uint64 memory_size, int memory_fd, int file_fd)
+{
+    // NOTE: all zero pages are left as holes, that's most of TransientStorage. Reading a page
+    // the app never touched maps the shared zero page, it doesn't allocate anything
+    uint64 page_size = (uint64)sysconf(_SC_PAGESIZE);
+    uint64 run_start = 0;
+    bool32 in_run = false;
+    for(uint64 offset = 0; offset <= memory_size; offset += page_size)
+    {
+        bool32 is_zero = true;
+        if(offset < memory_size)
+        {
+            uint64 *word = (uint64 *)(memory + offset);
+            for(uint64 word_idx = 0; word_idx < page_size/sizeof(uint64); ++word_idx)
+            {
+                if(word[word_idx])
+                {
+                    is_zero = false;
+                    break;
+                }
+            }
+        }
+
+        if(!is_zero && !in_run)
+        {
+            run_start = offset;
+            in_run = true;
+        }
+        else if(is_zero && in_run)
+        {
+            if(!LinuxWriteAll(memory_fd, memory + run_start, offset - run_start, run_start) ||
+               ((file_fd >= 0) && !LinuxWriteAll(file_fd, memory + run_start, offset - run_start, run_start)))
+            {
+                return false;
+            }
+            in_run = false;
+        }
+    }
+
+    return true;
+}
+
+// main thread, costs a memfd and a fork. False when the slot's last writer is still going
+internal bool32 LinuxTakeCheckpoint(linux_checkpointer *checkpointer, uint64 frame_index)
+{
+    linux_checkpoint *checkpoint = checkpointer->Checkpoints + (checkpointer->NextCheckpoint % LINUX_CHECKPOINT_COUNT);
+    if(checkpoint->WriterPid)
+    {
+        ++checkpointer->SkippedCount;
+        return false;
+    }
+
+    if(checkpoint->MemoryFd >= 0)
+    {
+        close(checkpoint->MemoryFd);
+        checkpoint->MemoryFd = -1;
+    }
+    checkpoint->IsReady = false;
+
+    int memory_fd = memfd_create("application checkpoint", MFD_CLOEXEC);
+    if((memory_fd < 0) || (ftruncate(memory_fd, (off_t)checkpointer->MemorySize) != 0))
+    {
+        if(memory_fd >= 0)
+        {
+            close(memory_fd);
+        }
+        ++checkpointer->FailedCount;
+        return false;
+    }
+
+    char filename[512] = {};
+    if(checkpointer->Directory)
+    {
+        snprintf(filename, sizeof(filename), "%s/checkpoint_%08llu.bin", checkpointer->Directory,
+                 (unsigned long long)frame_index);
+    }
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        // NOTE: the writer gets a smaller share than the frame loop so it doesn't take the parent's frame
+        // on a machine with few cores. Not SCHED_IDLE, on a busy machine that never gets to run at all
+        setpriority(PRIO_PROCESS, 0, LINUX_CHECKPOINT_WRITER_NICE);
+
+        // NOTE: the file is opened out here too, creating it can stall on the disk
+        int file_fd = -1;
+        if(filename[0])
+        {
+            file_fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+            if((file_fd < 0) || (ftruncate(file_fd, (off_t)checkpointer->MemorySize) != 0))
+            {
+                _exit(1);
+            }
+        }
+
+        bool32 written = LinuxWriteCheckpointImage(checkpointer->Memory, checkpointer->MemorySize, memory_fd, file_fd);
+        _exit(written ? 0 : 1);
+    }
+
+    if(pid < 0)
+    {
+        close(memory_fd);
+        ++checkpointer->FailedCount;
+        return false;
+    }
+
+    checkpoint->MemoryFd = memory_fd;
+    checkpoint->WriterPid = pid;
+    checkpoint->FrameIndex = frame_index;
+    ++checkpointer->NextCheckpoint;
+    ++checkpointer->TakenCount;
+    return true;
+}
+
+// main thread, reap the writers that are done
+internal void LinuxPollCheckpoints(linux_checkpointer *checkpointer)
+{
+    for(int checkpoint_idx = 0; checkpoint_idx < LINUX_CHECKPOINT_COUNT; ++checkpoint_idx)
+    {
+        linux_checkpoint *checkpoint = checkpointer->Checkpoints + checkpoint_idx;
+        if(checkpoint->WriterPid)
+        {
+            int status = 0;
+            pid_t pid = waitpid(checkpoint->WriterPid, &status, WNOHANG);
+            if(pid == checkpoint->WriterPid)
+            {
+                checkpoint->WriterPid = 0;
+                checkpoint->IsReady = (WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+                if(!checkpoint->IsReady)
+                {
+                    ++checkpointer->FailedCount;
+                }
+            }
+        }
+    }
+}
+
+// main thread, wait for the newest checkpoint's writer if it's still going, a rewind wants that one and
+// not whatever older one happens to be done
+internal void LinuxFinishNewestCheckpoint(linux_checkpointer *checkpointer)
+{
+    linux_checkpoint *newest = 0;
+    for(int checkpoint_idx = 0; checkpoint_idx < LINUX_CHECKPOINT_COUNT; ++checkpoint_idx)
+    {
+        linux_checkpoint *checkpoint = checkpointer->Checkpoints + checkpoint_idx;
+        if((checkpoint->WriterPid || checkpoint->IsReady) && (!newest || (checkpoint->FrameIndex > newest->FrameIndex)))
+        {
+            newest = checkpoint;
+        }
+    }
+
+    if(newest && newest->WriterPid)
+    {
+        int status = 0;
+        pid_t pid = waitpid(newest->WriterPid, &status, 0);
+        newest->WriterPid = 0;
+        newest->IsReady = ((pid > 0) && WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+        if(!newest->IsReady)
+        {
+            ++checkpointer->FailedCount;
+        }
+    }
+}
+
+// the newest checkpoint that's been written out, 0 if none is
+internal linux_checkpoint *LinuxLatestCheckpoint(linux_checkpointer *checkpointer)
+{
+    linux_checkpoint *result = 0;
+    for(int checkpoint_idx = 0; checkpoint_idx < LINUX_CHECKPOINT_COUNT; ++checkpoint_idx)
+    {
+        linux_checkpoint *checkpoint = checkpointer->Checkpoints + checkpoint_idx;
+        if(checkpoint->IsReady && (!result || (checkpoint->FrameIndex > result->FrameIndex)))
+        {
+            result = checkpoint;
+        }
+    }
+    return result;
+}
+
+// main thread, with no jobs running. Maps the checkpoint copy on write over application_memory,
+// so rewinding costs the same however big the memory is, the pages come in as they get touched
+internal bool32 LinuxRestoreCheckpoint(linux_checkpointer *checkpointer, linux_checkpoint *checkpoint,
+                                       linux_app_code *app_code, application_memory *app_memory)
+{
+    // NOTE: the file thread reads into and saves out of application_memory, the pages can't be
+    // swapped out from under it. Whatever the app still has going is stopped first, or the queue
+    // could keep filling while it's drained
+    app_code->BeginRestoreState(app_memory);
+    LinuxFinishFileRequests(&GlobalFileQueue);
+
+    void *memory = mmap(checkpointer->Memory, (size_t)checkpointer->MemorySize, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_FIXED, checkpoint->MemoryFd, 0);
+    bool32 result = (memory == checkpointer->Memory);
+    if(result)
+    {
+        madvise(memory, (size_t)checkpointer->MemorySize, MADV_HUGEPAGE);
+    }
+
+    // NOTE: called either way, Begin stopped the streams and they have to start again
+    app_code->EndRestoreState(app_memory);
+    return result;
+}
+
+//
+// Saved state
+//
+
+// write the app's state out as a relocatable image, see application_serialize.h
+internal bool32 LinuxSaveState(linux_app_code *app_code, application_memory *memory, char *filename)
+{
+    bool32 result = false;
+    uint64 size = app_code->SaveState(memory, 0, 0);
+    void *image = size ? malloc((size_t)size) : 0;
+    if(image && (app_code->SaveState(memory, image, size) == size))
+    {
+        result = LinuxSaveFileAtomically(filename, image, size);
+    }
+    free(image);
+    return result;
+}
+
+// NOTE: the file is mapped instead of read, the app copies its spans straight out of the page cache
+internal bool32 LinuxLoadStateFile(linux_app_code *app_code, application_memory *memory, char *filename)
+{
+    bool32 result = false;
+    int file_descriptor = open(filename, O_RDONLY);
+    if(file_descriptor >= 0)
+    {
+        struct stat file_stat;
+        if((fstat(file_descriptor, &file_stat) == 0) && (file_stat.st_size > 0))
+        {
+            void *file = mmap(0, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+            if(file != MAP_FAILED)
+            {
+                uint64 image_size = GetSavedFileDataSize(file, (uint64)file_stat.st_size);
+                if(image_size)
+                {
+                    result = app_code->LoadState(memory, file, image_size);
+                }
+                munmap(file, (size_t)file_stat.st_size);
+            }
+        }
+        close(file_descriptor);
+    }
+    return result;
+}
+
+// NOTE: a torn or missing save falls back to the one it replaced, returns the file that loaded or 0
+internal char *LinuxLoadState(linux_app_code *app_code, application_memory *memory, char *filename)
+{
+    local_persist char prev_filename[SAVED_FILE_MAX_FILENAME];
+
+    char *result = 0;
+    if(LinuxLoadStateFile(app_code, memory, filename))
+    {
+        result = filename;
+    }
+    else if(GetSavedFileName(prev_filename, sizeof(prev_filename), filename, ".prev") &&
+            LinuxLoadStateFile(app_code, memory, prev_filename))
+    {
+        result = prev_filename;
+    }
+    return result;
+}
+
+//
+// Frame dumps
+//
+
+// write the buffer out as a binary ppm, whatever format the app rendered it in
+internal bool32 LinuxDumpFrame(offscreen_graphics_buffer *buffer, char *filename)
+{
+    bool32 result = false;
+
+    offscreen_graphics_buffer converted = {};
+    converted.Width = buffer->Width;
+    converted.Height = buffer->Height;
+    converted.Pitch = buffer->Width*PixelFormatBytesPerPixel[PixelFormat_BGRX8];
+    converted.Format = PixelFormat_BGRX8;
+    converted.Memory = malloc((size_t)(converted.Pitch*converted.Height));
+
+    uint8 *rgb = (uint8 *)malloc((size_t)(3*buffer->Width*buffer->Height));
+    if(converted.Memory && rgb)
+    {
+        BlitBuffer(&converted, buffer);
+
+        uint8 *out = rgb;
+        for(int y = 0; y < converted.Height; ++y)
+        {
+            uint32 *pixel = (uint32 *)((uint8 *)converted.Memory + y*converted.Pitch);
+            for(int x = 0; x < converted.Width; ++x)
+            {
+                uint32 color = *pixel++;
+                *out++ = (uint8)(color >> 16);
+                *out++ = (uint8)(color >> 8);
+                *out++ = (uint8)color;
+            }
+        }
+
+        int file_descriptor = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        if(file_descriptor >= 0)
+        {
+            char header[64];
+            int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", buffer->Width, buffer->Height);
+            result = (LinuxWriteAll(file_descriptor, header, (uint64)header_size, 0) &&
+                      LinuxWriteAll(file_descriptor, rgb, (uint64)(out - rgb), (uint64)header_size));
+            close(file_descriptor);
+        }
+    }
+
+    free(rgb);
+    free(converted.Memory);
+    return result;
+}
+
+//
+// Batch runs
+//
+
+internal PLATFORM_WORK_QUEUE_CALLBACK(LinuxRunBatchFrame)
+{
+    linux_batch_instance *instance = (linux_batch_instance *)data;
+    linux_batch *batch = instance->Batch;
+    uint64 start_counter = LinuxGetWallClock();
+
+    // NOTE: there are no devices, the controllers just stay where they were
+    application_input *input = &instance->Input;
+    input->StartTimestamp = input->EndTimestamp;
+    input->EndTimestamp = start_counter;
+    batch->AppCode->UpdateAndRender(&instance->Memory, input, &instance->Buffer);
+
+    if(instance->Samples)
+    {
+        application_sound_output_buffer sound_buffer = {};
+        sound_buffer.SamplesPerSecond = batch->SamplesPerSecond;
+        sound_buffer.SampleCount = batch->SamplesPerSecond / batch->UpdateHz;
+        sound_buffer.Samples = instance->Samples;
+        sound_buffer.LatencySeconds = 1.0f / (real32)batch->UpdateHz;
+        batch->AppCode->GetSoundSamples(&instance->Memory, &sound_buffer);
+    }
+
+    uint64 microseconds = (LinuxGetWallClock() - start_counter) / 1000;
+    HdrRecordValue(&instance->FrameTimes, (microseconds < 0xFFFFFFFF) ? (uint32)microseconds : 0xFFFFFFFF);
+    ++instance->FrameCount;
+}
+
+// how much of a mapping has memory behind it right now, page_flags needs a byte per page
+internal uint64 LinuxGetResidentSize(void *memory, uint64 size, uint8 *page_flags)
+{
+    uint64 result = 0;
+    uint64 page_size = (uint64)sysconf(_SC_PAGESIZE);
+    if(mincore(memory, (size_t)size, page_flags) == 0)
+    {
+        uint64 page_count = (size + page_size - 1) / page_size;
+        for(uint64 page_idx = 0; page_idx < page_count; ++page_idx)
+        {
+            if(page_flags[page_idx] & 1)
+            {
+                result += page_size;
+            }
+        }
+    }
+    return result;
+}
+
+// run instance_count copies of the app side by side as fast as they go, frame_count frames each
+internal int LinuxRunBatch(linux_app_code *app_code, uint32 instance_count, uint32 worker_thread_count,
+                           uint64 frame_count, bool32 is_rendering, bool32 is_making_sound,
+                           pixel_format pixel_format, char *dump_frame_filename)
+{
+    local_persist linux_batch batch;
+    batch.AppCode = app_code;
+    batch.UpdateHz = 30;
+    batch.SamplesPerSecond = 44100;
+    batch.InstanceCount = instance_count;
+    batch.Instances = (linux_batch_instance *)calloc(instance_count, sizeof(linux_batch_instance));
+    if(!batch.Instances)
+    {
+        return 1;
+    }
+
+    local_persist platform_work_queue batch_queue;
+    LinuxMakeWorkQueue(&batch_queue, worker_thread_count, 0);
+    LinuxStartFileThread(&GlobalFileQueue);
+
+    uint64 storage_size = LINUX_PERMANENT_STORAGE_SIZE + LINUX_TRANSIENT_STORAGE_SIZE;
+    uint64 start_counter = LinuxGetWallClock();
+    for(uint32 instance_idx = 0; instance_idx < instance_count; ++instance_idx)
+    {
+        linux_batch_instance *instance = batch.Instances + instance_idx;
+        instance->Batch = &batch;
+
+#if APPLICATION_INTERNAL
+        void *base_address = (void *)(Terabytes(2) + (uint64)instance_idx*storage_size);
+#else
+        void *base_address = 0;
+#endif
+
+        // NOTE: no huge pages, nothing forks a batch run and small pages keep the resident sizes honest
+        void *memory = mmap(base_address, (size_t)storage_size, PROT_READ|PROT_WRITE,
+                            MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if(memory == MAP_FAILED)
+        {
+            fprintf(stderr, "could not map application memory for instance %u\n", instance_idx);
+            return 1;
+        }
+
+        application_memory *app_memory = &instance->Memory;
+        app_memory->PermanentStorageSize = LINUX_PERMANENT_STORAGE_SIZE;
+        app_memory->PermanentStorage = memory;
+        app_memory->TransientStorageSize = LINUX_TRANSIENT_STORAGE_SIZE;
+        app_memory->TransientStorage = (uint8 *)memory + LINUX_PERMANENT_STORAGE_SIZE;
+
+        LinuxMakeWorkQueue(&instance->WorkQueue, 0, 0);
+        app_memory->WorkQueue = &instance->WorkQueue;
+        app_memory->WorkerThreadCount = 0;
+
+        // NOTE: dozens of instances autosaving would be all the disk ever did
+        app_memory->AutosaveFilename = 0;
+        LinuxFillPlatformAPI(&app_memory->PlatformAPI);
+
+        offscreen_graphics_buffer *buffer = &instance->Buffer;
+        buffer->Width = 960;
+        buffer->Height = 540;
+        buffer->Pitch = buffer->Width*PixelFormatBytesPerPixel[pixel_format];
+        buffer->Format = pixel_format;
+        if(is_rendering)
+        {
+            buffer->Memory = calloc((size_t)(buffer->Pitch*buffer->Height), 1);
+        }
+        if(is_making_sound)
+        {
+            instance->Samples = (int16 *)calloc((size_t)batch.SamplesPerSecond, 2*sizeof(int16));
+        }
+        if((is_rendering && !buffer->Memory) || (is_making_sound && !instance->Samples))
+        {
+            return 1;
+        }
+
+        instance->Input.TimestampFrequency = 1000000000ULL;
+        instance->Input.SecondsToAdvanceOverUpdate = 1.0f / (real32)batch.UpdateHz;
+        instance->Input.EndTimestamp = start_counter;
+    }
+
+    local_persist hdr_histogram step_times;
+    uint64 session_start_counter = LinuxGetWallClock();
+    for(uint64 frame_index = 0; !frame_count || (frame_index < frame_count); ++frame_index)
+    {
+        uint64 step_counter = LinuxGetWallClock();
+        for(uint32 instance_idx = 0; instance_idx < instance_count; ++instance_idx)
+        {
+            LinuxAddEntry(&batch_queue, LinuxRunBatchFrame, batch.Instances + instance_idx, 0);
+        }
+        LinuxCompleteAllWork(&batch_queue);
+
+        uint64 microseconds = (LinuxGetWallClock() - step_counter) / 1000;
+        HdrRecordValue(&step_times, (microseconds < 0xFFFFFFFF) ? (uint32)microseconds : 0xFFFFFFFF);
+    }
+    real32 session_seconds = LinuxGetSecondsElapsed(session_start_counter, LinuxGetWallClock());
+
+    if(dump_frame_filename && is_rendering)
+    {
+        LinuxDumpFrame(&batch.Instances[0].Buffer, dump_frame_filename);
+    }
+    LinuxFinishFileRequests(&GlobalFileQueue);
+
+    uint64 total_frame_count = 0;
+    for(uint32 instance_idx = 0; instance_idx < instance_count; ++instance_idx)
+    {
+        total_frame_count += batch.Instances[instance_idx].FrameCount;
+    }
+    real64 frames_per_second = (session_seconds > 0.0f) ? (real64)total_frame_count / (real64)session_seconds : 0.0;
+
+    printf("batch: %u instances on %u threads, %llu frames each, %s, %s\n", instance_count, worker_thread_count + 1,
+           (unsigned long long)frame_count, is_rendering ? "rendering" : "no rendering",
+           is_making_sound ? "sound" : "no sound");
+    printf("%.1f frames per second over %.3fs, %.1fx realtime across all instances\n",
+           frames_per_second, session_seconds, frames_per_second / (real64)batch.UpdateHz);
+
+    printf("%-14s %8s %9s %9s %9s %9s %9s %9s %9s\n",
+           "timing (ms)", "count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+    telemetry_timing_summary step_summary = TelemetrySummarizeTiming(&step_times);
+    printf("%-14s %8llu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", "step",
+           (unsigned long long)step_summary.Count, step_summary.MinMs, step_summary.P50Ms, step_summary.P90Ms,
+           step_summary.P99Ms, step_summary.P999Ms, step_summary.MaxMs, step_summary.MeanMs);
+
+    // NOTE: resident is what the instance really costs, the rest of application_memory is only reserved
+    uint64 page_size = (uint64)sysconf(_SC_PAGESIZE);
+    uint8 *page_flags = (uint8 *)malloc((size_t)((storage_size + page_size - 1) / page_size));
+    uint64 total_resident_size = 0;
+    printf("%-14s %8s %9s %9s %9s %12s %12s\n",
+           "instance", "frames", "p50 ms", "p99 ms", "max ms", "resident MB", "reserved MB");
+    for(uint32 instance_idx = 0; instance_idx < instance_count; ++instance_idx)
+    {
+        linux_batch_instance *instance = batch.Instances + instance_idx;
+        telemetry_timing_summary summary = TelemetrySummarizeTiming(&instance->FrameTimes);
+        uint64 resident_size = page_flags ? LinuxGetResidentSize(instance->Memory.PermanentStorage, storage_size, page_flags) : 0;
+        total_resident_size += resident_size;
+        printf("%-14u %8llu %9.3f %9.3f %9.3f %12.1f %12.1f\n", instance_idx,
+               (unsigned long long)instance->FrameCount, summary.P50Ms, summary.P99Ms, summary.MaxMs,
+               resident_size / (1024.0*1024.0), storage_size / (1024.0*1024.0));
+    }
+    free(page_flags);
+
+    uint64 buffer_size = (is_rendering ? (uint64)(batch.Instances[0].Buffer.Pitch*batch.Instances[0].Buffer.Height) : 0) +
+                         (is_making_sound ? (uint64)batch.SamplesPerSecond*2*sizeof(int16) : 0);
+    printf("resident: %.1fMB in all, %.1fMB per instance plus %.1fKB of picture and sound buffers\n",
+           total_resident_size / (1024.0*1024.0), (total_resident_size / instance_count) / (1024.0*1024.0),
+           buffer_size / 1024.0);
+
+    return 0;
+}
+
+//
+// Main
+//
+
+global_variable frame_telemetry GlobalTelemetry;
+global_variable linux_checkpointer GlobalCheckpointer;
+
+internal void LinuxPrintUsage(char *program_name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --app <path>               application shared library (./application.so)\n"
+            "  --frames <count>           frames to run, 0 runs until killed (300)\n"
+            "  --checkpoint-every <n>     frames between checkpoints, 0 turns them off (30)\n"
+            "  --checkpoint-dir <path>    also write checkpoints to disk here\n"
+            "  --rewind-at <frame>        rewind to the latest checkpoint once, at this frame\n"
+            "  --realtime                 sleep to hold the update rate instead of running flat out\n"
+            "  --pixel-format <format>    bgrx8, rgba8, rgb565 or float32 (bgrx8)\n"
+            "  --dump-frame <path>        write the last frame out as a binary ppm\n"
+            "  --load-state <path>        start from a saved state, or <path>.prev if it is torn\n"
+            "  --save-state <path>        save the state after the last frame\n"
+            "  --threads <count>          threads running jobs, the main thread included (one per processor)\n"
+            "  --no-render                run without drawing anything\n"
+            "  --no-audio                 run without making any sound\n"
+            "  --instances <count>        batch run, this many copies of the app side by side as fast as\n"
+            "                             they go. Only --app, --frames, --threads, --pixel-format,\n"
+            "                             --dump-frame (instance 0), --no-render and --no-audio apply\n",
+            program_name);
+}
+
+int main(int argc, char **argv)
+{
+    char *app_filename = "./application.so";
+    uint64 frame_count = 300;
+    uint64 checkpoint_every = 30;
+    uint64 rewind_at = 0;
+    bool32 is_realtime = false;
+    pixel_format pixel_format = PixelFormat_BGRX8;
+    char *dump_frame_filename = 0;
+    char *load_state_filename = 0;
+    char *save_state_filename = 0;
+    uint32 thread_count = 0;
+    bool32 is_rendering = true;
+    bool32 is_making_sound = true;
+    uint32 instance_count = 0;
+    for(int arg_idx = 1; arg_idx < argc; ++arg_idx)
+    {
+        char *arg = argv[arg_idx];
+        bool32 has_value = (arg_idx + 1 < argc);
+        if(!strcmp(arg, "--app") && has_value)
+        {
+            app_filename = argv[++arg_idx];
+        }
+        else if(!strcmp(arg, "--frames") && has_value)
+        {
+            frame_count = strtoull(argv[++arg_idx], 0, 10);
+        }
+        else if(!strcmp(arg, "--checkpoint-every") && has_value)
+        {
+            checkpoint_every = strtoull(argv[++arg_idx], 0, 10);
+        }
+        else if(!strcmp(arg, "--checkpoint-dir") && has_value)
+        {
+            GlobalCheckpointer.Directory = argv[++arg_idx];
+            mkdir(GlobalCheckpointer.Directory, 0755);
+        }
+        else if(!strcmp(arg, "--rewind-at") && has_value)
+        {
+            rewind_at = strtoull(argv[++arg_idx], 0, 10);
+        }
+        else if(!strcmp(arg, "--realtime"))
+        {
+            is_realtime = true;
+        }
+        else if(!strcmp(arg, "--pixel-format") && has_value)
+        {
+            char *format_name = argv[++arg_idx];
+            int format_idx = 0;
+            while((format_idx < PixelFormat_Count) && strcmp(format_name, PixelFormatNames[format_idx]))
+            {
+                ++format_idx;
+            }
+            if(format_idx == PixelFormat_Count)
+            {
+                LinuxPrintUsage(argv[0]);
+                return 1;
+            }
+            pixel_format = (enum pixel_format)format_idx;
+        }
+        else if(!strcmp(arg, "--dump-frame") && has_value)
+        {
+            dump_frame_filename = argv[++arg_idx];
+        }
+        else if(!strcmp(arg, "--load-state") && has_value)
+        {
+            load_state_filename = argv[++arg_idx];
+        }
+        else if(!strcmp(arg, "--save-state") && has_value)
+        {
+            save_state_filename = argv[++arg_idx];
+        }
+        else if(!strcmp(arg, "--threads") && has_value)
+        {
+            thread_count = (uint32)strtoul(argv[++arg_idx], 0, 10);
+        }
+        else if(!strcmp(arg, "--no-render"))
+        {
+            is_rendering = false;
+        }
+        else if(!strcmp(arg, "--no-audio"))
+        {
+            is_making_sound = false;
+        }
+        else if(!strcmp(arg, "--instances") && has_value)
+        {
+            instance_count = (uint32)strtoul(argv[++arg_idx], 0, 10);
+            if(!instance_count || (instance_count > LINUX_MAX_BATCH_INSTANCE_COUNT))
+            {
+                LinuxPrintUsage(argv[0]);
+                return 1;
+            }
+        }
+        else
+        {
+            LinuxPrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    int application_update_hz = 30;
+    real32 target_seconds_per_frame = 1.0f / (real32)application_update_hz;
+    GlobalTelemetry.TargetSecondsPerFrame = target_seconds_per_frame;
+
+    linux_app_code app_code = LinuxLoadGameCode(app_filename);
+    if(!app_code.IsValid)
+    {
+        return 1;
+    }
+
+    if(!thread_count)
+    {
+        long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (processor_count > 1) ? (uint32)processor_count : 1;
+    }
+    uint32 worker_thread_count = thread_count - 1;
+    if(worker_thread_count > LINUX_MAX_WORKER_THREAD_COUNT)
+    {
+        worker_thread_count = LINUX_MAX_WORKER_THREAD_COUNT;
+    }
+
+    if(instance_count)
+    {
+        int result = LinuxRunBatch(&app_code, instance_count, worker_thread_count, frame_count,
+                                   is_rendering, is_making_sound, pixel_format, dump_frame_filename);
+        return result;
+    }
+
+#if APPLICATION_INTERNAL
+    void *base_address = (void *)Terabytes(2);
+#else
+    void *base_address = 0;
+#endif
+
+    application_memory app_memory = {};
+    app_memory.PermanentStorageSize = LINUX_PERMANENT_STORAGE_SIZE;
+    app_memory.TransientStorageSize = LINUX_TRANSIENT_STORAGE_SIZE;
+
+    // NOTE: private so a fork sees it copy on write. Huge pages keep the page tables small,
+    // which is most of what a fork of a big mapping costs
+    uint64 total_size = app_memory.PermanentStorageSize + app_memory.TransientStorageSize;
+    void *memory = mmap(base_address, (size_t)total_size, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if(memory == MAP_FAILED)
+    {
+        fprintf(stderr, "could not map %llu bytes of application memory\n", (unsigned long long)total_size);
+        return 1;
+    }
+    madvise(memory, (size_t)total_size, MADV_HUGEPAGE);
+    app_memory.PermanentStorage = memory;
+    app_memory.TransientStorage = (uint8 *)memory + app_memory.PermanentStorageSize;
+
+    GlobalCheckpointer.Memory = (uint8 *)memory;
+    GlobalCheckpointer.MemorySize = total_size;
+    for(int checkpoint_idx = 0; checkpoint_idx < LINUX_CHECKPOINT_COUNT; ++checkpoint_idx)
+    {
+        GlobalCheckpointer.Checkpoints[checkpoint_idx].MemoryFd = -1;
+    }
+
+    local_persist platform_work_queue work_queue;
+    if(!LinuxMakeWorkQueue(&work_queue, worker_thread_count, LINUX_JOB_FIBER_COUNT))
+    {
+        fprintf(stderr, "could not make the job fibers\n");
+        return 1;
+    }
+
+    LinuxStartFileThread(&GlobalFileQueue);
+
+    app_memory.WorkQueue = &work_queue;
+    app_memory.WorkerThreadCount = worker_thread_count;
+    app_memory.AutosaveFilename = "autosave.state";
+    LinuxFillPlatformAPI(&app_memory.PlatformAPI);
+
+    // NOTE: nobody looks at the picture or listens to the sound, but unless told not to the app still makes both
+    offscreen_graphics_buffer buffer = {};
+    buffer.Width = 960;
+    buffer.Height = 540;
+    buffer.Pitch = buffer.Width*PixelFormatBytesPerPixel[pixel_format];
+    buffer.Format = pixel_format;
+    if(is_rendering)
+    {
+        buffer.Memory = calloc((size_t)(buffer.Pitch*buffer.Height), 1);
+    }
+
+    int samples_per_second = 44100;
+    int16 *samples = (int16 *)calloc((size_t)samples_per_second, 2*sizeof(int16));
+
+    application_input input[2] = {};
+    application_input *new_input = &input[0];
+    application_input *old_input = &input[1];
+
+    if((is_rendering && !buffer.Memory) || !samples)
+    {
+        return 1;
+    }
+
+    if(load_state_filename)
+    {
+        uint64 load_counter = LinuxGetWallClock();
+        char *loaded_filename = LinuxLoadState(&app_code, &app_memory, load_state_filename);
+        if(!loaded_filename)
+        {
+            fprintf(stderr, "could not load the state in %s\n", load_state_filename);
+            return 1;
+        }
+        printf("loaded the state in %s in %.3fms\n", loaded_filename,
+               1000.0f*LinuxGetSecondsElapsed(load_counter, LinuxGetWallClock()));
+    }
+
+    uint64 last_counter = LinuxGetWallClock();
+    uint64 session_start_counter = last_counter;
+    uint64 session_start_cycles = __rdtsc();
+    old_input->EndTimestamp = last_counter;
+    for(uint64 frame_index = 0; !frame_count || (frame_index < frame_count); ++frame_index)
+    {
+        // NOTE: there are no devices, the controllers just stay where they were
+        *new_input = *old_input;
+        new_input->StartTimestamp = old_input->EndTimestamp;
+        new_input->EndTimestamp = LinuxGetWallClock();
+        new_input->TimestampFrequency = 1000000000ULL;
+        new_input->EventCount = 0;
+        new_input->DroppedEventCount = 0;
+        new_input->SecondsToAdvanceOverUpdate = target_seconds_per_frame;
+
+        LinuxPollCheckpoints(&GlobalCheckpointer);
+        if(rewind_at && (frame_index == rewind_at))
+        {
+            LinuxFinishNewestCheckpoint(&GlobalCheckpointer);
+            linux_checkpoint *checkpoint = LinuxLatestCheckpoint(&GlobalCheckpointer);
+            if(checkpoint && LinuxRestoreCheckpoint(&GlobalCheckpointer, checkpoint, &app_code, &app_memory))
+            {
+                printf("frame %llu: rewound to the checkpoint from frame %llu\n",
+                       (unsigned long long)frame_index, (unsigned long long)checkpoint->FrameIndex);
+            }
+            else
+            {
+                printf("frame %llu: no checkpoint to rewind to\n", (unsigned long long)frame_index);
+            }
+        }
+
+        app_code.UpdateAndRender(&app_memory, new_input, &buffer);
+        GlobalTelemetry.ArenaCount = app_code.DebugGetArenaInfo(&app_memory, GlobalTelemetry.Arenas,
+                                                                TELEMETRY_MAX_ARENA_COUNT);
+
+        application_sound_output_buffer sound_buffer = {};
+        sound_buffer.SamplesPerSecond = samples_per_second;
+        sound_buffer.SampleCount = samples_per_second / application_update_hz;
+        sound_buffer.Samples = samples;
+        sound_buffer.LatencySeconds = target_seconds_per_frame;
+        if(is_making_sound)
+        {
+            app_code.GetSoundSamples(&app_memory, &sound_buffer);
+            TelemetryRecordEffects(&GlobalTelemetry, &sound_buffer);
+        }
+
+        // NOTE: between frames no job is running, so the child sees a consistent image
+        if(checkpoint_every && ((frame_index % checkpoint_every) == 0))
+        {
+            uint64 checkpoint_counter = LinuxGetWallClock();
+            if(LinuxTakeCheckpoint(&GlobalCheckpointer, frame_index))
+            {
+                TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Snapshot,
+                                       LinuxGetSecondsElapsed(checkpoint_counter, LinuxGetWallClock()));
+            }
+        }
+
+        uint64 work_counter = LinuxGetWallClock();
+        real32 work_seconds_elapsed = LinuxGetSecondsElapsed(last_counter, work_counter);
+        if(is_realtime)
+        {
+            if(work_seconds_elapsed < target_seconds_per_frame)
+            {
+                real32 sleep_seconds = target_seconds_per_frame - work_seconds_elapsed;
+                timespec sleep_time = {0, (long)(sleep_seconds*1000000000.0f)};
+                nanosleep(&sleep_time, 0);
+            }
+            else
+            {
+                ++GlobalTelemetry.MissedFrameCount;
+            }
+        }
+
+        uint64 end_counter = LinuxGetWallClock();
+        ++GlobalTelemetry.FrameCount;
+        TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Work, work_seconds_elapsed);
+        TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Sleep, LinuxGetSecondsElapsed(work_counter, end_counter));
+        TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Frame, LinuxGetSecondsElapsed(last_counter, end_counter));
+        last_counter = end_counter;
+
+        application_input *temp = new_input;
+        new_input = old_input;
+        old_input = temp;
+    }
+
+    // NOTE: let the last checkpoints finish writing before leaving
+    for(int checkpoint_idx = 0; checkpoint_idx < LINUX_CHECKPOINT_COUNT; ++checkpoint_idx)
+    {
+        linux_checkpoint *checkpoint = GlobalCheckpointer.Checkpoints + checkpoint_idx;
+        if(checkpoint->WriterPid)
+        {
+            waitpid(checkpoint->WriterPid, 0, 0);
+            checkpoint->WriterPid = 0;
+        }
+    }
+
+    if(dump_frame_filename && is_rendering)
+    {
+        LinuxDumpFrame(&buffer, dump_frame_filename);
+    }
+
+    if(save_state_filename)
+    {
+        uint64 save_counter = LinuxGetWallClock();
+        if(LinuxSaveState(&app_code, &app_memory, save_state_filename))
+        {
+            printf("saved the state to %s in %.3fms\n", save_state_filename,
+                   1000.0f*LinuxGetSecondsElapsed(save_counter, LinuxGetWallClock()));
+        }
+        else
+        {
+            fprintf(stderr, "could not save the state to %s\n", save_state_filename);
+        }
+    }
+
+    // NOTE: a save the app handed off in its last frames still has to make it to the disk
+    LinuxFinishFileRequests(&GlobalFileQueue);
+
+    // NOTE: the time stamp counter against the wall clock over the whole session, to turn cycles into time
+    real32 session_seconds = LinuxGetSecondsElapsed(session_start_counter, LinuxGetWallClock());
+    if(session_seconds > 0.0f)
+    {
+        GlobalTelemetry.CyclesPerSecond = (real64)(__rdtsc() - session_start_cycles) / (real64)session_seconds;
+    }
+
+    local_persist char text_buffer[Kilobytes(16)];
+    TelemetryFormatText(&GlobalTelemetry, text_buffer, sizeof(text_buffer));
+    printf("%s", text_buffer);
+    printf("checkpoints: %llu taken, %llu skipped, %llu failed\n",
+           (unsigned long long)GlobalCheckpointer.TakenCount, (unsigned long long)GlobalCheckpointer.SkippedCount,
+           (unsigned long long)GlobalCheckpointer.FailedCount);
+
+    return 0;
+}
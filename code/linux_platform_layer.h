@@ -0,0 +1,199 @@
+/*
+    Headless Linux platform layer, the host's own types, see
+    linux_platform_layer.cpp
+
+    Author: Justin Morrow
+*/
+
+#if !defined(LINUX_PLATFORM_LAYER_H)
+
+struct linux_app_code
+{
+    void *AppCodeLibrary;
+    app_update_and_render *UpdateAndRender;
+    app_get_sound_samples *GetSoundSamples;
+    app_debug_get_arena_info *DebugGetArenaInfo;
+    app_save_state *SaveState;
+    app_load_state *LoadState;
+    app_begin_restore_state *BeginRestoreState;
+    app_end_restore_state *EndRestoreState;
+
+    bool32 IsValid;
+};
+
+#define LINUX_PERMANENT_STORAGE_SIZE Megabytes(64)
+#define LINUX_TRANSIENT_STORAGE_SIZE Gigabytes(1)
+
+#define LINUX_JOB_QUEUE_SIZE 4096 // NOTE: must be a power of 2
+#define LINUX_MAX_WORKER_THREAD_COUNT 63
+
+struct linux_job
+{
+    platform_work_queue_callback *Callback;
+    void *Data;
+    platform_job_counter *Counter;
+};
+
+// NOTE: as many ucontext fibers as Win32 has, but made a block at a time as waits need them instead of
+// all at startup. Each stack has a guard page under it, which splits it into a mapping of its own.
+// The stacks are MADV_DONTFORK so a checkpoint's fork doesn't copy them, but fork still has to walk
+// every mapping, so the pool only grows as far as the waits the app really has in flight.
+// The stacks live outside application_memory on purpose: checkpoints are taken and restored between
+// frames, when no job is running and every fiber is back on the free list with nothing on its stack
+#define LINUX_JOB_FIBER_COUNT 2048
+#define LINUX_JOB_FIBER_BLOCK_COUNT 64
+#define LINUX_JOB_FIBER_STACK_SIZE Kilobytes(64)
+
+// set on platform_job_counter::Value while fibers are parked on it
+#define LINUX_COUNTER_HAS_WAITERS 0x80000000
+#define LINUX_COUNTER_COUNT_MASK 0x7FFFFFFF
+
+struct linux_thread_context;
+
+struct linux_job_fiber
+{
+    ucontext_t Context;
+    platform_work_queue *Queue;
+    linux_job Job;
+    linux_job_fiber *Next; // NOTE: free list, ready list or the wait list of a counter
+    linux_thread_context *Thread; // NOTE: the thread that switched to it last, fibers move between threads
+};
+
+// NOTE: one locked ring shared by everyone, there's no work stealing like on Win32. A job that waits
+// parks its fiber and the thread gets on with other jobs. A queue made without fibers runs its jobs
+// on the threads' own stacks, and waiting there runs other jobs on top of the waiter
+struct platform_work_queue
+{
+    int32 volatile Lock;
+    uint32 ReadIndex;
+    uint32 WriteIndex;
+    linux_job Jobs[LINUX_JOB_QUEUE_SIZE];
+
+    int32 volatile OutstandingJobCount;
+    sem_t WakeSemaphore;
+
+    // NOTE: FiberLock covers the free list, the ready list and every counter's wait list
+    int32 volatile FiberLock;
+    uint32 MaxFiberCount; // NOTE: 0 for a queue without fibers
+    uint32 FiberCount; // NOTE: made so far, Fibers has room for MaxFiberCount
+    linux_job_fiber *Fibers;
+    linux_job_fiber *FirstFreeFiber;
+    linux_job_fiber *FirstReadyFiber;
+    linux_job_fiber *LastReadyFiber;
+    int32 volatile ReadyFiberCount;
+};
+
+enum linux_fiber_switch_reason
+{
+    LinuxFiberSwitch_Finished,
+    LinuxFiberSwitch_Wait,
+};
+
+struct linux_thread_context
+{
+    ucontext_t SchedulerContext; // NOTE: the thread's own stack
+    linux_job_fiber *CurrentFiber; // NOTE: 0 while running on the thread's own stack
+
+    // NOTE: what the job fiber wants done once it's switched back to the scheduler
+    linux_fiber_switch_reason SwitchReason;
+    platform_job_counter *WaitCounter;
+};
+
+#define LINUX_FILE_REQUEST_RING_SIZE 256
+
+enum linux_file_request_type
+{
+    LinuxFileRequest_Open,
+    LinuxFileRequest_Read,
+    LinuxFileRequest_Close,
+    LinuxFileRequest_Save,
+};
+
+struct linux_file_request
+{
+    linux_file_request_type Type;
+    platform_file_request *Request; // NOTE: 0 for closes
+
+    char *Filename; // NOTE: opens and saves
+    platform_file_handle *File;
+
+    int FileDescriptor; // NOTE: reads and closes
+    uint64 Offset;
+    uint64 Size; // NOTE: reads and saves
+    void *Dest; // NOTE: the data, for saves
+};
+
+// the file thread carries out requests in the order they were made. Making one takes the lock,
+// a batch run has every instance making requests from whichever thread is running it
+struct linux_file_queue
+{
+    int32 volatile Lock;
+    uint32 volatile WriteIndex;
+    uint32 volatile ReadIndex;
+    uint32 volatile DoneIndex; // NOTE: requests before this one are finished, not just taken
+    sem_t WakeSemaphore;
+
+    linux_file_request Requests[LINUX_FILE_REQUEST_RING_SIZE];
+};
+
+// NOTE: checkpoints are a fork of the whole process, the child sees application_memory
+// frozen copy on write and copies it into a memfd while the parent carries on
+#define LINUX_CHECKPOINT_COUNT 8
+#define LINUX_CHECKPOINT_WRITER_NICE 10 // NOTE: the nice value the writer child runs at, the frame loop stays at 0
+
+struct linux_checkpoint
+{
+    int MemoryFd; // NOTE: -1 when the slot is empty
+    pid_t WriterPid; // NOTE: 0 once the child has been reaped
+    bool32 IsReady;
+    uint64 FrameIndex;
+};
+
+struct linux_checkpointer
+{
+    uint8 *Memory;
+    uint64 MemorySize;
+    char *Directory; // NOTE: 0 to keep checkpoints in memory only
+
+    uint32 NextCheckpoint;
+    linux_checkpoint Checkpoints[LINUX_CHECKPOINT_COUNT];
+
+    uint64 TakenCount;
+    uint64 SkippedCount;
+    uint64 FailedCount;
+};
+
+// NOTE: a batch run is many copies of the app in one process, each with its own application_memory.
+// Every frame the main thread adds one job per instance to the batch queue and waits for all of
+// them. An instance's own work queue has no threads, the app's jobs run on whichever batch thread
+// is running that instance's frame while it waits on them
+struct linux_batch;
+
+struct linux_batch_instance
+{
+    linux_batch *Batch;
+
+    application_memory Memory;
+    platform_work_queue WorkQueue;
+    application_input Input;
+    offscreen_graphics_buffer Buffer;
+    int16 *Samples; // NOTE: 0 without sound
+
+    uint64 FrameCount;
+    hdr_histogram FrameTimes;
+};
+
+#define LINUX_MAX_BATCH_INSTANCE_COUNT 1024
+
+struct linux_batch
+{
+    linux_app_code *AppCode;
+    int UpdateHz;
+    int SamplesPerSecond;
+
+    uint32 InstanceCount;
+    linux_batch_instance *Instances;
+};
+
+#define LINUX_PLATFORM_LAYER_H
+#endif
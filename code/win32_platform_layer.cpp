@@ -9,7 +9,6 @@
   - Saved state locations
   - Getting a handle to our own executable file
   - Asset loading path
-  - Threading (launch a thread)
   - Raw Input (support for multiple keyboards)
   - Sleep/timeBeginPeriod
   - ClipCursor() (for multimonitor support)
@@ -23,6 +22,10 @@
 */
 
 #include "application.h"
+#include "application_telemetry.h"
+#include "application_saved_file.h"
+#include "application_debug_text.h"
+#include "application_audio_clock.h"
 
 #include <windows.h>
 #include <stdio.h>
@@ -41,6 +44,11 @@ struct win32_app_code
     HMODULE AppCodeDLL;
     app_update_and_render *UpdateAndRender;
     app_get_sound_samples *GetSoundSamples;
+    app_debug_get_arena_info *DebugGetArenaInfo;
+    app_save_state *SaveState;
+    app_load_state *LoadState;
+    app_begin_restore_state *BeginRestoreState;
+    app_end_restore_state *EndRestoreState;
 
     bool32 IsValid;
 };
@@ -54,6 +62,11 @@ internal win32_app_code Win32LoadGameCode()
     {
         result.UpdateAndRender = (app_update_and_render *)GetProcAddress(result.AppCodeDLL, "AppUpdateAndRender");
         result.GetSoundSamples = (app_get_sound_samples *)GetProcAddress(result.AppCodeDLL, "AppGetSoundSamples");
+        result.DebugGetArenaInfo = (app_debug_get_arena_info *)GetProcAddress(result.AppCodeDLL, "AppDebugGetArenaInfo");
+        result.SaveState = (app_save_state *)GetProcAddress(result.AppCodeDLL, "AppSaveState");
+        result.LoadState = (app_load_state *)GetProcAddress(result.AppCodeDLL, "AppLoadState");
+        result.BeginRestoreState = (app_begin_restore_state *)GetProcAddress(result.AppCodeDLL, "AppBeginRestoreState");
+        result.EndRestoreState = (app_end_restore_state *)GetProcAddress(result.AppCodeDLL, "AppEndRestoreState");
 
         result.IsValid = (result.UpdateAndRender && result.GetSoundSamples);
     }
@@ -64,6 +77,22 @@ internal win32_app_code Win32LoadGameCode()
         result.GetSoundSamples = AppGetSoundSamplesStub;
     }
 
+    // NOTE: optional, the app runs fine without it
+    if(!result.DebugGetArenaInfo)
+    {
+        result.DebugGetArenaInfo = AppDebugGetArenaInfoStub;
+    }
+    if(!result.SaveState || !result.LoadState)
+    {
+        result.SaveState = AppSaveStateStub;
+        result.LoadState = AppLoadStateStub;
+    }
+    if(!result.BeginRestoreState || !result.EndRestoreState)
+    {
+        result.BeginRestoreState = AppBeginRestoreStateStub;
+        result.EndRestoreState = AppEndRestoreStateStub;
+    }
+
     return result;
 }
 
@@ -115,22 +144,50 @@ internal void Win32LoadXInput() {
     }
 }
 
-// Process a digital button press from an XInput controller
-internal void Win32ProcessXInputDigitalButton(
-    DWORD x_input_button_state,
-    application_button_state *old_state, DWORD button_bit,
-    application_button_state *new_state)
+// add an event to this frame's input, keeping the events in the order they happened
+internal void Win32RecordInputEvent(application_input *input, uint32 controller_idx, uint32 button_idx,
+                                    real32 value, uint64 timestamp)
 {
-    new_state->EndedDown = ((x_input_button_state & button_bit) == button_bit);
-    new_state->HalfTransitionCount = (old_state->EndedDown != new_state->EndedDown) ? 1 : 0;
+    // NOTE: keyboard times are only as good as the message clock, keep them inside the frame's window
+    if(timestamp < input->StartTimestamp)
+    {
+        timestamp = input->StartTimestamp;
+    }
+
+    if(input->EventCount < MAX_INPUT_EVENT_COUNT)
+    {
+        // NOTE: keyboard and pad events come in separately, slide the new one back into place,
+        // after anything with the same time so events from one source keep their order
+        uint32 event_idx = input->EventCount++;
+        while(event_idx && (input->Events[event_idx - 1].Timestamp > timestamp))
+        {
+            input->Events[event_idx] = input->Events[event_idx - 1];
+            --event_idx;
+        }
+
+        application_input_event *event = input->Events + event_idx;
+        event->Timestamp = timestamp;
+        event->Time = (real32)(timestamp - input->StartTimestamp) / (real32)input->TimestampFrequency;
+        event->ControllerIndex = (uint8)controller_idx;
+        event->ButtonIndex = (uint8)button_idx;
+        event->Value = value;
+    }
+    else
+    {
+        ++input->DroppedEventCount;
+    }
 }
 
-// Process a digital button press from an XInput controller
-internal void Win32ProcessKeyboardMessage(application_button_state *new_state, bool32 is_down)
+// Process a key press for the keyboard controller
+internal void Win32ProcessKeyboardMessage(application_input *input, application_button_state *new_state,
+                                          bool32 is_down, uint64 timestamp)
 {
     Assert(new_state->EndedDown != is_down);
     new_state->EndedDown = is_down;
     ++new_state->HalfTransitionCount;
+
+    application_controller_input *keyboard = GetController(input, 0);
+    Win32RecordInputEvent(input, 0, (uint32)(new_state - keyboard->Buttons), is_down ? 1.0f : 0.0f, timestamp);
 }
 
 internal real32 Win32ProcessXInputStickPosition(SHORT thumb_stick_value, SHORT deadzone)
@@ -148,6 +205,275 @@ internal real32 Win32ProcessXInputStickPosition(SHORT thumb_stick_value, SHORT d
     return result;
 }
 
+// which of the controller's buttons a pad button bit drives
+internal application_button_state *Win32GetPadButton(application_controller_input *controller, uint32 button_bit)
+{
+    application_button_state *result = 0;
+    switch(button_bit)
+    {
+        case WIN32_PAD_STICK_UP: { result = &controller->MoveUp; } break;
+        case WIN32_PAD_STICK_DOWN: { result = &controller->MoveDown; } break;
+        case WIN32_PAD_STICK_LEFT: { result = &controller->MoveLeft; } break;
+        case WIN32_PAD_STICK_RIGHT: { result = &controller->MoveRight; } break;
+        case XINPUT_GAMEPAD_Y: { result = &controller->ActionUp; } break;
+        case XINPUT_GAMEPAD_A: { result = &controller->ActionDown; } break;
+        case XINPUT_GAMEPAD_X: { result = &controller->ActionLeft; } break;
+        case XINPUT_GAMEPAD_B: { result = &controller->ActionRight; } break;
+        case XINPUT_GAMEPAD_LEFT_SHOULDER: { result = &controller->LeftShoulder; } break;
+        case XINPUT_GAMEPAD_RIGHT_SHOULDER: { result = &controller->RightShoulder; } break;
+        case XINPUT_GAMEPAD_BACK: { result = &controller->Back; } break;
+        case XINPUT_GAMEPAD_START: { result = &controller->Start; } break;
+    }
+    return result;
+}
+
+global_variable uint32 Win32PadButtonBits[] =
+{
+    WIN32_PAD_STICK_UP, WIN32_PAD_STICK_DOWN, WIN32_PAD_STICK_LEFT, WIN32_PAD_STICK_RIGHT,
+    XINPUT_GAMEPAD_Y, XINPUT_GAMEPAD_A, XINPUT_GAMEPAD_X, XINPUT_GAMEPAD_B,
+    XINPUT_GAMEPAD_LEFT_SHOULDER, XINPUT_GAMEPAD_RIGHT_SHOULDER, XINPUT_GAMEPAD_BACK, XINPUT_GAMEPAD_START,
+};
+
+// turn a raw XInput pad into sticks plus button bits, the dpad and the stick directions included
+internal win32_pad_state Win32ReadXInputPad(XINPUT_GAMEPAD *pad)
+{
+    win32_pad_state result = {};
+    result.IsConnected = true;
+    result.Buttons = pad->wButtons;
+
+    // thumb stick and deadzone
+    result.StickX = Win32ProcessXInputStickPosition(pad->sThumbLX, XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE);
+    result.StickY = Win32ProcessXInputStickPosition(pad->sThumbLY, XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE);
+
+    // dpad
+    if(pad->wButtons & XINPUT_GAMEPAD_DPAD_UP)
+    {
+        result.StickY = 1.0f;
+    }
+    if(pad->wButtons & XINPUT_GAMEPAD_DPAD_DOWN)
+    {
+        result.StickY = -1.0f;
+    }
+    if(pad->wButtons & XINPUT_GAMEPAD_DPAD_LEFT)
+    {
+        result.StickX = -1.0f;
+    }
+    if(pad->wButtons & XINPUT_GAMEPAD_DPAD_RIGHT)
+    {
+        result.StickX = 1.0f;
+    }
+
+    // sticks are turned into single full direction presses
+    // the stick averageX/Y will still let you do granular movement
+    // if desired
+    real32 threshold = 0.5;
+    if(result.StickX < -threshold)
+    {
+        result.Buttons |= WIN32_PAD_STICK_LEFT;
+    }
+    if(result.StickX > threshold)
+    {
+        result.Buttons |= WIN32_PAD_STICK_RIGHT;
+    }
+    if(result.StickY < -threshold)
+    {
+        result.Buttons |= WIN32_PAD_STICK_DOWN;
+    }
+    if(result.StickY > threshold)
+    {
+        result.Buttons |= WIN32_PAD_STICK_UP;
+    }
+
+    return result;
+}
+
+// poll thread only, the ring is full when the main thread falls a whole ring behind
+inline void Win32PushPadEvent(win32_pad_poller *poller, uint32 *event_write_idx,
+                              uint32 pad_idx, uint32 button_bit, bool32 is_down, uint64 timestamp)
+{
+    if((*event_write_idx - poller->EventReadIndex) < WIN32_PAD_EVENT_RING_SIZE)
+    {
+        win32_pad_event *event = poller->Events + (*event_write_idx & (WIN32_PAD_EVENT_RING_SIZE - 1));
+        event->Timestamp = timestamp;
+        event->PadIndex = pad_idx;
+        event->ButtonBit = button_bit;
+        event->IsDown = is_down;
+        ++*event_write_idx;
+    }
+    else
+    {
+        InterlockedIncrement((LONG volatile *)&poller->DroppedEventCount);
+    }
+}
+
+DWORD WINAPI Win32PadPollThreadProc(LPVOID parameter)
+{
+    win32_pad_poller *poller = (win32_pad_poller *)parameter;
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    win32_pad_snapshot snapshot = {};
+    uint64 next_reconnect_poll[WIN32_PAD_COUNT] = {};
+    for(;;)
+    {
+        for(uint32 pad_idx = 0; pad_idx < WIN32_PAD_COUNT; ++pad_idx)
+        {
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+
+            // NOTE: XInputGetState stalls for a long time on an empty port, only look for new pads twice a second
+            win32_pad_state *old_pad = snapshot.Pads + pad_idx;
+            if(!old_pad->IsConnected && ((uint64)now.QuadPart < next_reconnect_poll[pad_idx]))
+            {
+                continue;
+            }
+
+            win32_pad_state new_pad = {};
+            XINPUT_STATE controller_state;
+            if(XInputGetState(pad_idx, &controller_state) == ERROR_SUCCESS)
+            {
+                new_pad = Win32ReadXInputPad(&controller_state.Gamepad);
+            }
+            else
+            {
+                next_reconnect_poll[pad_idx] = (uint64)now.QuadPart + (uint64)frequency.QuadPart/2;
+            }
+
+            // NOTE: a pad that went away lets go of everything it was holding
+            uint32 changed_buttons = old_pad->Buttons ^ new_pad.Buttons;
+            for(int bit_idx = 0; bit_idx < ArrayCount(Win32PadButtonBits); ++bit_idx)
+            {
+                uint32 button_bit = Win32PadButtonBits[bit_idx];
+                if(changed_buttons & button_bit)
+                {
+                    Win32PushPadEvent(poller, &snapshot.EventWriteIndex, pad_idx, button_bit,
+                                      (new_pad.Buttons & button_bit) != 0, (uint64)now.QuadPart);
+                }
+            }
+            *old_pad = new_pad;
+        }
+
+        LARGE_INTEGER sample_time;
+        QueryPerformanceCounter(&sample_time);
+        snapshot.Timestamp = (uint64)sample_time.QuadPart;
+
+        // NOTE: the events have to land before the index that publishes them
+        InterlockedIncrement((LONG volatile *)&poller->Sequence);
+        poller->Published = snapshot;
+        InterlockedIncrement((LONG volatile *)&poller->Sequence);
+
+        // NOTE: the scheduler runs at 1ms, see timeBeginPeriod in WinMain
+        Sleep(1);
+    }
+}
+
+// main thread, copy out the latest published pad states without blocking the poll thread
+internal void Win32ReadPadSnapshot(win32_pad_poller *poller, win32_pad_snapshot *snapshot)
+{
+    for(;;)
+    {
+        uint32 sequence = poller->Sequence;
+        _ReadBarrier();
+        if(!(sequence & 1))
+        {
+            *snapshot = poller->Published;
+            _ReadBarrier();
+            if(poller->Sequence == sequence)
+            {
+                break;
+            }
+        }
+        YieldProcessor();
+    }
+}
+
+// hand the pads to the app, button transitions come from the events the snapshot has seen,
+// returns how old the pad state is in seconds
+internal real32 Win32ProcessPads(win32_pad_poller *poller, application_input *old_input, application_input *new_input)
+{
+    win32_pad_snapshot snapshot;
+    Win32ReadPadSnapshot(poller, &snapshot);
+
+    // application input
+    DWORD max_controller_count = WIN32_PAD_COUNT; // adjusted for keyboard at 0 idx
+    if(max_controller_count > (ArrayCount(new_input->Controllers)) - 1)
+    {
+        max_controller_count = (ArrayCount(new_input->Controllers)) - 1;
+    }
+
+    for(DWORD pad_idx = 0; pad_idx < max_controller_count; ++pad_idx)
+    {
+        DWORD our_controller_idx = pad_idx + 1; // skip 0 idx for keyboard
+        application_controller_input *old_controller = GetController(old_input, our_controller_idx);
+        application_controller_input *new_controller = GetController(new_input, our_controller_idx);
+        win32_pad_state *pad = snapshot.Pads + pad_idx;
+
+        new_controller->IsConnected = pad->IsConnected;
+        new_controller->IsAnalog = pad->IsConnected;
+        new_controller->StickAverageX = pad->StickX;
+        new_controller->StickAverageY = pad->StickY;
+        if(new_controller->StickAverageX != old_controller->StickAverageX)
+        {
+            Win32RecordInputEvent(new_input, our_controller_idx, INPUT_EVENT_STICK_X,
+                                  new_controller->StickAverageX, snapshot.Timestamp);
+        }
+        if(new_controller->StickAverageY != old_controller->StickAverageY)
+        {
+            Win32RecordInputEvent(new_input, our_controller_idx, INPUT_EVENT_STICK_Y,
+                                  new_controller->StickAverageY, snapshot.Timestamp);
+        }
+
+        for(int bit_idx = 0; bit_idx < ArrayCount(Win32PadButtonBits); ++bit_idx)
+        {
+            application_button_state *button = Win32GetPadButton(new_controller, Win32PadButtonBits[bit_idx]);
+            button->EndedDown = (pad->Buttons & Win32PadButtonBits[bit_idx]) != 0;
+            button->HalfTransitionCount = 0;
+        }
+    }
+
+    uint32 event_read_idx = poller->EventReadIndex;
+    for(; event_read_idx != snapshot.EventWriteIndex; ++event_read_idx)
+    {
+        win32_pad_event *event = poller->Events + (event_read_idx & (WIN32_PAD_EVENT_RING_SIZE - 1));
+        if(event->PadIndex < max_controller_count)
+        {
+            uint32 our_controller_idx = event->PadIndex + 1;
+            application_controller_input *new_controller = GetController(new_input, our_controller_idx);
+            application_button_state *button = Win32GetPadButton(new_controller, event->ButtonBit);
+            ++button->HalfTransitionCount;
+            Win32RecordInputEvent(new_input, our_controller_idx, (uint32)(button - new_controller->Buttons),
+                                  event->IsDown ? 1.0f : 0.0f, event->Timestamp);
+        }
+    }
+
+    // NOTE: we're done with the slots before the poll thread may reuse them
+    _ReadWriteBarrier();
+    poller->EventReadIndex = event_read_idx;
+
+    // NOTE: if the ring overflowed some transitions are gone, at least show the ones we can see
+    for(DWORD pad_idx = 0; pad_idx < max_controller_count; ++pad_idx)
+    {
+        application_controller_input *old_controller = GetController(old_input, pad_idx + 1);
+        application_controller_input *new_controller = GetController(new_input, pad_idx + 1);
+        for(int button_idx = 0; button_idx < ArrayCount(new_controller->Buttons); ++button_idx)
+        {
+            application_button_state *old_button = old_controller->Buttons + button_idx;
+            application_button_state *new_button = new_controller->Buttons + button_idx;
+            if(!new_button->HalfTransitionCount && (old_button->EndedDown != new_button->EndedDown))
+            {
+                new_button->HalfTransitionCount = 1;
+            }
+        }
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    real32 result = (real32)((uint64)now.QuadPart - snapshot.Timestamp) / (real32)new_input->TimestampFrequency;
+    return result;
+}
+
 //
 // Sound
 //
@@ -378,113 +704,1209 @@ internal void Win32DebugSyncSound(
             Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->OutputPlayCursor, play_color);
             Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->OutputWriteCursor, write_color);
 
-            top += line_height + pad_y;
-            bottom += line_height + pad_y; 
+            top += line_height + pad_y;
+            bottom += line_height + pad_y; 
+
+            Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->OutputLocation, play_color);
+            Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->OutputLocation + this_marker->OutputByteCount, write_color);
+            
+            top += line_height + pad_y;
+            bottom += line_height + pad_y; 
+
+            Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, first_top, bottom, this_marker->ExpectedFlipPlayCursor, expected_flip_color);
+        }
+ 
+        Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->FlipPlayCursor, play_color);
+        Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->FlipPlayCursor + 480 * sound_output->BytesPerSample, play_window_color);
+        Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->FlipWriteCursor, write_color);        
+    } 
+}
+
+//
+// File IO
+//
+
+global_variable win32_file_queue GlobalFileQueue;
+
+// WriteFile takes 32 bit sizes
+internal bool32 Win32WriteAll(HANDLE file_handle, void *data, uint64 size)
+{
+    uint8 *at = (uint8 *)data;
+    while(size)
+    {
+        DWORD size_to_write = (size > Gigabytes(1)) ? (DWORD)Gigabytes(1) : (DWORD)size;
+        DWORD bytes_written = 0;
+        if(!WriteFile(file_handle, at, size_to_write, &bytes_written, 0) || (bytes_written != size_to_write))
+        {
+            return false;
+        }
+        at += size_to_write;
+        size -= size_to_write;
+    }
+    return true;
+}
+
+internal bool32 Win32ReadAll(HANDLE file_handle, void *dest, uint64 size)
+{
+    uint8 *at = (uint8 *)dest;
+    while(size)
+    {
+        DWORD size_to_read = (size > Gigabytes(1)) ? (DWORD)Gigabytes(1) : (DWORD)size;
+        DWORD bytes_read = 0;
+        if(!ReadFile(file_handle, at, size_to_read, &bytes_read, 0) || (bytes_read != size_to_read))
+        {
+            return false;
+        }
+        at += size_to_read;
+        size -= size_to_read;
+    }
+    return true;
+}
+
+// write filename the way application_saved_file.h describes, blocks until it's on the disk
+internal bool32 Win32SaveFileAtomically(char *filename, void *data, uint64 size)
+{
+    bool32 result = false;
+
+    char temp_filename[SAVED_FILE_MAX_FILENAME];
+    char prev_filename[SAVED_FILE_MAX_FILENAME];
+    if(GetSavedFileName(temp_filename, sizeof(temp_filename), filename, ".tmp") &&
+       GetSavedFileName(prev_filename, sizeof(prev_filename), filename, ".prev"))
+    {
+        saved_file_footer footer = MakeSavedFileFooter(data, size);
+
+        HANDLE file_handle = CreateFileA(temp_filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                                         FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        if(file_handle != INVALID_HANDLE_VALUE)
+        {
+            bool32 written = (Win32WriteAll(file_handle, data, size) &&
+                              Win32WriteAll(file_handle, &footer, sizeof(footer)) &&
+                              FlushFileBuffers(file_handle));
+            CloseHandle(file_handle);
+
+            if(written)
+            {
+                // NOTE: ReplaceFile keeps the old save as .prev in the same step, the first
+                // time there is nothing to replace yet
+                if(GetFileAttributesA(filename) != INVALID_FILE_ATTRIBUTES)
+                {
+                    result = ReplaceFileA(filename, temp_filename, prev_filename,
+                                          REPLACEFILE_IGNORE_MERGE_ERRORS, 0, 0);
+                }
+                else
+                {
+                    result = MoveFileExA(temp_filename, filename, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH);
+                }
+            }
+
+            if(!result)
+            {
+                // TODO: Logging
+                DeleteFileA(temp_filename);
+            }
+        }
+        else
+        {
+            // TODO: Logging
+        }
+    }
+
+    return result;
+}
+
+// DEBUG: free file memory
+void DEBUGPlatformFreeFileMemory(void *memory)
+{
+    if(memory)
+    {
+        VirtualFree(memory, 0, MEM_RELEASE);
+    }
+}
+
+// DEBUG: read the contents of a file 
+debug_read_file_result DEBUGPlatformReadEntireFile(char *filename)
+{
+    debug_read_file_result result = {};
+    
+    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if(file_handle != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER file_size;
+        if(GetFileSizeEx(file_handle, &file_size))
+        {
+            uint32 file_size32 = SafeTruncateUInt64(file_size.QuadPart);
+            result.Contents = VirtualAlloc(0, file_size32, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+            if(result.Contents)
+            {
+                DWORD bytes_read;
+                if(ReadFile(file_handle, result.Contents, file_size32, &bytes_read, 0) &&
+                   (file_size32 == bytes_read))
+                {
+                    // File read successfully
+                    result.ContentsSize = file_size32;
+                }
+                else
+                {                    
+                    // TODO: Logging
+                    DEBUGPlatformFreeFileMemory(result.Contents);
+                    result.Contents = 0;
+                }
+            }
+            else
+            {
+                // TODO: Logging
+            }
+        }
+        else
+        {
+            // TODO: Logging
+        }
+
+        CloseHandle(file_handle);
+    }
+    else
+    {
+        // TODO: Logging
+    }
+
+    return(result);
+}
+
+// DEBUG: write bytes into a file
+bool32 DEBUGPlatformWriteEntireFile(char *filename, uint32 memory_size, void *memory)
+{
+    bool32 result = false;
+    
+    HANDLE file_handle = CreateFileA(filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+    if(file_handle != INVALID_HANDLE_VALUE)
+    {
+        DWORD bytes_written;
+        if(WriteFile(file_handle, memory, memory_size, &bytes_written, 0))
+        {
+            // File read successfully
+            result = (bytes_written == memory_size);
+        }
+        else
+        {
+            // TODO: Logging
+        }
+
+        CloseHandle(file_handle);
+    }
+    else
+    {
+        // TODO: Logging
+    }
+
+    return(result);
+}
+
+// main thread only, false when the file thread is a whole ring behind
+internal bool32 Win32QueueFileRequest(win32_file_queue *queue, win32_file_request *file_request)
+{
+    bool32 result = false;
+    while(InterlockedCompareExchange((LONG volatile *)&queue->Lock, 1, 0) != 0)
+    {
+        YieldProcessor();
+    }
+
+    uint32 write_idx = queue->WriteIndex;
+    if((write_idx - queue->ReadIndex) < WIN32_FILE_REQUEST_RING_SIZE)
+    {
+        if(file_request->Request)
+        {
+            file_request->Request->State = PlatformFileRequest_Pending;
+            file_request->Request->BytesRead = 0;
+        }
+        queue->Requests[write_idx & (WIN32_FILE_REQUEST_RING_SIZE - 1)] = *file_request;
+
+        // NOTE: the request has to land before the index that publishes it
+        _WriteBarrier();
+        queue->WriteIndex = write_idx + 1;
+        ReleaseSemaphore(queue->WakeSemaphore, 1, 0);
+        result = true;
+    }
+
+    InterlockedExchange((LONG volatile *)&queue->Lock, 0);
+    return result;
+}
+
+internal PLATFORM_OPEN_FILE(Win32OpenFile)
+{
+    win32_file_request file_request = {};
+    file_request.Type = Win32FileRequest_Open;
+    file_request.Request = request;
+    file_request.Filename = filename;
+    file_request.File = file;
+    bool32 result = Win32QueueFileRequest(&GlobalFileQueue, &file_request);
+    return result;
+}
+
+internal PLATFORM_READ_DATA_FROM_FILE(Win32ReadDataFromFile)
+{
+    Assert(file->Platform);
+
+    win32_file_request file_request = {};
+    file_request.Type = Win32FileRequest_Read;
+    file_request.Request = request;
+    file_request.Handle = (HANDLE)file->Platform;
+    file_request.Offset = offset;
+    file_request.Size = size;
+    file_request.Dest = dest;
+    bool32 result = Win32QueueFileRequest(&GlobalFileQueue, &file_request);
+    return result;
+}
+
+internal PLATFORM_CLOSE_FILE(Win32CloseFile)
+{
+    win32_file_request file_request = {};
+    file_request.Type = Win32FileRequest_Close;
+    file_request.Handle = (HANDLE)file->Platform;
+    bool32 result = Win32QueueFileRequest(&GlobalFileQueue, &file_request);
+    if(result)
+    {
+        file->Platform = 0;
+        file->Size = 0;
+    }
+    return result;
+}
+
+internal PLATFORM_SAVE_FILE(Win32SaveFile)
+{
+    win32_file_request file_request = {};
+    file_request.Type = Win32FileRequest_Save;
+    file_request.Request = request;
+    file_request.Filename = filename;
+    file_request.Size = size;
+    file_request.Dest = data;
+    bool32 result = Win32QueueFileRequest(&GlobalFileQueue, &file_request);
+    return result;
+}
+
+// wait for the file thread to finish every request made so far, saves included
+internal void Win32FinishFileRequests(win32_file_queue *queue)
+{
+    uint32 write_idx = queue->WriteIndex;
+    while(queue->DoneIndex != write_idx)
+    {
+        Sleep(1);
+    }
+    _ReadBarrier();
+}
+
+DWORD WINAPI Win32FileThreadProc(LPVOID parameter)
+{
+    win32_file_queue *queue = (win32_file_queue *)parameter;
+    for(;;)
+    {
+        WaitForSingleObjectEx(queue->WakeSemaphore, INFINITE, FALSE);
+
+        uint32 read_idx = queue->ReadIndex;
+        Assert(read_idx != queue->WriteIndex);
+        _ReadBarrier();
+        win32_file_request file_request = queue->Requests[read_idx & (WIN32_FILE_REQUEST_RING_SIZE - 1)];
+
+        // NOTE: the copy is taken, the slot can be reused
+        _ReadWriteBarrier();
+        queue->ReadIndex = read_idx + 1;
+
+        bool32 succeeded = false;
+        switch(file_request.Type)
+        {
+            case Win32FileRequest_Open:
+            {
+                HANDLE file_handle = CreateFileA(file_request.Filename, GENERIC_READ, FILE_SHARE_READ, 0,
+                                                 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+                if(file_handle != INVALID_HANDLE_VALUE)
+                {
+                    LARGE_INTEGER file_size;
+                    if(GetFileSizeEx(file_handle, &file_size))
+                    {
+                        file_request.File->Size = (uint64)file_size.QuadPart;
+                        file_request.File->Platform = file_handle;
+                        succeeded = true;
+                    }
+                    else
+                    {
+                        // TODO: Logging
+                        CloseHandle(file_handle);
+                    }
+                }
+                else
+                {
+                    // TODO: Logging
+                }
+            } break;
+
+            case Win32FileRequest_Read:
+            {
+                // NOTE: a synchronous handle still reads at the offset given in the overlapped
+                OVERLAPPED overlapped = {};
+                overlapped.Offset = (DWORD)(file_request.Offset & 0xFFFFFFFF);
+                overlapped.OffsetHigh = (DWORD)(file_request.Offset >> 32);
+
+                DWORD bytes_read = 0;
+                if(ReadFile(file_request.Handle, file_request.Dest, (DWORD)file_request.Size, &bytes_read, &overlapped) &&
+                   (bytes_read == file_request.Size))
+                {
+                    file_request.Request->BytesRead = bytes_read;
+                    succeeded = true;
+                }
+                else
+                {
+                    // TODO: Logging
+                }
+            } break;
+
+            case Win32FileRequest_Close:
+            {
+                CloseHandle(file_request.Handle);
+            } break;
+
+            case Win32FileRequest_Save:
+            {
+                succeeded = Win32SaveFileAtomically(file_request.Filename, file_request.Dest, file_request.Size);
+            } break;
+        }
+
+        if(file_request.Request)
+        {
+            // NOTE: everything the request wrote has to be visible before the app sees it finished
+            _WriteBarrier();
+            file_request.Request->State = succeeded ? PlatformFileRequest_Done : PlatformFileRequest_Failed;
+        }
+        _WriteBarrier();
+        queue->DoneIndex = read_idx + 1;
+    }
+}
+
+//
+// Snapshots
+//
+
+inline void Win32GetSnapshotFilename(uint64 sequence, bool32 is_keyframe, char *dest, int dest_size)
+{
+    _snprintf_s(dest, dest_size, _TRUNCATE, "%s\\snapshot_%08llu.%s", WIN32_SNAPSHOT_DIRECTORY,
+                (unsigned long long)sequence, is_keyframe ? "key" : "delta");
+}
+
+// writer thread, pages are written out of source in the order of page_indices
+internal bool32 Win32WriteSnapshotFile(win32_snapshotter *snapshotter, win32_snapshot_type type, uint64 sequence,
+                                       uint32 *page_indices, uint32 page_count, uint8 *pages, bool32 pages_are_packed)
+{
+    bool32 result = false;
+
+    char filename[MAX_PATH];
+    Win32GetSnapshotFilename(sequence, (type == Win32Snapshot_Keyframe), filename, sizeof(filename));
+    HANDLE file_handle = CreateFileA(filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if(file_handle != INVALID_HANDLE_VALUE)
+    {
+        win32_snapshot_header header = {};
+        header.Magic = WIN32_SNAPSHOT_MAGIC;
+        header.Version = WIN32_SNAPSHOT_VERSION;
+        header.Type = type;
+        header.PageSize = snapshotter->PageSize;
+        header.Sequence = sequence;
+        header.KeyframeSequence = snapshotter->KeyframeSequence;
+        header.MemorySize = snapshotter->MemorySize;
+        header.PageCount = page_count;
+
+        result = (Win32WriteAll(file_handle, &header, sizeof(header)) &&
+                  Win32WriteAll(file_handle, page_indices, page_count*sizeof(uint32)));
+        if(pages_are_packed)
+        {
+            result = result && Win32WriteAll(file_handle, pages, (uint64)page_count*snapshotter->PageSize);
+        }
+        else
+        {
+            // NOTE: pages sit at their own place in pages, write each run of neighbours in one go
+            uint32 run_start = 0;
+            while(result && (run_start < page_count))
+            {
+                uint32 run_end = run_start + 1;
+                while((run_end < page_count) && (page_indices[run_end] == page_indices[run_end - 1] + 1))
+                {
+                    ++run_end;
+                }
+                result = Win32WriteAll(file_handle, pages + (uint64)page_indices[run_start]*snapshotter->PageSize,
+                                       (uint64)(run_end - run_start)*snapshotter->PageSize);
+                run_start = run_end;
+            }
+        }
+
+        CloseHandle(file_handle);
+        snapshotter->LastWrittenByteCount = sizeof(header) + (uint64)page_count*(sizeof(uint32) + snapshotter->PageSize);
+    }
+    else
+    {
+        // TODO: Logging
+    }
+
+    return result;
+}
+
+// writer thread, or the main thread while the writer is idle
+internal bool32 Win32ApplySnapshotFile(win32_snapshotter *snapshotter, uint64 sequence, bool32 is_keyframe)
+{
+    bool32 result = false;
+
+    char filename[MAX_PATH];
+    Win32GetSnapshotFilename(sequence, is_keyframe, filename, sizeof(filename));
+    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if(file_handle != INVALID_HANDLE_VALUE)
+    {
+        win32_snapshot_header header = {};
+        if(Win32ReadAll(file_handle, &header, sizeof(header)) &&
+           (header.Magic == WIN32_SNAPSHOT_MAGIC) && (header.Version == WIN32_SNAPSHOT_VERSION) &&
+           (header.PageSize == snapshotter->PageSize) && (header.MemorySize == snapshotter->MemorySize) &&
+           (header.Sequence == sequence) && (header.PageCount <= snapshotter->MaxPageCount))
+        {
+            uint32 page_count = (uint32)header.PageCount;
+            uint32 *page_indices = snapshotter->KeyframePageIndices;
+            result = Win32ReadAll(file_handle, page_indices, page_count*sizeof(uint32));
+            for(uint32 page_idx = 0; result && (page_idx < page_count); ++page_idx)
+            {
+                uint32 page = page_indices[page_idx];
+                result = false;
+                if(page < snapshotter->MaxPageCount)
+                {
+                    snapshotter->TouchedPages[page] = 1;
+                    result = Win32ReadAll(file_handle, snapshotter->Shadow + (uint64)page*snapshotter->PageSize,
+                                          snapshotter->PageSize);
+                }
+            }
+        }
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+DWORD WINAPI Win32SnapshotWriterThreadProc(LPVOID parameter)
+{
+    win32_snapshotter *snapshotter = (win32_snapshotter *)parameter;
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    for(;;)
+    {
+        WaitForSingleObjectEx(snapshotter->WakeEvent, INFINITE, FALSE);
+        if(snapshotter->IsStopping)
+        {
+            break;
+        }
+        Assert(snapshotter->WriterIsBusy);
+
+        // NOTE: keep the shadow copy current, keyframes are written from it
+        // so the main thread never has to copy more than what changed
+        uint64 page_size = snapshotter->PageSize;
+        for(uint32 staged_idx = 0; staged_idx < snapshotter->StagedPageCount; ++staged_idx)
+        {
+            uint32 page = snapshotter->PageIndices[staged_idx];
+            CopyMemory(snapshotter->Shadow + page*page_size, snapshotter->Staging + staged_idx*page_size, page_size);
+            snapshotter->TouchedPages[page] = 1;
+        }
+
+        uint64 sequence = snapshotter->StagedSequence;
+        bool32 is_written = false;
+        if(!snapshotter->HasKeyframe || snapshotter->NeedsKeyframe ||
+           ((sequence % WIN32_SNAPSHOT_KEYFRAME_INTERVAL) == 0))
+        {
+            uint64 previous_keyframe_sequence = snapshotter->KeyframeSequence;
+            bool32 had_keyframe = snapshotter->HasKeyframe;
+
+            uint32 page_count = 0;
+            for(uint32 page = 0; page < snapshotter->MaxPageCount; ++page)
+            {
+                if(snapshotter->TouchedPages[page])
+                {
+                    snapshotter->KeyframePageIndices[page_count++] = page;
+                }
+            }
+
+            snapshotter->KeyframeSequence = sequence;
+            if(Win32WriteSnapshotFile(snapshotter, Win32Snapshot_Keyframe, sequence,
+                                      snapshotter->KeyframePageIndices, page_count, snapshotter->Shadow, false))
+            {
+                is_written = true;
+                snapshotter->HasKeyframe = true;
+                snapshotter->NeedsKeyframe = false;
+
+                // NOTE: keep the chain before this one in case this one turns out to be damaged
+                if(had_keyframe)
+                {
+                    for(uint64 old_sequence = snapshotter->OldestSequenceOnDisk;
+                        old_sequence < previous_keyframe_sequence;
+                        ++old_sequence)
+                    {
+                        char filename[MAX_PATH];
+                        Win32GetSnapshotFilename(old_sequence, true, filename, sizeof(filename));
+                        DeleteFileA(filename);
+                        Win32GetSnapshotFilename(old_sequence, false, filename, sizeof(filename));
+                        DeleteFileA(filename);
+                    }
+                    snapshotter->OldestSequenceOnDisk = previous_keyframe_sequence;
+                }
+            }
+            else
+            {
+                // NOTE: the chain before this one is still whole, it's what a restore goes back to
+                snapshotter->KeyframeSequence = previous_keyframe_sequence;
+            }
+        }
+        else
+        {
+            is_written = Win32WriteSnapshotFile(snapshotter, Win32Snapshot_Delta, sequence, snapshotter->PageIndices,
+                                                snapshotter->StagedPageCount, snapshotter->Staging, true);
+        }
+
+        if(is_written)
+        {
+            snapshotter->LastWrittenSequence = sequence;
+        }
+        else
+        {
+            // NOTE: a delta after the gap could never be applied, so try for a keyframe next time.
+            // Shadow already has these pages, the keyframe gets them from there
+            snapshotter->NeedsKeyframe = true;
+        }
+        InterlockedExchange((LONG volatile *)&snapshotter->WriterIsBusy, 0);
+    }
+
+    return 0;
+}
+
+internal bool32 Win32InitSnapshotter(win32_snapshotter *snapshotter, void *memory, uint64 memory_size)
+{
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+
+    snapshotter->Memory = (uint8 *)memory;
+    snapshotter->MemorySize = memory_size;
+    snapshotter->PageSize = system_info.dwPageSize;
+    snapshotter->MaxPageCount = (uint32)(memory_size / system_info.dwPageSize);
+
+    snapshotter->DirtyAddresses = (void **)VirtualAlloc(0, snapshotter->MaxPageCount*sizeof(void *),
+                                                        MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    snapshotter->PageIndices = (uint32 *)VirtualAlloc(0, snapshotter->MaxPageCount*sizeof(uint32),
+                                                      MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    snapshotter->KeyframePageIndices = (uint32 *)VirtualAlloc(0, snapshotter->MaxPageCount*sizeof(uint32),
+                                                              MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    snapshotter->TouchedPages = (uint8 *)VirtualAlloc(0, snapshotter->MaxPageCount,
+                                                      MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    snapshotter->Staging = (uint8 *)VirtualAlloc(0, (size_t)memory_size, MEM_RESERVE, PAGE_READWRITE);
+
+    // NOTE: zero like Memory starts out, only the pages that get touched ever take up space
+    snapshotter->Shadow = (uint8 *)VirtualAlloc(0, (size_t)memory_size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+
+    if(!snapshotter->DirtyAddresses || !snapshotter->PageIndices || !snapshotter->KeyframePageIndices ||
+       !snapshotter->TouchedPages || !snapshotter->Staging || !snapshotter->Shadow)
+    {
+        return false;
+    }
+
+    CreateDirectoryA(WIN32_SNAPSHOT_DIRECTORY, 0);
+    snapshotter->WakeEvent = CreateEventA(0, FALSE, FALSE, 0);
+    snapshotter->WriterThread = CreateThread(0, 0, Win32SnapshotWriterThreadProc, snapshotter, 0, 0);
+
+    return true;
+}
+
+// main thread, lets the writer finish what it has, ends it and gives back the staging memory
+internal void Win32StopSnapshotter(win32_snapshotter *snapshotter)
+{
+    while(snapshotter->WriterIsBusy)
+    {
+        Sleep(1);
+    }
+
+    snapshotter->IsStopping = true;
+    SetEvent(snapshotter->WakeEvent);
+    WaitForSingleObject(snapshotter->WriterThread, INFINITE);
+    CloseHandle(snapshotter->WriterThread);
+    snapshotter->WriterThread = 0;
+
+    // NOTE: committed as far as the biggest snapshot ever staged, which can be all of Memory
+    VirtualFree(snapshotter->Staging, 0, MEM_DECOMMIT);
+}
+
+// main thread, the pages written to since the last call. False when there were too many to list
+internal bool32 Win32GetDirtyPages(win32_snapshotter *snapshotter, ULONG_PTR *page_count)
+{
+    ULONG granularity;
+    *page_count = snapshotter->MaxPageCount;
+    bool32 result = (GetWriteWatch(WRITE_WATCH_FLAG_RESET, snapshotter->Memory, (SIZE_T)snapshotter->MemorySize,
+                                   snapshotter->DirtyAddresses, page_count, &granularity) == 0);
+    return result;
+}
+
+// main thread, copies out what changed since the last snapshot and hands it to the writer.
+// False when the writer is still busy with the last one, the changes carry over to the next try
+internal bool32 Win32TakeSnapshot(win32_snapshotter *snapshotter)
+{
+    if(snapshotter->WriterIsBusy)
+    {
+        return false;
+    }
+
+    ULONG_PTR dirty_page_count;
+    if(!Win32GetDirtyPages(snapshotter, &dirty_page_count))
+    {
+        return false;
+    }
+
+    uint64 page_size = snapshotter->PageSize;
+    VirtualAlloc(snapshotter->Staging, (size_t)(dirty_page_count*page_size), MEM_COMMIT, PAGE_READWRITE);
+    for(ULONG_PTR dirty_idx = 0; dirty_idx < dirty_page_count; ++dirty_idx)
+    {
+        uint8 *page = (uint8 *)snapshotter->DirtyAddresses[dirty_idx];
+        uint32 page_idx = (uint32)((page - snapshotter->Memory) / page_size);
+        snapshotter->PageIndices[dirty_idx] = page_idx;
+        CopyMemory(snapshotter->Staging + dirty_idx*page_size, page, page_size);
+    }
+
+    snapshotter->StagedPageCount = (uint32)dirty_page_count;
+    snapshotter->StagedSequence = snapshotter->NextSequence++;
+    InterlockedExchange((LONG volatile *)&snapshotter->WriterIsBusy, 1);
+    SetEvent(snapshotter->WakeEvent);
+    return true;
+}
+
+// main thread, puts Memory back the way it was at the last snapshot written to disk,
+// by reading back its keyframe and every delta after it
+internal bool32 Win32RestoreSnapshot(win32_snapshotter *snapshotter)
+{
+    while(snapshotter->WriterIsBusy)
+    {
+        Sleep(1);
+    }
+    if(!snapshotter->HasKeyframe)
+    {
+        return false;
+    }
+
+    // NOTE: pages written since the last snapshot have to go back too
+    ULONG_PTR dirty_page_count;
+    if(!Win32GetDirtyPages(snapshotter, &dirty_page_count))
+    {
+        return false;
+    }
+    for(ULONG_PTR dirty_idx = 0; dirty_idx < dirty_page_count; ++dirty_idx)
+    {
+        uint8 *page = (uint8 *)snapshotter->DirtyAddresses[dirty_idx];
+        snapshotter->TouchedPages[(page - snapshotter->Memory) / snapshotter->PageSize] = 1;
+    }
+
+    // NOTE: anything the keyframe doesn't list was still zero when it was taken
+    uint64 page_size = snapshotter->PageSize;
+    for(uint32 page = 0; page < snapshotter->MaxPageCount; ++page)
+    {
+        if(snapshotter->TouchedPages[page])
+        {
+            ZeroMemory(snapshotter->Shadow + page*page_size, page_size);
+        }
+    }
+
+    bool32 result = Win32ApplySnapshotFile(snapshotter, snapshotter->KeyframeSequence, true);
+    for(uint64 sequence = snapshotter->KeyframeSequence + 1;
+        result && (sequence <= snapshotter->LastWrittenSequence);
+        ++sequence)
+    {
+        result = Win32ApplySnapshotFile(snapshotter, sequence, false);
+    }
+
+    for(uint32 page = 0; page < snapshotter->MaxPageCount; ++page)
+    {
+        if(snapshotter->TouchedPages[page])
+        {
+            if(result)
+            {
+                CopyMemory(snapshotter->Memory + page*page_size, snapshotter->Shadow + page*page_size, page_size);
+            }
+            else
+            {
+                // NOTE: the files didn't hold up, keep running as we were and start a new chain
+                CopyMemory(snapshotter->Shadow + page*page_size, snapshotter->Memory + page*page_size, page_size);
+                snapshotter->HasKeyframe = false;
+            }
+        }
+    }
+    ResetWriteWatch(snapshotter->Memory, (SIZE_T)snapshotter->MemorySize);
+
+    return result;
+}
+
+//
+// Threading
+//
+
+// NOTE: fibers move between threads, so this must not be cached across a fiber switch (built with /GT)
+global_variable __declspec(thread) win32_thread_context Win32ThreadContext;
+
+// owner only, fails when the deque is full
+inline bool32 Win32PushJob(win32_job_deque *deque, win32_job *job)
+{
+    bool32 result = false;
+
+    int64 bottom = deque->Bottom;
+    int64 top = deque->Top;
+    if((bottom - top) < WIN32_JOB_DEQUE_SIZE)
+    {
+        deque->Jobs[bottom & (WIN32_JOB_DEQUE_SIZE - 1)] = *job;
+
+        // NOTE: the job has to be written before a thief can see the new bottom
+        _WriteBarrier();
+        deque->Bottom = bottom + 1;
+        result = true;
+    }
+
+    return result;
+}
+
+// owner only, takes the most recently pushed job
+inline bool32 Win32PopJob(win32_job_deque *deque, win32_job *job)
+{
+    bool32 result = false;
+
+    // NOTE: thieves have to see the lowered bottom before we read top, x64 only
+    // keeps that store -> load order with a locked instruction
+    int64 bottom = deque->Bottom - 1;
+    InterlockedExchange64(&deque->Bottom, bottom);
+    int64 top = deque->Top;
+
+    if(top <= bottom)
+    {
+        *job = deque->Jobs[bottom & (WIN32_JOB_DEQUE_SIZE - 1)];
+        result = true;
+
+        if(top == bottom)
+        {
+            // NOTE: this was the last job, a thief may be going for it too
+            result = (InterlockedCompareExchange64(&deque->Top, top + 1, top) == top);
+            deque->Bottom = bottom + 1;
+        }
+    }
+    else
+    {
+        deque->Bottom = bottom + 1;
+    }
+
+    return result;
+}
+
+// any thread, takes the oldest job, can fail when it loses a race even though the deque isn't empty
+inline bool32 Win32StealJob(win32_job_deque *deque, win32_job *job)
+{
+    bool32 result = false;
+
+    int64 top = deque->Top;
+    _ReadBarrier();
+    int64 bottom = deque->Bottom;
+    if(top < bottom)
+    {
+        *job = deque->Jobs[top & (WIN32_JOB_DEQUE_SIZE - 1)];
+        _ReadBarrier();
+        result = (InterlockedCompareExchange64(&deque->Top, top + 1, top) == top);
+    }
+
+    return result;
+}
+
+// own deque first, then steal round robin starting from the next thread over
+internal bool32 Win32FindJob(platform_work_queue *queue, win32_job *job)
+{
+    uint32 thread_idx = Win32ThreadContext.ThreadIndex;
+    bool32 result = Win32PopJob(queue->Deques + thread_idx, job);
+    for(uint32 offset = 1; !result && (offset < queue->DequeCount); ++offset)
+    {
+        uint32 victim_idx = (thread_idx + offset) % queue->DequeCount;
+        result = Win32StealJob(queue->Deques + victim_idx, job);
+    }
+    return result;
+}
+
+inline bool32 Win32QueueHasWork(platform_work_queue *queue)
+{
+    bool32 result = (queue->ReadyFiberCount > 0);
+    for(uint32 deque_idx = 0; !result && (deque_idx < queue->DequeCount); ++deque_idx)
+    {
+        win32_job_deque *deque = queue->Deques + deque_idx;
+        result = (deque->Top < deque->Bottom);
+    }
+    return result;
+}
+
+inline void Win32WakeWorker(platform_work_queue *queue)
+{
+    // NOTE: the new work has to land before we look for sleepers, a worker going to sleep
+    // bumps the count first and then looks for work again, so one of us sees the other
+    MemoryBarrier();
+    if(queue->SleepingWorkerCount > 0)
+    {
+        ReleaseSemaphore(queue->WakeSemaphore, 1, 0);
+    }
+}
+
+inline void Win32LockFibers(platform_work_queue *queue)
+{
+    while(InterlockedCompareExchange((LONG volatile *)&queue->FiberLock, 1, 0) != 0)
+    {
+        YieldProcessor();
+    }
+}
+
+inline void Win32UnlockFibers(platform_work_queue *queue)
+{
+    InterlockedExchange((LONG volatile *)&queue->FiberLock, 0);
+}
+
+// the fiber lock must be held
+inline void Win32PushReadyFiber(platform_work_queue *queue, win32_job_fiber *fiber)
+{
+    fiber->Next = 0;
+    if(queue->LastReadyFiber)
+    {
+        queue->LastReadyFiber->Next = fiber;
+    }
+    else
+    {
+        queue->FirstReadyFiber = fiber;
+    }
+    queue->LastReadyFiber = fiber;
+    InterlockedIncrement((LONG volatile *)&queue->ReadyFiberCount);
+}
+
+internal win32_job_fiber *Win32PopReadyFiber(platform_work_queue *queue)
+{
+    win32_job_fiber *result = 0;
+    if(queue->ReadyFiberCount > 0)
+    {
+        Win32LockFibers(queue);
+        result = queue->FirstReadyFiber;
+        if(result)
+        {
+            queue->FirstReadyFiber = result->Next;
+            if(!queue->FirstReadyFiber)
+            {
+                queue->LastReadyFiber = 0;
+            }
+            InterlockedDecrement((LONG volatile *)&queue->ReadyFiberCount);
+        }
+        Win32UnlockFibers(queue);
+    }
+    return result;
+}
+
+inline win32_job_fiber *Win32AllocateJobFiber(platform_work_queue *queue)
+{
+    win32_job_fiber *result = Win32ThreadContext.SpareFiber;
+    if(result)
+    {
+        Win32ThreadContext.SpareFiber = 0;
+    }
+    else
+    {
+        Win32LockFibers(queue);
+        result = queue->FirstFreeFiber;
+        if(result)
+        {
+            queue->FirstFreeFiber = result->Next;
+        }
+        Win32UnlockFibers(queue);
+    }
+    return result;
+}
+
+inline void Win32FreeJobFiber(platform_work_queue *queue, win32_job_fiber *fiber)
+{
+    if(!Win32ThreadContext.SpareFiber)
+    {
+        Win32ThreadContext.SpareFiber = fiber;
+    }
+    else
+    {
+        Win32LockFibers(queue);
+        fiber->Next = queue->FirstFreeFiber;
+        queue->FirstFreeFiber = fiber;
+        Win32UnlockFibers(queue);
+    }
+}
+
+// called from the scheduler once the fiber is off its stack, so nobody can resume it too early
+internal void Win32ParkJobFiber(platform_work_queue *queue, win32_job_fiber *fiber, platform_job_counter *counter)
+{
+    Win32LockFibers(queue);
+
+    bool32 parked = false;
+    for(;;)
+    {
+        int32 value = counter->Value;
+        if(!(value & WIN32_COUNTER_COUNT_MASK))
+        {
+            break;
+        }
+        if(InterlockedCompareExchange((LONG volatile *)&counter->Value, value | WIN32_COUNTER_HAS_WAITERS, value) == value)
+        {
+            // NOTE: the job that takes the count to zero needs the lock to read the wait list, so it waits for us
+            fiber->Next = (win32_job_fiber *)counter->Waiters;
+            counter->Waiters = fiber;
+            parked = true;
+            break;
+        }
+    }
+
+    if(!parked)
+    {
+        // NOTE: the counter hit zero while the fiber was switching out
+        Win32PushReadyFiber(queue, fiber);
+    }
+
+    Win32UnlockFibers(queue);
+
+    if(!parked)
+    {
+        Win32WakeWorker(queue);
+    }
+}
+
+inline void Win32RunJob(platform_work_queue *queue, win32_job *job)
+{
+    job->Callback(queue, job->Data);
+
+    platform_job_counter *counter = job->Counter;
+    if(counter)
+    {
+        // NOTE: unless fibers are parked on it this is the last time the counter is touched, a waiter
+        // outside of a job may return and take the counter's memory with it as soon as it reads zero
+        int32 value = InterlockedDecrement((LONG volatile *)&counter->Value);
+        if(value == (int32)WIN32_COUNTER_HAS_WAITERS)
+        {
+            Win32LockFibers(queue);
+            win32_job_fiber *waiter = (win32_job_fiber *)counter->Waiters;
+            counter->Waiters = 0;
+            InterlockedAnd((LONG volatile *)&counter->Value, WIN32_COUNTER_COUNT_MASK);
+            while(waiter)
+            {
+                win32_job_fiber *next = waiter->Next;
+                Win32PushReadyFiber(queue, waiter);
+                waiter = next;
+            }
+            Win32UnlockFibers(queue);
+
+            Win32WakeWorker(queue);
+        }
+    }
+
+    InterlockedDecrement((LONG volatile *)&queue->OutstandingJobCount);
+}
 
-            Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->OutputLocation, play_color);
-            Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->OutputLocation + this_marker->OutputByteCount, write_color);
-            
-            top += line_height + pad_y;
-            bottom += line_height + pad_y; 
+VOID CALLBACK Win32JobFiberProc(LPVOID parameter)
+{
+    win32_job_fiber *fiber = (win32_job_fiber *)parameter;
+    for(;;)
+    {
+        Win32RunJob(fiber->Queue, &fiber->Job);
 
-            Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, first_top, bottom, this_marker->ExpectedFlipPlayCursor, expected_flip_color);
-        }
- 
-        Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->FlipPlayCursor, play_color);
-        Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->FlipPlayCursor + 480 * sound_output->BytesPerSample, play_window_color);
-        Win32DrawSoundBufferMarker(back_buffer, sound_output, cof, pad_x, top, bottom, this_marker->FlipWriteCursor, write_color);        
-    } 
+        // NOTE: the job may have been resumed on another thread, so this is whichever thread we're on now
+        Win32ThreadContext.SwitchReason = Win32FiberSwitch_Finished;
+        SwitchToFiber(Win32ThreadContext.SchedulerFiber);
+    }
 }
 
-//
-// File IO
-//
+// run the fiber until it finishes or waits, then deal with it from the scheduler's side
+internal void Win32SwitchToJobFiber(platform_work_queue *queue, win32_job_fiber *fiber)
+{
+    Win32ThreadContext.CurrentFiber = fiber;
+    SwitchToFiber(fiber->Handle);
+    Win32ThreadContext.CurrentFiber = 0;
 
-// DEBUG: read the contents of a file 
-debug_read_file_result DEBUGPlatformReadEntireFile(char *filename)
+    if(Win32ThreadContext.SwitchReason == Win32FiberSwitch_Finished)
+    {
+        Win32FreeJobFiber(queue, fiber);
+    }
+    else
+    {
+        Win32ParkJobFiber(queue, fiber, Win32ThreadContext.WaitCounter);
+    }
+}
+
+// resume a fiber whose wait is over, otherwise start a new job, returns false if there was nothing to do
+internal bool32 Win32DoNextWork(platform_work_queue *queue)
 {
-    debug_read_file_result result = {};
-    
-    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
-    if(file_handle != INVALID_HANDLE_VALUE)
+    bool32 result = true;
+
+    win32_job_fiber *fiber = Win32PopReadyFiber(queue);
+    if(fiber)
     {
-        LARGE_INTEGER file_size;
-        if(GetFileSizeEx(file_handle, &file_size))
+        Win32SwitchToJobFiber(queue, fiber);
+    }
+    else
+    {
+        win32_job job;
+        if(Win32FindJob(queue, &job))
         {
-            uint32 file_size32 = SafeTruncateUInt64(file_size.QuadPart);
-            result.Contents = VirtualAlloc(0, file_size32, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
-            if(result.Contents)
+            fiber = Win32AllocateJobFiber(queue);
+            if(fiber)
             {
-                DWORD bytes_read;
-                if(ReadFile(file_handle, result.Contents, file_size32, &bytes_read, 0) &&
-                   (file_size32 == bytes_read))
-                {
-                    // File read successfully
-                    result.ContentsSize = file_size32;
-                }
-                else
-                {                    
-                    // TODO: Logging
-                    DEBUGPlatformFreeFileMemory(result.Contents);
-                    result.Contents = 0;
-                }
+                fiber->Job = job;
+                Win32SwitchToJobFiber(queue, fiber);
             }
             else
             {
-                // TODO: Logging
+                // NOTE: every fiber is busy or parked, run it on this stack, its waits will block this thread
+                Win32RunJob(queue, &job);
             }
         }
         else
         {
-            // TODO: Logging
+            result = false;
         }
+    }
 
-        CloseHandle(file_handle);
+    return result;
+}
+
+internal PLATFORM_ADD_ENTRY(Win32AddEntry)
+{
+    win32_job job = {};
+    job.Callback = callback;
+    job.Data = data;
+    job.Counter = counter;
+
+    if(counter)
+    {
+        InterlockedIncrement((LONG volatile *)&counter->Value);
+    }
+    InterlockedIncrement((LONG volatile *)&queue->OutstandingJobCount);
+
+    if(Win32PushJob(queue->Deques + Win32ThreadContext.ThreadIndex, &job))
+    {
+        Win32WakeWorker(queue);
     }
     else
     {
-        // TODO: Logging
+        // NOTE: our deque is full, nobody else can take more of our work right now anyway
+        Win32RunJob(queue, &job);
     }
+}
 
-    return(result);
+internal PLATFORM_WAIT_FOR_COUNTER(Win32WaitForCounter)
+{
+    if(Win32ThreadContext.CurrentFiber)
+    {
+        // NOTE: inside a job, park the fiber and let the scheduler get on with something else
+        if(counter->Value & WIN32_COUNTER_COUNT_MASK)
+        {
+            Win32ThreadContext.SwitchReason = Win32FiberSwitch_Wait;
+            Win32ThreadContext.WaitCounter = counter;
+            SwitchToFiber(Win32ThreadContext.SchedulerFiber);
+        }
+    }
+    else
+    {
+        // NOTE: the whole value, not just the count, so we don't return while a job is still waking fibers
+        while(counter->Value != 0)
+        {
+            if(!Win32DoNextWork(queue))
+            {
+                // NOTE: whatever is left is running on other threads
+                YieldProcessor();
+            }
+        }
+    }
 }
 
-// DEBUG: free file memory
-void DEBUGPlatformFreeFileMemory(void *memory)
+internal PLATFORM_COMPLETE_ALL_WORK(Win32CompleteAllWork)
 {
-    if(memory)
+    Assert(!Win32ThreadContext.CurrentFiber);
+    while(queue->OutstandingJobCount != 0)
     {
-        VirtualFree(memory, 0, MEM_RELEASE);
+        if(!Win32DoNextWork(queue))
+        {
+            YieldProcessor();
+        }
     }
 }
 
-// DEBUG: write bytes into a file
-bool32 DEBUGPlatformWriteEntireFile(char *filename, uint32 memory_size, void *memory)
+DWORD WINAPI Win32WorkerThreadProc(LPVOID parameter)
 {
-    bool32 result = false;
-    
-    HANDLE file_handle = CreateFileA(filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
-    if(file_handle != INVALID_HANDLE_VALUE)
+    win32_worker_thread_info *info = (win32_worker_thread_info *)parameter;
+    platform_work_queue *queue = info->Queue;
+    Win32ThreadContext.ThreadIndex = info->ThreadIndex;
+    Win32ThreadContext.SchedulerFiber = ConvertThreadToFiberEx(0, FIBER_FLAG_FLOAT_SWITCH);
+
+    int idle_spin_count = 0;
+    for(;;)
     {
-        DWORD bytes_written;
-        if(WriteFile(file_handle, memory, memory_size, &bytes_written, 0))
+        if(Win32DoNextWork(queue))
         {
-            // File read successfully
-            result = (bytes_written == memory_size);
+            idle_spin_count = 0;
+        }
+        else if(idle_spin_count < 64)
+        {
+            // NOTE: spin a little first, jobs tend to come in bursts
+            YieldProcessor();
+            ++idle_spin_count;
         }
         else
         {
-            // TODO: Logging
+            InterlockedIncrement((LONG volatile *)&queue->SleepingWorkerCount);
+            if(!Win32QueueHasWork(queue))
+            {
+                WaitForSingleObjectEx(queue->WakeSemaphore, INFINITE, FALSE);
+            }
+            InterlockedDecrement((LONG volatile *)&queue->SleepingWorkerCount);
+            idle_spin_count = 0;
         }
+    }
+}
 
-        CloseHandle(file_handle);
+// one worker per extra logical processor, the main thread owns deque 0 and runs jobs while it waits
+internal bool32 Win32MakeWorkQueue(platform_work_queue *queue, win32_worker_thread_info *infos, uint32 worker_count)
+{
+    queue->DequeCount = worker_count + 1;
+    queue->Deques = (win32_job_deque *)VirtualAlloc(0, queue->DequeCount*sizeof(win32_job_deque),
+                                                    MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    queue->Fibers = (win32_job_fiber *)VirtualAlloc(0, WIN32_JOB_FIBER_COUNT*sizeof(win32_job_fiber),
+                                                    MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    if(!queue->Deques || !queue->Fibers)
+    {
+        return false;
     }
-    else
+
+    queue->OutstandingJobCount = 0;
+    queue->SleepingWorkerCount = 0;
+    queue->WakeSemaphore = CreateSemaphoreEx(0, 0, worker_count ? worker_count : 1, 0, 0, SEMAPHORE_ALL_ACCESS);
+
+    queue->FiberLock = 0;
+    queue->FirstFreeFiber = 0;
+    queue->FirstReadyFiber = 0;
+    queue->LastReadyFiber = 0;
+    queue->ReadyFiberCount = 0;
+    for(uint32 fiber_idx = 0; fiber_idx < WIN32_JOB_FIBER_COUNT; ++fiber_idx)
     {
-        // TODO: Logging
+        win32_job_fiber *fiber = queue->Fibers + fiber_idx;
+        fiber->Queue = queue;
+        fiber->Handle = CreateFiberEx(WIN32_JOB_FIBER_STACK_COMMIT_SIZE, WIN32_JOB_FIBER_STACK_RESERVE_SIZE,
+                                      FIBER_FLAG_FLOAT_SWITCH, Win32JobFiberProc, fiber);
+        if(fiber->Handle)
+        {
+            fiber->Next = queue->FirstFreeFiber;
+            queue->FirstFreeFiber = fiber;
+        }
     }
 
-    return(result);
+    Win32ThreadContext.ThreadIndex = 0;
+    Win32ThreadContext.SchedulerFiber = ConvertThreadToFiberEx(0, FIBER_FLAG_FLOAT_SWITCH);
+    for(uint32 worker_idx = 0; worker_idx < worker_count; ++worker_idx)
+    {
+        win32_worker_thread_info *info = infos + worker_idx;
+        info->Queue = queue;
+        info->ThreadIndex = worker_idx + 1;
+
+        HANDLE thread_handle = CreateThread(0, 0, Win32WorkerThreadProc, info, 0, 0);
+        CloseHandle(thread_handle);
+    }
+
+    return true;
 }
 
 //
@@ -494,6 +1916,11 @@ bool32 DEBUGPlatformWriteEntireFile(char *filename, uint32 memory_size, void *me
 global_variable bool32 Running;
 global_variable bool32 GlobalPause;
 global_variable win32_offscreen_buffer GlobalBackBuffer;
+global_variable frame_telemetry GlobalTelemetry;
+global_variable bool32 GlobalTelemetryDumpRequested;
+global_variable bool32 GlobalSnapshotRestoreRequested;
+global_variable bool32 GlobalShowDebugOverlay = true;
+global_variable resampler_quality GlobalResamplerQuality = ResamplerQuality_Medium;
 
 // get the dimensions of the provided window handle
 internal win32_window_dimension Win32GetWindowDimension(HWND window)
@@ -600,8 +2027,16 @@ LRESULT CALLBACK Win32MainWindowCallback(HWND window, UINT message, WPARAM wPara
 }
 
 // process a message and handle with default dispatch if nessesary
-internal void Win32ProcessPendingMessages(application_controller_input *kbd_controller)
+internal void Win32ProcessPendingMessages(application_input *input)
 {
+    application_controller_input *kbd_controller = GetController(input, 0);
+
+    // NOTE: messages carry the millisecond clock they were posted at, so pin that
+    // clock to the high resolution one once and date every message back from now
+    LARGE_INTEGER now_counter;
+    QueryPerformanceCounter(&now_counter);
+    DWORD now_ms = GetTickCount();
+
     MSG message;
     while(PeekMessageA(&message, 0, 0, 0, PM_REMOVE)) 
     {
@@ -621,67 +2056,95 @@ internal void Win32ProcessPendingMessages(application_controller_input *kbd_cont
                 bool was_down = (message.lParam & (1 << 30)) != 0;
                 bool is_down =  (message.lParam & (1 << 31)) == 0;
 
+                int32 message_age_ms = (int32)(now_ms - message.time);
+                if(message_age_ms < 0)
+                {
+                    message_age_ms = 0;
+                }
+                uint64 timestamp = (uint64)now_counter.QuadPart -
+                    ((uint64)message_age_ms*input->TimestampFrequency) / 1000;
+
                 // eat key repeats
                 if(was_down != is_down)
                 {
                     if(vkcode == 'W') 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->MoveUp, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->MoveUp, is_down, timestamp);
                     }
                     else if(vkcode == 'A') 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->MoveLeft, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->MoveLeft, is_down, timestamp);
                     }
                     else if(vkcode == 'S') 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->MoveDown, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->MoveDown, is_down, timestamp);
                     }
                     else if(vkcode == 'D') 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->MoveRight, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->MoveRight, is_down, timestamp);
                     }
                     else if(vkcode == 'Q') 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->LeftShoulder, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->LeftShoulder, is_down, timestamp);
                     }
                     else if(vkcode == 'E') 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->RightShoulder, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->RightShoulder, is_down, timestamp);
                     }
                     else if(vkcode == VK_UP) 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->ActionUp, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->ActionUp, is_down, timestamp);
                     }
                     else if(vkcode == VK_DOWN) 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->ActionDown, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->ActionDown, is_down, timestamp);
                     }
                     else if(vkcode == VK_RIGHT) 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->ActionRight, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->ActionRight, is_down, timestamp);
                     }
                     else if(vkcode == VK_LEFT) 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->ActionLeft, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->ActionLeft, is_down, timestamp);
                     }
                     else if(vkcode == VK_SPACE) 
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->Start, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->Start, is_down, timestamp);
                     }
                     else if(vkcode == VK_BACK)
                     {
-                        Win32ProcessKeyboardMessage(&kbd_controller->Back, is_down);
+                        Win32ProcessKeyboardMessage(input, &kbd_controller->Back, is_down, timestamp);
                     }
                     else if(vkcode == VK_ESCAPE) 
                     {
                         Running = false;
                     }
+                    else if(vkcode == VK_F9)
+                    {
+                        if(is_down)
+                            GlobalTelemetryDumpRequested = true;
+                    }
 #if APPLICATION_INTERNAL
                     else if(vkcode == 'P')
                     {
                         if(is_down)
                             GlobalPause = !GlobalPause;
                     }
+                    else if(vkcode == VK_F3)
+                    {
+                        if(is_down)
+                            GlobalShowDebugOverlay = !GlobalShowDebugOverlay;
+                    }
+                    else if(vkcode == VK_F5)
+                    {
+                        if(is_down)
+                            GlobalResamplerQuality = (resampler_quality)((GlobalResamplerQuality + 1) % ResamplerQuality_Count);
+                    }
+                    else if(vkcode == VK_F6)
+                    {
+                        if(is_down)
+                            GlobalSnapshotRestoreRequested = true;
+                    }
 #endif                    
                 }
 
@@ -718,6 +2181,117 @@ inline real32 Win32GetSecondsElapsed(LARGE_INTEGER start, LARGE_INTEGER end)
     return seconds_elapsed_for_work;
 }
 
+//
+// Telemetry
+//
+
+// NOTE: where the time stamp counter and the wall clock were when the session started
+global_variable LARGE_INTEGER GlobalSessionStartCounter;
+global_variable uint64 GlobalSessionStartCycles;
+
+// write the session's frame telemetry out as text and json next to the executable
+internal void Win32WriteTelemetry(frame_telemetry *telemetry, SYSTEMTIME *session_start)
+{
+    // NOTE: the time stamp counter against the wall clock so far, to turn cycles into time
+    real32 session_seconds = Win32GetSecondsElapsed(GlobalSessionStartCounter, Win32GetWallClock());
+    if(session_seconds > 0.0f)
+    {
+        telemetry->CyclesPerSecond = (real64)(__rdtsc() - GlobalSessionStartCycles) / (real64)session_seconds;
+    }
+
+    local_persist char text_buffer[Kilobytes(16)];
+    char filename[MAX_PATH];
+
+    int text_size = TelemetryFormatText(telemetry, text_buffer, sizeof(text_buffer));
+    OutputDebugStringA(text_buffer);
+    _snprintf_s(filename, sizeof(filename), "telemetry_%04d%02d%02d_%02d%02d%02d.txt",
+                session_start->wYear, session_start->wMonth, session_start->wDay,
+                session_start->wHour, session_start->wMinute, session_start->wSecond);
+    DEBUGPlatformWriteEntireFile(filename, text_size, text_buffer);
+
+    int json_size = TelemetryFormatJson(telemetry, text_buffer, sizeof(text_buffer));
+    _snprintf_s(filename, sizeof(filename), "telemetry_%04d%02d%02d_%02d%02d%02d.json",
+                session_start->wYear, session_start->wMonth, session_start->wDay,
+                session_start->wHour, session_start->wMinute, session_start->wSecond);
+    DEBUGPlatformWriteEntireFile(filename, json_size, text_buffer);
+}
+
+//
+// Debug overlay
+//
+
+struct win32_debug_overlay_counters
+{
+    real64 MsPerFrame;
+    real64 MegaCyclesPerFrame;
+    real32 AudioLatencySeconds;
+    real32 AudioGranularityMs;
+    real32 AudioJitterMs;
+    real32 AudioSafetyMs;
+    real32 OverlaySeconds;
+    resampler_quality ResamplerQuality;
+};
+
+// draw live performance counters into the bottom left of the back buffer
+internal void Win32DrawDebugOverlay(
+    offscreen_graphics_buffer *buffer, debug_glyph_atlas *atlas,
+    win32_debug_overlay_counters *counters, frame_telemetry *telemetry,
+    application_memory *memory)
+{
+    char arena_text[256] = {};
+    int arena_at = 0;
+    uint32 arena_count = TelemetryArenaCount(telemetry);
+    for(uint32 arena_idx = 0; arena_idx < arena_count; ++arena_idx)
+    {
+        debug_arena_info *arena = telemetry->Arenas + arena_idx;
+        arena_at = TelemetryAppend(arena_text, sizeof(arena_text), arena_at, "%s%s %.01f/%.01fMB",
+                                   arena_idx ? "  " : "", arena->Name,
+                                   (real64)arena->PeakUsed / Megabytes(1), (real64)arena->Size / Megabytes(1));
+    }
+
+    char text[1024];
+    _snprintf_s(text, sizeof(text), _TRUNCATE,
+                "%.02f ms/f  %.02f Mc/f  p99 %.02f ms\n"
+                "audio latency %.01f ms  underruns %llu  missed %llu\n"
+                "audio granularity %.01f ms  jitter %.01f ms  safety %.01f ms\n"
+                "resample %s %.01f c/sample\n"
+                "permanent %lluMB  transient %lluMB\n"
+                "peak %s\n"
+                "overlay %.03f ms",
+                counters->MsPerFrame, counters->MegaCyclesPerFrame,
+                HdrValueAtPercentile(&telemetry->Timings[TelemetryTiming_Frame], 99.0) / 1000.0,
+                1000.0f * counters->AudioLatencySeconds,
+                telemetry->AudioUnderrunCount, telemetry->MissedFrameCount,
+                counters->AudioGranularityMs, counters->AudioJitterMs, counters->AudioSafetyMs,
+                ResamplerQualityNames[counters->ResamplerQuality], TelemetryResampleCyclesPerFrame(telemetry),
+                memory->PermanentStorageSize / Megabytes(1), memory->TransientStorageSize / Megabytes(1),
+                arena_text, 1000.0f * counters->OverlaySeconds);
+
+    int line_count = 1;
+    int longest_line = 0;
+    int line_length = 0;
+    for(char *c = text; *c; ++c)
+    {
+        if(*c == '\n')
+        {
+            ++line_count;
+            line_length = 0;
+        }
+        else if(++line_length > longest_line)
+        {
+            longest_line = line_length;
+        }
+    }
+
+    int pad = 8;
+    int min_x = pad;
+    int min_y = buffer->Height - pad - line_count*atlas->LineHeight;
+    DarkenDebugRectangle(buffer, min_x - pad/2, min_y - pad/2,
+                         min_x + longest_line*atlas->AdvanceX + pad/2, buffer->Height - pad/2);
+    DrawDebugText(buffer, atlas, min_x + atlas->Scale, min_y + atlas->Scale, text, 0xFF000000);
+    DrawDebugText(buffer, atlas, min_x, min_y, text, 0xFFFFFFFF);
+}
+
 //
 // ENTRY POINT
 //
@@ -753,6 +2327,12 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
 #define application_update_hz  (monitor_refresh_hz / 2)
     real32 target_seconds_per_frame = 1.0f / (real32)application_update_hz;
 
+    SYSTEMTIME session_start;
+    GetLocalTime(&session_start);
+    GlobalSessionStartCounter = Win32GetWallClock();
+    GlobalSessionStartCycles = __rdtsc();
+    GlobalTelemetry.TargetSecondsPerFrame = target_seconds_per_frame;
+
     // register the window
     if(RegisterClassA(&window_class)) {
         HWND window = CreateWindowExA(
@@ -781,14 +2361,20 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
             win32_sound_output sound_output = {};
 
             sound_output.SamplesPerSecond = 48000;
+            // NOTE: most sound assets are recorded at 44.1k, mixing at that rate means only the device path resamples
+            sound_output.AppSamplesPerSecond = 44100;
             sound_output.ToneHz = 256;
             sound_output.ToneVolume = 3000;
             sound_output.WavePeriod = sound_output.SamplesPerSecond/sound_output.ToneHz;
             sound_output.BytesPerSample = sizeof(int16)*2;
             sound_output.SecondaryBufferSize = sound_output.SamplesPerSecond*sound_output.BytesPerSample;
             sound_output.LatencySampleCount = 3 * (sound_output.SamplesPerSecond / application_update_hz);
-            sound_output.SafetyBytes = 
-                ((sound_output.SamplesPerSecond * sound_output.BytesPerSample) / application_update_hz) / 2;
+
+            // NOTE: learns how far ahead of this device's play cursor it is safe to write
+            audio_clock audio_clock = {};
+            InitializeAudioClock(&audio_clock, sound_output.SamplesPerSecond,
+                                 sound_output.SecondaryBufferSize / sound_output.BytesPerSample,
+                                 target_seconds_per_frame);
 
             Win32InitDSound(window, sound_output.SamplesPerSecond, sound_output.SecondaryBufferSize);
             Win32ClearBuffer(&sound_output);
@@ -796,6 +2382,20 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
             int16 *samples = (int16 *)VirtualAlloc(0, sound_output.SecondaryBufferSize,
                                                    MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
 
+            // NOTE: one call never asks for more than a second of device frames, a second
+            // at the app's rate plus the filter's reach covers what that can need
+            int max_app_frame_count = sound_output.AppSamplesPerSecond + RESAMPLER_MAX_TAP_COUNT;
+            int16 *app_samples = (int16 *)VirtualAlloc(0, max_app_frame_count*sound_output.BytesPerSample,
+                                                       MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+            void *resampler_memory = VirtualAlloc(0, (size_t)ResamplerMemorySize(ResamplerQuality_High, max_app_frame_count),
+                                                  MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+            resampler sound_resampler = {};
+            if(resampler_memory)
+            {
+                InitializeResampler(&sound_resampler, resampler_memory, sound_output.AppSamplesPerSecond,
+                                    sound_output.SamplesPerSecond, GlobalResamplerQuality, max_app_frame_count);
+            }
+
 #if APPLICATION_INTERNAL
             LPVOID base_address = (LPVOID)Terabytes(2);
 #else
@@ -808,12 +2408,68 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
 
             // TODO: Handle various memory footprints (USING SYSTEM METRICS)
             uint64 total_size = app_memory.PermanentStorageSize + app_memory.TransientStorageSize;
+            // NOTE: write watched so snapshots only have to save the pages that changed
             app_memory.PermanentStorage = VirtualAlloc(base_address, (size_t)total_size,
-                                                       MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+                                                       MEM_RESERVE|MEM_COMMIT|MEM_WRITE_WATCH, PAGE_READWRITE);
             app_memory.TransientStorage = ((uint8 *)app_memory.PermanentStorage +
                                            app_memory.PermanentStorageSize);
 
-            if(samples && app_memory.PermanentStorage && app_memory.TransientStorage)
+            win32_snapshotter snapshotter = {};
+            bool32 snapshotter_is_valid = (app_memory.PermanentStorage &&
+                                           Win32InitSnapshotter(&snapshotter, app_memory.PermanentStorage, total_size));
+
+            SYSTEM_INFO system_info;
+            GetSystemInfo(&system_info);
+            uint32 worker_thread_count = system_info.dwNumberOfProcessors - 1;
+            if(worker_thread_count > WIN32_MAX_WORKER_THREAD_COUNT)
+            {
+                worker_thread_count = WIN32_MAX_WORKER_THREAD_COUNT;
+            }
+
+            platform_work_queue work_queue = {};
+            win32_worker_thread_info worker_infos[WIN32_MAX_WORKER_THREAD_COUNT];
+            bool32 work_queue_is_valid = Win32MakeWorkQueue(&work_queue, worker_infos, worker_thread_count);
+
+            // NOTE: every file request goes through here so the main thread never waits on the disk
+            GlobalFileQueue.WakeSemaphore = CreateSemaphoreEx(0, 0, WIN32_FILE_REQUEST_RING_SIZE, 0, 0,
+                                                              SEMAPHORE_ALL_ACCESS);
+            HANDLE file_thread = CreateThread(0, 0, Win32FileThreadProc, &GlobalFileQueue, 0, 0);
+            CloseHandle(file_thread);
+
+            win32_pad_poller pad_poller = {};
+            HANDLE pad_poll_thread = CreateThread(0, 0, Win32PadPollThreadProc, &pad_poller, 0, 0);
+            CloseHandle(pad_poll_thread);
+
+            app_memory.WorkQueue = &work_queue;
+            app_memory.WorkerThreadCount = worker_thread_count;
+            app_memory.AutosaveFilename = "autosave.state";
+            app_memory.PlatformAPI.AddEntry = Win32AddEntry;
+            app_memory.PlatformAPI.WaitForCounter = Win32WaitForCounter;
+            app_memory.PlatformAPI.CompleteAllWork = Win32CompleteAllWork;
+            app_memory.PlatformAPI.OpenFile = Win32OpenFile;
+            app_memory.PlatformAPI.ReadDataFromFile = Win32ReadDataFromFile;
+            app_memory.PlatformAPI.CloseFile = Win32CloseFile;
+            app_memory.PlatformAPI.SaveFile = Win32SaveFile;
+#if APPLICATION_INTERNAL
+            app_memory.PlatformAPI.DEBUGReadEntireFile = DEBUGPlatformReadEntireFile;
+            app_memory.PlatformAPI.DEBUGFreeFileMemory = DEBUGPlatformFreeFileMemory;
+            app_memory.PlatformAPI.DEBUGWriteEntireFile = DEBUGPlatformWriteEntireFile;
+#endif
+
+#if APPLICATION_INTERNAL
+            debug_glyph_atlas debug_atlas = {};
+            int debug_atlas_scale = 2;
+            void *debug_atlas_memory = VirtualAlloc(0, (size_t)DebugGlyphAtlasSize(debug_atlas_scale),
+                                                    MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+            if(debug_atlas_memory)
+            {
+                BakeDebugGlyphAtlas(&debug_atlas, debug_atlas_memory, debug_atlas_scale);
+            }
+            win32_debug_overlay_counters overlay_counters = {};
+#endif
+
+            if(samples && app_samples && resampler_memory &&
+               app_memory.PermanentStorage && app_memory.TransientStorage && work_queue_is_valid)
             {
                 application_input input[2] = {};
                 application_input *new_input = &input[0];
@@ -828,10 +2484,12 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                 LARGE_INTEGER last_counter = Win32GetWallClock();
                 LARGE_INTEGER flip_wall_clock = Win32GetWallClock();
                 uint64 last_cycle_count = __rdtsc();
+                old_input->EndTimestamp = (uint64)last_counter.QuadPart;
 
                 // sound vars
                 DWORD last_play_cursor = 0;
                 DWORD last_write_cursor = 0;
+                uint64 audio_played_bytes = 0;
                 bool32 is_sound_valid = false;
                 DWORD audio_latency_bytes = 0;
                 real32 audio_latency_seconds = 0;
@@ -852,112 +2510,36 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                             old_kbd_controller->Buttons[button_idx].EndedDown;
                     }
 
-                    Win32ProcessPendingMessages(new_kbd_controller);
+                    new_input->TimestampFrequency = (uint64)PerfCountFrequency;
+                    new_input->StartTimestamp = old_input->EndTimestamp;
+                    new_input->EventCount = 0;
+                    new_input->DroppedEventCount = 0;
+
+                    Win32ProcessPendingMessages(new_input);
 
                     // pause the game if pause button is pressed
                     if(GlobalPause)
                         continue;
 
                     // application input
-                    DWORD max_controller_count = XUSER_MAX_COUNT; // adjusted for keyboard at 0 idx
-                    if(max_controller_count > (ArrayCount(new_input->Controllers)) - 1)
-                    {
-                        max_controller_count = (ArrayCount(new_input->Controllers)) - 1;
-                    }
-                    
-                    for (DWORD controller_idx = 0;
-                        controller_idx < max_controller_count;
-                        ++controller_idx)
-                    {
-                        DWORD our_controller_idx = controller_idx + 1; // skip 0 idx for keyboard
-                        application_controller_input *old_controller = GetController(old_input, our_controller_idx);
-                        application_controller_input *new_controller = GetController(new_input, our_controller_idx);
-                        
-                        XINPUT_STATE controller_state;
-                        if(XInputGetState(controller_idx, &controller_state) == ERROR_SUCCESS)
-                        {
-                            new_controller->IsConnected = true;
-
-                            // NOTE: This controller is plugged in
-                            // TODO: See if ControllerState.dwPacketNumber increments too rapidly
-                            XINPUT_GAMEPAD *pad = &controller_state.Gamepad;
-
-                            // thumb stick and deadzone
-                            new_controller->IsAnalog = true;
-                            new_controller->StickAverageX = Win32ProcessXInputStickPosition(
-                                pad->sThumbLX, XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE);
-                            new_controller->StickAverageY = Win32ProcessXInputStickPosition(
-                                pad->sThumbLY, XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE);
-                            
-                            // dpad
-                            if(pad->wButtons & XINPUT_GAMEPAD_DPAD_UP)
-                            {
-                                new_controller->StickAverageY = 1.0f;
-                            }
-                            if(pad->wButtons & XINPUT_GAMEPAD_DPAD_DOWN)
-                            {
-                                new_controller->StickAverageY = -1.0f;
-                            }
-                            if(pad->wButtons & XINPUT_GAMEPAD_DPAD_LEFT)
-                            {
-                                new_controller->StickAverageX = -1.0f;
-                            }
-                            if(pad->wButtons & XINPUT_GAMEPAD_DPAD_RIGHT)
-                            {
-                                new_controller->StickAverageX = 1.0f;
-                            }
+                    real32 input_age_seconds = Win32ProcessPads(&pad_poller, old_input, new_input);
+                    TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_InputAge, input_age_seconds);
 
-                            // sticks are turned into single full direction presses
-                            // the stick averageX/Y will still let you do granular movement
-                            // if desired
-                            real32 threshold = 0.5;
-                            Win32ProcessXInputDigitalButton(
-                                (new_controller->StickAverageX < -threshold) ? 1 : 0,
-                                &old_controller->MoveLeft, 1,
-                                &new_controller->MoveLeft);
-                            Win32ProcessXInputDigitalButton(
-                                (new_controller->StickAverageX > threshold) ? 1 : 0,
-                                &old_controller->MoveLeft, 1,
-                                &new_controller->MoveLeft);
-                            Win32ProcessXInputDigitalButton(
-                                (new_controller->StickAverageY < -threshold) ? 1 : 0,
-                                &old_controller->MoveLeft, 1,
-                                &new_controller->MoveLeft);
-                            Win32ProcessXInputDigitalButton(
-                                (new_controller->StickAverageY > threshold) ? 1 : 0,
-                                &old_controller->MoveLeft, 1,
-                                &new_controller->MoveLeft);
-
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->ActionDown, XINPUT_GAMEPAD_A,
-                                                            &new_controller->ActionDown);
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->ActionRight, XINPUT_GAMEPAD_B,
-                                                            &new_controller->ActionRight);
-                            Win32ProcessXInputDigitalButton(pad->wButtons ,
-                                                            &old_controller->ActionLeft, XINPUT_GAMEPAD_X,
-                                                            &new_controller->ActionLeft);
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->ActionUp, XINPUT_GAMEPAD_Y,
-                                                            &new_controller->ActionUp);
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->LeftShoulder, XINPUT_GAMEPAD_LEFT_SHOULDER,
-                                                            &new_controller->LeftShoulder);
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->RightShoulder, XINPUT_GAMEPAD_RIGHT_SHOULDER,
-                                                            &new_controller->RightShoulder);
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->Start, XINPUT_GAMEPAD_START,
-                                                            &new_controller->Start);
-                            Win32ProcessXInputDigitalButton(pad->wButtons,
-                                                            &old_controller->Back, XINPUT_GAMEPAD_BACK,
-                                                            &new_controller->Back);
-                        }
-                        else
+                    new_input->EndTimestamp = (uint64)Win32GetWallClock().QuadPart;
+
+                    if(GlobalSnapshotRestoreRequested)
+                    {
+                        // NOTE: the work queue is idle between frames, the file thread is the only other
+                        // thing that writes the app's state. The app stops what it has going so the
+                        // queue can be drained, then drops what the snapshot was in the middle of
+                        if(snapshotter_is_valid)
                         {
-                            // NOTE: The controller is not available
-                            new_controller->IsConnected = false;
+                            dynamic_app_code.BeginRestoreState(&app_memory);
+                            Win32FinishFileRequests(&GlobalFileQueue);
+                            Win32RestoreSnapshot(&snapshotter);
+                            dynamic_app_code.EndRestoreState(&app_memory);
                         }
+                        GlobalSnapshotRestoreRequested = false;
                     }
 
                     // render and update
@@ -966,10 +2548,14 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                     b.Width = GlobalBackBuffer.Width; 
                     b.Height = GlobalBackBuffer.Height;
                     b.Pitch = GlobalBackBuffer.Pitch; 
+                    b.Format = PixelFormat_BGRX8;
+                    new_input->SecondsToAdvanceOverUpdate = target_seconds_per_frame;
                     dynamic_app_code.UpdateAndRender(&app_memory, new_input, &b);
+                    GlobalTelemetry.ArenaCount = dynamic_app_code.DebugGetArenaInfo(&app_memory, GlobalTelemetry.Arenas,
+                                                                                    TELEMETRY_MAX_ARENA_COUNT);
 
                     LARGE_INTEGER audio_wall_clock = Win32GetWallClock();
-                    real64 frame_begin_to_audio_begin_sec = 1000.0f * Win32GetSecondsElapsed(flip_wall_clock, audio_wall_clock);
+                    real64 frame_begin_to_audio_begin_sec = Win32GetSecondsElapsed(flip_wall_clock, audio_wall_clock);
 
                     DWORD play_cursor;
                     DWORD write_cursor;
@@ -979,7 +2565,8 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                         /* NOTE: explanation of low latency sound output
                             
                             We define a safety value that is the number of samples we think our application
-                            update loop may vary by. (lets say up to 2ms)
+                            update loop may vary by. The audio clock learns it from the cursors it is shown,
+                            see application_audio_clock.h
                             
                             When we wake up to write audio, we will look and see what the play cursor position is
                             and we will forecast ahead where we think the play cursor will be on the next frame boundary.
@@ -990,45 +2577,53 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
 
                             If the write cursor is_after_ the next frame boundary, then we assume that we can never sync the audio
                             perfectly, so we will write one frame's worth of audio plus the safety margins work of guard samples
-                            (1ms, or something determined to be safe, whatever we think the variability of our frame compution is)
+                            (whatever the clock has measured the variability of our frame computation and the cursor to be)
                         */
+                        if(is_sound_valid)
+                        {
+                            // NOTE: everything up to the write cursor is already committed to the device, so the
+                            // write cursor overtaking everything we have written is an underrun, count it and resync to it
+                            audio_played_bytes += (play_cursor + sound_output.SecondaryBufferSize - last_play_cursor) %
+                                sound_output.SecondaryBufferSize;
+                            DWORD audio_write_lead_bytes = (write_cursor + sound_output.SecondaryBufferSize - play_cursor) %
+                                sound_output.SecondaryBufferSize;
+                            uint64 audio_written_bytes = (uint64)sound_output.RunningSampleIndex*sound_output.BytesPerSample;
+                            if((audio_played_bytes + audio_write_lead_bytes) > audio_written_bytes)
+                            {
+                                ++GlobalTelemetry.AudioUnderrunCount;
+                                AudioClockNoteUnderrun(&audio_clock);
+                                is_sound_valid = false;
+                            }
+                        }
+                        last_play_cursor = play_cursor;
+
                         if(!is_sound_valid)
                         {
-                            sound_output.RunningSampleIndex = write_cursor / sound_output.BytesPerSample;
+                            DWORD unwrapped_write_cursor = write_cursor;
+                            if(write_cursor < play_cursor)
+                            {
+                                unwrapped_write_cursor += sound_output.SecondaryBufferSize;
+                            }
+                            sound_output.RunningSampleIndex = unwrapped_write_cursor / sound_output.BytesPerSample;
+                            audio_played_bytes = play_cursor;
                             is_sound_valid = true;
                         }
 
                         DWORD byte_to_lock = byte_to_lock = ((sound_output.RunningSampleIndex*sound_output.BytesPerSample) %
                                                                 sound_output.SecondaryBufferSize);
                          
-                        // handle laggy video card
-                        DWORD expected_sound_bytes_per_frame = 
-                            (sound_output.SamplesPerSecond * sound_output.BytesPerSample)  / application_update_hz;
+                        DWORD play_frame = play_cursor / sound_output.BytesPerSample;
+                        DWORD write_frame = write_cursor / sound_output.BytesPerSample;
+                        real64 audio_seconds = (real64)audio_wall_clock.QuadPart / (real64)PerfCountFrequency;
+                        AudioClockAddSample(&audio_clock, audio_seconds, play_frame, write_frame);
 
+                        // NOTE: write up to one video frame past the flip when the device can keep up with that,
+                        // otherwise one video frame past its write cursor plus the safety margin it has earned
                         real32 seconds_left_until_flip = target_seconds_per_frame - (real32)frame_begin_to_audio_begin_sec;
-                        DWORD expected_bytes_until_flip = (DWORD)((seconds_left_until_flip / target_seconds_per_frame) * (real32)expected_sound_bytes_per_frame);
-
-                        DWORD expected_frame_boundary_byte = play_cursor + expected_sound_bytes_per_frame; 
-                        DWORD safe_write_cursor = write_cursor;
-                        if(safe_write_cursor < play_cursor)
-                        {
-                            safe_write_cursor += sound_output.SecondaryBufferSize;
-                        }
-                        Assert(safe_write_cursor >= play_cursor);
-                        safe_write_cursor += sound_output.SafetyBytes;
-                        real32 audio_card_is_low_latency = (safe_write_cursor < expected_frame_boundary_byte);
-
-                        // compute target write cursor
-                        DWORD target_cursor = 0;
-                        if(audio_card_is_low_latency)
-                        {
-                            target_cursor = (expected_frame_boundary_byte + expected_sound_bytes_per_frame);
-                        }
-                        else 
-                        {
-                            target_cursor = (write_cursor + expected_sound_bytes_per_frame + sound_output.SafetyBytes);
-                        }
-                        target_cursor = (target_cursor % sound_output.SecondaryBufferSize);
+                        audio_clock_target audio_target = AudioClockComputeTarget(&audio_clock, play_frame, write_frame,
+                                                                                  seconds_left_until_flip);
+                        DWORD target_cursor = audio_target.TargetCursor*sound_output.BytesPerSample;
+                        DWORD expected_frame_boundary_byte = audio_target.ExpectedFlipPlayCursor*sound_output.BytesPerSample;
 
                         // compute bytes to write 
                         DWORD bytes_to_write = 0;
@@ -1041,12 +2636,43 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                         {
                             bytes_to_write = target_cursor - byte_to_lock;
                         }
+
+                        // NOTE: when the safety margin shrinks we may already have written past the new target,
+                        // wait for the play cursor to catch up instead of wrapping round the whole buffer
+                        DWORD lock_lead = (byte_to_lock + sound_output.SecondaryBufferSize - play_cursor) % sound_output.SecondaryBufferSize;
+                        DWORD target_lead = (target_cursor + sound_output.SecondaryBufferSize - play_cursor) % sound_output.SecondaryBufferSize;
+                        if(lock_lead > target_lead)
+                        {
+                            bytes_to_write = 0;
+                        }
                         
+                        if(sound_resampler.Quality != GlobalResamplerQuality)
+                        {
+                            InitializeResampler(&sound_resampler, resampler_memory, sound_output.AppSamplesPerSecond,
+                                                sound_output.SamplesPerSecond, GlobalResamplerQuality,
+                                                max_app_frame_count);
+                        }
+
+                        // NOTE: the app renders however many of its frames make up the device frames we need
+                        int device_frame_count = bytes_to_write / sound_output.BytesPerSample;
+                        application_sound_output_buffer app_sound_buffer = {};
+                        app_sound_buffer.SamplesPerSecond = sound_output.AppSamplesPerSecond;
+                        app_sound_buffer.SampleCount = ResamplerInputFramesNeeded(&sound_resampler, device_frame_count);
+                        app_sound_buffer.Samples = app_samples;
+                        app_sound_buffer.LatencySeconds = audio_latency_seconds;
+                        dynamic_app_code.GetSoundSamples(&app_memory, &app_sound_buffer);
+                        TelemetryRecordEffects(&GlobalTelemetry, &app_sound_buffer);
+
                         application_sound_output_buffer sound_buffer = {};
                         sound_buffer.SamplesPerSecond = sound_output.SamplesPerSecond;
-                        sound_buffer.SampleCount = bytes_to_write / sound_output.BytesPerSample;
+                        sound_buffer.SampleCount = device_frame_count;
                         sound_buffer.Samples = samples;
-                        dynamic_app_code.GetSoundSamples(&app_memory, &sound_buffer);
+
+                        uint64 resample_start_cycles = __rdtsc();
+                        ResampleStereo(&sound_resampler, app_sound_buffer.Samples, app_sound_buffer.SampleCount,
+                                       sound_buffer.Samples, sound_buffer.SampleCount);
+                        GlobalTelemetry.ResampleCycleCount += __rdtsc() - resample_start_cycles;
+                        GlobalTelemetry.ResampledFrameCount += sound_buffer.SampleCount;
 
                         win32_debug_time_marker *marker = &debug_time_markers[debug_time_marker_idx];
                         marker->OutputPlayCursor = play_cursor;
@@ -1055,12 +2681,10 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                         marker->OutputLocation = byte_to_lock;
                         marker->ExpectedFlipPlayCursor = expected_frame_boundary_byte;
 
-#if APPLICATION_INTERNAL // NOTE: sound code debug 
-                        
                         DWORD unwrapped_write_cursor = write_cursor;
                         if(write_cursor < play_cursor)
                         {
-                            unwrapped_write_cursor = sound_output.SecondaryBufferSize;
+                            unwrapped_write_cursor += sound_output.SecondaryBufferSize;
                         }
                         audio_latency_bytes = unwrapped_write_cursor - play_cursor;
 
@@ -1068,7 +2692,9 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                         // computing bytes per seconds
                         audio_latency_seconds = (((real32)audio_latency_bytes / (real32)sound_output.BytesPerSample) 
                             / (real32)sound_output.SamplesPerSecond);
-                            
+                        TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_AudioLatency, audio_latency_seconds);
+
+#if APPLICATION_INTERNAL // NOTE: sound code debug 
                         char text_buffer[256];
                         _snprintf_s(text_buffer, sizeof(text_buffer),
                                     "BTL:%u TC:%u BTW:%u - PC:%u WC:%u DELTA:%u (%fs)\n",
@@ -1087,6 +2713,19 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                         is_sound_valid = false;
                     }
 
+                    // NOTE: costs a copy of whatever the app wrote to since the last one, the writer thread does the rest
+                    snapshotter.SecondsSinceSnapshot += target_seconds_per_frame;
+                    if(snapshotter_is_valid && (snapshotter.SecondsSinceSnapshot >= WIN32_SNAPSHOT_INTERVAL_SECONDS))
+                    {
+                        LARGE_INTEGER snapshot_counter = Win32GetWallClock();
+                        if(Win32TakeSnapshot(&snapshotter))
+                        {
+                            snapshotter.SecondsSinceSnapshot = 0.0f;
+                            TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Snapshot,
+                                                   Win32GetSecondsElapsed(snapshot_counter, Win32GetWallClock()));
+                        }
+                    }
+
                     // timer stuff
                     LARGE_INTEGER work_counter = Win32GetWallClock();
                     real32 work_seconds_elapsed = Win32GetSecondsElapsed(last_counter, work_counter);
@@ -1121,12 +2760,18 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                     }
                     else
                     {
-                        // TODO: missed frame rate!
-                        // TODO: logging
+                        ++GlobalTelemetry.MissedFrameCount;
                     }
 
                     LARGE_INTEGER end_counter = Win32GetWallClock();
                     real64 ms_per_frame = 1000.0f * Win32GetSecondsElapsed(last_counter, end_counter);
+
+                    ++GlobalTelemetry.FrameCount;
+                    TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Work, work_seconds_elapsed);
+                    TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Sleep,
+                                           Win32GetSecondsElapsed(work_counter, end_counter));
+                    TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Frame,
+                                           Win32GetSecondsElapsed(last_counter, end_counter));
                     last_counter = end_counter;
 
                     win32_window_dimension dim = Win32GetWindowDimension(window);
@@ -1135,12 +2780,34 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                     Win32DebugSyncSound(
                         &GlobalBackBuffer, ArrayCount(debug_time_markers), 
                         debug_time_markers, debug_time_marker_idx - 1, &sound_output, target_seconds_per_frame);
+
+                    if(GlobalShowDebugOverlay && debug_atlas_memory)
+                    {
+                        LARGE_INTEGER overlay_counter = Win32GetWallClock();
+                        overlay_counters.MsPerFrame = ms_per_frame;
+                        overlay_counters.AudioLatencySeconds = audio_latency_seconds;
+                        overlay_counters.AudioGranularityMs = 1000.0f*audio_clock.GranularityFrames / (real32)audio_clock.SamplesPerSecond;
+                        overlay_counters.AudioJitterMs = 1000.0f*audio_clock.JitterSeconds;
+                        overlay_counters.AudioSafetyMs = 1000.0f*(real32)AudioClockSafetyFrames(&audio_clock) / (real32)audio_clock.SamplesPerSecond;
+                        overlay_counters.ResamplerQuality = sound_resampler.Quality;
+                        Win32DrawDebugOverlay(&b, &debug_atlas, &overlay_counters, &GlobalTelemetry, &app_memory);
+                        overlay_counters.OverlaySeconds = Win32GetSecondsElapsed(overlay_counter, Win32GetWallClock());
+                    }
 #endif
 
+                    LARGE_INTEGER present_counter = Win32GetWallClock();
                     Win32DisplayBufferInWindow(&GlobalBackBuffer, device_context, 
                                                     dim.Width, dim.Height);
                     
                     flip_wall_clock = Win32GetWallClock();
+                    TelemetryRecordSeconds(&GlobalTelemetry, TelemetryTiming_Present,
+                                           Win32GetSecondsElapsed(present_counter, flip_wall_clock));
+
+                    if(GlobalTelemetryDumpRequested)
+                    {
+                        Win32WriteTelemetry(&GlobalTelemetry, &session_start);
+                        GlobalTelemetryDumpRequested = false;
+                    }
 
 #if APPLICATION_INTERNAL //NOTE: debug sound code
                     {
@@ -1165,6 +2832,10 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                     uint64 cycles_elapsed = end_cycle_count - last_cycle_count;
                     last_cycle_count = end_cycle_count; 
 
+#if APPLICATION_INTERNAL
+                    overlay_counters.MegaCyclesPerFrame = ((real64)cycles_elapsed / (1000.0f * 1000.0f));
+#endif
+
 #if 0
                     real64 fps = 0.0f; // (real64)PerfCountFrequency / (real64)counter_elapsed;
                     real64 mcpf = ((real64)cycles_elapsed / (1000.0f * 1000.0f));
@@ -1182,6 +2853,16 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR commandLi
                     }
 #endif
                 }
+
+                if(snapshotter_is_valid)
+                {
+                    Win32StopSnapshotter(&snapshotter);
+                }
+
+                // NOTE: a save the app handed off in its last frames still has to make it to the disk
+                Win32FinishFileRequests(&GlobalFileQueue);
+
+                Win32WriteTelemetry(&GlobalTelemetry, &session_start);
             }
             else 
             {
@@ -8,7 +8,8 @@ struct win32_window_dimension
 
 struct win32_sound_output
 {
-    int SamplesPerSecond;
+    int SamplesPerSecond; // NOTE: the device's rate
+    int AppSamplesPerSecond; // NOTE: the rate the app renders at, resampled to the device's
     int ToneHz;
     int16 ToneVolume;
     uint32 RunningSampleIndex;
@@ -17,7 +18,6 @@ struct win32_sound_output
     DWORD SecondaryBufferSize;
     real32 tSine;
     int LatencySampleCount;
-    DWORD SafetyBytes;
 };
 
 struct win32_offscreen_buffer
@@ -42,5 +42,228 @@ struct win32_debug_time_marker
     DWORD FlipWriteCursor;
 };
 
+#define WIN32_PAD_COUNT XUSER_MAX_COUNT
+#define WIN32_PAD_EVENT_RING_SIZE 1024 // NOTE: must be a power of 2
+
+// NOTE: stick directions ride along as extra button bits above the XInput ones
+#define WIN32_PAD_STICK_LEFT (1 << 16)
+#define WIN32_PAD_STICK_RIGHT (1 << 17)
+#define WIN32_PAD_STICK_DOWN (1 << 18)
+#define WIN32_PAD_STICK_UP (1 << 19)
+
+struct win32_pad_state
+{
+    bool32 IsConnected;
+    uint32 Buttons;
+    real32 StickX;
+    real32 StickY;
+};
+
+struct win32_pad_event
+{
+    uint64 Timestamp;
+    uint32 PadIndex;
+    uint32 ButtonBit;
+    bool32 IsDown;
+};
+
+struct win32_pad_snapshot
+{
+    uint64 Timestamp;
+    uint32 EventWriteIndex; // NOTE: every event before this is already part of the pad states
+    win32_pad_state Pads[WIN32_PAD_COUNT];
+};
+
+// the poll thread samples the pads about once a millisecond and publishes the latest state through a
+// seqlock, button changes in between go through a single producer single consumer ring
+struct win32_pad_poller
+{
+    uint32 volatile Sequence; // NOTE: odd while the poll thread is writing Published
+    win32_pad_snapshot Published;
+
+    uint32 volatile EventReadIndex; // NOTE: only the main thread writes this
+    win32_pad_event Events[WIN32_PAD_EVENT_RING_SIZE];
+    uint32 volatile DroppedEventCount;
+};
+
+#define WIN32_MAX_WORKER_THREAD_COUNT 63
+#define WIN32_JOB_DEQUE_SIZE 4096 // NOTE: must be a power of 2
+
+struct win32_job
+{
+    platform_work_queue_callback *Callback;
+    void *Data;
+    platform_job_counter *Counter;
+};
+
+// Chase-Lev deque, the owning thread pushes and pops at Bottom, everyone else steals at Top
+struct win32_job_deque
+{
+    int64 volatile Top;
+    uint8 TopPad[56]; // NOTE: keep the thieves' line away from the owner's
+
+    int64 volatile Bottom;
+    uint8 BottomPad[56];
+
+    win32_job Jobs[WIN32_JOB_DEQUE_SIZE];
+};
+
+// NOTE: Win32 fibers allocate their own stacks, so the pool is made once at startup
+#define WIN32_JOB_FIBER_COUNT 2048
+#define WIN32_JOB_FIBER_STACK_COMMIT_SIZE Kilobytes(8)
+#define WIN32_JOB_FIBER_STACK_RESERVE_SIZE Kilobytes(64)
+
+// set on platform_job_counter::Value while fibers are parked on it
+#define WIN32_COUNTER_HAS_WAITERS 0x80000000
+#define WIN32_COUNTER_COUNT_MASK 0x7FFFFFFF
+
+struct win32_job_fiber
+{
+    void *Handle;
+    platform_work_queue *Queue;
+    win32_job Job;
+    win32_job_fiber *Next; // NOTE: free list, ready list or the wait list of a counter
+};
+
+struct platform_work_queue
+{
+    uint32 DequeCount; // NOTE: deque 0 belongs to the main thread, the rest to the workers
+    win32_job_deque *Deques;
+
+    int32 volatile OutstandingJobCount;
+    int32 volatile SleepingWorkerCount;
+    HANDLE WakeSemaphore;
+
+    // NOTE: FiberLock covers the free list, the ready list and every counter's wait list
+    int32 volatile FiberLock;
+    win32_job_fiber *Fibers;
+    win32_job_fiber *FirstFreeFiber;
+    win32_job_fiber *FirstReadyFiber;
+    win32_job_fiber *LastReadyFiber;
+    int32 volatile ReadyFiberCount;
+};
+
+struct win32_worker_thread_info
+{
+    platform_work_queue *Queue;
+    uint32 ThreadIndex;
+};
+
+enum win32_fiber_switch_reason
+{
+    Win32FiberSwitch_Finished,
+    Win32FiberSwitch_Wait,
+};
+
+struct win32_thread_context
+{
+    uint32 ThreadIndex; // NOTE: which deque this thread owns
+    void *SchedulerFiber; // NOTE: the thread itself, converted to a fiber
+
+    win32_job_fiber *CurrentFiber; // NOTE: 0 while running on the thread's own stack
+    win32_job_fiber *SpareFiber; // NOTE: kept from the last finished job to skip the free list
+
+    // NOTE: what the job fiber wants done once it's switched back to the scheduler
+    win32_fiber_switch_reason SwitchReason;
+    platform_job_counter *WaitCounter;
+};
+
+#define WIN32_FILE_REQUEST_RING_SIZE 256
+
+enum win32_file_request_type
+{
+    Win32FileRequest_Open,
+    Win32FileRequest_Read,
+    Win32FileRequest_Close,
+    Win32FileRequest_Save,
+};
+
+struct win32_file_request
+{
+    win32_file_request_type Type;
+    platform_file_request *Request; // NOTE: 0 for closes
+
+    char *Filename; // NOTE: opens and saves
+    platform_file_handle *File;
+
+    HANDLE Handle; // NOTE: reads and closes
+    uint64 Offset;
+    uint64 Size; // NOTE: reads and saves
+    void *Dest; // NOTE: the data, for saves
+};
+
+// single producer ring, the main thread makes requests and the file thread carries them out
+struct win32_file_queue
+{
+    int32 volatile Lock; // NOTE: taken by whoever is adding a request, any thread may
+    uint32 volatile WriteIndex;
+    uint32 volatile ReadIndex;
+    uint32 volatile DoneIndex; // NOTE: requests before this one are finished, not just taken
+    HANDLE WakeSemaphore;
+
+    win32_file_request Requests[WIN32_FILE_REQUEST_RING_SIZE];
+};
+
+// NOTE: application_memory is saved once a second, each save only writes the pages that
+// changed since the last one, every WIN32_SNAPSHOT_KEYFRAME_INTERVAL'th writes everything
+#define WIN32_SNAPSHOT_INTERVAL_SECONDS 1.0f
+#define WIN32_SNAPSHOT_KEYFRAME_INTERVAL 30
+#define WIN32_SNAPSHOT_DIRECTORY "snapshots"
+#define WIN32_SNAPSHOT_MAGIC 0x50414E53 // NOTE: "SNAP"
+#define WIN32_SNAPSHOT_VERSION 1
+
+enum win32_snapshot_type
+{
+    Win32Snapshot_Keyframe,
+    Win32Snapshot_Delta,
+};
+
+// NOTE: followed by PageCount uint32 page indices, ascending, then the pages in the same order
+struct win32_snapshot_header
+{
+    uint32 Magic;
+    uint32 Version;
+    uint32 Type;
+    uint32 PageSize;
+    uint64 Sequence;
+    uint64 KeyframeSequence; // NOTE: the keyframe this delta applies on top of, with every delta in between
+    uint64 MemorySize;
+    uint64 PageCount;
+};
+
+struct win32_snapshotter
+{
+    uint8 *Memory; // NOTE: allocated with MEM_WRITE_WATCH
+    uint64 MemorySize;
+    uint32 PageSize;
+    uint32 MaxPageCount;
+    void **DirtyAddresses;
+
+    real32 SecondsSinceSnapshot;
+    uint64 NextSequence;
+
+    // NOTE: the main thread stages dirty pages here while the writer is idle, then hands them over
+    int32 volatile WriterIsBusy;
+    bool32 volatile IsStopping;
+    HANDLE WakeEvent;
+    HANDLE WriterThread;
+    uint32 *PageIndices;
+    uint8 *Staging; // NOTE: reserved for all of Memory, committed as far as it gets used
+    uint32 StagedPageCount;
+    uint64 StagedSequence;
+
+    // NOTE: writer thread only, unless it is idle. Shadow is Memory as of the last snapshot staged,
+    // every page that was ever written to is marked in TouchedPages
+    uint8 *Shadow;
+    uint8 *TouchedPages;
+    uint32 *KeyframePageIndices;
+    bool32 HasKeyframe;
+    bool32 NeedsKeyframe; // NOTE: a write failed, the chain up to LastWrittenSequence restores but can't grow
+    uint64 KeyframeSequence;
+    uint64 OldestSequenceOnDisk;
+    uint64 LastWrittenSequence;
+    uint64 LastWrittenByteCount;
+};
+
 #define WIN32_PLATFORM_LAYER_H
 #endif
\ No newline at end of file